@@ -4,6 +4,7 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "esp_log.h"
+#include <string.h>
 
 static void IRAM_ATTR gpio_isr_handler(void* arg) {
   const bool ret = 1; // dummy value to pass to queue
@@ -30,6 +31,25 @@ static esp_err_t ads1115_write_register(ads1115_t* ads, ads1115_register_address
   return ret;
 }
 
+// set the register pointer and read it in one transaction using a repeated start
+static esp_err_t ads1115_read_register_combined(ads1115_t* ads, ads1115_register_addresses_t reg, uint8_t* data, uint8_t len) {
+  i2c_cmd_handle_t cmd;
+  esp_err_t ret;
+
+  cmd = i2c_cmd_link_create();
+  i2c_master_start(cmd);
+  i2c_master_write_byte(cmd,(ads->address<<1) | I2C_MASTER_WRITE,1);
+  i2c_master_write_byte(cmd,reg,1);
+  i2c_master_start(cmd); // repeated start
+  i2c_master_write_byte(cmd,(ads->address<<1) | I2C_MASTER_READ,1);
+  i2c_master_read(cmd, data, len, I2C_MASTER_LAST_NACK);
+  i2c_master_stop(cmd);
+  ret = i2c_master_cmd_begin(ads->i2c_port, cmd, ads->max_ticks);
+  i2c_cmd_link_delete(cmd);
+  ads->last_reg = reg;
+  return ret;
+}
+
 static esp_err_t ads1115_read_register(ads1115_t* ads, ads1115_register_addresses_t reg, uint8_t* data, uint8_t len) {
   i2c_cmd_handle_t cmd;
   esp_err_t ret;
@@ -182,4 +202,97 @@ double ads1115_get_voltage_from_raw(ads1115_t* ads, int16_t raw) {
   const int16_t bits = (1L<<15)-1;
 
   return (double)raw * fsr[ads->config.bit.PGA] / (double)bits;
-}
\ No newline at end of file
+}
+
+// start a single-shot conversion on the sampler's current channel
+static esp_err_t ads1115_sampler_convert(ads1115_sampler_t* sampler) {
+  ads1115_t* ads = sampler->ads;
+
+  ads->config.bit.MUX = sampler->mux[sampler->current];
+  ads->config.bit.MODE = ADS1115_MODE_SINGLE;
+  ads->config.bit.OS = 1;
+  return ads1115_write_register(ads, ADS1115_CONFIG_REGISTER_ADDR, ads->config.reg);
+}
+
+// each RDY edge: read the finished conversion and start the next channel, two bus transactions per sample
+// if RDY stays quiet, e.g. ALERT/RDY is not wired to the rdy pin, poll the OS bit every tick instead until it comes back
+static void ads1115_sampler_task(void* arg) {
+  const static char* TAG = "ads1115_sampler";
+  ads1115_sampler_t* sampler = (ads1115_sampler_t*)arg;
+  ads1115_t* ads = sampler->ads;
+  const TickType_t restart_ticks = pdMS_TO_TICKS(20); // several conversion times at the slowest useful rate
+  TickType_t timeout = restart_ticks + 1;
+  TickType_t waited = 0;
+  bool polling = false;
+  uint8_t data[2];
+  esp_err_t err;
+  bool tmp; // temporary bool for reading from queue
+
+  while(1) {
+    if(xQueueReceive(ads->rdy_pin.gpio_evt_queue, &tmp, timeout) == pdTRUE) {
+      if(polling) { // RDY is back, e.g. after the chip was off the bus for a while
+        ESP_LOGW(TAG,"RDY edges on GPIO %d again, stopped polling",ads->rdy_pin.pin);
+        polling = false;
+        timeout = restart_ticks + 1;
+      }
+    }
+    else {
+      err = ads1115_read_register_combined(ads, ADS1115_CONFIG_REGISTER_ADDR, data, 2);
+      if(err != ESP_OK || !(data[0] & 0x80)) { // OS bit reads 0 while converting
+        waited += timeout;
+        if(waited > restart_ticks) {
+          ESP_LOGW(TAG,"no conversion ready, restarting");
+          waited = 0;
+          ads1115_sampler_convert(sampler);
+        }
+        continue;
+      }
+      if(!polling) {
+        ESP_LOGW(TAG,"no RDY edge on GPIO %d, polling conversions instead",ads->rdy_pin.pin);
+        polling = true;
+        timeout = 1;
+      }
+    }
+    waited = 0;
+
+    err = ads1115_read_register_combined(ads, ADS1115_CONVERSION_REGISTER_ADDR, data, 2);
+    if(err == ESP_OK) {
+      sampler->raw[sampler->current] = ((uint16_t)data[0] << 8) | (uint16_t)data[1];
+      sampler->conversions[sampler->current]++;
+    }
+    else ESP_LOGE(TAG,"could not read from device: %s",esp_err_to_name(err));
+
+    sampler->current = (sampler->current + 1) % sampler->num_channels;
+    err = ads1115_sampler_convert(sampler);
+    if(err) ESP_LOGE(TAG,"could not write to device: %s",esp_err_to_name(err));
+  }
+}
+
+esp_err_t ads1115_sampler_start(ads1115_sampler_t* sampler, ads1115_t* ads, const ads1115_mux_t* mux, uint8_t num_channels) {
+  BaseType_t status;
+
+  if(!ads->rdy_pin.in_use || num_channels == 0 || num_channels > ADS1115_SAMPLER_MAX_CHANNELS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(sampler, 0, sizeof(ads1115_sampler_t));
+  sampler->ads = ads;
+  sampler->num_channels = num_channels;
+  memcpy(sampler->mux, mux, num_channels * sizeof(ads1115_mux_t));
+
+  gpio_isr_handler_add(ads->rdy_pin.pin, gpio_isr_handler, (void*)ads->rdy_pin.gpio_evt_queue);
+  xQueueReset(ads->rdy_pin.gpio_evt_queue);
+
+  status = xTaskCreate(ads1115_sampler_task, "ads1115_sampler", 2048, sampler, tskIDLE_PRIORITY + 2, &sampler->task);
+  if(status != pdPASS) {
+    gpio_isr_handler_remove(ads->rdy_pin.pin);
+    return ESP_ERR_NO_MEM;
+  }
+  ads->changed = 0;
+  return ads1115_sampler_convert(sampler);
+}
+
+int16_t ads1115_sampler_get_raw(ads1115_sampler_t* sampler, uint8_t index) {
+  assert(index < sampler->num_channels);
+  return sampler->raw[index];
+}
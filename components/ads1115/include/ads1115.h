@@ -8,6 +8,10 @@ extern "C" {
 #include <stdio.h>
 #include "driver/i2c.h"
 #include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define ADS1115_SAMPLER_MAX_CHANNELS 4
 
 typedef enum { // register address
   ADS1115_CONVERSION_REGISTER_ADDR = 0,
@@ -84,6 +88,16 @@ typedef struct {
   TickType_t max_ticks; // maximum wait ticks for i2c bus
 } ads1115_t;
 
+typedef struct {
+  ads1115_t* ads;
+  ads1115_mux_t mux[ADS1115_SAMPLER_MAX_CHANNELS]; // channels sampled in turn
+  uint8_t num_channels;
+  uint8_t current; // channel currently converting
+  volatile int16_t raw[ADS1115_SAMPLER_MAX_CHANNELS]; // latest reading per channel
+  volatile uint32_t conversions[ADS1115_SAMPLER_MAX_CHANNELS]; // number of readings per channel
+  TaskHandle_t task;
+} ads1115_sampler_t;
+
 // initialize device
 ads1115_t ads1115_config(i2c_port_t i2c_port, uint8_t address); // set up configuration
 
@@ -99,6 +113,10 @@ int16_t ads1115_get_raw(ads1115_t* ads); // get voltage in bits
 double ads1115_get_voltage(ads1115_t* ads); // get voltage in volts
 double ads1115_get_voltage_from_raw(ads1115_t* ads, int16_t raw); // Get voltage from a raw reading
 
+// background round-robin sampling, requires ads1115_set_rdy_pin, polls one conversion per tick if RDY never fires
+esp_err_t ads1115_sampler_start(ads1115_sampler_t* sampler, ads1115_t* ads, const ads1115_mux_t* mux, uint8_t num_channels); // start sampling the given channels
+int16_t ads1115_sampler_get_raw(ads1115_sampler_t* sampler, uint8_t index); // latest reading of a channel, never blocks
+
 
 #endif // ifdef ADS1115_H
 
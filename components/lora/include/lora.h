@@ -3,6 +3,8 @@
 #define __LORA_H__
 
 void lora_reset(void);
+void lora_begin_batch(void);
+void lora_end_batch(void);
 void lora_explicit_header_mode(void);
 void lora_implicit_header_mode(int size);
 void lora_idle(void);
@@ -18,7 +20,12 @@ void lora_set_sync_word(int sw);
 void lora_enable_crc(void);
 void lora_disable_crc(void);
 int lora_init(void);
+void lora_write_fifo(const uint8_t *buf, int size);
+void lora_read_fifo(uint8_t *buf, int size);
 void lora_send_packet(uint8_t *buf, int size);
+void lora_send_packet_async(uint8_t *buf, int size);
+int lora_tx_done(void);
+void lora_send_packet_complete(void);
 int lora_receive_packet(uint8_t *buf, int size);
 int lora_received(void);
 int lora_packet_rssi(void);
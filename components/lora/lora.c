@@ -2,6 +2,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_system.h"
+#include "esp_attr.h"
 #include "driver/spi_master.h"
 #include "soc/gpio_struct.h"
 #include "driver/gpio.h"
@@ -60,16 +61,82 @@
 #define IRQ_PAYLOAD_CRC_ERROR_MASK     0x20
 #define IRQ_RX_DONE_MASK               0x40
 
+/*
+ * DIO0 mapping (LoRa mode)
+ */
+#define DIO0_RX_DONE                   0x00
+#define DIO0_TX_DONE                   0x40
+
 #define PA_OUTPUT_RFO_PIN              0
 #define PA_OUTPUT_PA_BOOST_PIN         1
 
 #define TIMEOUT_RESET                  100
 
+#define FIFO_SIZE                      256
+
+#define SPI_QUEUE_SIZE                 16
+
 static spi_device_handle_t __spi;
 
 static int __implicit;
 static long __frequency;
 
+/*
+ * Shadow copies of the modem config registers so that the setters do not
+ * need a read-modify-write SPI round trip and can be queued in a batch.
+ */
+static uint8_t __modem_config_1;
+static uint8_t __modem_config_2;
+
+/*
+ * Register writes queued while in batch mode, see lora_begin_batch().
+ */
+static spi_transaction_t __queued[SPI_QUEUE_SIZE];
+static int __queued_count;
+static int __batch;
+
+/*
+ * Burst FIFO transfer buffers. Kept off the caller's stack, the receive task
+ * would otherwise need 512 bytes more, and word aligned so the SPI DMA can use
+ * them directly. Callers already serialize all radio access.
+ */
+WORD_ALIGNED_ATTR static uint8_t __fifo_out[FIFO_SIZE];
+WORD_ALIGNED_ATTR static uint8_t __fifo_in[FIFO_SIZE];
+
+/**
+ * Wait for all queued register writes to finish.
+ */
+static void
+lora_flush_queue(void)
+{
+   spi_transaction_t *result;
+
+   for(int i=0; i<__queued_count; i++)
+      spi_device_get_trans_result(__spi, &result, portMAX_DELAY);
+   __queued_count = 0;
+}
+
+/**
+ * Start batching register writes.
+ * Writes are queued to the SPI driver and clocked out back to back without
+ * waiting for each one to finish. Reads flush the queue first.
+ */
+void
+lora_begin_batch(void)
+{
+   __batch = 1;
+}
+
+/**
+ * Wait for all batched writes to complete and go back to synchronous access.
+ */
+void
+lora_end_batch(void)
+{
+   lora_flush_queue();
+   __batch = 0;
+}
+
 /**
  * Write a value to a register.
  * @param reg Register index.
@@ -78,19 +145,26 @@ static long __frequency;
 void 
 lora_write_reg(int reg, int val)
 {
-   uint8_t out[2] = { 0x80 | reg, val };
-   uint8_t in[2];
+   if (__batch) {
+      if (__queued_count == SPI_QUEUE_SIZE) lora_flush_queue();
+
+      spi_transaction_t *t = &__queued[__queued_count++];
+      memset(t, 0, sizeof(spi_transaction_t));
+      t->flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA;
+      t->length = 16;
+      t->tx_data[0] = 0x80 | reg;
+      t->tx_data[1] = val;
+      spi_device_queue_trans(__spi, t, portMAX_DELAY);
+      return;
+   }
 
    spi_transaction_t t = {
-      .flags = 0,
-      .length = 8 * sizeof(out),
-      .tx_buffer = out,
-      .rx_buffer = in  
+      .flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA,
+      .length = 16,
+      .tx_data = { 0x80 | reg, val }
    };
 
-   gpio_set_level(CONFIG_CS_GPIO, 0);
-   spi_device_transmit(__spi, &t);
-   gpio_set_level(CONFIG_CS_GPIO, 1);
+   spi_device_polling_transmit(__spi, &t);
 }
 
 /**
@@ -101,20 +175,68 @@ lora_write_reg(int reg, int val)
 int
 lora_read_reg(int reg)
 {
-   uint8_t out[2] = { reg, 0xff };
-   uint8_t in[2];
+   lora_flush_queue();
+
+   spi_transaction_t t = {
+      .flags = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA,
+      .length = 16,
+      .tx_data = { reg, 0xff }
+   };
+
+   spi_device_polling_transmit(__spi, &t);
+   return t.rx_data[1];
+}
+
+/**
+ * Write a block of data to the FIFO in a single burst access.
+ * The register address is sent once and the radio auto-increments the FIFO pointer.
+ * @param buf Data to write.
+ * @param size Number of bytes to write (at most 255).
+ */
+void
+lora_write_fifo(const uint8_t *buf, int size)
+{
+   assert(size < FIFO_SIZE);
+   if (size <= 0) return;
+
+   __fifo_out[0] = 0x80 | REG_FIFO;
+   memcpy(&__fifo_out[1], buf, size);
 
    spi_transaction_t t = {
       .flags = 0,
-      .length = 8 * sizeof(out),
-      .tx_buffer = out,
-      .rx_buffer = in
+      .length = 8 * (size + 1),
+      .tx_buffer = __fifo_out,
+      .rx_buffer = NULL
    };
 
-   gpio_set_level(CONFIG_CS_GPIO, 0);
-   spi_device_transmit(__spi, &t);
-   gpio_set_level(CONFIG_CS_GPIO, 1);
-   return in[1];
+   lora_flush_queue();
+   spi_device_polling_transmit(__spi, &t);
+}
+
+/**
+ * Read a block of data from the FIFO in a single burst access.
+ * @param buf Buffer for the data.
+ * @param size Number of bytes to read (at most 255).
+ */
+void
+lora_read_fifo(uint8_t *buf, int size)
+{
+   assert(size < FIFO_SIZE);
+   if (size <= 0) return;
+
+   memset(__fifo_out, 0xff, size + 1);
+   __fifo_out[0] = REG_FIFO;
+
+   spi_transaction_t t = {
+      .flags = 0,
+      .length = 8 * (size + 1),
+      .tx_buffer = __fifo_out,
+      .rx_buffer = __fifo_in
+   };
+
+   lora_flush_queue();
+   spi_device_polling_transmit(__spi, &t);
+   memcpy(buf, &__fifo_in[1], size);
 }
 
 /**
@@ -137,7 +259,8 @@ void
 lora_explicit_header_mode(void)
 {
    __implicit = 0;
-   lora_write_reg(REG_MODEM_CONFIG_1, lora_read_reg(REG_MODEM_CONFIG_1) & 0xfe);
+   __modem_config_1 &= 0xfe;
+   lora_write_reg(REG_MODEM_CONFIG_1, __modem_config_1);
 }
 
 /**
@@ -149,7 +272,8 @@ void
 lora_implicit_header_mode(int size)
 {
    __implicit = 1;
-   lora_write_reg(REG_MODEM_CONFIG_1, lora_read_reg(REG_MODEM_CONFIG_1) | 0x01);
+   __modem_config_1 |= 0x01;
+   lora_write_reg(REG_MODEM_CONFIG_1, __modem_config_1);
    lora_write_reg(REG_PAYLOAD_LENGTH, size);
 }
 
@@ -230,7 +354,8 @@ lora_set_spreading_factor(int sf)
       lora_write_reg(REG_DETECTION_THRESHOLD, 0x0a);
    }
 
-   lora_write_reg(REG_MODEM_CONFIG_2, (lora_read_reg(REG_MODEM_CONFIG_2) & 0x0f) | ((sf << 4) & 0xf0));
+   __modem_config_2 = (__modem_config_2 & 0x0f) | ((sf << 4) & 0xf0);
+   lora_write_reg(REG_MODEM_CONFIG_2, __modem_config_2);
 }
 
 /**
@@ -252,7 +377,8 @@ lora_set_bandwidth(long sbw)
    else if (sbw <= 125E3) bw = 7;
    else if (sbw <= 250E3) bw = 8;
    else bw = 9;
-   lora_write_reg(REG_MODEM_CONFIG_1, (lora_read_reg(REG_MODEM_CONFIG_1) & 0x0f) | (bw << 4));
+   __modem_config_1 = (__modem_config_1 & 0x0f) | (bw << 4);
+   lora_write_reg(REG_MODEM_CONFIG_1, __modem_config_1);
 }
 
 /**
@@ -266,7 +392,8 @@ lora_set_coding_rate(int denominator)
    else if (denominator > 8) denominator = 8;
 
    int cr = denominator - 4;
-   lora_write_reg(REG_MODEM_CONFIG_1, (lora_read_reg(REG_MODEM_CONFIG_1) & 0xf1) | (cr << 1));
+   __modem_config_1 = (__modem_config_1 & 0xf1) | (cr << 1);
+   lora_write_reg(REG_MODEM_CONFIG_1, __modem_config_1);
 }
 
 /**
@@ -296,7 +423,8 @@ lora_set_sync_word(int sw)
 void 
 lora_enable_crc(void)
 {
-   lora_write_reg(REG_MODEM_CONFIG_2, lora_read_reg(REG_MODEM_CONFIG_2) | 0x04);
+   __modem_config_2 |= 0x04;
+   lora_write_reg(REG_MODEM_CONFIG_2, __modem_config_2);
 }
 
 /**
@@ -305,7 +433,8 @@ lora_enable_crc(void)
 void 
 lora_disable_crc(void)
 {
-   lora_write_reg(REG_MODEM_CONFIG_2, lora_read_reg(REG_MODEM_CONFIG_2) & 0xfb);
+   __modem_config_2 &= 0xfb;
+   lora_write_reg(REG_MODEM_CONFIG_2, __modem_config_2);
 }
 
 /**
@@ -321,8 +450,6 @@ lora_init(void)
     */
    gpio_pad_select_gpio(CONFIG_RST_GPIO);
    gpio_set_direction(CONFIG_RST_GPIO, GPIO_MODE_OUTPUT);
-   gpio_pad_select_gpio(CONFIG_CS_GPIO);
-   gpio_set_direction(CONFIG_CS_GPIO, GPIO_MODE_OUTPUT);
 
    spi_bus_config_t bus = {
       .miso_io_num = CONFIG_MISO_GPIO,
@@ -330,17 +457,17 @@ lora_init(void)
       .sclk_io_num = CONFIG_SCK_GPIO,
       .quadwp_io_num = -1,
       .quadhd_io_num = -1,
-      .max_transfer_sz = 0
+      .max_transfer_sz = FIFO_SIZE + 1
    };
            
-   ret = spi_bus_initialize(VSPI_HOST, &bus, 0);
+   ret = spi_bus_initialize(VSPI_HOST, &bus, 1);
    assert(ret == ESP_OK);
 
    spi_device_interface_config_t dev = {
       .clock_speed_hz = 9000000,
       .mode = 0,
-      .spics_io_num = -1,
-      .queue_size = 1,
+      .spics_io_num = CONFIG_CS_GPIO,
+      .queue_size = SPI_QUEUE_SIZE,
       .flags = 0,
       .pre_cb = NULL
    };
@@ -376,6 +503,8 @@ lora_init(void)
    lora_write_reg(REG_FIFO_TX_BASE_ADDR, 0);
    lora_write_reg(REG_LNA, lora_read_reg(REG_LNA) | 0x03);
    lora_write_reg(REG_MODEM_CONFIG_3, 0x04);
+   __modem_config_1 = lora_read_reg(REG_MODEM_CONFIG_1);
+   __modem_config_2 = lora_read_reg(REG_MODEM_CONFIG_2);
    lora_set_tx_power(17);
 
    lora_idle();
@@ -383,32 +512,71 @@ lora_init(void)
 }
 
 /**
- * Send a packet.
+ * Start transmission of a packet without waiting for it to finish.
+ * DIO0 is mapped to TxDone, so completion can be picked up from the DIO0 interrupt.
+ * Call lora_send_packet_complete() once lora_tx_done() returns non-zero.
  * @param buf Data to be sent
  * @param size Size of data.
  */
 void 
-lora_send_packet(uint8_t *buf, int size)
+lora_send_packet_async(uint8_t *buf, int size)
 {
    /*
     * Transfer data to radio.
     */
    lora_idle();
    lora_write_reg(REG_FIFO_ADDR_PTR, 0);
+   lora_write_fifo(buf, size);
 
-   for(int i=0; i<size; i++) 
-      lora_write_reg(REG_FIFO, *buf++);
-   
    lora_write_reg(REG_PAYLOAD_LENGTH, size);
-   
+
    /*
-    * Start transmission and wait for conclusion.
+    * Raise DIO0 on TxDone and start transmission.
     */
+   lora_write_reg(REG_DIO_MAPPING_1, DIO0_TX_DONE);
    lora_write_reg(REG_OP_MODE, MODE_LONG_RANGE_MODE | MODE_TX);
-   while((lora_read_reg(REG_IRQ_FLAGS) & IRQ_TX_DONE_MASK) == 0)
+}
+
+/**
+ * Returns non-zero if the last transmission has finished.
+ */
+int
+lora_tx_done(void)
+{
+   if(lora_read_reg(REG_IRQ_FLAGS) & IRQ_TX_DONE_MASK) return 1;
+   return 0;
+}
+
+/**
+ * Finish an asynchronous transmission.
+ * Clears TxDone, maps DIO0 back to RxDone and puts the radio in receive mode.
+ */
+void
+lora_send_packet_complete(void)
+{
+   lora_write_reg(REG_IRQ_FLAGS, IRQ_TX_DONE_MASK);
+   lora_write_reg(REG_DIO_MAPPING_1, DIO0_RX_DONE);
+   lora_receive();
+}
+
+/**
+ * Send a packet.
+ * @param buf Data to be sent
+ * @param size Size of data.
+ */
+void 
+lora_send_packet(uint8_t *buf, int size)
+{
+   lora_send_packet_async(buf, size);
+
+   /*
+    * Wait for conclusion.
+    */
+   while(!lora_tx_done())
       vTaskDelay(2);
 
    lora_write_reg(REG_IRQ_FLAGS, IRQ_TX_DONE_MASK);
+   lora_write_reg(REG_DIO_MAPPING_1, DIO0_RX_DONE);
 }
 
 /**
@@ -442,8 +610,7 @@ lora_receive_packet(uint8_t *buf, int size)
    lora_idle();   
    lora_write_reg(REG_FIFO_ADDR_PTR, lora_read_reg(REG_FIFO_RX_CURRENT_ADDR));
    if(len > size) len = size;
-   for(int i=0; i<len; i++) 
-      *buf++ = lora_read_reg(REG_FIFO);
+   lora_read_fifo(buf, len);
 
    return len;
 }
@@ -0,0 +1,124 @@
+#include <string.h>
+#include "adc_dma.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/i2s.h"
+#include "soc/syscon_struct.h"
+#include "esp_log.h"
+
+/*
+ * ADC1 is sampled continuously by the I2S peripheral which DMAs the conversions to memory.
+ * The SAR pattern table makes the ADC scan all configured channels in turn, each 16 bit
+ * sample carries the channel number in its upper 4 bits.
+ */
+
+#define ADC_DMA_I2S_NUM         I2S_NUM_0
+#define ADC_DMA_SAMPLE_RATE     12000   // Conversions per second, shared by all channels
+#define ADC_DMA_BUF_LEN         256     // Samples per DMA buffer
+#define ADC_DMA_BUF_COUNT       4
+#define ADC_DMA_RING_LEN        64      // Samples kept per channel, power of 2
+#define ADC_DMA_BIT_WIDTH_12    3
+#define INVALID_INDEX           0xFF
+
+typedef struct adc_ring {
+    uint16_t            samples[ADC_DMA_RING_LEN];
+    volatile uint32_t   head;
+} adc_ring;
+
+static void adc_dma_task(void* params);
+static void set_pattern(uint8_t index, adc1_channel_t channel, adc_atten_t atten);
+
+static const char* TAG = "ADC_DMA";
+
+static adc_ring rings[ADC_DMA_MAX_CHANNELS];
+static uint8_t channel_index[ADC1_CHANNEL_MAX];
+static uint8_t num_active_channels;
+
+void adc_dma_init(const adc1_channel_t* channels, uint8_t num_channels, adc_atten_t atten)
+{
+    assert(num_channels > 0 && num_channels <= ADC_DMA_MAX_CHANNELS);
+    memset(rings, 0, sizeof(rings));
+    memset(channel_index, INVALID_INDEX, sizeof(channel_index));
+    num_active_channels = num_channels;
+
+    i2s_config_t i2s_config = {
+        .mode = I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN,
+        .sample_rate = ADC_DMA_SAMPLE_RATE,
+        .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+        .communication_format = I2S_COMM_FORMAT_I2S_MSB,
+        .intr_alloc_flags = 0,
+        .dma_buf_count = ADC_DMA_BUF_COUNT,
+        .dma_buf_len = ADC_DMA_BUF_LEN,
+        .use_apll = false,
+    };
+    ESP_ERROR_CHECK(i2s_driver_install(ADC_DMA_I2S_NUM, &i2s_config, 0, NULL));
+    ESP_ERROR_CHECK(i2s_set_adc_mode(ADC_UNIT_1, channels[0]));
+    ESP_ERROR_CHECK(i2s_adc_enable(ADC_DMA_I2S_NUM));
+
+    // i2s_adc_enable() sets up a single channel pattern, overwrite it to scan all channels
+    SYSCON.saradc_ctrl.sar1_patt_len = num_channels - 1;
+    for (uint8_t i = 0; i < num_channels; i++) {
+        assert(channels[i] < ADC1_CHANNEL_MAX);
+        channel_index[channels[i]] = i;
+        set_pattern(i, channels[i], atten);
+    }
+
+    TaskHandle_t handle;
+    BaseType_t status = xTaskCreate(adc_dma_task, "adc_dma_task", 2048, NULL, tskIDLE_PRIORITY + 3, &handle);
+    assert(status == pdPASS);
+    ESP_LOGI(TAG, "Sampling %d channels at %d Hz each", num_channels, ADC_DMA_SAMPLE_RATE / num_channels);
+}
+
+// Mean of the latest num_samples 12 bit readings of the channel at index in the list given to adc_dma_init
+uint32_t adc_dma_get_average(uint8_t index, uint8_t num_samples)
+{
+    assert(index < num_active_channels);
+    assert(num_samples > 0 && num_samples <= ADC_DMA_RING_LEN);
+    adc_ring* ring = &rings[index];
+    uint32_t head = ring->head;
+    uint32_t sum = 0;
+
+    if (head < num_samples) {
+        num_samples = head;
+        if (num_samples == 0) {
+            return 0;
+        }
+    }
+
+    for (uint8_t i = 1; i <= num_samples; i++) {
+        sum += ring->samples[(head - i) & (ADC_DMA_RING_LEN - 1)];
+    }
+    return sum / num_samples;
+}
+
+static void adc_dma_task(void* params)
+{
+    uint16_t buf[ADC_DMA_BUF_LEN];
+    size_t bytes_read;
+
+    while (true) {
+        if (i2s_read(ADC_DMA_I2S_NUM, buf, sizeof(buf), &bytes_read, portMAX_DELAY) != ESP_OK) {
+            continue;
+        }
+        for (size_t i = 0; i < bytes_read / sizeof(uint16_t); i++) {
+            uint8_t channel = buf[i] >> 12;
+            if (channel >= ADC1_CHANNEL_MAX || channel_index[channel] == INVALID_INDEX) {
+                continue;
+            }
+            adc_ring* ring = &rings[channel_index[channel]];
+            ring->samples[ring->head & (ADC_DMA_RING_LEN - 1)] = buf[i] & 0x0FFF;
+            ring->head++;
+        }
+    }
+}
+
+// Pattern table entries are 8 bits: channel << 4 | bit width << 2 | attenuation, four per register MSB first
+static void set_pattern(uint8_t index, adc1_channel_t channel, adc_atten_t atten)
+{
+    uint8_t reg = index / 4;
+    uint8_t offset = (3 - index % 4) * 8;
+    uint32_t entry = (channel << 4) | (ADC_DMA_BIT_WIDTH_12 << 2) | atten;
+
+    SYSCON.saradc_sar1_patt_tab[reg] = (SYSCON.saradc_sar1_patt_tab[reg] & ~(0xFFUL << offset)) | (entry << offset);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+#include "driver/adc.h"
+
+#define ADC_DMA_MAX_CHANNELS    16      // Size of the SAR ADC1 pattern table
+
+void adc_dma_init(const adc1_channel_t* channels, uint8_t num_channels, adc_atten_t atten);
+uint32_t adc_dma_get_average(uint8_t index, uint8_t num_samples);
@@ -10,11 +10,45 @@
 #define ROVER_STATIC_IP                     "192.168.4.5"
 #define ROVER_CAM_STATIC_IP                 "192.168.4.6"
 
+// Phones on the web server at once, the AP has room for them next to the Rover and its camera
+#define ROVER_MAX_PHONES                    3
+#define AP_MAX_STATIONS                     (ROVER_MAX_PHONES + 2)
+
+// Send frame_codec encoded control frames over LoRa instead of raw channels, Rover must support it
+//#define ROVER_LORA_COMPACT_FRAMES
+
+// Switch LoRa profiles on the link quality of telematics, Rover must support it, see transport_lora.h.
+// Slower profiles are only used if a control frame and a 100 byte telematics frame fit the control period,
+// at the 100 ms period that is none of them so this stays off until the period or the Rover slot changes.
+//#define ROVER_LORA_ADR
+
+// Batch telematics to phones into one websocket frame per window of this many ms, phone must support it, see web_server.h
+//#define ROVER_PHONE_TELEMATICS_BATCH_MS     30
+
+// Only send phones the telematics fields that changed, see rover_telematics.h
+//#define ROVER_PHONE_TELEMATICS_DELTAS
+
+// Log the control latency histograms on serial this often, see latency_probe.h
+//#define ROVER_LATENCY_LOG_INTERVAL_MS       10000
+
+// Record all control and telematics frames to the recorder flash partition, see flight_recorder.h
+//#define ROVER_FLIGHT_RECORDER
+
+// Send control frames to the Rover over UDP instead of the websocket, Rover must support it, see transport_udp.h
+//#define ROVER_UDP_CONTROL
+#define ROVER_UDP_CONTROL_PORT              8081
+#define ROVER_CONTROLLER_UDP_CONTROL_PORT   8082
+
+// Send every control frame over both the websocket and LoRa when WiFi is selected, Rover must support it, see redundant_link.h
+//#define ROVER_REDUNDANT_TRANSPORT
+
 #define ROVER_CONTROLLER_MIN_TX_VALUE       1000
 #define ROVER_CONTROLLER_MAX_TX_VALUE       2000
 
 #define ROVER_CONTROLLER_SDA                GPIO_NUM_22
 #define ROVER_CONTROLLER_SCL                GPIO_NUM_23
+// ADS1115 ALERT/RDY, boards without this wire still work but the pots are only polled once per tick
+#define ROVER_CONTROLLER_ADS_RDY            GPIO_NUM_16
 
 #define LED_RIGHT_GPIO                      GPIO_NUM_15
 #define LED_LEFT_GPIO                       GPIO_NUM_12
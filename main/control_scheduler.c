@@ -0,0 +1,198 @@
+#include <string.h>
+#include "control_scheduler.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "assert.h"
+
+#define DEFAULT_SAMPLE_BUDGET_US    2000
+#define DEFAULT_FILTER_BUDGET_US    500
+#define DEFAULT_ENCODE_BUDGET_US    500
+#define DEFAULT_SEND_BUDGET_US      5000    // Encoding for and handing the frame to the transports, the waits are in LINK_WAIT
+
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static uint16_t period_ms;
+static TickType_t last_wake_tick;
+static int64_t cycle_due_us;
+static int64_t cycle_start_us;
+static bool cycle_open;
+static uint64_t jitter_sum_us;
+static int64_t stage_start_us[CONTROL_STAGE_END];
+static uint32_t nested_us[CONTROL_STAGE_END];      // Time spent in stages nested in this one, not counted against it
+static control_scheduler_stats_t stats;
+
+static const uint32_t default_budget_us[CONTROL_STAGE_END] = {
+    [CONTROL_STAGE_SAMPLE] = DEFAULT_SAMPLE_BUDGET_US,
+    [CONTROL_STAGE_FILTER] = DEFAULT_FILTER_BUDGET_US,
+    [CONTROL_STAGE_ENCODE] = DEFAULT_ENCODE_BUDGET_US,
+    [CONTROL_STAGE_SEND] = DEFAULT_SEND_BUDGET_US,
+};
+
+// Stages that run inside another one, CONTROL_STAGE_END if not nested
+static const control_stage_t parent_stage[CONTROL_STAGE_END] = {
+    [CONTROL_STAGE_SAMPLE] = CONTROL_STAGE_END,
+    [CONTROL_STAGE_FILTER] = CONTROL_STAGE_END,
+    [CONTROL_STAGE_ENCODE] = CONTROL_STAGE_END,
+    [CONTROL_STAGE_SEND] = CONTROL_STAGE_END,
+    [CONTROL_STAGE_LINK_WAIT] = CONTROL_STAGE_SEND,
+};
+
+static void finish_cycle(void);
+
+void control_scheduler_init(uint16_t period)
+{
+    // The wake up is done on tick level so the period has to be a whole number of ticks
+    assert(period >= portTICK_PERIOD_MS && period % portTICK_PERIOD_MS == 0);
+    period_ms = period;
+    memset(&stats, 0, sizeof(stats));
+    jitter_sum_us = 0;
+    stats.period_us = period * 1000;
+    for (uint8_t i = 0; i < CONTROL_STAGE_END; i++) {
+        stats.stages[i].budget_us = default_budget_us[i];
+    }
+    // Until the transport sets it from its slot plan, waiting a whole period is an overrun
+    stats.stages[CONTROL_STAGE_LINK_WAIT].budget_us = stats.period_us;
+    last_wake_tick = xTaskGetTickCount();
+    cycle_due_us = esp_timer_get_time();
+    cycle_open = false;
+}
+
+uint16_t control_scheduler_get_period_ms(void)
+{
+    return period_ms;
+}
+
+// Only meaningful in the sampling task, the next cycle may have started when read from another task
+int64_t control_scheduler_get_cycle_start_us(void)
+{
+    portENTER_CRITICAL(&lock);
+    int64_t start_us = cycle_start_us;
+    portEXIT_CRITICAL(&lock);
+
+    return start_us;
+}
+
+void control_scheduler_set_budget(control_stage_t stage, uint32_t budget_us)
+{
+    assert(stage < CONTROL_STAGE_END);
+    portENTER_CRITICAL(&lock);
+    stats.stages[stage].budget_us = budget_us;
+    portEXIT_CRITICAL(&lock);
+}
+
+void control_scheduler_wait_next_cycle(void)
+{
+    const TickType_t period_ticks = pdMS_TO_TICKS(period_ms);
+    uint32_t missed = 0;
+
+    portENTER_CRITICAL(&lock);
+    // Previous cycle never reached the send stage, it still counts against the deadline
+    finish_cycle();
+    portEXIT_CRITICAL(&lock);
+
+    // cycle_due_us and last_wake_tick are only used by this task
+    int64_t now = esp_timer_get_time();
+    cycle_due_us += stats.period_us;
+    if (now > cycle_due_us) {
+        // Overran by more than a period, skip the missed cycles instead of running them back to back
+        missed = (now - cycle_due_us) / stats.period_us + 1;
+        cycle_due_us += (int64_t)missed * stats.period_us;
+        // Stays on the tick schedule, a delay from now would round to a tick early and shift every later cycle
+        last_wake_tick += missed * period_ticks;
+    }
+    vTaskDelayUntil(&last_wake_tick, period_ticks);
+
+    int64_t start_us = esp_timer_get_time();
+    uint32_t jitter = start_us > cycle_due_us ? start_us - cycle_due_us : cycle_due_us - start_us;
+
+    portENTER_CRITICAL(&lock);
+    cycle_start_us = start_us;
+    stats.skipped_cycles += missed;
+    stats.cycles++;
+    stats.last_jitter_us = jitter;
+    if (jitter > stats.max_jitter_us) {
+        stats.max_jitter_us = jitter;
+    }
+    jitter_sum_us += jitter;
+    stats.avg_jitter_us = jitter_sum_us / stats.cycles;
+    cycle_open = true;
+    portEXIT_CRITICAL(&lock);
+}
+
+void control_scheduler_stage_begin(control_stage_t stage)
+{
+    assert(stage < CONTROL_STAGE_END);
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&lock);
+    stage_start_us[stage] = now;
+    nested_us[stage] = 0;
+    portEXIT_CRITICAL(&lock);
+}
+
+void control_scheduler_stage_end(control_stage_t stage)
+{
+    assert(stage < CONTROL_STAGE_END);
+    control_stage_stats_t* stage_stats = &stats.stages[stage];
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&lock);
+    uint32_t duration = now - stage_start_us[stage];
+    if (parent_stage[stage] != CONTROL_STAGE_END) {
+        nested_us[parent_stage[stage]] += duration;
+    }
+    duration = duration > nested_us[stage] ? duration - nested_us[stage] : 0;
+
+    stage_stats->last_us = duration;
+    if (duration > stage_stats->max_us) {
+        stage_stats->max_us = duration;
+    }
+    if (duration > stage_stats->budget_us) {
+        stage_stats->overruns++;
+    }
+    portEXIT_CRITICAL(&lock);
+}
+
+void control_scheduler_cycle_done(void)
+{
+    portENTER_CRITICAL(&lock);
+    finish_cycle();
+    portEXIT_CRITICAL(&lock);
+}
+
+// Must be called with lock held
+static void finish_cycle(void)
+{
+    if (!cycle_open) {
+        return;
+    }
+    cycle_open = false;
+    if (esp_timer_get_time() > cycle_start_us + stats.period_us) {
+        stats.deadline_misses++;
+    }
+}
+
+void control_scheduler_get_stats(control_scheduler_stats_t* out)
+{
+    assert(out != NULL);
+    portENTER_CRITICAL(&lock);
+    *out = stats;
+    portEXIT_CRITICAL(&lock);
+}
+
+void control_scheduler_reset_stats(void)
+{
+    portENTER_CRITICAL(&lock);
+    for (uint8_t i = 0; i < CONTROL_STAGE_END; i++) {
+        stats.stages[i].last_us = 0;
+        stats.stages[i].max_us = 0;
+        stats.stages[i].overruns = 0;
+    }
+    stats.cycles = 0;
+    stats.deadline_misses = 0;
+    stats.skipped_cycles = 0;
+    stats.last_jitter_us = 0;
+    stats.max_jitter_us = 0;
+    stats.avg_jitter_us = 0;
+    jitter_sum_us = 0;
+    portEXIT_CRITICAL(&lock);
+}
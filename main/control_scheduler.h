@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+// Priority of the tasks running the control cycle, above the transport and LED tasks so WiFi load can't delay a frame
+#define CONTROL_TASK_PRIORITY   (tskIDLE_PRIORITY + 4)
+
+typedef enum control_stage_t {
+    CONTROL_STAGE_SAMPLE,
+    CONTROL_STAGE_FILTER,
+    CONTROL_STAGE_ENCODE,
+    CONTROL_STAGE_SEND,
+    CONTROL_STAGE_LINK_WAIT,    // Inside SEND: waiting for the LoRa rover slot and previous transmission, not counted in SEND
+    CONTROL_STAGE_END
+} control_stage_t;
+
+typedef struct control_stage_stats_t {
+    uint32_t    budget_us;
+    uint32_t    last_us;
+    uint32_t    max_us;
+    uint32_t    overruns;           // Times the stage took longer than its budget
+} control_stage_stats_t;
+
+typedef struct control_scheduler_stats_t {
+    uint32_t                period_us;
+    uint32_t                cycles;
+    uint32_t                deadline_misses;    // Cycles not done before the next one was due
+    uint32_t                skipped_cycles;     // Cycles dropped to get back on the schedule after an overrun
+    uint32_t                last_jitter_us;     // Wake up time relative to when the cycle was due
+    uint32_t                max_jitter_us;
+    uint32_t                avg_jitter_us;
+    control_stage_stats_t   stages[CONTROL_STAGE_END];
+} control_scheduler_stats_t;
+
+/*
+ * A cycle starts when control_scheduler_wait_next_cycle returns and ends with
+ * control_scheduler_cycle_done, the stages in between may run in different tasks.
+ * Each stage must only be begun and ended by one task, the stats are shared and locked.
+ */
+void control_scheduler_init(uint16_t period_ms);
+uint16_t control_scheduler_get_period_ms(void);
+int64_t control_scheduler_get_cycle_start_us(void);
+void control_scheduler_set_budget(control_stage_t stage, uint32_t budget_us);
+void control_scheduler_wait_next_cycle(void);
+void control_scheduler_stage_begin(control_stage_t stage);
+void control_scheduler_stage_end(control_stage_t stage);
+void control_scheduler_cycle_done(void);
+void control_scheduler_get_stats(control_scheduler_stats_t* stats);
+void control_scheduler_reset_stats(void);
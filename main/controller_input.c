@@ -10,39 +10,26 @@
 #include "soc/adc_channel.h"
 #include "rover_utils.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "ads1115.h"
+#include "adc_dma.h"
+#include "input_filter.h"
+#include "control_scheduler.h"
 
 #define DEFAULT_VREF    1100
-#define NO_OF_SAMPLES   32
+#define NO_OF_SAMPLES   32  // DMA samples averaged before the filter stage, the last 16 ms at 2 kHz per channel, 8 ms delay
 
 #define ATTENUATION     ADC_ATTEN_DB_11
-#define ADC_WIDTH       ADC_WIDTH_BIT_10
+#define ADC_WIDTH       ADC_WIDTH_BIT_12 // Continuous DMA sampling is always 12 bit
 
 #define I2C_NUM         I2C_NUM_0
 
 #define LAST_SWITCH     INPUT_SWITCH_3_UP
 
+#define SWITCH_DEBOUNCE_MS      10  // A switch must be quiet this long after an edge before its level is trusted
+#define SWITCH_RESYNC_MS        100 // Levels are compared with the samples at least this often, in case an edge was missed
+#define SWITCH_BIT(index)       (1UL << ((index) - INPUT_ANALOG_I2C_END))
 
-static uint16_t rover_channel_map[INPUTS_END] = {
-    INPUT_LEFT_JOYSTICK_X,
-    INPUT_LEFT_JOYSTICK_Y,
-    INPUT_LEFT_JOYSTICK_ROTATE,
-    INPUT_RIGHT_JOYSTICK_X,
-    INPUT_RIGHT_JOYSTICK_Y,
-    INPUT_RIGHT_JOYSTICK_ROTATE,
-    INPUT_POT_LEFT,
-    INPUT_POT_RIGHT,
-    INPUT_SWITCH_1_UP,
-    INPUT_SWITCH_1_DOWN,
-    INPUT_SWITCH_2_UP,
-    INPUT_SWITCH_2_DOWN,
-    INPUT_SWITCH_3_UP,
-    INPUT_SWITCH_3_DOWN,
-    INPUT_SWITCH_4_UP,
-    INPUT_SWITCH_4_DOWN,
-    INPUT_SWITCH_5_UP,
-    INPUT_SWITCH_5_DOWN,
-};
 
 // Mapping of all inputs to GPIO/ADC num
 static uint16_t rover_pin_map[INPUTS_END] = {
@@ -66,15 +53,47 @@ static uint16_t rover_pin_map[INPUTS_END] = {
     [INPUT_SWITCH_5_DOWN] = GPIO_NUM_12, // Note: ESP32 won't start if pulled high at boot
 };
 
+// Tuned for the 100 ms control period, the delay at rest is (1 - alpha) / alpha * period:
+// sticks and rotate axes 5 Hz one euro, about 32 ms on top of the 8 ms of DMA averaging, less when moving.
+// The ADS1115 is quiet enough at 16 bit that the pots are not filtered at all.
+// The stick deadband in rover_controller hides what jitter is left at rest.
+#define JOYSTICK_FILTER { .type = INPUT_FILTER_ONE_EURO, .min_cutoff_hz = 5.0f, .beta = 0.01f, .d_cutoff_hz = 1.0f }
+#define ROTATE_FILTER   JOYSTICK_FILTER
+#define POT_FILTER      { .type = INPUT_FILTER_NONE }
+
+// Filter applied to each analog input, switches are not filtered
+static const input_filter_config_t filter_config[INPUTS_END] = {
+    [INPUT_LEFT_JOYSTICK_X] = JOYSTICK_FILTER,
+    [INPUT_LEFT_JOYSTICK_Y] = JOYSTICK_FILTER,
+    [INPUT_LEFT_JOYSTICK_ROTATE] = ROTATE_FILTER,
+    [INPUT_RIGHT_JOYSTICK_X] = JOYSTICK_FILTER,
+    [INPUT_RIGHT_JOYSTICK_Y] = JOYSTICK_FILTER,
+    [INPUT_RIGHT_JOYSTICK_ROTATE] = ROTATE_FILTER,
+    [INPUT_POT_LEFT] = POT_FILTER,
+    [INPUT_POT_RIGHT] = POT_FILTER,
+};
+
+
+typedef struct switch_debounce_t {
+    bool        pending;        // Edge seen, waiting for the switch to settle
+    int64_t     last_edge_us;
+} switch_debounce_t;
 
 static void print_char_val_type(esp_adc_cal_value_t val_type);
 static void sample_task(void* params);
+static void switch_task(void* params);
+static void IRAM_ATTR switch_isr_handler(void* arg);
 
 static controller_sample_t samples[INPUTS_END];
 static esp_adc_cal_characteristics_t* adc_chars;
 static uint16_t sleep_time;
 static samples_callback* on_sample_done_callback;
+static switch_change_callback* on_switch_change_callback;
+static TaskHandle_t switch_task_handle;
+static switch_debounce_t switch_debounce[INPUTS_END];
 static ads1115_t ads;
+static ads1115_sampler_t ads_sampler;
+static input_filter_t filters[INPUTS_END];
 
 void controller_input_init(uint16_t time_between_samples_ms, samples_callback* callback)
 {
@@ -84,19 +103,31 @@ void controller_input_init(uint16_t time_between_samples_ms, samples_callback* c
     on_sample_done_callback = callback;
     sleep_time = time_between_samples_ms;
 
+    for (uint8_t i = 0; i < INPUTS_END; i++) {
+        input_filter_init(&filters[i], &filter_config[i]);
+    }
+
     adc_chars = calloc(1, sizeof(esp_adc_cal_characteristics_t));
     esp_adc_cal_value_t val_type = esp_adc_cal_characterize(ADC_UNIT_1, ATTENUATION, ADC_WIDTH, DEFAULT_VREF, adc_chars);
     print_char_val_type(val_type);
 
+    adc1_channel_t adc_channels[INPUT_ANALOG_END];
     adc1_config_width(ADC_WIDTH);
     for (uint8_t i = 0; i < INPUT_ANALOG_END; i++) {
         adc1_config_channel_atten((adc1_channel_t)rover_pin_map[i], ATTENUATION);
+        adc_channels[i] = (adc1_channel_t)rover_pin_map[i];
     }
+    adc_dma_init(adc_channels, INPUT_ANALOG_END, ATTENUATION);
 
+    gpio_install_isr_service(0);
     for (uint8_t i = INPUT_ANALOG_I2C_END; i < LAST_SWITCH; i++) {
         gpio_pad_select_gpio((gpio_num_t)rover_pin_map[i]);
         gpio_set_direction((gpio_num_t)rover_pin_map[i], GPIO_MODE_INPUT);
         gpio_set_pull_mode((gpio_num_t)rover_pin_map[i], GPIO_PULLDOWN_ONLY);
+        samples[i].raw_value = gpio_get_level((gpio_num_t)rover_pin_map[i]);
+        samples[i].voltage = samples[i].raw_value == 0 ? 0 : 3300;
+        gpio_set_intr_type((gpio_num_t)rover_pin_map[i], GPIO_INTR_ANYEDGE);
+        gpio_isr_handler_add((gpio_num_t)rover_pin_map[i], switch_isr_handler, (void*)(intptr_t)i);
     }
 
     ESP_ERROR_CHECK(i2c_driver_install(I2C_NUM, I2C_MODE_MASTER, 0, 0, 0));
@@ -113,12 +144,27 @@ void controller_input_init(uint16_t time_between_samples_ms, samples_callback* c
 
     ads = ads1115_config(I2C_NUM, 0x48);
     ads1115_set_sps(&ads, ADS1115_SPS_860);
+    ads1115_set_rdy_pin(&ads, ROVER_CONTROLLER_ADS_RDY);
+
+    ads1115_mux_t ads_channels[INPUT_ANALOG_I2C_END - INPUT_ANALOG_END];
+    for (uint8_t i = INPUT_ANALOG_END; i < INPUT_ANALOG_I2C_END; i++) {
+        ads_channels[i - INPUT_ANALOG_END] = (ads1115_mux_t)rover_pin_map[i];
+    }
+    esp_err_t err = ads1115_sampler_start(&ads_sampler, &ads, ads_channels, INPUT_ANALOG_I2C_END - INPUT_ANALOG_END);
+    assert(err == ESP_OK);
 
     TaskHandle_t handle;
-    BaseType_t status = xTaskCreate(sample_task, "gpio_sample_task", 4096, NULL, tskIDLE_PRIORITY, &handle);
+    BaseType_t status = xTaskCreate(sample_task, "gpio_sample_task", 4096, NULL, CONTROL_TASK_PRIORITY, &handle);
+    assert(status == pdPASS);
+    status = xTaskCreate(switch_task, "switch_task", 2048, NULL, tskIDLE_PRIORITY + 1, &switch_task_handle);
     assert(status == pdPASS);
 }
 
+void controller_input_register_on_switch_change(switch_change_callback* callback)
+{
+    on_switch_change_callback = callback;
+}
+
 uint32_t controller_input_get_map(uint8_t id, uint32_t min, uint32_t max)
 {
     assert(id < INPUT_ANALOG_END);
@@ -144,33 +190,153 @@ uint32_t controller_input_get_map(uint8_t id, uint32_t min, uint32_t max)
     return map(samples[id].raw_value, 0, max_reading, min, max);
 }
 
+// Delay the filter stage adds to the input at the current sample rate
+float controller_input_get_filter_delay_ms(uint8_t id)
+{
+    assert(id < INPUTS_END);
+    return input_filter_group_delay_ms(&filters[id], sleep_time);
+}
+
 static void sample_task(void* params)
 {
+    uint16_t raw_values[INPUT_ANALOG_I2C_END];
+
     while (true) {
+        control_scheduler_wait_next_cycle();
+
+        control_scheduler_stage_begin(CONTROL_STAGE_SAMPLE);
         for (uint8_t i = 0; i < INPUT_ANALOG_END; i++) {
-            uint32_t adc_reading = 0;
-            for (int sample = 0; sample < NO_OF_SAMPLES; sample++) {
-                adc_reading += (uint32_t)adc1_get_raw((adc1_channel_t)rover_pin_map[i]);
-            }
-            adc_reading /= NO_OF_SAMPLES;
+            // Filled in the background by DMA, input index is the same as the adc_dma channel index
+            raw_values[i] = adc_dma_get_average(i, NO_OF_SAMPLES);
+        }
+        for (uint8_t i = INPUT_ANALOG_END; i < INPUT_ANALOG_I2C_END; i++) {
+            // Sampled in the background, this only picks up the latest conversion
+            int16_t raw = ads1115_sampler_get_raw(&ads_sampler, i - INPUT_ANALOG_END);
+            raw_values[i] = raw < 0 ? 0 : raw;
+        }
+        control_scheduler_stage_end(CONTROL_STAGE_SAMPLE);
+
+        control_scheduler_stage_begin(CONTROL_STAGE_FILTER);
+        for (uint8_t i = 0; i < INPUT_ANALOG_END; i++) {
+            uint32_t adc_reading = input_filter_apply(&filters[i], raw_values[i], sleep_time / 1000.0f);
             samples[i].raw_value = adc_reading;
             samples[i].voltage = esp_adc_cal_raw_to_voltage(adc_reading, adc_chars);
         }
-
         for (uint8_t i = INPUT_ANALOG_END; i < INPUT_ANALOG_I2C_END; i++) {
-            // Not used right now so skip
-            //ads1115_set_mux(&ads, rover_pin_map[i]);
-            //samples[i].raw_value = ads1115_get_raw(&ads);
-            //samples[i].voltage = ads1115_get_voltage_from_raw(&ads, samples[i].raw_value) * 1000;
+            int16_t raw = input_filter_apply(&filters[i], raw_values[i], sleep_time / 1000.0f);
+            samples[i].raw_value = raw;
+            samples[i].voltage = ads1115_get_voltage_from_raw(&ads, raw) * 1000;
         }
+        control_scheduler_stage_end(CONTROL_STAGE_FILTER);
+
+        // Switch samples are kept up to date by switch_task
+
+        on_sample_done_callback(samples, INPUTS_END);
+    }
+}
 
+// A switch whose level differs from its sample without an edge seen gets debounced like it had one
+static void switch_resync(int64_t now)
+{
+    for (uint8_t i = INPUT_ANALOG_I2C_END; i < LAST_SWITCH; i++) {
+        if (!switch_debounce[i].pending && gpio_get_level((gpio_num_t)rover_pin_map[i]) != samples[i].raw_value) {
+            switch_debounce[i].pending = true;
+            switch_debounce[i].last_edge_us = now;
+        }
+    }
+}
+
+// Debounces the switch edges reported by the ISR and reports changes right away instead of on the next sample
+static void switch_task(void* params)
+{
+    TickType_t timeout = pdMS_TO_TICKS(SWITCH_RESYNC_MS);
+    int64_t first_edge_us = 0;
+
+    // Report the levels read at init so there is a complete set of switch samples before the first edge
+    if (on_switch_change_callback != NULL) {
+        on_switch_change_callback(samples, INPUTS_END, 0);
+    }
+
+    while (true) {
+        uint32_t edges = 0;
+        int64_t now;
+
+        // One pending bit per switch, edges can't be lost however many come before the task runs
+        xTaskNotifyWait(0, UINT32_MAX, &edges, timeout);
+        now = esp_timer_get_time();
         for (uint8_t i = INPUT_ANALOG_I2C_END; i < LAST_SWITCH; i++) {
-            samples[i].raw_value = gpio_get_level((gpio_num_t)rover_pin_map[i]);
-            samples[i].voltage = samples[i].raw_value == 0 ? 0 : 3300;
+            if (edges & SWITCH_BIT(i)) {
+                // Every bounce restarts the wait for that switch
+                switch_debounce[i].pending = true;
+                switch_debounce[i].last_edge_us = now;
+            }
         }
 
-        on_sample_done_callback(samples, INPUTS_END);
-        vTaskDelay(pdMS_TO_TICKS(sleep_time));
+        bool changed = false;
+        bool settled = false;
+        bool pending = false;
+        int64_t next_settle_us = INT64_MAX;
+
+        for (uint8_t i = INPUT_ANALOG_I2C_END; i < LAST_SWITCH; i++) {
+            if (!switch_debounce[i].pending) {
+                continue;
+            }
+            int64_t settle_us = switch_debounce[i].last_edge_us + SWITCH_DEBOUNCE_MS * 1000LL;
+            if (now >= settle_us) {
+                switch_debounce[i].pending = false;
+                settled = true;
+                uint32_t level = gpio_get_level((gpio_num_t)rover_pin_map[i]);
+                if (level != samples[i].raw_value) {
+                    samples[i].raw_value = level;
+                    samples[i].voltage = level == 0 ? 0 : 3300;
+                    changed = true;
+                }
+            }
+        }
+
+        // After a debounce window and on every timeout, so a missed edge costs one resync period at most
+        if (settled || edges == 0) {
+            switch_resync(now);
+        }
+        for (uint8_t i = INPUT_ANALOG_I2C_END; i < LAST_SWITCH; i++) {
+            if (switch_debounce[i].pending) {
+                pending = true;
+                if (first_edge_us == 0) {
+                    first_edge_us = switch_debounce[i].last_edge_us;
+                }
+                int64_t settle_us = switch_debounce[i].last_edge_us + SWITCH_DEBOUNCE_MS * 1000LL;
+                if (settle_us < next_settle_us) {
+                    next_settle_us = settle_us;
+                }
+            }
+        }
+
+        if (changed && on_switch_change_callback != NULL) {
+            on_switch_change_callback(samples, INPUTS_END, first_edge_us);
+        }
+        if (pending) {
+            timeout = pdMS_TO_TICKS((next_settle_us - now + 999) / 1000);
+            if (timeout == 0) {
+                timeout = 1;
+            }
+        } else {
+            timeout = pdMS_TO_TICKS(SWITCH_RESYNC_MS);
+            first_edge_us = 0;
+        }
+    }
+}
+
+static void IRAM_ATTR switch_isr_handler(void* arg)
+{
+    uint8_t index = (intptr_t)arg;
+    BaseType_t higher_prio_task_woken = pdFALSE;
+    // Edges before the task exists are picked up by its first resync
+    if (switch_task_handle == NULL) {
+        return;
+    }
+    xTaskNotifyFromISR(switch_task_handle, SWITCH_BIT(index), eSetBits, &higher_prio_task_woken);
+    if (higher_prio_task_woken) {
+        portYIELD_FROM_ISR();
     }
 }
 
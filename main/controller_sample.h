@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+// Kept apart from controller_input.h so code working on samples doesn't depend on the ADC drivers
+typedef struct controller_sample_t {
+    uint32_t        raw_value;
+    uint32_t        voltage;
+} controller_sample_t;
+
+typedef enum inputs {
+    INPUT_LEFT_JOYSTICK_X,
+    INPUT_LEFT_JOYSTICK_Y,
+    INPUT_LEFT_JOYSTICK_ROTATE,
+    INPUT_RIGHT_JOYSTICK_X,
+    INPUT_RIGHT_JOYSTICK_Y,
+    INPUT_RIGHT_JOYSTICK_ROTATE,
+    INPUT_ANALOG_END,
+    INPUT_POT_LEFT = INPUT_ANALOG_END,
+    INPUT_POT_RIGHT,
+    INPUT_ANALOG_I2C_END,
+    INPUT_SWITCH_1_UP = INPUT_ANALOG_I2C_END,
+    INPUT_SWITCH_1_DOWN,
+    INPUT_SWITCH_2_UP,
+    INPUT_SWITCH_2_DOWN,
+    INPUT_SWITCH_3_UP,
+    INPUT_SWITCH_3_DOWN,
+    INPUT_SWITCH_4_UP,
+    INPUT_SWITCH_4_DOWN,
+    INPUT_SWITCH_5_UP,
+    INPUT_SWITCH_5_DOWN,
+    INPUTS_END
+} inputs;
@@ -0,0 +1,54 @@
+#include <string.h>
+#include "flight_record.h"
+#include "assert.h"
+
+static void put_u16(uint8_t* buf, uint16_t value)
+{
+    buf[0] = value & 0xFF;
+    buf[1] = value >> 8;
+}
+
+static void put_u32(uint8_t* buf, uint32_t value)
+{
+    put_u16(buf, value & 0xFFFF);
+    put_u16(&buf[2], value >> 16);
+}
+
+static uint32_t get_u32(const uint8_t* buf)
+{
+    return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+uint16_t flight_record_put(uint8_t* buf, uint32_t time_ms, flight_record_type_t type, flight_transport_t transport,
+                           const uint8_t* data, uint16_t length)
+{
+    assert(FLIGHT_RECORDER_RECORD_HEADER + length <= FLIGHT_RECORDER_SECTOR_SIZE - FLIGHT_RECORDER_SECTOR_HEADER);
+    put_u32(buf, time_ms);
+    buf[4] = type;
+    buf[5] = transport;
+    put_u16(&buf[6], length);
+    memcpy(&buf[FLIGHT_RECORDER_RECORD_HEADER], data, length);
+
+    return FLIGHT_RECORDER_RECORD_HEADER + length;
+}
+
+void flight_record_finish_sector(uint8_t* sector, uint32_t sequence, uint16_t used)
+{
+    assert(used >= FLIGHT_RECORDER_SECTOR_HEADER && used <= FLIGHT_RECORDER_SECTOR_SIZE);
+    put_u32(sector, FLIGHT_RECORDER_MAGIC);
+    put_u32(&sector[4], sequence);
+    put_u16(&sector[8], used);
+    sector[10] = FLIGHT_RECORDER_VERSION;
+    sector[11] = 0;
+    memset(&sector[used], 0xFF, FLIGHT_RECORDER_SECTOR_SIZE - used);
+}
+
+bool flight_record_read_sector_header(const uint8_t* header, uint32_t* sequence)
+{
+    if (get_u32(header) != FLIGHT_RECORDER_MAGIC) {
+        return false;
+    }
+    *sequence = get_u32(&header[4]);
+
+    return true;
+}
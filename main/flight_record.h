@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "flight_recorder.h"
+
+/*
+ * Encoding of the sectors and records described in flight_recorder.h, kept apart
+ * from the flash handling so the format can be tested on the host.
+ */
+
+// Writes the record to buf, returns its size, FLIGHT_RECORDER_RECORD_HEADER + length
+uint16_t flight_record_put(uint8_t* buf, uint32_t time_ms, flight_record_type_t type, flight_transport_t transport,
+                           const uint8_t* data, uint16_t length);
+// Writes the sector header and pads the unused part of the sector with 0xFF
+void flight_record_finish_sector(uint8_t* sector, uint32_t sequence, uint16_t used);
+// Returns false if the header isn't that of a written sector
+bool flight_record_read_sector_header(const uint8_t* header, uint32_t* sequence);
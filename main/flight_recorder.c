@@ -0,0 +1,223 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "assert.h"
+#include "flight_recorder.h"
+#include "flight_record.h"
+
+#define RECORDER_PARTITION_SUBTYPE  0x40
+#define RECORDER_PARTITION_LABEL    "recorder"
+#define FLUSH_TASK_PRIORITY         (tskIDLE_PRIORITY + 1)   // Flash erase is slow, never in the way of the control tasks
+#define FLASH_GAP_WAIT_MS           500     // Longest wait for a control frame before going ahead with a flash operation
+#define NOTIFY_FLUSH                (1 << 0)
+#define NOTIFY_CONTROL_SENT         (1 << 1)
+
+static void flush_task(void* params);
+static void erase_next_sector(void);
+
+static const char* TAG = "FLIGHT_RECORDER";
+
+static const esp_partition_t* partition = NULL;
+static TaskHandle_t flush_task_handle;
+// Only taken by tasks and held for a copy at most, interrupts stay enabled unlike with a critical section
+static xSemaphoreHandle lock;
+
+// Records go into the active buffer, the other one is written to flash in the meantime
+static uint8_t buffers[2][FLIGHT_RECORDER_SECTOR_SIZE];
+static uint8_t active;
+static uint16_t active_used;
+static uint16_t flush_used;
+static volatile bool flush_pending;
+static volatile bool erase_pending;     // next_sector still has to be erased before it can be written
+
+static uint32_t num_sectors;
+static uint32_t next_sector;
+static uint32_t next_sequence;
+static flight_recorder_stats_t stats;
+
+// Continues after the newest sector found in the partition
+static void find_next_sector(void)
+{
+    uint8_t header[FLIGHT_RECORDER_SECTOR_HEADER];
+    bool found = false;
+    uint32_t newest = 0;
+
+    next_sector = 0;
+    next_sequence = 0;
+    for (uint32_t i = 0; i < num_sectors; i++) {
+        if (esp_partition_read(partition, i * FLIGHT_RECORDER_SECTOR_SIZE, header, sizeof(header)) != ESP_OK) {
+            continue;
+        }
+        uint32_t sequence;
+        if (flight_record_read_sector_header(header, &sequence) && (!found || (int32_t)(sequence - newest) > 0)) {
+            found = true;
+            newest = sequence;
+            next_sector = (i + 1) % num_sectors;
+            next_sequence = sequence + 1;
+        }
+    }
+}
+
+void flight_recorder_init(void)
+{
+    const esp_partition_t* found = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, RECORDER_PARTITION_SUBTYPE,
+                                                            RECORDER_PARTITION_LABEL);
+    if (found == NULL) {
+        ESP_LOGE(TAG, "No %s partition, not recording", RECORDER_PARTITION_LABEL);
+        return;
+    }
+    num_sectors = found->size / FLIGHT_RECORDER_SECTOR_SIZE;
+    assert(num_sectors > 0);
+
+    memset(&stats, 0, sizeof(stats));
+    active = 0;
+    active_used = FLIGHT_RECORDER_SECTOR_HEADER;
+    flush_pending = false;
+    lock = xSemaphoreCreateMutex();
+    assert(lock != NULL);
+    partition = found;
+    find_next_sector();
+    ESP_LOGI(TAG, "Recording from sector %u of %u, sequence %u", next_sector, num_sectors, next_sequence);
+    // Nothing else is running yet, a good time for the first flash stall
+    erase_next_sector();
+
+    BaseType_t status = xTaskCreate(flush_task, "flight_recorder", 3072, NULL, FLUSH_TASK_PRIORITY, &flush_task_handle);
+    assert(status == pdPASS);
+}
+
+// Must be called with lock held, returns false if the other buffer is still being written
+static bool swap_buffers(void)
+{
+    if (flush_pending) {
+        return false;
+    }
+    flush_used = active_used;
+    flush_pending = true;
+    active ^= 1;
+    active_used = FLIGHT_RECORDER_SECTOR_HEADER;
+
+    return true;
+}
+
+// Only copies the frame to RAM, safe to call from any task on the control path
+void flight_recorder_record(flight_record_type_t type, flight_transport_t transport, const uint8_t* data, uint16_t length)
+{
+    uint32_t size = FLIGHT_RECORDER_RECORD_HEADER + length;
+    bool notify = false;
+
+    if (partition == NULL) {
+        return;
+    }
+    if (FLIGHT_RECORDER_SECTOR_HEADER + size > FLIGHT_RECORDER_SECTOR_SIZE) {
+        stats.dropped++;
+        return;
+    }
+    uint32_t time_ms = esp_timer_get_time() / 1000;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (active_used + size > FLIGHT_RECORDER_SECTOR_SIZE) {
+        if (!swap_buffers()) {
+            stats.dropped++;
+            xSemaphoreGive(lock);
+            return;
+        }
+        notify = true;
+    }
+    active_used += flight_record_put(&buffers[active][active_used], time_ms, type, transport, data, length);
+    stats.records++;
+    xSemaphoreGive(lock);
+
+    if (notify) {
+        xTaskNotify(flush_task_handle, NOTIFY_FLUSH, eSetBits);
+    }
+    if (type == FLIGHT_RECORD_CONTROL && (flush_pending || erase_pending)) {
+        xTaskNotify(flush_task_handle, NOTIFY_CONTROL_SENT, eSetBits);
+    }
+}
+
+void flight_recorder_get_stats(flight_recorder_stats_t* out)
+{
+    assert(out != NULL);
+    *out = stats;
+}
+
+static void write_sector(uint8_t* sector, uint16_t used)
+{
+    flight_record_finish_sector(sector, next_sequence, used);
+
+    uint32_t offset = next_sector * FLIGHT_RECORDER_SECTOR_SIZE;
+    esp_err_t err = esp_partition_write(partition, offset, sector, FLIGHT_RECORDER_SECTOR_SIZE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Writing sector %u failed: %d", next_sector, err);
+        stats.flash_errors++;
+    } else {
+        stats.sectors_written++;
+    }
+    // A failed sector is skipped, the sequence still goes up so the order stays right
+    next_sector = (next_sector + 1) % num_sectors;
+    next_sequence++;
+    erase_pending = true;
+}
+
+// The sector is erased well before it is written, so a full buffer never waits for an erase
+static void erase_next_sector(void)
+{
+    esp_err_t err = esp_partition_erase_range(partition, next_sector * FLIGHT_RECORDER_SECTOR_SIZE,
+                                              FLIGHT_RECORDER_SECTOR_SIZE);
+    if (err != ESP_OK) {
+        // The write will most likely fail too and skip the sector
+        ESP_LOGE(TAG, "Erasing sector %u failed: %d", next_sector, err);
+        stats.flash_errors++;
+    }
+    erase_pending = false;
+}
+
+// Erasing a sector takes about 45 ms, writing one a few ms, during which the flash cache is off on both
+// cores. Every task and interrupt not running from IRAM is held up, the control tasks included.
+// The flush task has the lowest priority so it only gets to run once a control frame has been sent and
+// the sending tasks are waiting for the next period, which is where the stall does the least harm.
+// A control frame recorded while the last flash operation ran is too late, only a new one counts.
+static void wait_for_control_gap(void)
+{
+    uint32_t events = 0;
+    TickType_t start = xTaskGetTickCount();
+
+    xTaskNotifyWait(0, UINT32_MAX, NULL, 0);
+    while (!(events & NOTIFY_CONTROL_SENT)) {
+        TickType_t waited = xTaskGetTickCount() - start;
+        if (waited >= pdMS_TO_TICKS(FLASH_GAP_WAIT_MS)) {
+            // Nothing is being sent, any time is as good
+            return;
+        }
+        xTaskNotifyWait(0, UINT32_MAX, &events, pdMS_TO_TICKS(FLASH_GAP_WAIT_MS) - waited);
+    }
+}
+
+static void flush_task(void* params)
+{
+    while (true) {
+        if (!flush_pending && !erase_pending) {
+            if (xTaskNotifyWait(0, UINT32_MAX, NULL, pdMS_TO_TICKS(FLIGHT_RECORDER_MAX_AGE_MS)) == pdFALSE) {
+                // Nothing filled up for a while, write what there is so it isn't lost on power off
+                xSemaphoreTake(lock, portMAX_DELAY);
+                if (active_used > FLIGHT_RECORDER_SECTOR_HEADER) {
+                    swap_buffers();
+                }
+                xSemaphoreGive(lock);
+            }
+            continue;
+        }
+        // One flash operation per control gap, erasing first as the sector has to be erased to be written
+        wait_for_control_gap();
+        if (erase_pending) {
+            erase_next_sector();
+        } else {
+            write_sector(buffers[active ^ 1], flush_used);
+            flush_pending = false;
+        }
+    }
+}
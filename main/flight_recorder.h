@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Records every control frame sent and every telematics frame received to the
+ * "recorder" flash partition (see partitions.csv), so what happened in the field can
+ * be read back afterwards with
+ *
+ *   esptool.py read_flash 0x110000 0x200000 flight.bin
+ *   python tools/read_flight_recorder.py flight.bin
+ *
+ * Records are collected in a RAM sector and written a whole sector at a time, going
+ * round the partition so every sector is erased equally often. When the partition is
+ * full the oldest sector is overwritten. A partly filled sector is written after
+ * FLIGHT_RECORDER_MAX_AGE_MS, so at most that much is lost on power off.
+ *
+ * Flash erases and writes stop the flash cache, holding up every task and interrupt
+ * not in IRAM for up to about 45 ms. The next sector is erased ahead of time, at boot
+ * and then right after each write, and every flash operation is done just after a
+ * control frame was sent, so the stall falls in the gap before the next control frame.
+ *
+ * Flash sector, FLIGHT_RECORDER_SECTOR_SIZE bytes, all values little endian:
+ *
+ *   uint32 magic        FLIGHT_RECORDER_MAGIC, anything else is an unused sector
+ *   uint32 sequence     +1 for every sector written, the highest is the newest
+ *   uint16 used         bytes of header and records, the rest is padding
+ *   uint8  version      FLIGHT_RECORDER_VERSION
+ *   uint8  reserved
+ *   records...
+ *
+ * Record:
+ *
+ *   uint32 time_ms      since boot
+ *   uint8  type         flight_record_type_t
+ *   uint8  transport    flight_transport_t
+ *   uint16 length
+ *   uint8  data[length] control frame as sent, or telematics frame as received
+ */
+
+#define FLIGHT_RECORDER_MAGIC           0x43455246  // "FREC"
+#define FLIGHT_RECORDER_VERSION         1
+#define FLIGHT_RECORDER_SECTOR_SIZE     4096
+#define FLIGHT_RECORDER_SECTOR_HEADER   12
+#define FLIGHT_RECORDER_RECORD_HEADER   8
+#define FLIGHT_RECORDER_MAX_AGE_MS      5000
+
+typedef enum flight_record_type_t {
+    FLIGHT_RECORD_CONTROL = 0,
+    FLIGHT_RECORD_TELEMATICS
+} flight_record_type_t;
+
+typedef enum flight_transport_t {
+    FLIGHT_TRANSPORT_LORA = 0,
+    FLIGHT_TRANSPORT_WS,
+    FLIGHT_TRANSPORT_UDP
+} flight_transport_t;
+
+typedef struct flight_recorder_stats_t {
+    uint32_t    records;
+    uint32_t    dropped;            // Sector buffer full while the previous one was still being written
+    uint32_t    sectors_written;
+    uint32_t    flash_errors;
+} flight_recorder_stats_t;
+
+void flight_recorder_init(void);
+void flight_recorder_record(flight_record_type_t type, flight_transport_t transport, const uint8_t* data, uint16_t length);
+void flight_recorder_get_stats(flight_recorder_stats_t* stats);
@@ -0,0 +1,260 @@
+#include <string.h>
+#include "frame_codec.h"
+#include "assert.h"
+
+#define CHANNEL_BITS        10
+#define SWITCH_BITS         2
+#define FULL_INTERVAL       10      // Send a full frame at least this often even if deltas are possible
+
+typedef struct bit_writer {
+    uint8_t*    buf;
+    uint16_t    pos;
+    uint32_t    acc;
+    uint8_t     bits;
+} bit_writer;
+
+typedef struct bit_reader {
+    const uint8_t*  buf;
+    uint16_t        pos;
+    uint16_t        len;
+    uint32_t        acc;
+    uint8_t         bits;
+} bit_reader;
+
+static void write_bits(bit_writer* w, uint32_t value, uint8_t bits);
+static void flush_bits(bit_writer* w);
+static bool read_bits(bit_reader* r, uint8_t bits, uint32_t* value);
+static uint8_t crc8(const uint8_t* buf, uint16_t len);
+static uint16_t packed_len(uint8_t num_bits);
+static uint16_t clamp_channel(uint16_t value);
+
+void frame_codec_init(frame_codec_t* codec)
+{
+    memset(codec, 0, sizeof(frame_codec_t));
+}
+
+// Assigns the next sequence number to the frame, returns the encoded length or 0 if buf is too small
+uint16_t frame_codec_encode(frame_codec_t* codec, frame_codec_frame_t* frame, uint8_t* buf, uint16_t len)
+{
+    const frame_codec_frame_t* ref = NULL;
+    uint8_t changed = 0;
+    uint8_t num_changed = 0;
+    bit_writer w;
+
+    assert(frame->num_channels <= FRAME_CODEC_MAX_CHANNELS);
+    assert(frame->num_switches <= FRAME_CODEC_MAX_SWITCHES);
+
+    frame->seq = codec->next_seq;
+    for (uint8_t i = 0; i < frame->num_channels; i++) {
+        frame->channels[i] = clamp_channel(frame->channels[i]);
+    }
+
+    if (codec->has_ack) {
+        uint8_t acked_seq = codec->acked_seq;
+        const frame_codec_frame_t* candidate = &codec->history[acked_seq % FRAME_CODEC_HISTORY];
+        if ((uint8_t)(frame->seq - acked_seq) >= FRAME_CODEC_HISTORY) {
+            // Acks stopped, forget it before the sequence number wraps around and makes it look recent again
+            codec->has_ack = false;
+        } else if (codec->frames_since_full < FULL_INTERVAL && codec->valid[acked_seq % FRAME_CODEC_HISTORY] &&
+                   candidate->seq == acked_seq && candidate->num_channels == frame->num_channels &&
+                   candidate->num_switches == frame->num_switches) {
+            ref = candidate;
+        }
+    }
+
+    if (ref) {
+        for (uint8_t i = 0; i < frame->num_channels; i++) {
+            if (frame->channels[i] != ref->channels[i]) {
+                changed |= 1 << i;
+                num_changed++;
+            }
+        }
+        if (len < 4 + packed_len(num_changed * CHANNEL_BITS + frame->num_switches * SWITCH_BITS) + 1) {
+            return 0;
+        }
+        buf[0] = (FRAME_CODEC_VERSION << 4) | FRAME_CODEC_DELTA;
+        buf[1] = frame->seq;
+        buf[2] = ref->seq;
+        buf[3] = changed;
+        w.pos = 4;
+        codec->frames_since_full++;
+    } else {
+        if (len < 3 + packed_len(frame->num_channels * CHANNEL_BITS + frame->num_switches * SWITCH_BITS) + 1) {
+            return 0;
+        }
+        buf[0] = (FRAME_CODEC_VERSION << 4) | FRAME_CODEC_FULL;
+        buf[1] = frame->seq;
+        buf[2] = (frame->num_channels << 4) | frame->num_switches;
+        w.pos = 3;
+        codec->frames_since_full = 0;
+    }
+
+    w.buf = buf;
+    w.acc = 0;
+    w.bits = 0;
+    for (uint8_t i = 0; i < frame->num_channels; i++) {
+        if (ref == NULL || (changed & (1 << i))) {
+            write_bits(&w, frame->channels[i] - FRAME_CODEC_CHANNEL_MIN, CHANNEL_BITS);
+        }
+    }
+    for (uint8_t i = 0; i < frame->num_switches; i++) {
+        write_bits(&w, frame->switches[i], SWITCH_BITS);
+    }
+    flush_bits(&w);
+    buf[w.pos] = crc8(buf, w.pos);
+
+    codec->history[frame->seq % FRAME_CODEC_HISTORY] = *frame;
+    codec->valid[frame->seq % FRAME_CODEC_HISTORY] = true;
+    codec->next_seq++;
+
+    return w.pos + 1;
+}
+
+// Decodes a FULL or DELTA frame, deltas need their reference frame to have been decoded before
+bool frame_codec_decode(frame_codec_t* codec, const uint8_t* buf, uint16_t len, frame_codec_frame_t* frame)
+{
+    bit_reader r;
+    uint32_t value;
+    uint8_t changed = 0xFF;
+
+    if (len < 4 || crc8(buf, len - 1) != buf[len - 1] || (buf[0] >> 4) != FRAME_CODEC_VERSION) {
+        return false;
+    }
+
+    frame->seq = buf[1];
+    switch (buf[0] & 0x0F) {
+        case FRAME_CODEC_FULL:
+            frame->num_channels = buf[2] >> 4;
+            frame->num_switches = buf[2] & 0x0F;
+            if (frame->num_channels > FRAME_CODEC_MAX_CHANNELS || frame->num_switches > FRAME_CODEC_MAX_SWITCHES) {
+                return false;
+            }
+            r.pos = 3;
+            break;
+        case FRAME_CODEC_DELTA:
+        {
+            uint8_t ref_seq = buf[2];
+            const frame_codec_frame_t* ref = &codec->history[ref_seq % FRAME_CODEC_HISTORY];
+            if (len < 5 || !codec->valid[ref_seq % FRAME_CODEC_HISTORY] || ref->seq != ref_seq) {
+                return false;
+            }
+            memcpy(frame->channels, ref->channels, sizeof(frame->channels));
+            frame->num_channels = ref->num_channels;
+            frame->num_switches = ref->num_switches;
+            changed = buf[3];
+            r.pos = 4;
+            break;
+        }
+        default:
+            return false;
+    }
+
+    r.buf = buf;
+    r.len = len - 1;
+    r.acc = 0;
+    r.bits = 0;
+    for (uint8_t i = 0; i < frame->num_channels; i++) {
+        if (changed & (1 << i)) {
+            if (!read_bits(&r, CHANNEL_BITS, &value)) {
+                return false;
+            }
+            frame->channels[i] = clamp_channel(value + FRAME_CODEC_CHANNEL_MIN);
+        }
+    }
+    for (uint8_t i = 0; i < frame->num_switches; i++) {
+        if (!read_bits(&r, SWITCH_BITS, &value)) {
+            return false;
+        }
+        frame->switches[i] = value;
+    }
+
+    codec->history[frame->seq % FRAME_CODEC_HISTORY] = *frame;
+    codec->valid[frame->seq % FRAME_CODEC_HISTORY] = true;
+    return true;
+}
+
+// Called when the receiver acknowledged a frame, may be called from another task than the encoder
+void frame_codec_ack(frame_codec_t* codec, uint8_t seq)
+{
+    codec->acked_seq = seq;
+    codec->has_ack = true;
+}
+
+uint16_t frame_codec_encode_ack(uint8_t seq, uint8_t* buf, uint16_t len)
+{
+    if (len < FRAME_CODEC_ACK_LEN) {
+        return 0;
+    }
+    buf[0] = (FRAME_CODEC_VERSION << 4) | FRAME_CODEC_ACK;
+    buf[1] = seq;
+    buf[2] = crc8(buf, 2);
+    return FRAME_CODEC_ACK_LEN;
+}
+
+bool frame_codec_parse_ack(const uint8_t* buf, uint16_t len, uint8_t* seq)
+{
+    if (len != FRAME_CODEC_ACK_LEN || buf[0] != ((FRAME_CODEC_VERSION << 4) | FRAME_CODEC_ACK) || crc8(buf, 2) != buf[2]) {
+        return false;
+    }
+    *seq = buf[1];
+    return true;
+}
+
+static void write_bits(bit_writer* w, uint32_t value, uint8_t bits)
+{
+    w->acc |= value << w->bits;
+    w->bits += bits;
+    while (w->bits >= 8) {
+        w->buf[w->pos++] = w->acc & 0xFF;
+        w->acc >>= 8;
+        w->bits -= 8;
+    }
+}
+
+static void flush_bits(bit_writer* w)
+{
+    if (w->bits > 0) {
+        w->buf[w->pos++] = w->acc & 0xFF;
+        w->acc = 0;
+        w->bits = 0;
+    }
+}
+
+static bool read_bits(bit_reader* r, uint8_t bits, uint32_t* value)
+{
+    while (r->bits < bits) {
+        if (r->pos >= r->len) {
+            return false;
+        }
+        r->acc |= (uint32_t)r->buf[r->pos++] << r->bits;
+        r->bits += 8;
+    }
+    *value = r->acc & ((1UL << bits) - 1);
+    r->acc >>= bits;
+    r->bits -= bits;
+    return true;
+}
+
+static uint8_t crc8(const uint8_t* buf, uint16_t len)
+{
+    uint8_t crc = 0;
+    for (uint16_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint16_t packed_len(uint8_t num_bits)
+{
+    return (num_bits + 7) / 8;
+}
+
+static uint16_t clamp_channel(uint16_t value)
+{
+    if (value < FRAME_CODEC_CHANNEL_MIN) return FRAME_CODEC_CHANNEL_MIN;
+    if (value > FRAME_CODEC_CHANNEL_MAX) return FRAME_CODEC_CHANNEL_MAX;
+    return value;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Compact control frame format, all frames start with
+ *
+ *   byte 0: version << 4 | type
+ *   byte 1: sequence number
+ *
+ * FULL:  byte 2: num_channels << 4 | num_switches, then every channel as 10 bits
+ *        (value - FRAME_CODEC_CHANNEL_MIN) and every switch as 2 bits.
+ * DELTA: byte 2: sequence number of the reference frame, byte 3: bitmask of changed
+ *        channels, then the changed channels as 10 bits and every switch as 2 bits.
+ *        Channel and switch count are taken from the reference frame.
+ * ACK:   sent by the receiver to acknowledge the frame with the given sequence number,
+ *        the encoder only uses acknowledged frames of the last FRAME_CODEC_HISTORY as delta reference.
+ *
+ * Bits are packed LSB first and padded to a whole byte, all frames end with a CRC-8
+ * (polynomial 0x07) over the preceding bytes.
+ */
+
+#define FRAME_CODEC_VERSION         1
+#define FRAME_CODEC_MAX_CHANNELS    8
+#define FRAME_CODEC_MAX_SWITCHES    8
+#define FRAME_CODEC_MAX_LEN         (4 + (FRAME_CODEC_MAX_CHANNELS * 10 + FRAME_CODEC_MAX_SWITCHES * 2 + 7) / 8 + 1)
+#define FRAME_CODEC_ACK_LEN         3
+#define FRAME_CODEC_HISTORY         16
+
+#define FRAME_CODEC_CHANNEL_MIN     1000
+#define FRAME_CODEC_CHANNEL_MAX     2000
+
+typedef enum frame_codec_type_t {
+    FRAME_CODEC_FULL = 0,
+    FRAME_CODEC_DELTA,
+    FRAME_CODEC_ACK
+} frame_codec_type_t;
+
+typedef enum frame_codec_switch_t {
+    FRAME_CODEC_SWITCH_MID = 0,
+    FRAME_CODEC_SWITCH_UP,
+    FRAME_CODEC_SWITCH_DOWN
+} frame_codec_switch_t;
+
+typedef struct frame_codec_frame_t {
+    uint8_t     seq;
+    uint8_t     num_channels;
+    uint16_t    channels[FRAME_CODEC_MAX_CHANNELS];     // FRAME_CODEC_CHANNEL_MIN - FRAME_CODEC_CHANNEL_MAX
+    uint8_t     num_switches;
+    uint8_t     switches[FRAME_CODEC_MAX_SWITCHES];     // frame_codec_switch_t
+} frame_codec_frame_t;
+
+// Keeps the last frames sent or received so deltas can be encoded and resolved
+typedef struct frame_codec_t {
+    frame_codec_frame_t history[FRAME_CODEC_HISTORY];
+    bool                valid[FRAME_CODEC_HISTORY];
+    uint8_t             next_seq;
+    uint8_t             frames_since_full;
+    volatile bool       has_ack;
+    volatile uint8_t    acked_seq;
+} frame_codec_t;
+
+void frame_codec_init(frame_codec_t* codec);
+uint16_t frame_codec_encode(frame_codec_t* codec, frame_codec_frame_t* frame, uint8_t* buf, uint16_t len);
+bool frame_codec_decode(frame_codec_t* codec, const uint8_t* buf, uint16_t len, frame_codec_frame_t* frame);
+void frame_codec_ack(frame_codec_t* codec, uint8_t seq);
+uint16_t frame_codec_encode_ack(uint8_t seq, uint8_t* buf, uint16_t len);
+bool frame_codec_parse_ack(const uint8_t* buf, uint16_t len, uint8_t* seq);
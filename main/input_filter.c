@@ -0,0 +1,124 @@
+#include <string.h>
+#include <math.h>
+#include "input_filter.h"
+#include "assert.h"
+
+#define EMA_FRACTION_BITS   8
+
+static uint16_t apply_ema(input_filter_t* filter, uint16_t value);
+static uint16_t apply_median(input_filter_t* filter, uint16_t value);
+static uint16_t apply_one_euro(input_filter_t* filter, uint16_t value, float dt_s);
+static float smoothing_factor(float cutoff_hz, float dt_s);
+
+void input_filter_init(input_filter_t* filter, const input_filter_config_t* config)
+{
+    memset(filter, 0, sizeof(input_filter_t));
+    filter->config = *config;
+    if (config->type == INPUT_FILTER_MEDIAN) {
+        assert(config->median_len > 0 && config->median_len <= INPUT_FILTER_MAX_MEDIAN && (config->median_len & 1));
+    }
+}
+
+uint16_t input_filter_apply(input_filter_t* filter, uint16_t value, float dt_s)
+{
+    switch (filter->config.type) {
+        case INPUT_FILTER_EMA:
+            return apply_ema(filter, value);
+        case INPUT_FILTER_MEDIAN:
+            return apply_median(filter, value);
+        case INPUT_FILTER_ONE_EURO:
+            return apply_one_euro(filter, value, dt_s);
+        case INPUT_FILTER_NONE:
+        default:
+            return value;
+    }
+}
+
+// Delay added by the filter for a slowly changing input, for the one euro filter this is the worst case at rest
+float input_filter_group_delay_ms(const input_filter_t* filter, float sample_period_ms)
+{
+    float alpha;
+
+    switch (filter->config.type) {
+        case INPUT_FILTER_EMA:
+            alpha = 1.0f / (1 << filter->config.ema_shift);
+            return (1.0f - alpha) / alpha * sample_period_ms;
+        case INPUT_FILTER_MEDIAN:
+            return (filter->config.median_len - 1) / 2.0f * sample_period_ms;
+        case INPUT_FILTER_ONE_EURO:
+            alpha = smoothing_factor(filter->config.min_cutoff_hz, sample_period_ms / 1000.0f);
+            return (1.0f - alpha) / alpha * sample_period_ms;
+        case INPUT_FILTER_NONE:
+        default:
+            return 0;
+    }
+}
+
+static uint16_t apply_ema(input_filter_t* filter, uint16_t value)
+{
+    int32_t scaled = (int32_t)value << EMA_FRACTION_BITS;
+
+    if (!filter->initialized) {
+        filter->ema_acc = scaled;
+        filter->initialized = true;
+    } else {
+        filter->ema_acc += (scaled - filter->ema_acc) >> filter->config.ema_shift;
+    }
+    return (filter->ema_acc + (1 << (EMA_FRACTION_BITS - 1))) >> EMA_FRACTION_BITS;
+}
+
+static uint16_t apply_median(input_filter_t* filter, uint16_t value)
+{
+    uint16_t sorted[INPUT_FILTER_MAX_MEDIAN];
+    uint8_t len = filter->config.median_len;
+
+    filter->window[filter->window_pos] = value;
+    filter->window_pos = (filter->window_pos + 1) % len;
+    if (filter->window_count < len) {
+        filter->window_count++;
+    }
+
+    // Insertion sort, the window is tiny
+    for (uint8_t i = 0; i < filter->window_count; i++) {
+        uint16_t v = filter->window[i];
+        int8_t j = i - 1;
+        while (j >= 0 && sorted[j] > v) {
+            sorted[j + 1] = sorted[j];
+            j--;
+        }
+        sorted[j + 1] = v;
+    }
+    return sorted[filter->window_count / 2];
+}
+
+// See "1 Euro Filter: A Simple Speed-based Low-pass Filter for Noisy Input in Interactive Systems", Casiez et al.
+static uint16_t apply_one_euro(input_filter_t* filter, uint16_t value, float dt_s)
+{
+    float x = value;
+    float dx;
+    float cutoff;
+    float alpha;
+
+    if (!filter->initialized || dt_s <= 0) {
+        filter->x_prev = x;
+        filter->dx_prev = 0;
+        filter->initialized = true;
+        return value;
+    }
+
+    dx = (x - filter->x_prev) / dt_s;
+    alpha = smoothing_factor(filter->config.d_cutoff_hz, dt_s);
+    filter->dx_prev += alpha * (dx - filter->dx_prev);
+
+    cutoff = filter->config.min_cutoff_hz + filter->config.beta * fabsf(filter->dx_prev);
+    alpha = smoothing_factor(cutoff, dt_s);
+    filter->x_prev += alpha * (x - filter->x_prev);
+
+    return (uint16_t)(filter->x_prev + 0.5f);
+}
+
+static float smoothing_factor(float cutoff_hz, float dt_s)
+{
+    float tau = 1.0f / (2.0f * (float)M_PI * cutoff_hz);
+    return dt_s / (dt_s + tau);
+}
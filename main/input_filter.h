@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define INPUT_FILTER_MAX_MEDIAN     9
+
+typedef enum input_filter_type_t {
+    INPUT_FILTER_NONE = 0,
+    INPUT_FILTER_EMA,           // Fixed point exponential moving average, alpha = 1 / 2^ema_shift
+    INPUT_FILTER_MEDIAN,        // Median of the last median_len samples, removes spikes
+    INPUT_FILTER_ONE_EURO       // Adaptive low pass, smooth at rest and low lag when moving
+} input_filter_type_t;
+
+typedef struct input_filter_config_t {
+    input_filter_type_t type;
+    uint8_t             ema_shift;
+    uint8_t             median_len;     // Odd, at most INPUT_FILTER_MAX_MEDIAN
+    float               min_cutoff_hz;  // One euro cutoff at rest
+    float               beta;           // One euro cutoff increase per unit/s of speed
+    float               d_cutoff_hz;    // One euro cutoff for the speed estimate
+} input_filter_config_t;
+
+typedef struct input_filter_t {
+    input_filter_config_t   config;
+    bool                    initialized;
+    int32_t                 ema_acc;
+    uint16_t                window[INPUT_FILTER_MAX_MEDIAN];
+    uint8_t                 window_pos;
+    uint8_t                 window_count;
+    float                   x_prev;
+    float                   dx_prev;
+} input_filter_t;
+
+void input_filter_init(input_filter_t* filter, const input_filter_config_t* config);
+uint16_t input_filter_apply(input_filter_t* filter, uint16_t value, float dt_s);
+float input_filter_group_delay_ms(const input_filter_t* filter, float sample_period_ms);
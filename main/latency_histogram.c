@@ -0,0 +1,92 @@
+#include <string.h>
+#include "latency_histogram.h"
+#include "assert.h"
+
+#define MIN_SHIFT   6   // log2(LATENCY_HISTOGRAM_MIN_US)
+#define SUB_BUCKETS (1 << LATENCY_HISTOGRAM_SUB_SHIFT)
+
+void latency_histogram_init(latency_histogram_t* histogram)
+{
+    assert(histogram != NULL);
+    memset(histogram, 0, sizeof(latency_histogram_t));
+    histogram->min_us = UINT32_MAX;
+}
+
+void latency_histogram_record(latency_histogram_t* histogram, uint32_t us)
+{
+    histogram->buckets[latency_histogram_bucket(us)]++;
+    histogram->count++;
+    histogram->sum_us += us;
+    if (us < histogram->min_us) {
+        histogram->min_us = us;
+    }
+    if (us > histogram->max_us) {
+        histogram->max_us = us;
+    }
+}
+
+uint8_t latency_histogram_bucket(uint32_t us)
+{
+    if (us < LATENCY_HISTOGRAM_MIN_US) {
+        return 0;
+    }
+
+    uint8_t octave = 31 - __builtin_clz(us) - MIN_SHIFT;
+    if (octave >= LATENCY_HISTOGRAM_OCTAVES) {
+        return LATENCY_HISTOGRAM_OVERFLOW;
+    }
+    // The bits below the leading one pick the bucket within the octave
+    uint8_t sub = (us >> (octave + MIN_SHIFT - LATENCY_HISTOGRAM_SUB_SHIFT)) & (SUB_BUCKETS - 1);
+
+    return 1 + octave * SUB_BUCKETS + sub;
+}
+
+// Smallest value that no longer fits in the bucket, UINT32_MAX for the overflow bucket
+uint32_t latency_histogram_bucket_upper_us(uint8_t bucket)
+{
+    assert(bucket < LATENCY_HISTOGRAM_BUCKETS);
+    if (bucket == 0) {
+        return LATENCY_HISTOGRAM_MIN_US;
+    }
+    if (bucket == LATENCY_HISTOGRAM_OVERFLOW) {
+        return UINT32_MAX;
+    }
+
+    uint8_t octave = (bucket - 1) / SUB_BUCKETS;
+    uint8_t sub = (bucket - 1) % SUB_BUCKETS;
+
+    return (uint32_t)(SUB_BUCKETS + sub + 1) << (octave + MIN_SHIFT - LATENCY_HISTOGRAM_SUB_SHIFT);
+}
+
+// Returns 0 if nothing has been recorded
+uint32_t latency_histogram_percentile(const latency_histogram_t* histogram, uint8_t percent)
+{
+    assert(percent <= 100);
+    if (histogram->count == 0) {
+        return 0;
+    }
+
+    // Rank of the value, rounded up so the 100th percentile is the last value
+    uint32_t rank = ((uint64_t)histogram->count * percent + 99) / 100;
+    uint32_t seen = 0;
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (uint8_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            uint32_t upper = latency_histogram_bucket_upper_us(i);
+            return upper < histogram->max_us ? upper : histogram->max_us;
+        }
+    }
+
+    return histogram->max_us;
+}
+
+uint32_t latency_histogram_mean(const latency_histogram_t* histogram)
+{
+    if (histogram->count == 0) {
+        return 0;
+    }
+    return histogram->sum_us / histogram->count;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Fixed size latency histogram, cheap enough to record from the control path.
+ * Values below LATENCY_HISTOGRAM_MIN_US share the first bucket, above that every
+ * power of two is split in four buckets, so a bucket is at most 25% wide. Values
+ * beyond the last octave go in a separate overflow bucket, so they aren't mixed up
+ * with the values of the last octave.
+ * Percentiles are reported as the upper bound of the bucket they fall in, capped
+ * by the largest value recorded.
+ */
+
+#define LATENCY_HISTOGRAM_MIN_US    64
+#define LATENCY_HISTOGRAM_OCTAVES   16      // 64 us up to about 4 s
+#define LATENCY_HISTOGRAM_SUB_SHIFT 2       // log2 of the buckets per octave
+#define LATENCY_HISTOGRAM_OVERFLOW  (1 + (LATENCY_HISTOGRAM_OCTAVES << LATENCY_HISTOGRAM_SUB_SHIFT))
+#define LATENCY_HISTOGRAM_BUCKETS   (LATENCY_HISTOGRAM_OVERFLOW + 1)
+
+typedef struct latency_histogram_t {
+    uint32_t    buckets[LATENCY_HISTOGRAM_BUCKETS];
+    uint32_t    count;
+    uint32_t    min_us;
+    uint32_t    max_us;
+    uint64_t    sum_us;
+} latency_histogram_t;
+
+void latency_histogram_init(latency_histogram_t* histogram);
+void latency_histogram_record(latency_histogram_t* histogram, uint32_t us);
+uint32_t latency_histogram_percentile(const latency_histogram_t* histogram, uint8_t percent);
+uint32_t latency_histogram_mean(const latency_histogram_t* histogram);
+uint8_t latency_histogram_bucket(uint32_t us);
+uint32_t latency_histogram_bucket_upper_us(uint8_t bucket);
@@ -0,0 +1,207 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "latency_probe.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "assert.h"
+#include "config.h"
+
+#define ACK_HISTORY     16  // Frames kept to match acks against, must be a power of 2
+
+// Times crossing tasks are kept as the low 32 bits of esp_timer so they are written in one go
+typedef struct link_probes_t {
+    latency_histogram_t     histograms[LATENCY_STAGE_END];
+    uint32_t                pending_sampled_us;     // Frame enqueued but not yet started
+    bool                    pending;
+    volatile uint32_t       in_air_sampled_us;      // Frame being transmitted
+    volatile bool           in_air;
+    volatile uint32_t       ack_sampled_us[ACK_HISTORY];
+    volatile uint16_t       ack_seq[ACK_HISTORY];
+    volatile bool           ack_valid[ACK_HISTORY];
+} link_probes_t;
+
+static const char* TAG = "LATENCY";
+
+static const char* link_names[LATENCY_LINK_END] = {
+    [LATENCY_LINK_LORA] = "lora",
+    [LATENCY_LINK_WS] = "ws",
+    [LATENCY_LINK_UDP] = "udp",
+};
+static const char* stage_names[LATENCY_STAGE_END] = {
+    [LATENCY_STAGE_FILTER] = "filter",
+    [LATENCY_STAGE_ENCODE] = "encode",
+    [LATENCY_STAGE_ENQUEUE] = "enqueue",
+    [LATENCY_STAGE_ON_AIR] = "on_air",
+    [LATENCY_STAGE_ACK] = "ack",
+};
+
+static link_probes_t links[LATENCY_LINK_END];
+#ifdef ROVER_LATENCY_LOG_INTERVAL_MS
+static esp_timer_handle_t log_timer;
+#endif
+
+#ifdef ROVER_LATENCY_LOG_INTERVAL_MS
+static void log_timer_callback(void* arg)
+{
+    latency_probe_log();
+}
+#endif
+
+void latency_probe_init(void)
+{
+    memset(links, 0, sizeof(links));
+    latency_probe_reset();
+
+#ifdef ROVER_LATENCY_LOG_INTERVAL_MS
+    const esp_timer_create_args_t log_timer_args = {
+        .callback = &log_timer_callback,
+        .name = "latency_log"
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&log_timer_args, &log_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(log_timer, ROVER_LATENCY_LOG_INTERVAL_MS * 1000));
+#endif
+}
+
+void latency_probe_reset(void)
+{
+    for (uint8_t i = 0; i < LATENCY_LINK_END; i++) {
+        for (uint8_t j = 0; j < LATENCY_STAGE_END; j++) {
+            latency_histogram_init(&links[i].histograms[j]);
+        }
+    }
+}
+
+static void record(link_probes_t* probes, latency_stage_t stage, uint32_t sampled_us)
+{
+    latency_histogram_record(&probes->histograms[stage], (uint32_t)esp_timer_get_time() - sampled_us);
+}
+
+// Called by the send task when the frame is handed to the transport
+void latency_probe_enqueue(latency_link_t link, const latency_trace_t* trace, uint16_t seq)
+{
+    assert(link < LATENCY_LINK_END);
+    link_probes_t* probes = &links[link];
+    uint32_t sampled_us = trace->sampled_us;
+    uint8_t index = seq & (ACK_HISTORY - 1);
+
+    latency_histogram_record(&probes->histograms[LATENCY_STAGE_FILTER], trace->filtered_us - trace->sampled_us);
+    latency_histogram_record(&probes->histograms[LATENCY_STAGE_ENCODE], trace->encoded_us - trace->sampled_us);
+    record(probes, LATENCY_STAGE_ENQUEUE, sampled_us);
+    probes->pending_sampled_us = sampled_us;
+    probes->pending = true;
+
+    probes->ack_valid[index] = false;
+    probes->ack_sampled_us[index] = sampled_us;
+    probes->ack_seq[index] = seq;
+    probes->ack_valid[index] = true;
+}
+
+// The enqueued frame is now being sent, a frame the transport dropped never gets here
+void latency_probe_tx_started(latency_link_t link)
+{
+    assert(link < LATENCY_LINK_END);
+    link_probes_t* probes = &links[link];
+
+    if (probes->pending) {
+        probes->pending = false;
+        probes->in_air_sampled_us = probes->pending_sampled_us;
+        probes->in_air = true;
+    } else {
+        probes->in_air = false;
+    }
+}
+
+// The enqueued frame is never sent, whatever the transport sends next isn't it
+void latency_probe_tx_dropped(latency_link_t link)
+{
+    assert(link < LATENCY_LINK_END);
+    links[link].pending = false;
+}
+
+void latency_probe_on_air(latency_link_t link)
+{
+    assert(link < LATENCY_LINK_END);
+    link_probes_t* probes = &links[link];
+
+    if (probes->in_air) {
+        probes->in_air = false;
+        record(probes, LATENCY_STAGE_ON_AIR, probes->in_air_sampled_us);
+    }
+}
+
+// Acks older than the history, or for untraced frames, are ignored
+void latency_probe_ack(latency_link_t link, uint16_t seq)
+{
+    assert(link < LATENCY_LINK_END);
+    link_probes_t* probes = &links[link];
+    uint8_t index = seq & (ACK_HISTORY - 1);
+
+    if (probes->ack_valid[index] && probes->ack_seq[index] == seq) {
+        probes->ack_valid[index] = false;
+        record(probes, LATENCY_STAGE_ACK, probes->ack_sampled_us[index]);
+    }
+}
+
+void latency_probe_get(latency_link_t link, latency_stage_t stage, latency_histogram_t* histogram)
+{
+    assert(link < LATENCY_LINK_END && stage < LATENCY_STAGE_END);
+    assert(histogram != NULL);
+    *histogram = links[link].histograms[stage];
+}
+
+/*
+ * { "latency": { "<link>": { "<stage>": { "n": count, "p50": us, "p99": us, "max": us }, ... }, ... } }
+ * Links and stages without any frames are left out. Returns 0 if buf is too small.
+ */
+uint16_t latency_probe_to_json(char* buf, uint16_t size)
+{
+    latency_histogram_t histogram;
+    int len = snprintf(buf, size, "{\"latency\":{");
+
+    for (uint8_t i = 0; i < LATENCY_LINK_END; i++) {
+        bool link_open = false;
+        for (uint8_t j = 0; j < LATENCY_STAGE_END && len < size; j++) {
+            latency_probe_get(i, j, &histogram);
+            if (histogram.count == 0) {
+                continue;
+            }
+            if (!link_open) {
+                len += snprintf(&buf[len], size - len, "%s\"%s\":{", buf[len - 1] == '}' ? "," : "", link_names[i]);
+                link_open = true;
+            } else {
+                len += snprintf(&buf[len], size - len, ",");
+            }
+            if (len < size) {
+                len += snprintf(&buf[len], size - len, "\"%s\":{\"n\":%u,\"p50\":%u,\"p99\":%u,\"max\":%u}",
+                                stage_names[j], histogram.count, latency_histogram_percentile(&histogram, 50),
+                                latency_histogram_percentile(&histogram, 99), histogram.max_us);
+            }
+        }
+        if (link_open && len < size) {
+            len += snprintf(&buf[len], size - len, "}");
+        }
+    }
+    if (len < size) {
+        len += snprintf(&buf[len], size - len, "}}");
+    }
+
+    return len < size ? len : 0;
+}
+
+void latency_probe_log(void)
+{
+    latency_histogram_t histogram;
+
+    for (uint8_t i = 0; i < LATENCY_LINK_END; i++) {
+        for (uint8_t j = 0; j < LATENCY_STAGE_END; j++) {
+            latency_probe_get(i, j, &histogram);
+            if (histogram.count > 0) {
+                ESP_LOGI(TAG, "%-4s %-7s n %6u  min %7u  p50 %7u  p99 %7u  max %7u  mean %7u us",
+                         link_names[i], stage_names[j], histogram.count, histogram.min_us,
+                         latency_histogram_percentile(&histogram, 50), latency_histogram_percentile(&histogram, 99),
+                         histogram.max_us, latency_histogram_mean(&histogram));
+            }
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include "latency_histogram.h"
+
+/*
+ * Control latency per transport, every probe is the time since the inputs of the
+ * frame were sampled (start of the control cycle):
+ *
+ *   FILTER   samples filtered and handed to the send task
+ *   ENCODE   payload built and the transport picked
+ *   ENQUEUE  handed to the transport
+ *   ON_AIR   sent, LoRa TxDone or the websocket/UDP send returning
+ *   ACK      acknowledged by the Rover, only UDP and compact LoRa frames are acked
+ *
+ * Only frames sent for a new set of samples are traced, frames sent for a switch
+ * change or as keepalive are not. Each histogram is written by a single task, a reader
+ * on another task may see a value recorded half way.
+ */
+
+#define LATENCY_PROBE_JSON_MAX_LEN  1536
+
+typedef enum latency_link_t {
+    LATENCY_LINK_LORA,
+    LATENCY_LINK_WS,
+    LATENCY_LINK_UDP,
+    LATENCY_LINK_END
+} latency_link_t;
+
+typedef enum latency_stage_t {
+    LATENCY_STAGE_FILTER,
+    LATENCY_STAGE_ENCODE,
+    LATENCY_STAGE_ENQUEUE,
+    LATENCY_STAGE_ON_AIR,
+    LATENCY_STAGE_ACK,
+    LATENCY_STAGE_END
+} latency_stage_t;
+
+// Probe timestamps of one frame from esp_timer_get_time
+typedef struct latency_trace_t {
+    int64_t     sampled_us;
+    int64_t     filtered_us;
+    int64_t     encoded_us;
+} latency_trace_t;
+
+void latency_probe_init(void);
+void latency_probe_enqueue(latency_link_t link, const latency_trace_t* trace, uint16_t seq);
+void latency_probe_tx_started(latency_link_t link);
+void latency_probe_tx_dropped(latency_link_t link);
+void latency_probe_on_air(latency_link_t link);
+void latency_probe_ack(latency_link_t link, uint16_t seq);
+void latency_probe_get(latency_link_t link, latency_stage_t stage, latency_histogram_t* histogram);
+void latency_probe_reset(void);
+uint16_t latency_probe_to_json(char* buf, uint16_t size);
+void latency_probe_log(void);
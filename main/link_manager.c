@@ -0,0 +1,199 @@
+#include <string.h>
+#include "link_manager.h"
+#include "metrics.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "assert.h"
+
+#define WS_STALE_MS                 400     // Rover sends telematics about 10/s over WiFi
+#define WS_MAX_SEND_LATENCY_US      30000
+#define WS_MAX_LOSS_PERCENT         20
+#define WS_RECOVER_MS               2000    // WiFi must be healthy this long before it is used again
+#define LORA_STALE_MS               3000    // Telematics arrive about every 500 ms over LoRa
+
+#define AVG_SHIFT                   3       // Averages weigh in every new value by 1/8
+
+static const char* TAG = "LINK_MANAGER";
+
+// The transports report from their own tasks while the send task selects, everything below is locked
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static link_stats_t stats;
+static int64_t ws_last_rx_us;
+static int64_t udp_last_rx_us;
+static int64_t ws_healthy_since_us;
+static int64_t lora_last_rx_us;
+static uint32_t ws_loss_avg;    // Percent << AVG_SHIFT
+static bool ws_connected;
+
+void link_manager_init(void)
+{
+    portENTER_CRITICAL(&lock);
+    memset(&stats, 0, sizeof(stats));
+    stats.active = LINK_LORA;
+    stats.mode = LINK_MODE_AUTO;
+    ws_last_rx_us = 0;
+    udp_last_rx_us = 0;
+    ws_healthy_since_us = 0;
+    lora_last_rx_us = 0;
+    ws_loss_avg = 0;
+    ws_connected = false;
+    portEXIT_CRITICAL(&lock);
+    metrics_set(METRIC_ACTIVE_LINK, LINK_LORA);
+}
+
+void link_manager_set_mode(link_mode_t mode)
+{
+    portENTER_CRITICAL(&lock);
+    stats.mode = mode;
+    portEXIT_CRITICAL(&lock);
+}
+
+static uint32_t staleness_ms(int64_t last_rx_us, int64_t now)
+{
+    if (last_rx_us == 0) {
+        return UINT32_MAX;
+    }
+    return (now - last_rx_us) / 1000;
+}
+
+// WiFi is usable if either the websocket or UDP has recently had data from the Rover, must be called with lock held
+static bool ws_is_healthy(int64_t now)
+{
+    bool ws_fresh = ws_connected && staleness_ms(ws_last_rx_us, now) < WS_STALE_MS;
+    bool udp_fresh = staleness_ms(udp_last_rx_us, now) < WS_STALE_MS;
+
+    return (ws_fresh || udp_fresh) &&
+           stats.ws_send_latency_us < WS_MAX_SEND_LATENCY_US &&
+           stats.ws_loss_percent < WS_MAX_LOSS_PERCENT;
+}
+
+// Called for every control frame, decides which transport it goes out on
+link_t link_manager_select(void)
+{
+    int64_t now = esp_timer_get_time();
+    link_stats_t handover;
+
+    portENTER_CRITICAL(&lock);
+    link_t selected = stats.active;
+    stats.ws_staleness_ms = staleness_ms(ws_last_rx_us, now);
+    stats.udp_staleness_ms = staleness_ms(udp_last_rx_us, now);
+    stats.lora_staleness_ms = staleness_ms(lora_last_rx_us, now);
+    stats.ws_healthy = ws_is_healthy(now);
+    stats.lora_healthy = stats.lora_staleness_ms < LORA_STALE_MS;
+
+    if (stats.ws_healthy) {
+        if (ws_healthy_since_us == 0) {
+            ws_healthy_since_us = now;
+        }
+    } else {
+        ws_healthy_since_us = 0;
+    }
+
+    switch (stats.mode) {
+        case LINK_MODE_FORCE_LORA:
+            selected = LINK_LORA;
+            break;
+        case LINK_MODE_FORCE_WIFI:
+            selected = LINK_WIFI;
+            break;
+        default:
+            if (stats.active == LINK_WIFI && !stats.ws_healthy) {
+                selected = LINK_LORA;
+            } else if (stats.active == LINK_LORA && stats.ws_healthy &&
+                       (now - ws_healthy_since_us >= WS_RECOVER_MS * 1000LL || !stats.lora_healthy)) {
+                // Don't wait for the hold time if there is nothing coming over LoRa either
+                selected = LINK_WIFI;
+            }
+            break;
+    }
+
+    bool handed_over = selected != stats.active;
+    if (handed_over) {
+        handover = stats;
+        stats.active = selected;
+        stats.handovers++;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    // No logging with the lock held
+    if (handed_over) {
+        ESP_LOGW(TAG, "Handover to %s, ws: %u ms stale %u us send %u%% loss, lora: %u ms stale rssi %d",
+                 selected == LINK_WIFI ? "WiFi" : "LoRa", handover.ws_staleness_ms, handover.ws_send_latency_us,
+                 handover.ws_loss_percent, handover.lora_staleness_ms, handover.lora_rssi);
+        metrics_set(METRIC_ACTIVE_LINK, selected);
+    }
+
+    return selected;
+}
+
+void link_manager_get_stats(link_stats_t* out)
+{
+    assert(out != NULL);
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&lock);
+    *out = stats;
+    out->ws_staleness_ms = staleness_ms(ws_last_rx_us, now);
+    out->udp_staleness_ms = staleness_ms(udp_last_rx_us, now);
+    out->lora_staleness_ms = staleness_ms(lora_last_rx_us, now);
+    portEXIT_CRITICAL(&lock);
+}
+
+void link_manager_on_ws_send(bool success, uint32_t duration_us)
+{
+    portENTER_CRITICAL(&lock);
+    ws_loss_avg += (success ? 0 : 100) - (ws_loss_avg >> AVG_SHIFT);
+    stats.ws_loss_percent = ws_loss_avg >> AVG_SHIFT;
+    if (success) {
+        stats.ws_send_latency_us += ((int32_t)duration_us - (int32_t)stats.ws_send_latency_us) >> AVG_SHIFT;
+    }
+    portEXIT_CRITICAL(&lock);
+}
+
+void link_manager_on_ws_data(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    // Data getting through counts as a successful transfer, so loss recovers while WiFi isn't used for sending
+    portENTER_CRITICAL(&lock);
+    ws_loss_avg -= ws_loss_avg >> AVG_SHIFT;
+    stats.ws_loss_percent = ws_loss_avg >> AVG_SHIFT;
+    ws_connected = true;
+    ws_last_rx_us = now;
+    portEXIT_CRITICAL(&lock);
+}
+
+void link_manager_on_ws_lost(void)
+{
+    portENTER_CRITICAL(&lock);
+    ws_connected = false;
+    ws_loss_avg = 0;
+    stats.ws_loss_percent = 0;
+    stats.ws_send_latency_us = 0;
+    portEXIT_CRITICAL(&lock);
+}
+
+// Telematics on the UDP server or acks of UDP control frames
+void link_manager_on_udp_data(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&lock);
+    ws_loss_avg -= ws_loss_avg >> AVG_SHIFT;
+    stats.ws_loss_percent = ws_loss_avg >> AVG_SHIFT;
+    udp_last_rx_us = now;
+    portEXIT_CRITICAL(&lock);
+}
+
+void link_manager_on_lora_packet(int rssi, float snr)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&lock);
+    lora_last_rx_us = now;
+    stats.lora_rssi = rssi;
+    stats.lora_snr = snr;
+    portEXIT_CRITICAL(&lock);
+    metrics_set(METRIC_LORA_RSSI, rssi);
+}
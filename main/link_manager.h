@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum link_t {
+    LINK_LORA = 0,
+    LINK_WIFI
+} link_t;
+
+typedef enum link_mode_t {
+    LINK_MODE_AUTO = 0,
+    LINK_MODE_FORCE_LORA,
+    LINK_MODE_FORCE_WIFI
+} link_mode_t;
+
+typedef struct link_stats_t {
+    link_t      active;
+    link_mode_t mode;
+    uint32_t    handovers;
+    bool        ws_healthy;
+    uint32_t    ws_send_latency_us;     // Averaged time a websocket send blocks, grows when TCP can't get data through
+    uint8_t     ws_loss_percent;        // Averaged share of failed websocket sends
+    uint32_t    ws_staleness_ms;        // Since anything was received from the Rover over the websocket
+    uint32_t    udp_staleness_ms;       // Since anything was received from the Rover over UDP, telematics or acks
+    bool        lora_healthy;
+    int16_t     lora_rssi;
+    float       lora_snr;
+    uint32_t    lora_staleness_ms;      // Since a LoRa packet was received from the Rover
+} link_stats_t;
+
+/*
+ * Picks the transport for control frames from link quality. WiFi is left as soon as the
+ * websocket looks unhealthy, well before the websocket timeout, and is only used again
+ * once it has been healthy for a while so a fading link doesn't flip back and forth.
+ * Anything received from the Rover over UDP counts as WiFi activity as well, so a Rover
+ * reporting over UDP keeps WiFi in use without a websocket.
+ */
+void link_manager_init(void);
+void link_manager_set_mode(link_mode_t mode);
+link_t link_manager_select(void);
+void link_manager_get_stats(link_stats_t* stats);
+
+void link_manager_on_ws_send(bool success, uint32_t duration_us);
+void link_manager_on_ws_data(void);
+void link_manager_on_ws_lost(void);
+void link_manager_on_udp_data(void);
+void link_manager_on_lora_packet(int rssi, float snr);
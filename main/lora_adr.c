@@ -0,0 +1,131 @@
+#include <math.h>
+#include "lora_adr.h"
+#include "assert.h"
+
+#define ADR_MARGIN_DB           5.0f    // Link margin to keep above the demodulation floor
+#define ADR_HYSTERESIS_DB       3.0f    // Extra margin needed before stepping to a faster profile
+#define ADR_MIN_PACKETS         8       // Packets averaged before stepping to a faster profile
+#define ADR_NOISE_FIGURE_DB     6.0f
+
+static float required_snr(uint8_t spreading_factor);
+static float link_margin(uint8_t profile);
+
+// Ordered from fastest to most robust, profile 0 is what both ends start with
+static const lora_profile_t profiles[] = {
+    { .spreading_factor = 7,  .bandwidth = 500000, .coding_rate = 5 },
+    { .spreading_factor = 7,  .bandwidth = 250000, .coding_rate = 5 },
+    { .spreading_factor = 8,  .bandwidth = 250000, .coding_rate = 5 },
+    { .spreading_factor = 9,  .bandwidth = 125000, .coding_rate = 5 },
+    { .spreading_factor = 10, .bandwidth = 125000, .coding_rate = 5 },
+};
+
+#define NUM_PROFILES (sizeof(profiles) / sizeof(profiles[0]))
+
+static uint8_t current_profile = LORA_ADR_DEFAULT_PROFILE;
+static uint8_t max_profile = NUM_PROFILES - 1;
+static uint32_t num_packets;
+static float rssi_avg;
+static float snr_avg;
+
+// Time on air according to the formula in the SX1276 datasheet
+uint32_t lora_packet_time_on_air_us(const lora_profile_t* profile, uint16_t preamble_length, uint16_t payload_len,
+                                    bool explicit_header, bool crc)
+{
+    const int sf = profile->spreading_factor;
+    const int cr = profile->coding_rate - 4;
+    uint32_t symbol_us = (uint32_t)((1000000ULL << sf) / profile->bandwidth);
+    int low_data_rate_optimize = symbol_us > 16000 ? 1 : 0;
+    int32_t payload_bits = 8 * payload_len - 4 * sf + 28 + (crc ? 16 : 0) - (explicit_header ? 0 : 20);
+    int32_t bits_per_block = 4 * (sf - 2 * low_data_rate_optimize);
+    int32_t payload_symbols = 8;
+
+    if (payload_bits > 0) {
+        payload_symbols += ((payload_bits + bits_per_block - 1) / bits_per_block) * (cr + 4);
+    }
+
+    // Preamble is followed by 4.25 symbols of sync word and start of frame delimiter
+    return (preamble_length * 4 + 17) * symbol_us / 4 + payload_symbols * symbol_us;
+}
+
+// What both ends use, explicit header and CRC on
+uint32_t lora_time_on_air_us(const lora_profile_t* profile, uint16_t preamble_length, uint16_t payload_len)
+{
+    return lora_packet_time_on_air_us(profile, preamble_length, payload_len, true, true);
+}
+
+void lora_adr_reset(uint8_t profile)
+{
+    assert(profile < NUM_PROFILES);
+    current_profile = profile;
+    num_packets = 0;
+}
+
+// Slower profiles than this are never recommended, e.g. because their slots don't fit the control period
+void lora_adr_set_max_profile(uint8_t profile)
+{
+    assert(profile < NUM_PROFILES);
+    max_profile = profile;
+}
+
+const lora_profile_t* lora_adr_get_profile(uint8_t profile)
+{
+    assert(profile < NUM_PROFILES);
+    return &profiles[profile];
+}
+
+uint8_t lora_adr_num_profiles(void)
+{
+    return NUM_PROFILES;
+}
+
+// Feed the RSSI/SNR of a packet received with the current profile, returns the profile to use
+uint8_t lora_adr_on_packet(int rssi, float snr)
+{
+    if (num_packets == 0) {
+        rssi_avg = rssi;
+        snr_avg = snr;
+    } else {
+        rssi_avg += (rssi - rssi_avg) / 4;
+        snr_avg += (snr - snr_avg) / 4;
+    }
+    num_packets++;
+
+    // Running out of margin, step to the fastest profile that still holds right away
+    if (link_margin(current_profile) < ADR_MARGIN_DB) {
+        for (uint8_t i = current_profile + 1; i <= max_profile; i++) {
+            if (link_margin(i) >= ADR_MARGIN_DB) {
+                return i;
+            }
+        }
+        return current_profile > max_profile ? current_profile : max_profile;
+    }
+
+    if (num_packets >= ADR_MIN_PACKETS) {
+        for (uint8_t i = 0; i < current_profile; i++) {
+            if (link_margin(i) >= ADR_MARGIN_DB + ADR_HYSTERESIS_DB) {
+                return i;
+            }
+        }
+    }
+
+    return current_profile;
+}
+
+// Demodulation SNR floor from the SX1276 datasheet
+static float required_snr(uint8_t spreading_factor)
+{
+    return -5.0f - 2.5f * (spreading_factor - 6);
+}
+
+// Predicted margin in dB if the link was using the given profile
+static float link_margin(uint8_t profile)
+{
+    const lora_profile_t* current = &profiles[current_profile];
+    const lora_profile_t* p = &profiles[profile];
+    float bw_gain = 10.0f * log10f((float)current->bandwidth / p->bandwidth);
+    float snr_margin = snr_avg + bw_gain - required_snr(p->spreading_factor);
+    float sensitivity = -174.0f + 10.0f * log10f(p->bandwidth) + ADR_NOISE_FIGURE_DB + required_snr(p->spreading_factor);
+    float rssi_margin = rssi_avg - sensitivity;
+
+    return snr_margin < rssi_margin ? snr_margin : rssi_margin;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LORA_ADR_DEFAULT_PROFILE    0
+
+typedef struct lora_profile_t {
+    uint8_t     spreading_factor;   // 6-12
+    uint32_t    bandwidth;          // Hz
+    uint8_t     coding_rate;        // 5-8, denominator of the coding rate 4/x
+} lora_profile_t;
+
+uint32_t lora_packet_time_on_air_us(const lora_profile_t* profile, uint16_t preamble_length, uint16_t payload_len,
+                                    bool explicit_header, bool crc);
+uint32_t lora_time_on_air_us(const lora_profile_t* profile, uint16_t preamble_length, uint16_t payload_len);
+
+void lora_adr_reset(uint8_t profile);
+void lora_adr_set_max_profile(uint8_t profile);
+const lora_profile_t* lora_adr_get_profile(uint8_t profile);
+uint8_t lora_adr_num_profiles(void);
+uint8_t lora_adr_on_packet(int rssi, float snr);
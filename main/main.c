@@ -22,6 +22,13 @@
 #include "web_server.h"
 #include "config.h"
 #include "transport_lora.h"
+#include "link_manager.h"
+#include "transport_udp.h"
+#include "latency_probe.h"
+#include "task_profiler.h"
+#include "flight_recorder.h"
+
+#define TASK_PROFILE_INTERVAL_MS    1000
 
 static const char *TAG = "main";
 
@@ -70,7 +77,7 @@ static void start_ap(void) {
             .ssid = AP_SSID,
             .ssid_len = strlen(AP_SSID),
             .password = AP_PASS,
-            .max_connection = 3,
+            .max_connection = AP_MAX_STATIONS,
             .authmode = WIFI_AUTH_WPA2_PSK
         },
     };
@@ -92,9 +99,18 @@ void app_main(void)
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
     leds_init();
+    link_manager_init();
+    latency_probe_init();
+    task_profiler_init(TASK_PROFILE_INTERVAL_MS);
+#ifdef ROVER_FLIGHT_RECORDER
+    flight_recorder_init();
+#endif
     transport_lora_init();
     webserver_init();
     transport_ws_init();
+#ifdef ROVER_UDP_CONTROL
+    transport_udp_init();
+#endif
     rover_controller_init();
     transport_ws_start();
     
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "metrics.h"
+#include "assert.h"
+
+typedef struct metric_info_t {
+    const char*     name;
+    bool            gauge;
+} metric_info_t;
+
+static const metric_info_t info[METRIC_END] = {
+    [METRIC_LORA_FRAMES_SENT]       = { "lora_frames_sent", false },
+    [METRIC_WS_FRAMES_SENT]         = { "ws_frames_sent", false },
+    [METRIC_UDP_FRAMES_SENT]        = { "udp_frames_sent", false },
+    [METRIC_WS_SEND_ERRORS]         = { "ws_send_errors", false },
+    [METRIC_UDP_SEND_ERRORS]        = { "udp_send_errors", false },
+    [METRIC_LORA_CRC_ERRORS]        = { "lora_crc_errors", false },
+    [METRIC_LORA_TX_TIMEOUTS]       = { "lora_tx_timeouts", false },
+    [METRIC_LORA_FRAMES_DROPPED]    = { "lora_frames_dropped", false },
+    [METRIC_WS_TIMEOUTS]            = { "ws_timeouts", false },
+    [METRIC_TELEMATICS_RECEIVED]    = { "telematics_received", false },
+    [METRIC_TELEMATICS_DROPPED]     = { "telematics_dropped", false },
+    [METRIC_PHONE_FRAMES_DROPPED]   = { "phone_frames_dropped", false },
+    [METRIC_PHONE_SEND_ERRORS]      = { "phone_send_errors", false },
+    [METRIC_SEMAPHORE_TIMEOUTS]     = { "semaphore_timeouts", false },
+    [METRIC_PHONES_CONNECTED]       = { "phones_connected", true },
+    [METRIC_ACTIVE_LINK]            = { "active_link", true },
+    [METRIC_LORA_RSSI]              = { "lora_rssi", true },
+};
+
+// Gauges are stored as the bits of their int32_t value
+static atomic_uint values[METRIC_END];
+
+void metrics_inc(metric_t metric)
+{
+    atomic_fetch_add_explicit(&values[metric], 1, memory_order_relaxed);
+}
+
+void metrics_add(metric_t metric, uint32_t value)
+{
+    atomic_fetch_add_explicit(&values[metric], value, memory_order_relaxed);
+}
+
+void metrics_set(metric_t metric, int32_t value)
+{
+    atomic_store_explicit(&values[metric], (uint32_t)value, memory_order_relaxed);
+}
+
+int64_t metrics_get(metric_t metric)
+{
+    assert(metric < METRIC_END);
+    uint32_t value = atomic_load_explicit(&values[metric], memory_order_relaxed);
+
+    return info[metric].gauge ? (int64_t)(int32_t)value : (int64_t)value;
+}
+
+// Returns the text length, 0 if buf is too small
+uint16_t metrics_format(char* buf, uint16_t size)
+{
+    int len = 0;
+
+    for (uint8_t i = 0; i < METRIC_END && len < size; i++) {
+        len += snprintf(&buf[len], size - len, "# TYPE rover_%s %s\nrover_%s %lld\n", info[i].name,
+                        info[i].gauge ? "gauge" : "counter", info[i].name, (long long)metrics_get(i));
+    }
+
+    return len < size ? len : 0;
+}
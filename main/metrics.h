@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Fixed set of named counters and gauges, updated with single atomic operations so they
+ * can be used from any task or timer callback without locks or allocation.
+ * Counters only go up and wrap at 32 bits, gauges hold the latest signed value.
+ *
+ * Exported in the Prometheus text format by GET /metrics on the web server:
+ *
+ *   # TYPE rover_<name> counter|gauge
+ *   rover_<name> <value>
+ */
+
+#define METRICS_MAX_TEXT_LEN    2048
+
+typedef enum metric_t {
+    // Counters
+    METRIC_LORA_FRAMES_SENT,
+    METRIC_WS_FRAMES_SENT,
+    METRIC_UDP_FRAMES_SENT,
+    METRIC_WS_SEND_ERRORS,
+    METRIC_UDP_SEND_ERRORS,
+    METRIC_LORA_CRC_ERRORS,
+    METRIC_LORA_TX_TIMEOUTS,
+    METRIC_LORA_FRAMES_DROPPED,
+    METRIC_WS_TIMEOUTS,
+    METRIC_TELEMATICS_RECEIVED,
+    METRIC_TELEMATICS_DROPPED,
+    METRIC_PHONE_FRAMES_DROPPED,
+    METRIC_PHONE_SEND_ERRORS,
+    METRIC_SEMAPHORE_TIMEOUTS,
+    // Gauges
+    METRIC_PHONES_CONNECTED,
+    METRIC_ACTIVE_LINK,             // link_t, see link_manager.h
+    METRIC_LORA_RSSI,
+    METRIC_END
+} metric_t;
+
+void metrics_inc(metric_t metric);
+void metrics_add(metric_t metric, uint32_t value);
+void metrics_set(metric_t metric, int32_t value);
+int64_t metrics_get(metric_t metric);
+uint16_t metrics_format(char* buf, uint16_t size);
@@ -0,0 +1,48 @@
+#include <string.h>
+#include "redundant_link.h"
+#include "assert.h"
+
+// out must fit REDUNDANT_LINK_HEADER_LEN + payload_len bytes, returns the frame length
+uint16_t redundant_link_encode(uint16_t seq, const uint8_t* payload, uint16_t payload_len, uint8_t* out)
+{
+    out[0] = seq & 0xFF;
+    out[1] = seq >> 8;
+    memcpy(&out[REDUNDANT_LINK_HEADER_LEN], payload, payload_len);
+
+    return REDUNDANT_LINK_HEADER_LEN + payload_len;
+}
+
+void redundant_link_rx_init(redundant_link_rx_t* rx)
+{
+    assert(rx != NULL);
+    memset(rx, 0, sizeof(redundant_link_rx_t));
+}
+
+// Returns true and points payload into frame if the frame should be used, false if it's a duplicate or stale
+bool redundant_link_rx_accept(redundant_link_rx_t* rx, const uint8_t* frame, uint16_t len, int64_t now_ms,
+                              const uint8_t** payload, uint16_t* payload_len)
+{
+    if (len < REDUNDANT_LINK_HEADER_LEN) {
+        return false;
+    }
+
+    uint16_t seq = frame[0] | (frame[1] << 8);
+
+    if (rx->synced && now_ms - rx->last_accepted_ms < REDUNDANT_LINK_RESYNC_MS) {
+        int16_t diff = (int16_t)(seq - rx->last_seq);
+        if (diff <= 0) {
+            rx->duplicates++;
+            return false;
+        }
+        rx->lost += diff - 1;
+    }
+
+    rx->synced = true;
+    rx->last_seq = seq;
+    rx->last_accepted_ms = now_ms;
+    rx->accepted++;
+    *payload = &frame[REDUNDANT_LINK_HEADER_LEN];
+    *payload_len = len - REDUNDANT_LINK_HEADER_LEN;
+
+    return true;
+}
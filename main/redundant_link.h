@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Redundant mode sends every control frame over both the websocket and LoRa,
+ * the Rover uses whichever copy arrives first. Both copies are identical:
+ *
+ *   byte 0-1: sequence number, little endian
+ *   byte 2- : control payload, same as in non redundant mode
+ *
+ * Receiver contract:
+ *  - The sequence number is incremented by one for every control frame, a resend
+ *    over another link keeps the sequence number.
+ *  - A frame is accepted if its sequence number is newer than the last accepted,
+ *    compared with 16 bit serial number arithmetic: (int16_t)(seq - last) > 0.
+ *    Everything else is a duplicate or arrived out of order and is dropped, an
+ *    older frame must never overwrite a newer one.
+ *  - If nothing has been accepted for REDUNDANT_LINK_RESYNC_MS the next frame is
+ *    accepted whatever its sequence number, so a restarted controller is picked up.
+ *
+ * redundant_link_rx_accept is the reference implementation of this contract.
+ */
+
+#define REDUNDANT_LINK_HEADER_LEN   2
+#define REDUNDANT_LINK_RESYNC_MS    1000
+
+typedef struct redundant_link_rx_t {
+    bool        synced;
+    uint16_t    last_seq;
+    int64_t     last_accepted_ms;
+    uint32_t    accepted;
+    uint32_t    duplicates;         // Dropped, same or older sequence number than already accepted
+    uint32_t    lost;               // Sequence numbers skipped over, not received on any link
+} redundant_link_rx_t;
+
+uint16_t redundant_link_encode(uint16_t seq, const uint8_t* payload, uint16_t payload_len, uint8_t* out);
+
+void redundant_link_rx_init(redundant_link_rx_t* rx);
+bool redundant_link_rx_accept(redundant_link_rx_t* rx, const uint8_t* frame, uint16_t len, int64_t now_ms,
+                              const uint8_t** payload, uint16_t* payload_len);
@@ -1,126 +1,341 @@
 #include <string.h>
+#include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/semphr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "rover_controller.h"
 #include "controller_input.h"
 #include "transport_wifi.h"
 #include "transport_lora.h"
-#include "rover_utils.h"
+#include "transport_udp.h"
+#include "rover_payload.h"
+#include "frame_codec.h"
+#include "control_scheduler.h"
+#include "triple_buffer.h"
+#include "redundant_link.h"
+#include "link_manager.h"
+#include "latency_probe.h"
 #include "config.h"
 
-#define ADC_SAMPLE_DELAY        100
+#define ADC_SAMPLE_DELAY        100 // Control period, has to be a multiple of the FreeRTOS tick
 #define MAX_TX_BUF_LEN          100
 
-#define ADC_DATA_NOTIFICATION   1
+#define STICK_DEADBAND          8
+#define KEEPALIVE_INTERVAL_MS   250 // Well below the Rover failsafe timeout
+
+#define REDUNDANT_WS_SEND_TIMEOUT_MS    20 // A stalled websocket must not hold back the next frame
+
+#if defined(ROVER_REDUNDANT_TRANSPORT) && defined(ROVER_LORA_COMPACT_FRAMES)
+#error "Compact LoRa frames have their own sequence numbers and can't be used in redundant mode"
+#endif
+
+#define ADC_DATA_NOTIFICATION       1
+#define SWITCH_CHANGE_NOTIFICATION  2
+
+#define NUM_SWITCH_INPUTS       (INPUTS_END - INPUT_ANALOG_I2C_END)
+
+typedef struct sample_snapshot_t {
+    controller_sample_t     samples[INPUTS_END];
+    latency_trace_t         trace;
+} sample_snapshot_t;
+
+typedef struct switch_snapshot_t {
+    controller_sample_t     samples[NUM_SWITCH_INPUTS];
+    int64_t                 edge_time_us;
+} switch_snapshot_t;
 
 static void sample_readings_done_callback(controller_sample_t* samples, uint8_t num_samples);
+static void switch_changed_callback(controller_sample_t* samples, uint8_t num_samples, int64_t edge_time_us);
 static void periodic_send_data(void* params);
-static bool build_rover_payload(void);
-static uint16_t convert_3_way_switch(uint32_t raw1, uint32_t raw2);
+static bool build_rover_payload(bool force);
 static bool should_use_wifi_transport(void);
+static void send_frame(bool use_wifi, const latency_trace_t* trace);
+#ifdef ROVER_LORA_COMPACT_FRAMES
+static void build_compact_frame(void);
+static void on_lora_frame_ack(uint8_t seq);
+#endif
 
 
-static const char* TAG = "ROVER_CONTROLLER";
-
 static TaskHandle_t task_handle;
-static xSemaphoreHandle sem_handle;
-static controller_sample_t controller_samples[INPUTS_END];
+static controller_sample_t controller_samples[INPUTS_END]; // Only used by the send task
+
+// Analog samples and switches come from different tasks, each has its own lock-free handoff to the send task
+static triple_buffer_t sample_buffer;
+static sample_snapshot_t sample_buffer_storage[3];
+static triple_buffer_t switch_buffer;
+static switch_snapshot_t switch_buffer_storage[3];
 
 static uint16_t tx_buf[MAX_TX_BUF_LEN];
 static uint16_t tx_buf_payload_len;
 
+// A channel is only considered changed when it moved more than this since the last sent frame
+static uint16_t channel_deadband[ROVER_PAYLOAD_CHANNELS] = { STICK_DEADBAND, STICK_DEADBAND, STICK_DEADBAND, STICK_DEADBAND, 0, 0 };
+static int64_t last_sent_us = 0;
+static rover_controller_stats_t stats;
+
+#ifdef ROVER_LORA_COMPACT_FRAMES
+static frame_codec_t codec;
+static uint8_t compact_tx_buf[FRAME_CODEC_MAX_LEN];
+static uint16_t compact_tx_buf_len;
+static uint8_t compact_tx_seq;
+#endif
+
+#ifdef ROVER_REDUNDANT_TRANSPORT
+static uint8_t redundant_tx_buf[REDUNDANT_LINK_HEADER_LEN + ROVER_PAYLOAD_LEN];
+#endif
+#if defined(ROVER_REDUNDANT_TRANSPORT) || defined(ROVER_UDP_CONTROL)
+static uint16_t frame_seq;
+#endif
+
 void rover_controller_init(void)
 {
-    sem_handle = xSemaphoreCreateBinary();
-    assert(sem_handle != NULL);
-    xSemaphoreGive(sem_handle);
-    BaseType_t status = xTaskCreate(periodic_send_data, "send_values", 4096, NULL, tskIDLE_PRIORITY, &task_handle);
+    triple_buffer_init(&sample_buffer, sample_buffer_storage, sizeof(sample_buffer_storage[0]));
+    triple_buffer_init(&switch_buffer, switch_buffer_storage, sizeof(switch_buffer_storage[0]));
+    control_scheduler_init(ADC_SAMPLE_DELAY);
+    BaseType_t status = xTaskCreate(periodic_send_data, "send_values", 4096, NULL, CONTROL_TASK_PRIORITY, &task_handle);
     assert(status == pdPASS);
 
+#ifdef ROVER_LORA_COMPACT_FRAMES
+    frame_codec_init(&codec);
+    transport_lora_register_on_ack(&on_lora_frame_ack);
+    transport_lora_configure_slots(ADC_SAMPLE_DELAY, FRAME_CODEC_MAX_LEN);
+#elif defined(ROVER_REDUNDANT_TRANSPORT)
+    transport_lora_configure_slots(ADC_SAMPLE_DELAY, REDUNDANT_LINK_HEADER_LEN + ROVER_PAYLOAD_LEN);
+#else
+    transport_lora_configure_slots(ADC_SAMPLE_DELAY, ROVER_PAYLOAD_LEN);
+#endif
+    controller_input_register_on_switch_change(&switch_changed_callback);
     controller_input_init(ADC_SAMPLE_DELAY, &sample_readings_done_callback);
 }
 
 static void periodic_send_data(void* params)
 {
+    bool have_samples = false;
+
     while (true) {
         uint32_t notification;
-        assert(xTaskNotifyWait(ADC_DATA_NOTIFICATION, 0, &notification, portMAX_DELAY));
-        assert(notification == ADC_DATA_NOTIFICATION);
-        assert(xSemaphoreTake(sem_handle, portMAX_DELAY) == pdPASS);
+        assert(xTaskNotifyWait(0, ADC_DATA_NOTIFICATION | SWITCH_CHANGE_NOTIFICATION, &notification, portMAX_DELAY));
+        assert(notification & (ADC_DATA_NOTIFICATION | SWITCH_CHANGE_NOTIFICATION));
 
-        for (uint8_t i = 0; i < INPUTS_END; i++) {
-            //printf("%d: Raw: %d  ", i, controller_samples[i].raw_value);
+        const void* snapshot;
+        int64_t edge_us = 0;
+        latency_trace_t trace;
+        bool traced = false;
+        if (triple_buffer_read(&sample_buffer, &snapshot)) {
+            const sample_snapshot_t* sampled = snapshot;
+            memcpy(controller_samples, sampled->samples, sizeof(controller_sample_t) * INPUT_ANALOG_I2C_END);
+            trace = sampled->trace;
+            traced = true;
+        }
+        if (triple_buffer_read(&switch_buffer, &snapshot)) {
+            const switch_snapshot_t* switches = snapshot;
+            memcpy(&controller_samples[INPUT_ANALOG_I2C_END], switches->samples, sizeof(switches->samples));
+            edge_us = switches->edge_time_us;
         }
-        //printf("\n");
-        bool payload_changed = build_rover_payload();
-        xSemaphoreGive(sem_handle);
-        if (true) {
-            if (should_use_wifi_transport()) {
-                transport_ws_send((uint8_t*)tx_buf, tx_buf_payload_len);
-            } else {
-                transport_lora_send((uint8_t*)tx_buf, tx_buf_payload_len);
+        // Nothing goes out until the sticks were sampled, a frame of zeroed samples would drive the Rover
+        have_samples = have_samples || traced;
+        if (!have_samples) {
+            continue;
+        }
+
+        // A switch flip may only change the transport, send it anyway so the Rover sees it right away
+        bool switch_changed = notification & SWITCH_CHANGE_NOTIFICATION;
+        bool keepalive_due = esp_timer_get_time() - last_sent_us >= KEEPALIVE_INTERVAL_MS * 1000LL;
+        control_scheduler_stage_begin(CONTROL_STAGE_ENCODE);
+        bool payload_changed = build_rover_payload(keepalive_due || switch_changed);
+        bool use_wifi = should_use_wifi_transport();
+#ifdef ROVER_LORA_COMPACT_FRAMES
+        if (payload_changed && !use_wifi) {
+            build_compact_frame();
+        }
+#endif
+        control_scheduler_stage_end(CONTROL_STAGE_ENCODE);
+        trace.encoded_us = esp_timer_get_time();
+        if (payload_changed) {
+            control_scheduler_stage_begin(CONTROL_STAGE_SEND);
+            send_frame(use_wifi, traced ? &trace : NULL);
+            control_scheduler_stage_end(CONTROL_STAGE_SEND);
+            last_sent_us = esp_timer_get_time();
+            stats.frames_sent++;
+            if (edge_us != 0) {
+                stats.last_switch_latency_us = last_sent_us - edge_us;
+                if (stats.last_switch_latency_us > stats.max_switch_latency_us) {
+                    stats.max_switch_latency_us = stats.last_switch_latency_us;
+                }
             }
+        } else {
+            stats.frames_suppressed++;
+        }
+        if (notification & ADC_DATA_NOTIFICATION) {
+            control_scheduler_cycle_done();
         }
     }
 }
 
-static bool build_rover_payload(void)
+void rover_controller_set_deadband(uint8_t channel, uint16_t deadband)
 {
-    bool payload_changed = true;
-    uint16_t temp_tx_buf[MAX_TX_BUF_LEN];
+    assert(channel < ROVER_PAYLOAD_CHANNELS);
+    channel_deadband[channel] = deadband;
+}
 
-    tx_buf_payload_len = 6 * sizeof(uint16_t); // Rover RC controller have 6 channels, limit to that for now for compatability
+void rover_controller_get_stats(rover_controller_stats_t* out)
+{
+    assert(out != NULL);
+    *out = stats;
+}
 
-    temp_tx_buf[0] = 2000 + 1000 - map(controller_samples[INPUT_RIGHT_JOYSTICK_X].voltage, 0, 3300, 1000, 2000); // Steer joystick is inverted
-    temp_tx_buf[1] = map(controller_samples[INPUT_RIGHT_JOYSTICK_Y].voltage, 0, 3300, 1000, 2000);
-    temp_tx_buf[2] = map(controller_samples[INPUT_LEFT_JOYSTICK_X].voltage, 0, 3300, 1000, 2000);
-    temp_tx_buf[3] = map(controller_samples[INPUT_LEFT_JOYSTICK_Y].voltage, 0, 3300, 1000, 2000);
-    temp_tx_buf[4] = convert_3_way_switch(controller_samples[INPUT_SWITCH_1_UP].raw_value, controller_samples[INPUT_SWITCH_1_DOWN].raw_value);
-    temp_tx_buf[5] = 1500;
+// Returns true if the payload should be sent, either because it changed more than the deadband or it's forced
+static bool build_rover_payload(bool force)
+{
+    uint16_t temp_tx_buf[ROVER_PAYLOAD_CHANNELS];
 
+    tx_buf_payload_len = ROVER_PAYLOAD_LEN;
 
-    //TODO("Could do more here, like only send if something changed more than x")
-    if (memcmp(temp_tx_buf, tx_buf, tx_buf_payload_len) == 0) {
-        payload_changed = false;
-    } else {
+    rover_payload_build(controller_samples, temp_tx_buf);
+    bool payload_changed = force || rover_payload_changed(tx_buf, temp_tx_buf, channel_deadband);
+    if (payload_changed) {
         memcpy(tx_buf, temp_tx_buf, tx_buf_payload_len);
     }
-    //ESP_LOGW(TAG, "Send: %d, %d \t %d, %d \t %d, %d", tx_buf[0], tx_buf[1], tx_buf[2],  tx_buf[3], tx_buf[4], tx_buf[5]);
     return payload_changed;
 }
 
 static void sample_readings_done_callback(controller_sample_t* samples, uint8_t num_samples)
 {
     assert(num_samples == INPUTS_END);
-    if (xSemaphoreTake(sem_handle, pdMS_TO_TICKS(5)) == pdPASS) {
-        memcpy(controller_samples, samples, sizeof(controller_sample_t) * num_samples);
-        xSemaphoreGive(sem_handle);
-    } else {
-        ESP_LOGE(TAG, "Failed getting adc sample copy semaphore");
+    sample_snapshot_t* snapshot = triple_buffer_write_buf(&sample_buffer);
+    memcpy(snapshot->samples, samples, sizeof(snapshot->samples));
+    // Called from the sampling task right after filtering
+    snapshot->trace.sampled_us = control_scheduler_get_cycle_start_us();
+    snapshot->trace.filtered_us = esp_timer_get_time();
+    triple_buffer_publish(&sample_buffer);
+
+    assert(xTaskNotify(task_handle, ADC_DATA_NOTIFICATION, eSetBits) == pdPASS);
+}
+
+static void switch_changed_callback(controller_sample_t* samples, uint8_t num_samples, int64_t edge_time_us)
+{
+    assert(num_samples == INPUTS_END);
+    switch_snapshot_t* switches = triple_buffer_write_buf(&switch_buffer);
+    memcpy(switches->samples, &samples[INPUT_ANALOG_I2C_END], sizeof(switches->samples));
+    switches->edge_time_us = edge_time_us;
+    triple_buffer_publish(&switch_buffer);
+
+    // The levels reported at start are no change, they go out with the first frame
+    if (edge_time_us != 0) {
+        assert(xTaskNotify(task_handle, SWITCH_CHANGE_NOTIFICATION, eSetBits) == pdPASS);
     }
-    
-    assert(xTaskNotify(task_handle, ADC_DATA_NOTIFICATION, eSetValueWithOverwrite) == pdPASS);
 }
 
-static uint16_t convert_3_way_switch(uint32_t up, uint32_t down)
+// Switch 2 up forces LoRa and down forces WiFi, in the middle the link manager picks from link quality
+static bool should_use_wifi_transport(void)
 {
-    uint16_t value;
+    switch (rover_payload_3_way_switch(controller_samples[INPUT_SWITCH_2_UP].raw_value, controller_samples[INPUT_SWITCH_2_DOWN].raw_value)) {
+        case 1000:
+            link_manager_set_mode(LINK_MODE_FORCE_LORA);
+            break;
+        case 2000:
+            link_manager_set_mode(LINK_MODE_FORCE_WIFI);
+            break;
+        default:
+            link_manager_set_mode(LINK_MODE_AUTO);
+            break;
+    }
 
-    if (up == 0 && down == 0) {
-        value = 1500;
-    } else if (up == 1) {
-        value = 1000;
+    return link_manager_select() == LINK_WIFI;
+}
+
+// trace is NULL for frames that aren't traced, see latency_probe.h
+static void send_frame(bool use_wifi, const latency_trace_t* trace)
+{
+    esp_err_t wifi_result;
+#if defined(ROVER_REDUNDANT_TRANSPORT) || defined(ROVER_UDP_CONTROL)
+    uint16_t seq = frame_seq++;
+#endif
+#ifdef ROVER_REDUNDANT_TRANSPORT
+    // Every frame gets a sequence number, with WiFi selected the same frame is sent over both links, see redundant_link.h
+    uint16_t len = redundant_link_encode(seq, (uint8_t*)tx_buf, tx_buf_payload_len, redundant_tx_buf);
+#endif
+
+    // WiFi goes first, a LoRa send blocks until the rover slot and the previous frame are done
+    if (use_wifi) {
+#if defined(ROVER_UDP_CONTROL)
+        const latency_link_t link = LATENCY_LINK_UDP;
+        const uint16_t ack_seq = seq;
+#else
+        // Frames over the websocket are never acked
+        const latency_link_t link = LATENCY_LINK_WS;
+        const uint16_t ack_seq = 0;
+#endif
+        if (trace) {
+            latency_probe_enqueue(link, trace, ack_seq);
+            latency_probe_tx_started(link);
+        }
+#if defined(ROVER_UDP_CONTROL)
+        wifi_result = transport_udp_send(seq, (uint8_t*)tx_buf, tx_buf_payload_len);
+#elif defined(ROVER_REDUNDANT_TRANSPORT)
+        wifi_result = transport_ws_send_timeout(redundant_tx_buf, len, REDUNDANT_WS_SEND_TIMEOUT_MS);
+#else
+        wifi_result = transport_ws_send((uint8_t*)tx_buf, tx_buf_payload_len);
+#endif
+        if (wifi_result != ESP_OK) {
+            stats.wifi_send_failures++;
+        } else if (trace) {
+            latency_probe_on_air(link);
+        }
+    }
+
+#ifdef ROVER_REDUNDANT_TRANSPORT
+    if (trace) {
+        latency_probe_enqueue(LATENCY_LINK_LORA, trace, seq);
+    }
+    transport_lora_send(redundant_tx_buf, len);
+#else
+    if (!use_wifi) {
+#ifdef ROVER_LORA_COMPACT_FRAMES
+        if (trace) {
+            latency_probe_enqueue(LATENCY_LINK_LORA, trace, compact_tx_seq);
+        }
+        transport_lora_send(compact_tx_buf, compact_tx_buf_len);
+#else
+        if (trace) {
+            latency_probe_enqueue(LATENCY_LINK_LORA, trace, 0);
+        }
+        transport_lora_send((uint8_t*)tx_buf, tx_buf_payload_len);
+#endif
+    }
+#endif
+}
+
+#ifdef ROVER_LORA_COMPACT_FRAMES
+// Same content as the raw payload: four stick channels and switch 1, channel 5 is not used by the Rover
+static void build_compact_frame(void)
+{
+    frame_codec_frame_t frame;
+    uint16_t switch_1 = tx_buf[4];
+
+    frame.num_channels = 4;
+    for (uint8_t i = 0; i < frame.num_channels; i++) {
+        frame.channels[i] = tx_buf[i];
+    }
+    frame.num_switches = 1;
+    if (switch_1 == 1000) {
+        frame.switches[0] = FRAME_CODEC_SWITCH_UP;
+    } else if (switch_1 == 2000) {
+        frame.switches[0] = FRAME_CODEC_SWITCH_DOWN;
     } else {
-        value = 2000;
+        frame.switches[0] = FRAME_CODEC_SWITCH_MID;
     }
 
-    return value;
-} 
+    compact_tx_buf_len = frame_codec_encode(&codec, &frame, compact_tx_buf, sizeof(compact_tx_buf));
+    assert(compact_tx_buf_len > 0);
+    compact_tx_seq = frame.seq;
+}
 
-static bool should_use_wifi_transport(void)
+static void on_lora_frame_ack(uint8_t seq)
 {
-    return convert_3_way_switch(controller_samples[INPUT_SWITCH_2_UP].raw_value, controller_samples[INPUT_SWITCH_2_DOWN].raw_value) == 2000;
+    frame_codec_ack(&codec, seq);
+    latency_probe_ack(LATENCY_LINK_LORA, seq);
 }
+#endif
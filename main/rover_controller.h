@@ -1,3 +1,15 @@
 #pragma once
 
-void rover_controller_init(void);
\ No newline at end of file
+#include <stdint.h>
+
+typedef struct rover_controller_stats_t {
+    uint32_t    frames_sent;
+    uint32_t    frames_suppressed;      // Inputs within deadband and keepalive not due
+    uint32_t    last_switch_latency_us; // From the first switch edge to the frame being handed to the transport
+    uint32_t    max_switch_latency_us;
+    uint32_t    wifi_send_failures;
+} rover_controller_stats_t;
+
+void rover_controller_init(void);
+void rover_controller_set_deadband(uint8_t channel, uint16_t deadband);
+void rover_controller_get_stats(rover_controller_stats_t* stats);
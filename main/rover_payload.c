@@ -0,0 +1,40 @@
+#include <stdlib.h>
+#include "rover_payload.h"
+#include "rover_utils.h"
+
+// samples is indexed by inputs, channels must fit ROVER_PAYLOAD_CHANNELS values
+void rover_payload_build(const controller_sample_t* samples, uint16_t* channels)
+{
+    channels[0] = 2000 + 1000 - map(samples[INPUT_RIGHT_JOYSTICK_X].voltage, 0, 3300, 1000, 2000); // Steer joystick is inverted
+    channels[1] = map(samples[INPUT_RIGHT_JOYSTICK_Y].voltage, 0, 3300, 1000, 2000);
+    channels[2] = map(samples[INPUT_LEFT_JOYSTICK_X].voltage, 0, 3300, 1000, 2000);
+    channels[3] = map(samples[INPUT_LEFT_JOYSTICK_Y].voltage, 0, 3300, 1000, 2000);
+    channels[4] = rover_payload_3_way_switch(samples[INPUT_SWITCH_1_UP].raw_value, samples[INPUT_SWITCH_1_DOWN].raw_value);
+    channels[5] = 1500;
+}
+
+// True if any channel moved more than its deadband since the last sent payload
+bool rover_payload_changed(const uint16_t* sent, const uint16_t* channels, const uint16_t* deadband)
+{
+    for (uint8_t i = 0; i < ROVER_PAYLOAD_CHANNELS; i++) {
+        if (abs((int)channels[i] - (int)sent[i]) > deadband[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint16_t rover_payload_3_way_switch(uint32_t up, uint32_t down)
+{
+    uint16_t value;
+
+    if (up == 0 && down == 0) {
+        value = 1500;
+    } else if (up == 1) {
+        value = 1000;
+    } else {
+        value = 2000;
+    }
+
+    return value;
+}
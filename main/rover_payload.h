@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "controller_sample.h"
+
+/*
+ * Turns filtered samples into the channel values sent to the Rover. Only depends on
+ * libc so it can be built and fed recorded samples off target.
+ *
+ * Payload: ROVER_PAYLOAD_CHANNELS little endian uint16, 1000 - 2000 with 1500 centered.
+ */
+
+#define ROVER_PAYLOAD_CHANNELS  6 // Rover RC controller have 6 channels, limit to that for now for compatability
+#define ROVER_PAYLOAD_LEN       (ROVER_PAYLOAD_CHANNELS * sizeof(uint16_t))
+
+void rover_payload_build(const controller_sample_t* samples, uint16_t* channels);
+bool rover_payload_changed(const uint16_t* sent, const uint16_t* channels, const uint16_t* deadband);
+uint16_t rover_payload_3_way_switch(uint32_t up, uint32_t down);
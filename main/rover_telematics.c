@@ -1,14 +1,53 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
 #include "rover_telematics.h"
 #include "assert.h"
 #include "leds.h"
+#include "metrics.h"
+#include "config.h"
+
+typedef struct telematics_field_t {
+    char                key[ROVER_TELEMATICS_KEY_LEN];
+    char                raw[ROVER_TELEMATICS_VALUE_LEN];   // Value as received, sent on exactly like this
+    telematics_value_t  value;
+} telematics_field_t;
+
+typedef struct parsed_field_t {
+    const char*     key;
+    uint8_t         key_len;
+    const char*     raw;
+    uint8_t         raw_len;
+} parsed_field_t;
+
+static int parse_object(const char* json, uint16_t length, parsed_field_t* fields, uint8_t max_fields);
+static bool store_field(const parsed_field_t* parsed, int64_t now);
+static uint16_t append_field(char* buf, uint16_t size, uint16_t len, const telematics_field_t* field);
+static uint16_t build_snapshot(uint8_t* buf, uint16_t size);
 
 static on_telematics* on_data = NULL;
+static xSemaphoreHandle store_sem;
+static telematics_field_t fields[ROVER_TELEMATICS_MAX_FIELDS];
+static uint8_t num_fields;
+// Frames come from both the LoRa and WiFi tasks, these are only used with store_sem held.
+// Kept off the stack as they would take about 600 bytes of the receiving task's stack.
+static parsed_field_t parsed[ROVER_TELEMATICS_MAX_FIELDS];
+static bool changed[ROVER_TELEMATICS_MAX_FIELDS];
+#ifdef ROVER_PHONE_TELEMATICS_DELTAS
+// Room for the terminating null snprintf writes after the closing brace
+static uint8_t delta_buf[ROVER_TELEMATICS_MAX_LEN + 1];
+#endif
 
 
 void rover_telematics_register_on_data(on_telematics* callback)
 {
     assert(on_data == NULL);
     assert(callback != NULL);
+    store_sem = xSemaphoreCreateMutex();
+    assert(store_sem != NULL);
     on_data = callback;
 }
 
@@ -17,7 +56,243 @@ void rover_telematics_put(uint8_t* telematics, uint16_t length)
     // Later one LED will be used for something else.
     leds_toggle(LED_LEFT);
     leds_toggle(LED_RIGHT);
-    if (on_data) {
+    metrics_inc(METRIC_TELEMATICS_RECEIVED);
+    if (!on_data) {
+        return;
+    }
+    if (length > ROVER_TELEMATICS_MAX_LEN) {
+        metrics_inc(METRIC_TELEMATICS_DROPPED);
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    xSemaphoreTake(store_sem, portMAX_DELAY);
+    int num_parsed = parse_object((const char*)telematics, length, parsed, ROVER_TELEMATICS_MAX_FIELDS);
+    if (num_parsed < 0) {
+        xSemaphoreGive(store_sem);
         on_data(telematics, length);
+        return;
+    }
+
+    for (uint8_t i = 0; i < num_parsed; i++) {
+        changed[i] = store_field(&parsed[i], now);
+    }
+
+#ifdef ROVER_PHONE_TELEMATICS_DELTAS
+    // delta_buf is only used with store_sem held like parsed
+    uint16_t len = 0;
+    bool fits = true;
+    for (uint8_t i = 0; i < num_parsed && fits; i++) {
+        if (changed[i]) {
+            int field_len = snprintf((char*)&delta_buf[len], sizeof(delta_buf) - len, "%s\"%.*s\":%.*s",
+                                     len == 0 ? "{" : ",", parsed[i].key_len, parsed[i].key,
+                                     parsed[i].raw_len, parsed[i].raw);
+            // With the closing brace
+            fits = field_len > 0 && len + field_len + 1 <= ROVER_TELEMATICS_MAX_LEN;
+            len += fits ? field_len : 0;
+        }
+    }
+    if (!fits) {
+        // Every field of the frame, that is all the changes too
+        on_data(telematics, length);
+    } else if (len > 0) {
+        delta_buf[len++] = '}';
+        on_data(delta_buf, len);
+    }
+#else
+    on_data(telematics, length);
+#endif
+    xSemaphoreGive(store_sem);
+}
+
+bool rover_telematics_get(const char* key, telematics_value_t* value)
+{
+    bool found = false;
+
+    xSemaphoreTake(store_sem, portMAX_DELAY);
+    for (uint8_t i = 0; i < num_fields; i++) {
+        if (strcmp(fields[i].key, key) == 0) {
+            *value = fields[i].value;
+            found = true;
+            break;
+        }
+    }
+    xSemaphoreGive(store_sem);
+
+    return found;
+}
+
+// Every known field as one JSON object, returns 0 if nothing has been received yet
+uint16_t rover_telematics_snapshot(uint8_t* buf, uint16_t size)
+{
+    xSemaphoreTake(store_sem, portMAX_DELAY);
+    uint16_t len = build_snapshot(buf, size);
+    xSemaphoreGive(store_sem);
+
+    return len;
+}
+
+void rover_telematics_with_snapshot(uint8_t* buf, uint16_t size, on_telematics_snapshot* callback, void* arg)
+{
+    xSemaphoreTake(store_sem, portMAX_DELAY);
+    callback(buf, build_snapshot(buf, size), arg);
+    xSemaphoreGive(store_sem);
+}
+
+// Must be called with store_sem held
+static uint16_t build_snapshot(uint8_t* buf, uint16_t size)
+{
+    uint16_t len = 0;
+
+    for (uint8_t i = 0; i < num_fields; i++) {
+        len = append_field((char*)buf, size, len, &fields[i]);
+    }
+    if (len == 0 || len >= size) {
+        return 0;
+    }
+    buf[len++] = '}';
+
+    return len;
+}
+
+static uint16_t append_field(char* buf, uint16_t size, uint16_t len, const telematics_field_t* field)
+{
+    if (len >= size) {
+        return len;
+    }
+    return len + snprintf(&buf[len], size - len, "%s\"%s\":%s", len == 0 ? "{" : ",", field->key, field->raw);
+}
+
+// Must be called with store_sem held, returns true if the value is new or differs from the cached one
+static bool store_field(const parsed_field_t* parsed, int64_t now)
+{
+    telematics_field_t* field = NULL;
+    bool changed;
+
+    for (uint8_t i = 0; i < num_fields; i++) {
+        if (strlen(fields[i].key) == parsed->key_len && strncmp(fields[i].key, parsed->key, parsed->key_len) == 0) {
+            field = &fields[i];
+            break;
+        }
+    }
+    if (field == NULL) {
+        if (num_fields == ROVER_TELEMATICS_MAX_FIELDS) {
+            return true;
+        }
+        field = &fields[num_fields++];
+        memcpy(field->key, parsed->key, parsed->key_len);
+        field->key[parsed->key_len] = '\0';
+        field->raw[0] = '\0';
+    }
+
+    changed = strlen(field->raw) != parsed->raw_len || strncmp(field->raw, parsed->raw, parsed->raw_len) != 0;
+    if (changed) {
+        memcpy(field->raw, parsed->raw, parsed->raw_len);
+        field->raw[parsed->raw_len] = '\0';
+        if (parsed->raw[0] == 't' || parsed->raw[0] == 'f') {
+            field->value.type = TELEMATICS_BOOL;
+            field->value.number = parsed->raw[0] == 't';
+        } else if (parsed->raw[0] == 'n') {
+            field->value.type = TELEMATICS_NULL;
+            field->value.number = 0;
+        } else {
+            field->value.type = TELEMATICS_NUMBER;
+            field->value.number = strtod(field->raw, NULL);
+        }
+    }
+    field->value.updated_us = now;
+
+    return changed;
+}
+
+static const char* skip_space(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        p++;
+    }
+    return p;
+}
+
+static bool is_value_char(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' || c == 'E';
+}
+
+static bool valid_value(const char* raw, uint8_t len)
+{
+    if ((len == 4 && strncmp(raw, "true", 4) == 0) || (len == 5 && strncmp(raw, "false", 5) == 0) ||
+        (len == 4 && strncmp(raw, "null", 4) == 0)) {
+        return true;
     }
-}
\ No newline at end of file
+    char* parsed_end;
+    char tmp[ROVER_TELEMATICS_VALUE_LEN];
+    memcpy(tmp, raw, len);
+    tmp[len] = '\0';
+    strtod(tmp, &parsed_end);
+
+    return parsed_end == &tmp[len];
+}
+
+// Returns the number of fields in a flat JSON object, or -1 if it isn't one
+static int parse_object(const char* json, uint16_t length, parsed_field_t* out, uint8_t max_fields)
+{
+    const char* end = json + length;
+    const char* p = skip_space(json, end);
+    int count = 0;
+
+    if (p == end || *p++ != '{') {
+        return -1;
+    }
+    p = skip_space(p, end);
+    if (p < end && *p == '}') {
+        return 0;
+    }
+
+    while (p < end) {
+        if (*p++ != '"') {
+            return -1;
+        }
+        const char* key = p;
+        while (p < end && *p != '"' && *p != '\\') {
+            p++;
+        }
+        if (p == end || *p != '"' || p - key == 0 || p - key >= ROVER_TELEMATICS_KEY_LEN) {
+            return -1;
+        }
+        uint8_t key_len = p - key;
+        p = skip_space(p + 1, end);
+        if (p == end || *p++ != ':') {
+            return -1;
+        }
+        p = skip_space(p, end);
+        const char* raw = p;
+        while (p < end && is_value_char(*p)) {
+            p++;
+        }
+        if (p - raw == 0 || p - raw >= ROVER_TELEMATICS_VALUE_LEN || !valid_value(raw, p - raw)) {
+            return -1;
+        }
+        if (count == max_fields) {
+            return -1;
+        }
+        out[count].key = key;
+        out[count].key_len = key_len;
+        out[count].raw = raw;
+        out[count].raw_len = p - raw;
+        count++;
+
+        p = skip_space(p, end);
+        if (p == end) {
+            return -1;
+        }
+        if (*p == '}') {
+            return skip_space(p + 1, end) == end ? count : -1;
+        }
+        if (*p++ != ',') {
+            return -1;
+        }
+        p = skip_space(p, end);
+    }
+
+    return -1;
+}
@@ -2,9 +2,48 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
+
+// Largest telematics frame passed on, bigger frames are dropped by the transports
+#define ROVER_TELEMATICS_MAX_LEN    1024
+
+#define ROVER_TELEMATICS_MAX_FIELDS 32
+#define ROVER_TELEMATICS_KEY_LEN    24
+#define ROVER_TELEMATICS_VALUE_LEN  24
+
+/*
+ * Telematics frames that are a flat JSON object, { "key": value, ... } with number,
+ * true/false or null values, are parsed and the latest value of every field is kept.
+ * Anything else is passed on untouched and not cached.
+ *
+ * With ROVER_PHONE_TELEMATICS_DELTAS set in config.h the callback only gets the fields
+ * that changed since the last frame, as a JSON object in the same format. A complete
+ * object with every field is available from rover_telematics_snapshot.
+ *
+ * Frames that update the cache are passed on with the cache locked, the callback of
+ * rover_telematics_with_snapshot runs under the same lock so whatever it queues is in
+ * order with them: every frame passed on before it is in the snapshot, every frame after
+ * it is newer. Frames longer than ROVER_TELEMATICS_MAX_LEN are dropped.
+ */
+typedef enum telematics_type_t {
+    TELEMATICS_NUMBER,
+    TELEMATICS_BOOL,
+    TELEMATICS_NULL
+} telematics_type_t;
+
+typedef struct telematics_value_t {
+    telematics_type_t   type;
+    double              number;     // Also 1 or 0 for bools
+    int64_t             updated_us; // When the field was last received
+} telematics_value_t;
 
 typedef void on_telematics(uint8_t* telematics, uint16_t length);
+// length is 0 if nothing has been received yet
+typedef void on_telematics_snapshot(uint8_t* snapshot, uint16_t length, void* arg);
 
 void rover_telematics_register_on_data(on_telematics* callback);
 
-void rover_telematics_put(uint8_t* telematics, uint16_t length);
\ No newline at end of file
+void rover_telematics_put(uint8_t* telematics, uint16_t length);
+bool rover_telematics_get(const char* key, telematics_value_t* value);
+uint16_t rover_telematics_snapshot(uint8_t* buf, uint16_t size);
+void rover_telematics_with_snapshot(uint8_t* buf, uint16_t size, on_telematics_snapshot* callback, void* arg);
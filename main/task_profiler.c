@@ -0,0 +1,145 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "assert.h"
+#include "task_profiler.h"
+
+#if !configUSE_TRACE_FACILITY || !configGENERATE_RUN_TIME_STATS
+#error "task_profiler needs CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS"
+#endif
+
+typedef struct task_profile_t {
+    char            name[configMAX_TASK_NAME_LEN];
+    UBaseType_t     number;                         // xTaskNumber, unique for the lifetime of the task
+    uint8_t         priority;
+    uint16_t        stack_free;
+    uint32_t        last_run_time;
+    uint8_t         cpu[TASK_PROFILER_HISTORY];     // Ring indexed the same as every other task
+} task_profile_t;
+
+static void sample(void* arg);
+
+static const char* TAG = "TASK_PROFILER";
+
+static xSemaphoreHandle profile_sem;
+static esp_timer_handle_t sample_timer;
+static uint32_t sample_interval_ms;
+static TaskStatus_t task_status[TASK_PROFILER_MAX_TASKS];
+static task_profile_t profiles[TASK_PROFILER_MAX_TASKS];
+static uint8_t num_profiles;
+static uint8_t history_head;       // Where the next sample goes
+static uint8_t history_count;
+static bool baseline_taken;         // The first sample only sets the run times to count from
+static uint32_t last_total_run_time;
+
+void task_profiler_init(uint32_t interval_ms)
+{
+    profile_sem = xSemaphoreCreateMutex();
+    assert(profile_sem != NULL);
+    sample_interval_ms = interval_ms;
+    num_profiles = 0;
+    history_head = 0;
+    history_count = 0;
+    baseline_taken = false;
+
+    const esp_timer_create_args_t sample_timer_args = {
+        .callback = &sample,
+        .name = "task_profiler"
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&sample_timer_args, &sample_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(sample_timer, interval_ms * 1000));
+}
+
+static task_profile_t* find_profile(const TaskStatus_t* status)
+{
+    for (uint8_t i = 0; i < num_profiles; i++) {
+        if (profiles[i].number == status->xTaskNumber) {
+            return &profiles[i];
+        }
+    }
+    if (num_profiles == TASK_PROFILER_MAX_TASKS) {
+        return NULL;
+    }
+
+    task_profile_t* profile = &profiles[num_profiles++];
+    memset(profile, 0, sizeof(task_profile_t));
+    strncpy(profile->name, status->pcTaskName, sizeof(profile->name) - 1);
+    profile->number = status->xTaskNumber;
+    // Counted from when the task was created, the first interval is not a whole one
+    profile->last_run_time = 0;
+
+    return profile;
+}
+
+static void sample(void* arg)
+{
+    uint32_t total_run_time;
+    UBaseType_t num_tasks = uxTaskGetSystemState(task_status, TASK_PROFILER_MAX_TASKS, &total_run_time);
+
+    if (num_tasks == 0) {
+        ESP_LOGW(TAG, "More than %d tasks, not profiled", TASK_PROFILER_MAX_TASKS);
+        return;
+    }
+
+    uint32_t elapsed = total_run_time - last_total_run_time;
+    last_total_run_time = total_run_time;
+
+    xSemaphoreTake(profile_sem, portMAX_DELAY);
+    for (uint8_t i = 0; i < num_profiles; i++) {
+        profiles[i].cpu[history_head] = 0;
+    }
+    for (UBaseType_t i = 0; i < num_tasks; i++) {
+        task_profile_t* profile = find_profile(&task_status[i]);
+        if (profile == NULL) {
+            continue;
+        }
+        uint32_t used = task_status[i].ulRunTimeCounter - profile->last_run_time;
+        profile->last_run_time = task_status[i].ulRunTimeCounter;
+        profile->priority = task_status[i].uxCurrentPriority;
+        profile->stack_free = task_status[i].usStackHighWaterMark;
+        if (elapsed > 0) {
+            uint64_t percent = (uint64_t)used * 100 / elapsed;
+            profile->cpu[history_head] = percent > 100 ? 100 : percent;
+        }
+    }
+    if (baseline_taken) {
+        history_head = (history_head + 1) % TASK_PROFILER_HISTORY;
+        if (history_count < TASK_PROFILER_HISTORY) {
+            history_count++;
+        }
+    }
+    baseline_taken = true;
+    xSemaphoreGive(profile_sem);
+}
+
+// See task_profiler.h for the format, returns 0 if buf is too small
+uint16_t task_profiler_to_json(char* buf, uint16_t size)
+{
+    int len = snprintf(buf, size, "{\"interval_ms\":%u,\"tasks\":[", sample_interval_ms);
+
+    xSemaphoreTake(profile_sem, portMAX_DELAY);
+    for (uint8_t i = 0; i < num_profiles && len < size; i++) {
+        const task_profile_t* profile = &profiles[i];
+        len += snprintf(&buf[len], size - len, "%s{\"name\":\"%s\",\"prio\":%u,\"stack_free\":%u,\"cpu\":[",
+                        i == 0 ? "" : ",", profile->name, profile->priority, profile->stack_free);
+        for (uint8_t j = 0; j < history_count && len < size; j++) {
+            uint8_t index = (history_head + TASK_PROFILER_HISTORY - history_count + j) % TASK_PROFILER_HISTORY;
+            len += snprintf(&buf[len], size - len, "%s%u", j == 0 ? "" : ",", profile->cpu[index]);
+        }
+        if (len < size) {
+            len += snprintf(&buf[len], size - len, "]}");
+        }
+    }
+    xSemaphoreGive(profile_sem);
+
+    if (len < size) {
+        len += snprintf(&buf[len], size - len, "]}");
+    }
+
+    return len < size ? len : 0;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Samples the FreeRTOS run time stats and stack high water marks of every task at a
+ * fixed interval and keeps the last TASK_PROFILER_HISTORY samples. Needs
+ * CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS.
+ *
+ * Served as JSON by GET /tasks on the web server:
+ *
+ *   { "interval_ms": ms, "tasks": [ { "name": "send_values", "prio": 5, "stack_free": bytes,
+ *     "cpu": [ percent, ... ] }, ... ] }
+ *
+ * stack_free is the least free stack the task ever had. cpu is the share of one core
+ * the task used in each interval, oldest first, so the idle tasks are close to 100
+ * when the system is idle. A task that has been deleted reports 0 from then on.
+ */
+
+#define TASK_PROFILER_MAX_TASKS     24
+#define TASK_PROFILER_HISTORY       10
+#define TASK_PROFILER_JSON_MAX_LEN  3072
+
+void task_profiler_init(uint32_t interval_ms);
+uint16_t task_profiler_to_json(char* buf, uint16_t size);
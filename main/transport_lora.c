@@ -4,27 +4,77 @@
 #include "freertos/semphr.h"
 #include "lora.h"
 #include "transport_lora.h"
+#include "lora_adr.h"
+#include "frame_codec.h"
 #include "rover_telematics.h"
+#include "link_manager.h"
+#include "latency_probe.h"
+#include "metrics.h"
+#include "flight_recorder.h"
+#include "control_scheduler.h"
+#include "config.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_timer.h"
 #include "assert.h"
 #include "driver/gpio.h"
 
 #define DIO0_PIN GPIO_NUM_26
 
 #define LORA_DIO0_HIGH 2
+#define LORA_TX_STARTED 4
 
 #define MAX_LORA_PAYLOAD 100
+#define RECEIVE_TASK_STACK_SIZE 4096 // Telematics parsing, flight recorder and logging all run on this task
+#define LORA_TX_TIMEOUT_MARGIN_MS 20 // On top of the time on air of the frame being sent
+
+#define LORA_FREQUENCY 868e6
+#define LORA_PREAMBLE_LENGTH 8
+#define LORA_TX_POWER 17
+
+#define LORA_SLOT_GUARD_US 2000
+
+#define PROFILE_SWITCH_HEADER_0 'L'
+#define PROFILE_SWITCH_HEADER_1 'P'
+#define PROFILE_CONFIRM_TIMEOUT_MS 1000
+#define LINK_LOST_TIMEOUT_MS 3000
 
 static const char* TAG = "TRANSPORT_LORA";
 
 static void IRAM_ATTR gpio_dio0_isr_handler(void* arg);
 static void lora_receive_task(void* arg);
+static void finish_transmission(void);
+static void wait_for_rover_slot(void);
+static void update_slot_plan(void);
+static void apply_profile(uint8_t index);
+static void start_transmission(uint8_t* data, uint16_t length);
+#ifdef ROVER_LORA_ADR
+static void limit_profiles(void);
+#endif
+static void check_link_timeouts(void);
+static void on_packet_received(void);
 
 
 static TaskHandle_t lora_receive_task_handle;
 static xSemaphoreHandle lora_sem;
+static xSemaphoreHandle tx_idle_sem;
+static volatile bool tx_in_progress = false;
 static bool lora_modem_detected = false;
+static lora_slot_plan_t slot_plan;
+static uint32_t slot_period_ms;
+static uint16_t slot_controller_payload_len;
+static uint32_t tx_timeout_ms = LORA_TX_TIMEOUT_MARGIN_MS;
+static volatile int64_t rover_slot_end_us = 0;
+static on_frame_ack* on_ack = NULL;
+
+// Adaptive data rate state, only accessed with lora_sem held
+static uint8_t profile = LORA_ADR_DEFAULT_PROFILE;
+static uint8_t previous_profile = LORA_ADR_DEFAULT_PROFILE;
+static uint8_t next_profile;
+static bool switch_pending = false;
+static bool switch_in_flight = false;
+static int64_t confirm_deadline_us = 0;
+static int64_t last_rx_us = 0;
 
 void transport_lora_init(void)
 {
@@ -38,13 +88,17 @@ void transport_lora_init(void)
 
    lora_sem = xSemaphoreCreateBinary();
    assert(lora_sem != NULL);
-   
-   lora_set_frequency(868e6);
+   tx_idle_sem = xSemaphoreCreateBinary();
+   assert(tx_idle_sem != NULL);
+   xSemaphoreGive(tx_idle_sem);
+
+   lora_begin_batch();
+   lora_set_frequency(LORA_FREQUENCY);
    lora_enable_crc();
-   lora_set_spreading_factor(7);
-   lora_set_tx_power(17);
-   lora_set_bandwidth(500E3);
-   lora_set_coding_rate(5);
+   lora_set_tx_power(LORA_TX_POWER);
+   lora_set_preamble_length(LORA_PREAMBLE_LENGTH);
+   lora_end_batch();
+   apply_profile(LORA_ADR_DEFAULT_PROFILE);
 
    gpio_config_t io_conf;
    io_conf.intr_type = GPIO_PIN_INTR_POSEDGE;
@@ -56,7 +110,7 @@ void transport_lora_init(void)
 
    gpio_install_isr_service(0);
 
-   BaseType_t status = xTaskCreate(lora_receive_task, "lora_receive_task", 2048, NULL, 2, &lora_receive_task_handle);
+   BaseType_t status = xTaskCreate(lora_receive_task, "lora_receive_task", RECEIVE_TASK_STACK_SIZE, NULL, 2, &lora_receive_task_handle);
    assert(status == pdPASS);
 
    gpio_isr_handler_add(DIO0_PIN, gpio_dio0_isr_handler, (void*) DIO0_PIN);
@@ -69,40 +123,251 @@ void transport_lora_init(void)
 void transport_lora_send(uint8_t* data, uint16_t length)
 {
    if (lora_modem_detected) {
+      control_scheduler_stage_begin(CONTROL_STAGE_LINK_WAIT);
+      wait_for_rover_slot();
+      // Previous frame still on air, TxDone or its timeout will release it
+      BaseType_t idle = xSemaphoreTake(tx_idle_sem, pdMS_TO_TICKS(tx_timeout_ms));
+      control_scheduler_stage_end(CONTROL_STAGE_LINK_WAIT);
+      if (idle != pdTRUE) {
+         ESP_LOGW(TAG, "Previous transmission not done, dropping frame");
+         metrics_inc(METRIC_SEMAPHORE_TIMEOUTS);
+         metrics_inc(METRIC_LORA_FRAMES_DROPPED);
+         latency_probe_tx_dropped(LATENCY_LINK_LORA);
+         return;
+      }
       assert(xSemaphoreTake(lora_sem, pdMS_TO_TICKS(50)) == pdTRUE);
-      gpio_isr_handler_remove(DIO0_PIN);
-      lora_send_packet(data, length);
-      gpio_isr_handler_add(DIO0_PIN, gpio_dio0_isr_handler, (void*) DIO0_PIN);
-      lora_receive();
+      check_link_timeouts();
+      tx_in_progress = true;
+      if (switch_pending) {
+         // Tell the rover to change profile instead of sending this frame, the next one goes out with the new profile
+         uint8_t cmd[] = { PROFILE_SWITCH_HEADER_0, PROFILE_SWITCH_HEADER_1, next_profile };
+         switch_pending = false;
+         switch_in_flight = true;
+         // The switch frame goes on air untraced, its TxDone is not this frame's
+         latency_probe_tx_dropped(LATENCY_LINK_LORA);
+         latency_probe_tx_started(LATENCY_LINK_LORA);
+         start_transmission(cmd, sizeof(cmd));
+      } else {
+         latency_probe_tx_started(LATENCY_LINK_LORA);
+         flight_recorder_record(FLIGHT_RECORD_CONTROL, FLIGHT_TRANSPORT_LORA, data, length);
+         start_transmission(data, length);
+         metrics_inc(METRIC_LORA_FRAMES_SENT);
+      }
       xSemaphoreGive(lora_sem);
+      xTaskNotify(lora_receive_task_handle, LORA_TX_STARTED, eSetBits);
+   }
+}
+
+void transport_lora_register_on_ack(on_frame_ack* callback)
+{
+   assert(on_ack == NULL);
+   assert(callback != NULL);
+   on_ack = callback;
+}
+
+void transport_lora_configure_slots(uint32_t period_ms, uint16_t controller_payload_len)
+{
+   slot_period_ms = period_ms;
+   slot_controller_payload_len = controller_payload_len;
+#ifdef ROVER_LORA_ADR
+   limit_profiles();
+#endif
+   update_slot_plan();
+}
+
+void transport_lora_get_slot_plan(lora_slot_plan_t* plan)
+{
+   assert(plan != NULL);
+   *plan = slot_plan;
+}
+
+static void update_slot_plan(void)
+{
+   const lora_profile_t* p = lora_adr_get_profile(profile);
+   uint32_t used_us;
+
+   if (slot_period_ms == 0) {
+      return;
+   }
+
+   slot_plan.period_us = slot_period_ms * 1000;
+   slot_plan.controller_slot_us = lora_time_on_air_us(p, LORA_PREAMBLE_LENGTH, slot_controller_payload_len) + LORA_SLOT_GUARD_US;
+   slot_plan.rover_slot_us = lora_time_on_air_us(p, LORA_PREAMBLE_LENGTH, MAX_LORA_PAYLOAD) + LORA_SLOT_GUARD_US;
+
+   used_us = slot_plan.controller_slot_us + slot_plan.rover_slot_us;
+   // A send waits at most for the previous frame and the rover slot after it
+   control_scheduler_set_budget(CONTROL_STAGE_LINK_WAIT, used_us);
+   if (used_us > slot_plan.period_us) {
+      ESP_LOGW(TAG, "Slots need %d us, more than the %d us period", used_us, slot_plan.period_us);
+      slot_plan.idle_us = 0;
+   } else {
+      slot_plan.idle_us = slot_plan.period_us - used_us;
+   }
+   ESP_LOGI(TAG, "Slot plan: controller %d us, rover %d us, idle %d us",
+            slot_plan.controller_slot_us, slot_plan.rover_slot_us, slot_plan.idle_us);
+}
+
+#ifdef ROVER_LORA_ADR
+// Profiles are ordered by airtime, only use the ones where both slots fit in the control period
+static void limit_profiles(void)
+{
+   uint8_t max_profile = 0;
+
+   for (uint8_t i = 1; i < lora_adr_num_profiles(); i++) {
+      const lora_profile_t* p = lora_adr_get_profile(i);
+      uint32_t used_us = lora_time_on_air_us(p, LORA_PREAMBLE_LENGTH, slot_controller_payload_len) +
+                         lora_time_on_air_us(p, LORA_PREAMBLE_LENGTH, MAX_LORA_PAYLOAD) + 2 * LORA_SLOT_GUARD_US;
+      if (used_us > slot_period_ms * 1000) {
+         break;
+      }
+      max_profile = i;
+   }
+   if (max_profile == 0) {
+      ESP_LOGE(TAG, "No profile but 0 fits a %d ms period, ADR can't switch", slot_period_ms);
+   } else if (max_profile < lora_adr_num_profiles() - 1) {
+      ESP_LOGW(TAG, "Profiles above %d don't fit a %d ms period, not used", max_profile, slot_period_ms);
+   }
+   lora_adr_set_max_profile(max_profile);
+}
+#endif
+
+// Must be called with lora_sem held, the timeout follows the airtime of the frame with the current profile
+static void start_transmission(uint8_t* data, uint16_t length)
+{
+   const lora_profile_t* p = lora_adr_get_profile(profile);
+
+   tx_timeout_ms = lora_time_on_air_us(p, LORA_PREAMBLE_LENGTH, length) / 1000 + LORA_TX_TIMEOUT_MARGIN_MS;
+   lora_send_packet_async(data, length);
+}
+
+// Must be called with lora_sem held while the radio is not transmitting
+static void apply_profile(uint8_t index)
+{
+   const lora_profile_t* p = lora_adr_get_profile(index);
+
+   lora_idle();
+   lora_begin_batch();
+   lora_set_spreading_factor(p->spreading_factor);
+   lora_set_bandwidth(p->bandwidth);
+   lora_set_coding_rate(p->coding_rate);
+   lora_end_batch();
+
+   profile = index;
+   last_rx_us = esp_timer_get_time();
+   lora_adr_reset(index);
+   update_slot_plan();
+   ESP_LOGI(TAG, "Using profile %d: SF%d, %d Hz, CR 4/%d", index, p->spreading_factor, p->bandwidth, p->coding_rate);
+}
+
+// Fall back if the rover did not follow a profile switch or went silent
+static void check_link_timeouts(void)
+{
+   int64_t now = esp_timer_get_time();
+
+   if (confirm_deadline_us != 0 && now > confirm_deadline_us) {
+      ESP_LOGW(TAG, "Rover did not follow to profile %d, reverting", profile);
+      confirm_deadline_us = 0;
+      apply_profile(previous_profile);
+      lora_receive();
+   } else if (profile != LORA_ADR_DEFAULT_PROFILE && now - last_rx_us > LINK_LOST_TIMEOUT_MS * 1000LL) {
+      ESP_LOGW(TAG, "Link lost, back to default profile");
+      apply_profile(LORA_ADR_DEFAULT_PROFILE);
+      lora_receive();
+   }
+}
+
+static void on_packet_received(void)
+{
+   int rssi = lora_packet_rssi();
+   float snr = lora_packet_snr();
+
+   link_manager_on_lora_packet(rssi, snr);
+
+   last_rx_us = esp_timer_get_time();
+   confirm_deadline_us = 0;
+#ifdef ROVER_LORA_ADR
+   uint8_t recommended = lora_adr_on_packet(rssi, snr);
+   if (recommended != profile && !switch_in_flight) {
+      next_profile = recommended;
+      switch_pending = true;
    }
+#endif
 }
 
 static void lora_receive_task(void* arg)
 {
     while (true) {
          uint8_t buf[MAX_LORA_PAYLOAD];
-         uint32_t notification;
+         uint32_t notification = 0;
+         TickType_t timeout = tx_in_progress ? pdMS_TO_TICKS(tx_timeout_ms) : portMAX_DELAY;
 
-         assert(xTaskNotifyWait(LORA_DIO0_HIGH, 0, &notification, portMAX_DELAY));
-         assert(notification == LORA_DIO0_HIGH);
+         xTaskNotifyWait(0, LORA_DIO0_HIGH | LORA_TX_STARTED, &notification, timeout);
          assert(xSemaphoreTake(lora_sem, pdMS_TO_TICKS(50)) == pdTRUE);
-         while (lora_received()) {
-            uint32_t x = lora_receive_packet(buf, sizeof(buf));
-            if (x == -1) {
-               printf("crc err\n");
-            } else {
-                printf("Received: %d\n", x);
-                rover_telematics_put(buf, x);
+         if (tx_in_progress) {
+            if (lora_tx_done()) {
+               latency_probe_on_air(LATENCY_LINK_LORA);
+               finish_transmission();
+            } else if (notification == 0) {
+               ESP_LOGE(TAG, "TxDone timeout");
+               metrics_inc(METRIC_LORA_TX_TIMEOUTS);
+               finish_transmission();
+            }
+         } else {
+            while (lora_received()) {
+               uint32_t x = lora_receive_packet(buf, sizeof(buf));
+               if (x == -1) {
+                  printf("crc err\n");
+                  metrics_inc(METRIC_LORA_CRC_ERRORS);
+               } else {
+                   printf("Received: %d\n", x);
+                   // Rover only sends one frame per slot, no need to wait for the rest of it
+                   rover_slot_end_us = 0;
+                   on_packet_received();
+                   uint8_t acked_seq;
+                   if (on_ack && frame_codec_parse_ack(buf, x, &acked_seq)) {
+                      on_ack(acked_seq);
+                   } else {
+                      flight_recorder_record(FLIGHT_RECORD_TELEMATICS, FLIGHT_TRANSPORT_LORA, buf, x);
+                      rover_telematics_put(buf, x);
+                   }
+               }
             }
          }
-         gpio_isr_handler_add(DIO0_PIN, gpio_dio0_isr_handler, (void*) DIO0_PIN);
          xSemaphoreGive(lora_sem);
     }
 }
 
+// Must be called with lora_sem held
+static void finish_transmission(void)
+{
+   if (switch_in_flight) {
+      switch_in_flight = false;
+      previous_profile = profile;
+      apply_profile(next_profile);
+      confirm_deadline_us = esp_timer_get_time() + PROFILE_CONFIRM_TIMEOUT_MS * 1000LL;
+   }
+   lora_send_packet_complete();
+   rover_slot_end_us = esp_timer_get_time() + slot_plan.rover_slot_us;
+   tx_in_progress = false;
+   xSemaphoreGive(tx_idle_sem);
+}
+
+// Don't step on the rover's telematics, wait for its slot to pass
+static void wait_for_rover_slot(void)
+{
+   int64_t remaining_us = rover_slot_end_us - esp_timer_get_time();
+
+   if (remaining_us > 0) {
+      TickType_t ticks = (remaining_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000);
+      vTaskDelay(ticks);
+   }
+}
+
 static void IRAM_ATTR gpio_dio0_isr_handler(void* arg)
 {
-   gpio_isr_handler_remove(DIO0_PIN);
-   assert(xTaskNotifyFromISR(lora_receive_task_handle, LORA_DIO0_HIGH, eSetValueWithOverwrite, NULL) == pdPASS);
+   BaseType_t higher_prio_task_woken = pdFALSE;
+   xTaskNotifyFromISR(lora_receive_task_handle, LORA_DIO0_HIGH, eSetBits, &higher_prio_task_woken);
+   if (higher_prio_task_woken) {
+      portYIELD_FROM_ISR();
+   }
 }
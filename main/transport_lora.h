@@ -1,4 +1,39 @@
 #pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * LoRa is half duplex, so each control period is split in slots:
+ *
+ * | controller TX | rover TX | idle ... | controller TX | ...
+ *
+ * The rover may only transmit telematics during the rover slot, which opens
+ * when it receives a control frame. The controller will not start a new
+ * transmission until the rover slot has passed, or until a telematics frame
+ * has been received in it.
+ *
+ * With ROVER_LORA_ADR the modem profile (SF/BW/CR) follows the link quality of
+ * received telematics, see lora_adr.h, otherwise profile 0 is always used.
+ * Profiles where a control frame and a max size telematics frame don't both fit
+ * in the control period are never used. To switch, the controller sends the 3 byte frame
+ * { 'L', 'P', <profile index> } in place of a control frame and then changes
+ * profile. If no telematics arrive with the new profile within 1 s the controller
+ * goes back to the previous one, and if nothing at all is received for 3 s both
+ * ends are expected to fall back to profile 0.
+ */
+typedef struct lora_slot_plan_t {
+    uint32_t    period_us;              // Control period, one controller frame per period
+    uint32_t    controller_slot_us;     // Airtime of a control frame including guard time
+    uint32_t    rover_slot_us;          // Airtime of a max size telematics frame including guard time
+    uint32_t    idle_us;                // What is left of the period, 0 if the plan does not fit
+} lora_slot_plan_t;
+
+// Called when the rover acknowledges a compact control frame, see frame_codec.h
+typedef void on_frame_ack(uint8_t seq);
+
 void transport_lora_init(void);
 void transport_lora_send(uint8_t* data, uint16_t length);
+void transport_lora_configure_slots(uint32_t period_ms, uint16_t controller_payload_len);
+void transport_lora_get_slot_plan(lora_slot_plan_t* plan);
+void transport_lora_register_on_ack(on_frame_ack* callback);
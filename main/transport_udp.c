@@ -0,0 +1,156 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "assert.h"
+
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+
+#include "transport_udp.h"
+#include "redundant_link.h"
+#include "latency_probe.h"
+#include "metrics.h"
+#include "link_manager.h"
+#include "flight_recorder.h"
+#include "config.h"
+
+#define MAX_FRAME_LEN           64
+#define ACK_LEN                 3
+#define ACK_ALIVE_TIMEOUT_MS    500
+#define SENT_HISTORY            16  // Send times kept to match acks against, must be a power of 2
+#define RTT_AVG_SHIFT           3
+
+static void udp_ack_task(void* params);
+
+static const char* TAG = "TRANSPORT_UDP";
+
+static int sock = -1;
+static struct sockaddr_in rover_addr;
+// Written by the sending task and udp_ack_task, read from any task
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t sent_at_us[SENT_HISTORY];
+static uint16_t sent_seq[SENT_HISTORY];
+static int64_t last_ack_us;
+static transport_udp_stats_t stats;
+
+void transport_udp_init(void)
+{
+    struct sockaddr_in local_addr;
+
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    assert(sock >= 0);
+
+    memset(&local_addr, 0, sizeof(local_addr));
+    local_addr.sin_family = AF_INET;
+    local_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    local_addr.sin_port = htons(ROVER_CONTROLLER_UDP_CONTROL_PORT);
+    if (bind(sock, (struct sockaddr*)&local_addr, sizeof(local_addr)) < 0) {
+        ESP_LOGE(TAG, "Socket unable to bind: errno %d", errno);
+    }
+
+    memset(&rover_addr, 0, sizeof(rover_addr));
+    rover_addr.sin_family = AF_INET;
+    rover_addr.sin_addr.s_addr = inet_addr(ROVER_STATIC_IP);
+    rover_addr.sin_port = htons(ROVER_UDP_CONTROL_PORT);
+
+    BaseType_t status = xTaskCreate(udp_ack_task, "udp_ack", 2048, NULL, 5, NULL);
+    assert(status == pdPASS);
+}
+
+// Never blocks, if the frame can't be handed to the stack right away it's dropped
+esp_err_t transport_udp_send(uint16_t seq, uint8_t* payload, uint16_t length)
+{
+    uint8_t frame[MAX_FRAME_LEN];
+
+    assert(REDUNDANT_LINK_HEADER_LEN + length <= MAX_FRAME_LEN);
+    uint16_t frame_len = redundant_link_encode(seq, payload, length, frame);
+    flight_recorder_record(FLIGHT_RECORD_CONTROL, FLIGHT_TRANSPORT_UDP, frame, frame_len);
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&lock);
+    sent_seq[seq & (SENT_HISTORY - 1)] = seq;
+    sent_at_us[seq & (SENT_HISTORY - 1)] = now;
+    portEXIT_CRITICAL(&lock);
+    int sent = sendto(sock, frame, frame_len, MSG_DONTWAIT, (struct sockaddr*)&rover_addr, sizeof(rover_addr));
+    portENTER_CRITICAL(&lock);
+    if (sent != frame_len) {
+        stats.send_errors++;
+    } else {
+        stats.frames_sent++;
+    }
+    portEXIT_CRITICAL(&lock);
+    if (sent != frame_len) {
+        metrics_inc(METRIC_UDP_SEND_ERRORS);
+        return ESP_FAIL;
+    }
+    metrics_inc(METRIC_UDP_FRAMES_SENT);
+
+    return ESP_OK;
+}
+
+// True if the Rover has acked recently, always false if the Rover doesn't send acks
+bool transport_udp_alive(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&lock);
+    int64_t ack_us = last_ack_us;
+    portEXIT_CRITICAL(&lock);
+
+    return ack_us != 0 && now - ack_us < ACK_ALIVE_TIMEOUT_MS * 1000LL;
+}
+
+void transport_udp_get_stats(transport_udp_stats_t* out)
+{
+    assert(out != NULL);
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&lock);
+    *out = stats;
+    out->ack_staleness_ms = last_ack_us == 0 ? UINT32_MAX : (now - last_ack_us) / 1000;
+    portEXIT_CRITICAL(&lock);
+}
+
+static void on_ack(uint16_t seq)
+{
+    int64_t now = esp_timer_get_time();
+    uint8_t index = seq & (SENT_HISTORY - 1);
+
+    portENTER_CRITICAL(&lock);
+    last_ack_us = now;
+    stats.acks++;
+    // Acks older than the history can't be matched to a send time
+    if (sent_seq[index] == seq && sent_at_us[index] != 0) {
+        int32_t rtt = now - sent_at_us[index];
+        if (stats.rtt_us == 0) {
+            stats.rtt_us = rtt;
+        } else {
+            stats.rtt_us += (rtt - (int32_t)stats.rtt_us) >> RTT_AVG_SHIFT;
+        }
+        sent_at_us[index] = 0;
+    }
+    portEXIT_CRITICAL(&lock);
+    link_manager_on_udp_data();
+    latency_probe_ack(LATENCY_LINK_UDP, seq);
+}
+
+static void udp_ack_task(void* params)
+{
+    uint8_t rx_buffer[16];
+
+    while (true) {
+        struct sockaddr_in source_addr;
+        socklen_t socklen = sizeof(source_addr);
+        int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer), 0, (struct sockaddr*)&source_addr, &socklen);
+
+        if (len < 0) {
+            ESP_LOGE(TAG, "recvfrom failed: errno %d", errno);
+            vTaskDelay(pdMS_TO_TICKS(1000));
+        } else if (len == ACK_LEN && rx_buffer[0] == 'A') {
+            on_ack(rx_buffer[1] | (rx_buffer[2] << 8));
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_system.h"
+
+/*
+ * Control frames over UDP, for use instead of the websocket when the Rover is on WiFi.
+ * A lost datagram is never resent, the next frame replaces it, so nothing waits
+ * behind a lost frame like on TCP.
+ *
+ * Controller -> Rover, to ROVER_STATIC_IP:ROVER_UDP_CONTROL_PORT:
+ *   Frames in the redundant_link.h format, 16 bit sequence number then the control
+ *   payload. The Rover follows the same latest wins rules as in redundant mode.
+ *
+ * Rover -> Controller, back to the port the frame came from (optional):
+ *   { 'A', seq low, seq high }, acknowledges the newest frame the Rover has accepted.
+ *   The Rover may ack every frame or just now and then as a heartbeat, the controller
+ *   only uses acks for round trip time and liveness.
+ */
+
+typedef struct transport_udp_stats_t {
+    uint32_t    frames_sent;
+    uint32_t    send_errors;
+    uint32_t    acks;
+    uint32_t    rtt_us;             // Averaged round trip time from acks
+    uint32_t    ack_staleness_ms;   // Since the last ack, UINT32_MAX if none yet
+} transport_udp_stats_t;
+
+void transport_udp_init(void);
+esp_err_t transport_udp_send(uint16_t seq, uint8_t* payload, uint16_t length);
+bool transport_udp_alive(void);
+void transport_udp_get_stats(transport_udp_stats_t* stats);
@@ -18,10 +18,15 @@
 #include <lwip/netdb.h>
 
 #include "rover_telematics.h"
+#include "link_manager.h"
+#include "metrics.h"
+#include "flight_recorder.h"
+#include "ws_reassembler.h"
 
 #include "config.h"
 
 #define WS_TIMEOUT_MS 1500
+#define WS_SEND_TIMEOUT_MS 1000
 
 #define PORT 8080
 
@@ -32,6 +37,7 @@ static void ws_timed_out(void* arg);
 static void async_ws_connect(void);
 static void handle_rover_connection(void* args);
 static void udp_server_task(void *args);
+static void on_ws_data(esp_websocket_event_data_t* data);
 
 
 static const char *TAG = "TRANSPORT_WS";
@@ -41,8 +47,13 @@ static esp_websocket_client_handle_t client = NULL;
 static xSemaphoreHandle connect_semaphore;
 static esp_timer_handle_t ws_timeout_timer;
 
+// Frames bigger than the client buffer arrive in chunks, they are put together here
+static uint8_t ws_rx_buf[ROVER_TELEMATICS_MAX_LEN];
+static ws_reassembler_t ws_rx;
+
 void transport_ws_init(void)
 {
+    ws_reassembler_init(&ws_rx, ws_rx_buf, sizeof(ws_rx_buf));
     connect_semaphore = xSemaphoreCreateBinary();
     assert(connect_semaphore != NULL);
     xSemaphoreGive(connect_semaphore);
@@ -74,17 +85,27 @@ void transport_ws_start(void)
 }
 
 esp_err_t transport_ws_send(uint8_t* buf, uint16_t len)
+{
+    return transport_ws_send_timeout(buf, len, WS_SEND_TIMEOUT_MS);
+}
+
+esp_err_t transport_ws_send_timeout(uint8_t* buf, uint16_t len, uint32_t timeout_ms)
 {
     esp_err_t res = ESP_FAIL;
     if (esp_websocket_client_is_connected(client) && rover_connected) {
-        uint32_t len_sent = esp_websocket_client_send_bin(client, (char*)buf, len, pdMS_TO_TICKS(1000));
-        if (len_sent > 0) {
-            if (len_sent != len) {
-                ESP_LOGE(TAG, "Need logic to handle partial writes");
-            }
+        flight_recorder_record(FLIGHT_RECORD_CONTROL, FLIGHT_TRANSPORT_WS, buf, len);
+        int64_t start = esp_timer_get_time();
+        // Returns -1 on failure, also if the frame was cut off half way. The Rover drops the
+        // broken frame and as the next control frame replaces this one there is no point resending it.
+        int len_sent = esp_websocket_client_send_bin(client, (char*)buf, len, pdMS_TO_TICKS(timeout_ms));
+        if (len_sent == len) {
             res = ESP_OK;
+        } else if (len_sent >= 0) {
+            ESP_LOGE(TAG, "Partial write %d of %d", len_sent, len);
         }
+        link_manager_on_ws_send(res == ESP_OK, esp_timer_get_time() - start);
     }
+    metrics_inc(res == ESP_OK ? METRIC_WS_FRAMES_SENT : METRIC_WS_SEND_ERRORS);
 
     return res;
 }
@@ -108,7 +129,9 @@ static void handle_rover_connection(void* args)
 static void ws_timed_out(void* arg)
 {
     ESP_LOGE(TAG, "WS Timeout Rover lost");
+    metrics_inc(METRIC_WS_TIMEOUTS);
     rover_connected = false;
+    link_manager_on_ws_lost();
     esp_websocket_client_stop(client);
 }
 
@@ -127,9 +150,11 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base, i
         rover_connected = true;
         xSemaphoreGive(connect_semaphore);
         restart_communication_timer();
+        link_manager_on_ws_data();
         break;
     case WEBSOCKET_EVENT_DISCONNECTED:
         ESP_LOGW(TAG, "WEBSOCKET_EVENT_DISCONNECTED");
+        link_manager_on_ws_lost();
         if (!rover_connected) {
             ESP_LOGD(TAG, "Not Rover");
             xSemaphoreGive(connect_semaphore);
@@ -137,11 +162,8 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base, i
         break;
     case WEBSOCKET_EVENT_DATA:
         restart_communication_timer();
-        if (data->data_len != data->payload_len && data->data_len > 1) {
-            ESP_LOGE(TAG, "Need to implement segmented websocket data => discarding");
-        } else {
-            rover_telematics_put(data->data_ptr, data->data_len);
-        }
+        link_manager_on_ws_data();
+        on_ws_data(data);
         break;
     case WEBSOCKET_EVENT_ERROR:
         ESP_LOGW(TAG, "WEBSOCKET_EVENT_ERROR");
@@ -151,6 +173,25 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base, i
     }
 }
 
+// Called once per chunk, the Rover must send every telematics message as a single frame, see ws_reassembler.h
+static void on_ws_data(esp_websocket_event_data_t* data)
+{
+    uint16_t length;
+
+    switch (ws_reassembler_feed(&ws_rx, data->op_code, (const uint8_t*)data->data_ptr, data->data_len,
+                                data->payload_offset, data->payload_len, &length)) {
+        case WS_REASSEMBLER_MESSAGE:
+            flight_recorder_record(FLIGHT_RECORD_TELEMATICS, FLIGHT_TRANSPORT_WS, ws_rx_buf, length);
+            rover_telematics_put(ws_rx_buf, length);
+            break;
+        case WS_REASSEMBLER_DROPPED:
+            metrics_inc(METRIC_TELEMATICS_DROPPED);
+            break;
+        default:
+            break;
+    }
+}
+
 static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
 {
     switch (event_id) {
@@ -181,6 +222,7 @@ static void async_ws_connect(void)
         }
     } else {
         ESP_LOGE(TAG, "Failed getting connect semaphore, connect already in progress");
+        metrics_inc(METRIC_SEMAPHORE_TIMEOUTS);
     }
 }
 
@@ -231,9 +273,12 @@ static void udp_server_task(void *pvParameters)
             else {
                 inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr.s_addr, addr_str, sizeof(addr_str) - 1);
                 if (rx_buffer[0] == '[' && rx_buffer[len - 1] == ']') {
+                    link_manager_on_udp_data();
+                    flight_recorder_record(FLIGHT_RECORD_TELEMATICS, FLIGHT_TRANSPORT_UDP, &rx_buffer[1], len - 2);
                     rover_telematics_put(&rx_buffer[1], len - 2);
                 } else {
                     ESP_LOGI(TAG, "start: %c, end: %c", rx_buffer[0], rx_buffer[len - 1]);
+                    metrics_inc(METRIC_TELEMATICS_DROPPED);
                 }
             }
         }
@@ -4,4 +4,5 @@
 
 void transport_ws_init(void);
 void transport_ws_start(void);
-esp_err_t transport_ws_send(uint8_t* buf, uint16_t len);
\ No newline at end of file
+esp_err_t transport_ws_send(uint8_t* buf, uint16_t len);
+esp_err_t transport_ws_send_timeout(uint8_t* buf, uint16_t len, uint32_t timeout_ms);
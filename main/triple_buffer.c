@@ -0,0 +1,52 @@
+#include <string.h>
+#include "triple_buffer.h"
+#include "assert.h"
+
+#define TRIPLE_BUFFER_FRESH         0x4
+#define TRIPLE_BUFFER_INDEX_MASK    0x3
+
+void triple_buffer_init(triple_buffer_t* buffer, void* storage, size_t size)
+{
+    assert(buffer != NULL && storage != NULL);
+    memset(storage, 0, 3 * size);
+    buffer->storage = storage;
+    buffer->size = size;
+    buffer->write_index = 0;
+    buffer->read_index = 1;
+    atomic_init(&buffer->middle, 2);
+    atomic_init(&buffer->publish_count, 0);
+}
+
+// The buffer returned is owned by the producer until it's published
+void* triple_buffer_write_buf(triple_buffer_t* buffer)
+{
+    return buffer->storage + buffer->write_index * buffer->size;
+}
+
+void triple_buffer_publish(triple_buffer_t* buffer)
+{
+    // Release so the buffer content is visible before the consumer can pick it up
+    unsigned int previous = atomic_exchange_explicit(&buffer->middle, buffer->write_index | TRIPLE_BUFFER_FRESH, memory_order_acq_rel);
+    buffer->write_index = previous & TRIPLE_BUFFER_INDEX_MASK;
+    atomic_fetch_add_explicit(&buffer->publish_count, 1, memory_order_relaxed);
+}
+
+// Returns true if something was published since the last read, data always points to the latest value
+bool triple_buffer_read(triple_buffer_t* buffer, const void** data)
+{
+    bool fresh = false;
+
+    if (atomic_load_explicit(&buffer->middle, memory_order_relaxed) & TRIPLE_BUFFER_FRESH) {
+        unsigned int previous = atomic_exchange_explicit(&buffer->middle, buffer->read_index, memory_order_acq_rel);
+        buffer->read_index = previous & TRIPLE_BUFFER_INDEX_MASK;
+        fresh = true;
+    }
+    *data = buffer->storage + buffer->read_index * buffer->size;
+
+    return fresh;
+}
+
+uint32_t triple_buffer_publish_count(triple_buffer_t* buffer)
+{
+    return atomic_load_explicit(&buffer->publish_count, memory_order_relaxed);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+/*
+ * Lock-free handoff of the latest value from one producer task to one consumer task.
+ * The producer fills the buffer from triple_buffer_write_buf and publishes it, the consumer
+ * always gets the most recently published buffer. Neither side ever blocks or waits on the
+ * other, values published between two reads are overwritten, never torn.
+ */
+typedef struct triple_buffer_t {
+    uint8_t*        storage;        // 3 * size bytes
+    size_t          size;
+    uint8_t         write_index;    // Only touched by the producer
+    uint8_t         read_index;     // Only touched by the consumer
+    atomic_uint     middle;         // Index of the buffer in between, with TRIPLE_BUFFER_FRESH if not read yet
+    atomic_uint     publish_count;
+} triple_buffer_t;
+
+void triple_buffer_init(triple_buffer_t* buffer, void* storage, size_t size);
+void* triple_buffer_write_buf(triple_buffer_t* buffer);
+void triple_buffer_publish(triple_buffer_t* buffer);
+bool triple_buffer_read(triple_buffer_t* buffer, const void** data);
+uint32_t triple_buffer_publish_count(triple_buffer_t* buffer);
@@ -6,12 +6,19 @@
 #include <esp_event.h>
 #include "lwip/err.h"
 #include "lwip/sys.h"
+#include "lwip/sockets.h"
 #include "esp_http_server.h"
 #include "esp_https_server.h"
 
 #include "esp_timer.h"
+#include <string.h>
+#include <stdlib.h>
 
 #include "rover_telematics.h"
+#include "link_manager.h"
+#include "latency_probe.h"
+#include "metrics.h"
+#include "task_profiler.h"
 #include "leds.h"
 
 #include "config.h"
@@ -21,32 +28,78 @@
 
 #define MAX_WS_INCOMING_SIZE    100
 #define WS_CONNECT_MESSAGE      "CONNECT"
-#define MAX_WS_CONNECTIONS      2
+#define WS_LATENCY_MESSAGE      "LATENCY"
+#define MAX_WS_CONNECTIONS      ROVER_MAX_PHONES
+#define MAX_HTTP_CONNECTIONS    2   // GET /metrics and /tasks while every phone is connected, must stay within LWIP_MAX_SOCKETS - 3
+#define CLIENT_QUEUE_LEN        4   // Frames queued per phone, the oldest is dropped when a slow phone falls behind
+#define SEND_WAIT_TIMEOUT_S     1   // Only reached if the socket fills up mid frame, full sockets are skipped before sending
 #define INVALID_FD              -1
-#define TX_BUF_SIZE             100
+#define BATCH_RECORD_HEADER_LEN 2
+#define TX_BUF_SIZE             (ROVER_TELEMATICS_MAX_LEN + BATCH_RECORD_HEADER_LEN)
+#define LINK_STATS_INTERVAL_MS  1000
+
+// One copy of every frame is shared by all clients, freed when the last client has sent it
+typedef struct ws_tx_buf {
+    uint8_t             refs;
+    httpd_ws_type_t     type;
+    uint16_t            len;
+    uint8_t             data[];
+} ws_tx_buf;
 
 typedef struct ws_client {
-    int     fd;
-    bool    tx_in_progress;
+    int         fd;
+    bool        send_queued;                    // A send work item is queued on the httpd task
+    ws_tx_buf*  queue[CLIENT_QUEUE_LEN];
+    uint8_t     queue_head;
+    uint8_t     queue_count;
+    bool        live;                           // Gets telematics, from when its snapshot was queued
 } ws_client;
 
+// A snapshot on its way to the client that asked for it
+typedef struct ws_snapshot {
+    ws_client*  client;
+    ws_tx_buf*  buf;
+} ws_snapshot;
+
 typedef struct web_server {
     httpd_handle_t      handle;
     bool                running;
     ws_client           clients[MAX_WS_CONNECTIONS];
-    xSemaphoreHandle    tx_sem;
-    uint8_t             tx_buf[TX_BUF_SIZE];
-    uint16_t            tx_buf_len;
+    xSemaphoreHandle    clients_sem;            // Guards the client queues and buffer refs
+    esp_timer_handle_t  link_stats_timer;
+#ifdef ROVER_PHONE_TELEMATICS_BATCH_MS
+    xSemaphoreHandle    batch_sem;
+    uint8_t             batch_buf[TX_BUF_SIZE];
+    uint16_t            batch_len;
+    uint16_t            batch_records;
+    esp_timer_handle_t  batch_timer;
+#endif
+    webserver_stats_t   stats;
 } web_server;
 
 
 static ws_client* find_ws_client(int fd);
 static void on_client_disconnect(httpd_handle_t hd, int sockfd);
-static bool any_client_tx();
 static bool any_client_connected();
+static void update_phones_connected(void);
+static void client_queue_clear(ws_client* client);
+static void client_queue_push(ws_client* client, ws_tx_buf* buf);
+static void send_snapshot(ws_client* client);
+static void queue_snapshot(uint8_t* data, uint16_t length, void* arg);
+static void send_latency(ws_client* client);
+static void tx_buf_unref(ws_tx_buf* buf);
+static bool socket_writable(int fd);
 
 static esp_err_t ws_handler(httpd_req_t *req);
+static esp_err_t metrics_handler(httpd_req_t *req);
+static esp_err_t tasks_handler(httpd_req_t *req);
+static void ws_async_send(void *arg);
 static void on_telematics_data(uint8_t* telemetics, uint16_t length);
+static void send_link_stats(void* arg);
+static bool broadcast(uint8_t* data, uint16_t length, httpd_ws_type_t type);
+#ifdef ROVER_PHONE_TELEMATICS_BATCH_MS
+static void flush_batch(void* arg);
+#endif
 
 static const httpd_uri_t ws = {
     .uri        = "/ws",
@@ -55,6 +108,18 @@ static const httpd_uri_t ws = {
     .user_ctx   = NULL,
     .is_websocket = true
 };
+static const httpd_uri_t metrics = {
+    .uri        = "/metrics",
+    .method     = HTTP_GET,
+    .handler    = metrics_handler,
+    .user_ctx   = NULL
+};
+static const httpd_uri_t tasks = {
+    .uri        = "/tasks",
+    .method     = HTTP_GET,
+    .handler    = tasks_handler,
+    .user_ctx   = NULL
+};
 static const char *TAG = "web_server";
 
 static web_server server;
@@ -68,17 +133,37 @@ void webserver_init(void)
 
     for (uint8_t i = 0; i < MAX_WS_CONNECTIONS; i++) {
         server.clients[i].fd = INVALID_FD;
-        server.clients[i].tx_in_progress = false;
     }
 
-    server.tx_sem = xSemaphoreCreateBinary();
-    assert(server.tx_sem != NULL);
-    xSemaphoreGive(server.tx_sem);
+    server.clients_sem = xSemaphoreCreateMutex();
+    assert(server.clients_sem != NULL);
     
 
+    const esp_timer_create_args_t link_stats_timer_args = {
+        .callback = &send_link_stats,
+        .name = "link_stats"
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&link_stats_timer_args, &server.link_stats_timer));
+
+#ifdef ROVER_PHONE_TELEMATICS_BATCH_MS
+    server.batch_sem = xSemaphoreCreateMutex();
+    assert(server.batch_sem != NULL);
+    const esp_timer_create_args_t batch_timer_args = {
+        .callback = &flush_batch,
+        .name = "telematics_batch"
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&batch_timer_args, &server.batch_timer));
+#endif
+
     rover_telematics_register_on_data(&on_telematics_data);
 }
 
+void webserver_get_stats(webserver_stats_t* stats)
+{
+    assert(stats != NULL);
+    *stats = server.stats;
+}
+
 void webserver_start(void)
 {
     assert(!server.running);
@@ -100,13 +185,18 @@ void webserver_start(void)
 
     config.httpd.server_port = WS_SERVER_PORT;
     config.httpd.close_fn = on_client_disconnect;
-    config.httpd.max_open_sockets = MAX_WS_CONNECTIONS;
+    config.httpd.max_open_sockets = MAX_WS_CONNECTIONS + MAX_HTTP_CONNECTIONS;
+    config.httpd.send_wait_timeout = SEND_WAIT_TIMEOUT_S;
 
     err = httpd_ssl_start(&server.handle, &config);
     assert(err == ESP_OK);
 
     err = httpd_register_uri_handler(server.handle, &ws);
     assert(err == ESP_OK);
+    err = httpd_register_uri_handler(server.handle, &metrics);
+    assert(err == ESP_OK);
+    err = httpd_register_uri_handler(server.handle, &tasks);
+    assert(err == ESP_OK);
     server.running = true;
     ESP_LOGI(TAG, "Web Server started on port %d, server handle %p", config.httpd.server_port, server.handle);
 #else
@@ -114,15 +204,21 @@ void webserver_start(void)
 
     config.server_port = WS_SERVER_PORT;
     config.close_fn = on_client_disconnect;
-    config.max_open_sockets = MAX_WS_CONNECTIONS;
+    config.max_open_sockets = MAX_WS_CONNECTIONS + MAX_HTTP_CONNECTIONS;
+    config.send_wait_timeout = SEND_WAIT_TIMEOUT_S;
     err = httpd_start(&server.handle, &config);
     assert(err == ESP_OK);
 
     err = httpd_register_uri_handler(server.handle, &ws);
     assert(err == ESP_OK);
+    err = httpd_register_uri_handler(server.handle, &metrics);
+    assert(err == ESP_OK);
+    err = httpd_register_uri_handler(server.handle, &tasks);
+    assert(err == ESP_OK);
     server.running = true;
     ESP_LOGI(TAG, "Web Server started on port %d, server handle %p", config.server_port, server.handle);
 #endif
+    ESP_ERROR_CHECK(esp_timer_start_periodic(server.link_stats_timer, LINK_STATS_INTERVAL_MS * 1000));
 
     
 }
@@ -153,24 +249,64 @@ static void on_client_disconnect(httpd_handle_t hd, int sockfd)
     ws_client* client = find_ws_client(sockfd);
     if (client == NULL) return;
     
-    bool tx_ongoing = any_client_tx();
-
-    client->tx_in_progress = false;
+    xSemaphoreTake(server.clients_sem, portMAX_DELAY);
+    client_queue_clear(client);
     client->fd = INVALID_FD;
-    if (tx_ongoing && !any_client_tx()) {
-        xSemaphoreGive(server.tx_sem);
+    xSemaphoreGive(server.clients_sem);
+    update_phones_connected();
+}
+
+static void update_phones_connected(void)
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < MAX_WS_CONNECTIONS; i++) {
+        if (server.clients[i].fd != INVALID_FD) {
+            count++;
+        }
     }
+    metrics_set(METRIC_PHONES_CONNECTED, count);
 }
 
-static bool any_client_tx()
+// Must be called with clients_sem held
+static void client_queue_clear(ws_client* client)
 {
-    uint8_t i = 0;
-    for (i = 0; i < MAX_WS_CONNECTIONS; i++) {
-        if (server.clients[i].fd != INVALID_FD && server.clients[i].tx_in_progress) {
-            return true;
+    while (client->queue_count > 0) {
+        tx_buf_unref(client->queue[client->queue_head]);
+        client->queue_head = (client->queue_head + 1) % CLIENT_QUEUE_LEN;
+        client->queue_count--;
+    }
+}
+
+// Must be called with clients_sem held
+static void client_queue_push(ws_client* client, ws_tx_buf* buf)
+{
+    if (client->queue_count == CLIENT_QUEUE_LEN) {
+        // Phone isn't keeping up, newest data is worth more than the oldest
+        tx_buf_unref(client->queue[client->queue_head]);
+        client->queue_head = (client->queue_head + 1) % CLIENT_QUEUE_LEN;
+        client->queue_count--;
+        server.stats.drops++;
+        metrics_inc(METRIC_PHONE_FRAMES_DROPPED);
+    }
+    client->queue[(client->queue_head + client->queue_count) % CLIENT_QUEUE_LEN] = buf;
+    client->queue_count++;
+    buf->refs++;
+    if (!client->send_queued) {
+        client->send_queued = httpd_queue_work(server.handle, ws_async_send, client) == ESP_OK;
+        if (!client->send_queued) {
+            ESP_LOGE(TAG, "Failed queueing websocket send");
         }
     }
-    return false;
+}
+
+// Must be called with clients_sem held
+static void tx_buf_unref(ws_tx_buf* buf)
+{
+    assert(buf->refs > 0);
+    buf->refs--;
+    if (buf->refs == 0) {
+        free(buf);
+    }
 }
 
 static bool any_client_connected()
@@ -206,70 +342,322 @@ static esp_err_t ws_handler(httpd_req_t *req)
     if (packet.type == HTTPD_WS_TYPE_TEXT) {
         if (packet.len == strlen(WS_CONNECT_MESSAGE) && strncmp((char*)packet.payload, WS_CONNECT_MESSAGE, packet.len) == 0) {
             ESP_LOGI(TAG, "Got CONNECT");
-            uint8_t i = 0;
-            for (i = 0; i < MAX_WS_CONNECTIONS; i++) {
-                if (server.clients[i].fd == INVALID_FD) {
-                    server.clients[i].fd =  httpd_req_to_sockfd(req);
-                    server.clients[i].tx_in_progress = false;
-                    break;
+            // A phone asking again on the same socket keeps its slot and gets a new snapshot
+            int fd = httpd_req_to_sockfd(req);
+            ws_client* client = find_ws_client(fd);
+            if (client == NULL) {
+                client = find_ws_client(INVALID_FD);
+                if (client == NULL) {
+                    // Failing closes the socket, the phone sees it wasn't taken
+                    ESP_LOGW(TAG, "Already %d phones connected", MAX_WS_CONNECTIONS);
+                    return ESP_FAIL;
                 }
+                xSemaphoreTake(server.clients_sem, portMAX_DELAY);
+                client->fd = fd;
+                client->queue_head = 0;
+                client->queue_count = 0;
+                client->live = false;
+                xSemaphoreGive(server.clients_sem);
+                update_phones_connected();
+            }
+            send_snapshot(client);
+        } else if (packet.len == strlen(WS_LATENCY_MESSAGE) && strncmp((char*)packet.payload, WS_LATENCY_MESSAGE, packet.len) == 0) {
+            ws_client* client = find_ws_client(httpd_req_to_sockfd(req));
+            if (client != NULL) {
+                send_latency(client);
             }
-            assert(i < MAX_WS_CONNECTIONS);
         }
     }
    
     return ESP_OK;
 }
 
+// GET /metrics, see metrics.h for the format
+static esp_err_t metrics_handler(httpd_req_t *req)
+{
+    char* buf = malloc(METRICS_MAX_TEXT_LEN);
+    if (buf == NULL) {
+        ESP_LOGE(TAG, "Out of memory for metrics");
+        return httpd_resp_send_500(req);
+    }
+    uint16_t len = metrics_format(buf, METRICS_MAX_TEXT_LEN);
+    assert(len > 0);
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    esp_err_t err = httpd_resp_send(req, buf, len);
+    free(buf);
+
+    return err;
+}
+
+// GET /tasks, see task_profiler.h for the format
+static esp_err_t tasks_handler(httpd_req_t *req)
+{
+    char* buf = malloc(TASK_PROFILER_JSON_MAX_LEN);
+    if (buf == NULL) {
+        ESP_LOGE(TAG, "Out of memory for task profile");
+        return httpd_resp_send_500(req);
+    }
+    uint16_t len = task_profiler_to_json(buf, TASK_PROFILER_JSON_MAX_LEN);
+    assert(len > 0);
+
+    httpd_resp_set_type(req, "application/json");
+    esp_err_t err = httpd_resp_send(req, buf, len);
+    free(buf);
+
+    return err;
+}
+
+// Zero timeout select, a phone that stopped reading has a full send buffer and would
+// otherwise block the httpd task and every other phone for send_wait_timeout
+static bool socket_writable(int fd)
+{
+    fd_set write_fds;
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = 0 };
+
+    FD_ZERO(&write_fds);
+    FD_SET(fd, &write_fds);
+    return select(fd + 1, NULL, &write_fds, NULL, &timeout) > 0;
+}
+
+// Runs on the httpd task and sends one frame, then queues itself again if there is more
+// so all clients take turns instead of one slow client being drained first.
+// Sends never wait for a full socket, the frame is dropped and the client is tried
+// again when the next frame is pushed to it.
 static void ws_async_send(void *arg)
 {
     esp_err_t err;
     httpd_ws_frame_t packet;
     ws_client* client = (ws_client*)arg;
 
+    xSemaphoreTake(server.clients_sem, portMAX_DELAY);
+    if (client->fd == INVALID_FD || client->queue_count == 0) {
+        client->send_queued = false;
+        xSemaphoreGive(server.clients_sem);
+        return;
+    }
+    int fd = client->fd;
+    ws_tx_buf* buf = client->queue[client->queue_head];
+    client->queue_head = (client->queue_head + 1) % CLIENT_QUEUE_LEN;
+    client->queue_count--;
+    xSemaphoreGive(server.clients_sem);
+
+    if (!socket_writable(fd)) {
+        xSemaphoreTake(server.clients_sem, portMAX_DELAY);
+        tx_buf_unref(buf);
+        client->send_queued = false;
+        server.stats.drops++;
+        xSemaphoreGive(server.clients_sem);
+        metrics_inc(METRIC_PHONE_FRAMES_DROPPED);
+        return;
+    }
+
     memset(&packet, 0, sizeof(httpd_ws_frame_t));
-    packet.payload = server.tx_buf;
-    packet.len = server.tx_buf_len;
-    packet.type = HTTPD_WS_TYPE_BINARY;
+    packet.payload = buf->data;
+    packet.len = buf->len;
+    packet.type = buf->type;
     packet.final = true;
 
-    err = httpd_ws_send_frame_async(server.handle, client->fd, &packet);
+    err = httpd_ws_send_frame_async(server.handle, fd, &packet);
     if (err != ESP_OK) {
         ESP_LOGW(TAG, "httpd_ws_send_frame_async failed: %d", err);
+        metrics_inc(METRIC_PHONE_SEND_ERRORS);
     }
-    client->tx_in_progress = false;
-    if (!any_client_tx()) {
-        xSemaphoreGive(server.tx_sem);
+
+    xSemaphoreTake(server.clients_sem, portMAX_DELAY);
+    tx_buf_unref(buf);
+    if (client->queue_count > 0 && httpd_queue_work(server.handle, ws_async_send, client) == ESP_OK) {
+        client->send_queued = true;
+    } else {
+        client->send_queued = false;
     }
+    xSemaphoreGive(server.clients_sem);
 }
 
+#ifdef ROVER_PHONE_TELEMATICS_BATCH_MS
+// Collects telematics for ROVER_PHONE_TELEMATICS_BATCH_MS and sends them as one frame, see web_server.h
 static void on_telematics_data(uint8_t* telemetics, uint16_t length)
 {
-    assert(length <= TX_BUF_SIZE);
-        
+    server.stats.frames_in++;
     if (!any_client_connected()) {
         return;
     }
 
-    
-    
-    if (xSemaphoreTake(server.tx_sem, 0) == pdPASS) {
-        memcpy(server.tx_buf, telemetics, length);
-        server.tx_buf_len = length;
-        for (uint8_t i = 0; i < MAX_WS_CONNECTIONS; i++) {
-            if (server.clients[i].fd != INVALID_FD) {
-                server.clients[i].tx_in_progress = true;
-                esp_err_t err;
-                err = httpd_queue_work(server.handle, ws_async_send, &server.clients[i]);
-                if (err != ESP_OK) {
-                    server.clients[i].tx_in_progress = false;
-                }
-            }
+    assert(length <= ROVER_TELEMATICS_MAX_LEN);
+    xSemaphoreTake(server.batch_sem, portMAX_DELAY);
+    if (server.batch_len + BATCH_RECORD_HEADER_LEN + length > sizeof(server.batch_buf)) {
+        // Send what fits now instead of waiting for the window to end
+        esp_timer_stop(server.batch_timer);
+        broadcast(server.batch_buf, server.batch_len, HTTPD_WS_TYPE_BINARY);
+        server.batch_len = 0;
+        server.batch_records = 0;
+    }
+    if (server.batch_records == 0) {
+        esp_timer_start_once(server.batch_timer, ROVER_PHONE_TELEMATICS_BATCH_MS * 1000);
+    }
+    server.batch_buf[server.batch_len] = length & 0xFF;
+    server.batch_buf[server.batch_len + 1] = length >> 8;
+    memcpy(&server.batch_buf[server.batch_len + BATCH_RECORD_HEADER_LEN], telemetics, length);
+    server.batch_len += BATCH_RECORD_HEADER_LEN + length;
+    server.batch_records++;
+    xSemaphoreGive(server.batch_sem);
+}
+
+static void flush_batch(void* arg)
+{
+    xSemaphoreTake(server.batch_sem, portMAX_DELAY);
+    if (server.batch_records > 0) {
+        broadcast(server.batch_buf, server.batch_len, HTTPD_WS_TYPE_BINARY);
+        server.batch_len = 0;
+        server.batch_records = 0;
+    }
+    xSemaphoreGive(server.batch_sem);
+}
+#else
+static void on_telematics_data(uint8_t* telemetics, uint16_t length)
+{
+    server.stats.frames_in++;
+    broadcast(telemetics, length, HTTPD_WS_TYPE_BINARY);
+}
+#endif
+
+// Gives a newly connected phone every known telematics value right away instead of
+// waiting for each one to be received, sent like any other telematics frame
+static void send_snapshot(ws_client* client)
+{
+    ws_snapshot snapshot = { .client = client };
+
+    snapshot.buf = malloc(sizeof(ws_tx_buf) + TX_BUF_SIZE);
+    if (snapshot.buf == NULL) {
+        ESP_LOGE(TAG, "Out of memory for telematics snapshot");
+        // Without one it gets what comes from now on
+        xSemaphoreTake(server.clients_sem, portMAX_DELAY);
+        client->live = client->fd != INVALID_FD;
+        xSemaphoreGive(server.clients_sem);
+        return;
+    }
+#ifdef ROVER_PHONE_TELEMATICS_BATCH_MS
+    rover_telematics_with_snapshot(&snapshot.buf->data[BATCH_RECORD_HEADER_LEN], ROVER_TELEMATICS_MAX_LEN,
+                                   &queue_snapshot, &snapshot);
+#else
+    rover_telematics_with_snapshot(snapshot.buf->data, ROVER_TELEMATICS_MAX_LEN, &queue_snapshot, &snapshot);
+#endif
+}
+
+// Runs with the telematics cache locked, no frame can be passed on until the snapshot is queued
+// and the client is live, so the client never gets a frame older than the snapshot after it
+static void queue_snapshot(uint8_t* data, uint16_t length, void* arg)
+{
+    ws_snapshot* snapshot = (ws_snapshot*)arg;
+    ws_tx_buf* buf = snapshot->buf;
+
+#ifdef ROVER_PHONE_TELEMATICS_BATCH_MS
+    // What is batched is older than the snapshot, the live clients get it now and this one doesn't
+    esp_timer_stop(server.batch_timer);
+    flush_batch(NULL);
+    buf->data[0] = length & 0xFF;
+    buf->data[1] = length >> 8;
+    buf->len = BATCH_RECORD_HEADER_LEN + length;
+#else
+    buf->len = length;
+#endif
+    buf->refs = 0;
+    buf->type = HTTPD_WS_TYPE_BINARY;
+
+    xSemaphoreTake(server.clients_sem, portMAX_DELAY);
+    if (snapshot->client->fd != INVALID_FD) {
+        if (length > 0) {
+            client_queue_push(snapshot->client, buf);
         }
-        if (!any_client_tx()) {
-            ESP_LOGE(TAG, "Failed queueing data transmission on all websockets, releasing semaphore");
-            xSemaphoreGive(server.tx_sem);
+        snapshot->client->live = true;
+    }
+    if (buf->refs == 0) {
+        free(buf);
+    }
+    xSemaphoreGive(server.clients_sem);
+}
+
+// Answer to a LATENCY request, the histograms as JSON in a text frame to the phone that asked, see latency_probe.h
+static void send_latency(ws_client* client)
+{
+    ws_tx_buf* buf = malloc(sizeof(ws_tx_buf) + LATENCY_PROBE_JSON_MAX_LEN);
+    if (buf == NULL) {
+        ESP_LOGE(TAG, "Out of memory for latency stats");
+        return;
+    }
+    buf->len = latency_probe_to_json((char*)buf->data, LATENCY_PROBE_JSON_MAX_LEN);
+    assert(buf->len > 0);
+    buf->refs = 0;
+    buf->type = HTTPD_WS_TYPE_TEXT;
+
+    xSemaphoreTake(server.clients_sem, portMAX_DELAY);
+    if (client->fd != INVALID_FD) {
+        client_queue_push(client, buf);
+    }
+    if (buf->refs == 0) {
+        free(buf);
+    }
+    xSemaphoreGive(server.clients_sem);
+}
+
+// Link stats are sent as text so they can't be mistaken for binary telematics
+static void send_link_stats(void* arg)
+{
+    char buf[256];
+    link_stats_t link;
+
+    if (!any_client_connected()) {
+        return;
+    }
+
+    link_manager_get_stats(&link);
+    int len = snprintf(buf, sizeof(buf),
+                       "{\"link\":{\"active\":\"%s\",\"mode\":%d,\"handovers\":%u,"
+                       "\"ws\":{\"healthy\":%d,\"send_us\":%u,\"loss\":%u,\"stale_ms\":%u,\"udp_stale_ms\":%u},"
+                       "\"lora\":{\"healthy\":%d,\"rssi\":%d,\"snr\":%.1f,\"stale_ms\":%u}}}",
+                       link.active == LINK_WIFI ? "wifi" : "lora", link.mode, link.handovers,
+                       link.ws_healthy, link.ws_send_latency_us, link.ws_loss_percent, link.ws_staleness_ms, link.udp_staleness_ms,
+                       link.lora_healthy, link.lora_rssi, link.lora_snr, link.lora_staleness_ms);
+    assert(len > 0 && len < sizeof(buf));
+    broadcast((uint8_t*)buf, len, HTTPD_WS_TYPE_TEXT);
+}
+
+// Queues the frame to every client without copying it per client, returns true if any client got it
+static bool broadcast(uint8_t* data, uint16_t length, httpd_ws_type_t type)
+{
+    bool queued = false;
+
+    assert(length <= TX_BUF_SIZE);
+    if (!any_client_connected()) {
+        return false;
+    }
+
+    ws_tx_buf* buf = malloc(sizeof(ws_tx_buf) + length);
+    if (buf == NULL) {
+        ESP_LOGE(TAG, "Out of memory for websocket frame");
+        return false;
+    }
+    buf->refs = 0;
+    buf->type = type;
+    buf->len = length;
+    memcpy(buf->data, data, length);
+
+    xSemaphoreTake(server.clients_sem, portMAX_DELAY);
+    for (uint8_t i = 0; i < MAX_WS_CONNECTIONS; i++) {
+        // Telematics only go to clients that got their snapshot first
+        if (server.clients[i].fd != INVALID_FD && (server.clients[i].live || type != HTTPD_WS_TYPE_BINARY)) {
+            client_queue_push(&server.clients[i], buf);
+            queued = true;
         }
     }
+    if (buf->refs == 0) {
+        free(buf);
+    }
+    xSemaphoreGive(server.clients_sem);
+
+    if (queued && type == HTTPD_WS_TYPE_BINARY) {
+        server.stats.frames_out++;
+    }
 
+    return queued;
 }
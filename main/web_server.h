@@ -1,5 +1,25 @@
 #pragma once
 
+#include <stdint.h>
+
+/*
+ * Telematics are forwarded to connected phones as binary websocket frames. With
+ * ROVER_PHONE_TELEMATICS_BATCH_MS set in config.h everything received within that
+ * window is sent as one frame of records, each record is a 16 bit little endian
+ * length followed by the telematics frame as received from the Rover.
+ * Link stats are sent as JSON in text frames.
+ * All sends run on the httpd task, a phone whose socket is full has its frame
+ * dropped instead of holding up the other phones.
+ * Up to ROVER_MAX_PHONES in config.h phones can connect, the socket of one more is
+ * closed when it sends CONNECT.
+ */
+typedef struct webserver_stats_t {
+    uint32_t    frames_in;      // Telematics frames received from the Rover
+    uint32_t    frames_out;     // Binary websocket frames queued to phones, counted once for all phones
+    uint32_t    drops;          // Frames dropped for a phone that wasn't keeping up, full queue or full socket
+} webserver_stats_t;
+
 void webserver_init(void);
 void webserver_start(void);
 void webserver_stop(void);
+void webserver_get_stats(webserver_stats_t* stats);
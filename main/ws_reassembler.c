@@ -0,0 +1,56 @@
+#include <string.h>
+#include "ws_reassembler.h"
+#include "esp_log.h"
+#include "assert.h"
+
+static const char* TAG = "WS_REASSEMBLER";
+
+void ws_reassembler_init(ws_reassembler_t* reassembler, uint8_t* buf, uint16_t buf_len)
+{
+    assert(reassembler != NULL && buf != NULL);
+    reassembler->buf = buf;
+    reassembler->buf_len = buf_len;
+    reassembler->expected_offset = 0;
+    reassembler->discarding = false;
+}
+
+ws_reassembler_result_t ws_reassembler_feed(ws_reassembler_t* reassembler, uint8_t op_code, const uint8_t* data,
+                                            int data_len, int payload_offset, int payload_len, uint16_t* length)
+{
+    if (op_code == WS_REASSEMBLER_OPCODE_CONT) {
+        if (payload_offset == 0) {
+            ESP_LOGE(TAG, "Fragmented message, dropping continuation frame");
+            return WS_REASSEMBLER_DROPPED;
+        }
+        return WS_REASSEMBLER_NONE;
+    }
+    if (op_code != WS_REASSEMBLER_OPCODE_BINARY && op_code != WS_REASSEMBLER_OPCODE_TEXT) {
+        return WS_REASSEMBLER_NONE;
+    }
+    if (payload_offset == 0) {
+        reassembler->expected_offset = 0;
+        reassembler->discarding = payload_len > reassembler->buf_len;
+        if (reassembler->discarding) {
+            ESP_LOGE(TAG, "Frame of %d bytes too big, discarding", payload_len);
+            return WS_REASSEMBLER_DROPPED;
+        }
+    }
+    if (reassembler->discarding) {
+        return WS_REASSEMBLER_NONE;
+    }
+    if (payload_offset != reassembler->expected_offset || payload_offset + data_len > payload_len) {
+        // Lost the start of the frame, wait for the next one
+        ESP_LOGE(TAG, "Unexpected chunk at %d, expected %d", payload_offset, reassembler->expected_offset);
+        reassembler->discarding = true;
+        return WS_REASSEMBLER_DROPPED;
+    }
+
+    memcpy(&reassembler->buf[payload_offset], data, data_len);
+    reassembler->expected_offset += data_len;
+    if (reassembler->expected_offset < payload_len) {
+        return WS_REASSEMBLER_NONE;
+    }
+    reassembler->expected_offset = 0;
+    *length = payload_len;
+    return WS_REASSEMBLER_MESSAGE;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Puts websocket frames back together from the chunks the websocket client hands over.
+ * A frame bigger than the client buffer arrives in several data events, each with the
+ * offset of the chunk in the frame and the length of the whole frame. Only single frame
+ * messages can be put together: the client doesn't report FIN, so continuation frames of a
+ * fragmented message are dropped. A frame with a chunk missing or bigger than the buffer is
+ * dropped as a whole, the next frame is taken again.
+ */
+
+#define WS_REASSEMBLER_OPCODE_CONT      0x0
+#define WS_REASSEMBLER_OPCODE_TEXT      0x1
+#define WS_REASSEMBLER_OPCODE_BINARY    0x2
+
+typedef enum ws_reassembler_result_t {
+    WS_REASSEMBLER_NONE,        // Nothing complete yet, or not a data frame
+    WS_REASSEMBLER_MESSAGE,     // The buffer holds a complete message
+    WS_REASSEMBLER_DROPPED,     // A message is lost, reported once on the chunk it was dropped at
+} ws_reassembler_result_t;
+
+typedef struct ws_reassembler_t {
+    uint8_t*    buf;
+    uint16_t    buf_len;
+    int         expected_offset;
+    bool        discarding;     // Rest of the current frame is skipped
+} ws_reassembler_t;
+
+void ws_reassembler_init(ws_reassembler_t* reassembler, uint8_t* buf, uint16_t buf_len);
+// One chunk as esp_websocket_event_data_t has it, on WS_REASSEMBLER_MESSAGE length is set to the message length
+ws_reassembler_result_t ws_reassembler_feed(ws_reassembler_t* reassembler, uint8_t op_code, const uint8_t* data,
+                                            int data_len, int payload_offset, int payload_len, uint16_t* length);
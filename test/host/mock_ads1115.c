@@ -0,0 +1,303 @@
+#include <string.h>
+#include <assert.h>
+#include "mock_ads1115.h"
+#include "driver/i2c.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#define REG_CONVERSION      0
+#define REG_CONFIG          1
+#define REG_LO_THRESH       2
+#define REG_HI_THRESH       3
+#define NUM_REGS            4
+
+#define CONFIG_OS           0x8000
+#define CONFIG_MUX_SHIFT    12
+#define CONFIG_MUX_MASK     0x07
+#define CONFIG_DR_SHIFT     5
+#define CONFIG_DR_MASK      0x07
+#define CONFIG_COMP_QUE     0x0003
+#define CONFIG_RESET        0x8583
+
+#define MAX_OPS             16
+#define NEVER               INT64_MAX
+#define STEP_US             20
+
+typedef enum op_type_t {
+    OP_START,
+    OP_WRITE,
+    OP_READ,
+    OP_STOP
+} op_type_t;
+
+typedef struct op_t {
+    op_type_t   type;
+    uint8_t     data[2];        // Bytes to write
+    uint8_t*    dest;           // Where read bytes go
+    size_t      len;
+} op_t;
+
+typedef struct cmd_link_t {
+    op_t        ops[MAX_OPS];
+    uint8_t     num_ops;
+} cmd_link_t;
+
+static const uint16_t data_rates[] = { 8, 16, 32, 64, 128, 250, 475, 860 };
+
+static uint16_t regs[NUM_REGS] = { 0, CONFIG_RESET, 0x8000, 0x7FFF };
+static uint8_t pointer;
+static mock_ads1115_signal_t* signal_fn;
+static mock_ads1115_stats_t stats;
+static uint8_t started_mux[MOCK_ADS1115_MAX_LOG];
+static uint32_t num_started;
+static int64_t conversion_done_us = NEVER;
+static bool rdy_connected = true;
+static bool present = true;
+static gpio_isr_t rdy_isr;
+static void* rdy_isr_arg;
+
+void mock_ads1115_set_signal(mock_ads1115_signal_t* signal)
+{
+    signal_fn = signal;
+}
+
+void mock_ads1115_set_rdy_connected(bool connected)
+{
+    rdy_connected = connected;
+}
+
+void mock_ads1115_set_present(bool is_present)
+{
+    present = is_present;
+    if (!present) {
+        // The conversion in flight is lost
+        conversion_done_us = NEVER;
+        regs[REG_CONFIG] |= CONFIG_OS;
+    }
+}
+
+void mock_ads1115_get_stats(mock_ads1115_stats_t* out)
+{
+    *out = stats;
+}
+
+void mock_ads1115_clear_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+    num_started = 0;
+}
+
+uint8_t mock_ads1115_started_mux(uint32_t index)
+{
+    assert(index < num_started && index < MOCK_ADS1115_MAX_LOG);
+    return started_mux[index];
+}
+
+static uint8_t config_mux(void)
+{
+    return (regs[REG_CONFIG] >> CONFIG_MUX_SHIFT) & CONFIG_MUX_MASK;
+}
+
+// Conversion ready mode: comparator enabled, hi threshold MSB set and lo threshold MSB clear
+static bool rdy_mode(void)
+{
+    return (regs[REG_CONFIG] & CONFIG_COMP_QUE) != CONFIG_COMP_QUE && (regs[REG_HI_THRESH] & 0x8000) &&
+           !(regs[REG_LO_THRESH] & 0x8000);
+}
+
+static void write_config(uint16_t value)
+{
+    stats.config_writes++;
+    // OS reads back 0 while converting
+    regs[REG_CONFIG] = value & ~CONFIG_OS;
+    if (!(value & CONFIG_OS)) {
+        regs[REG_CONFIG] |= CONFIG_OS;
+        return;
+    }
+    if (num_started < MOCK_ADS1115_MAX_LOG) {
+        started_mux[num_started] = config_mux();
+    }
+    num_started++;
+    uint16_t rate = data_rates[(value >> CONFIG_DR_SHIFT) & CONFIG_DR_MASK];
+    conversion_done_us = esp_timer_get_time() + (1000000 + rate - 1) / rate;
+}
+
+static void finish_conversion(void)
+{
+    conversion_done_us = NEVER;
+    regs[REG_CONVERSION] = signal_fn != NULL ? (uint16_t)signal_fn(config_mux()) : 0;
+    regs[REG_CONFIG] |= CONFIG_OS;
+    stats.conversions++;
+    if (rdy_mode()) {
+        stats.rdy_pulses++;
+        if (rdy_connected && rdy_isr != NULL) {
+            rdy_isr(rdy_isr_arg);
+        }
+    }
+}
+
+// The scheduler can't tell when a task starts a conversion, time moves in small steps so one
+// started on the way finishes at most STEP_US late
+void mock_ads1115_run_until(int64_t until_us)
+{
+    while (esp_timer_get_time() < until_us) {
+        int64_t next_us = esp_timer_get_time() + STEP_US;
+        next_us = next_us < until_us ? next_us : until_us;
+        host_rtos_run_until(conversion_done_us < next_us ? conversion_done_us : next_us);
+        if (conversion_done_us <= esp_timer_get_time()) {
+            finish_conversion();
+        }
+    }
+    host_rtos_run_until(until_us);
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+    cmd_link_t* link = calloc(1, sizeof(cmd_link_t));
+    assert(link != NULL);
+    return link;
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle)
+{
+    free(cmd_handle);
+}
+
+static op_t* add_op(i2c_cmd_handle_t cmd_handle, op_type_t type)
+{
+    cmd_link_t* link = cmd_handle;
+    assert(link->num_ops < MAX_OPS);
+    op_t* op = &link->ops[link->num_ops++];
+    op->type = type;
+    return op;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle)
+{
+    add_op(cmd_handle, OP_START);
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en)
+{
+    op_t* op = add_op(cmd_handle, OP_WRITE);
+    op->data[0] = data;
+    op->len = 1;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, uint8_t* data, size_t data_len, bool ack_en)
+{
+    assert(data_len <= sizeof(((op_t*)NULL)->data));
+    op_t* op = add_op(cmd_handle, OP_WRITE);
+    memcpy(op->data, data, data_len);
+    op->len = data_len;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t* data, size_t data_len, i2c_ack_type_t ack)
+{
+    op_t* op = add_op(cmd_handle, OP_READ);
+    op->dest = data;
+    op->len = data_len;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle)
+{
+    add_op(cmd_handle, OP_STOP);
+    return ESP_OK;
+}
+
+// Runs the command link against the chip: after a start the first byte is the address, a write
+// sets the pointer with its first byte and the register with the next two, reads go MSB first
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait)
+{
+    cmd_link_t* link = cmd_handle;
+    bool addressed = false;
+    bool reading = false;
+    bool read = false;
+    uint8_t written[3];
+    uint8_t num_written = 0;
+
+    stats.transactions++;
+    if (!present) {
+        return ESP_FAIL;
+    }
+    for (uint8_t i = 0; i < link->num_ops; i++) {
+        op_t* op = &link->ops[i];
+        switch (op->type) {
+            case OP_START:
+                addressed = false;
+                break;
+            case OP_WRITE:
+                for (size_t b = 0; b < op->len; b++) {
+                    if (!addressed) {
+                        assert((op->data[b] >> 1) == MOCK_ADS1115_ADDRESS);
+                        addressed = true;
+                        reading = op->data[b] & I2C_MASTER_READ;
+                    } else {
+                        assert(!reading && num_written < sizeof(written));
+                        written[num_written++] = op->data[b];
+                    }
+                }
+                break;
+            case OP_READ:
+                assert(addressed && reading && op->len <= 2);
+                // Pointer writes before a repeated start take effect before the read
+                if (num_written > 0) {
+                    assert(written[0] < NUM_REGS);
+                    pointer = written[0];
+                }
+                op->dest[0] = regs[pointer] >> 8;
+                if (op->len > 1) {
+                    op->dest[1] = regs[pointer] & 0xFF;
+                }
+                read = true;
+                break;
+            case OP_STOP:
+                break;
+        }
+    }
+    if (read) {
+        stats.reads++;
+    } else if (num_written > 0) {
+        assert(written[0] < NUM_REGS && (num_written == 1 || num_written == 3));
+        pointer = written[0];
+        if (num_written == 3) {
+            uint16_t value = ((uint16_t)written[1] << 8) | written[2];
+            if (pointer == REG_CONFIG) {
+                write_config(value);
+            } else if (pointer != REG_CONVERSION) {
+                regs[pointer] = value;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_config(const gpio_config_t* config)
+{
+    assert(config->pin_bit_mask == 1ULL << MOCK_ADS1115_RDY_PIN);
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t num, gpio_isr_t isr_handler, void* args)
+{
+    assert(num == MOCK_ADS1115_RDY_PIN);
+    rdy_isr = isr_handler;
+    rdy_isr_arg = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t num)
+{
+    rdy_isr = NULL;
+    return ESP_OK;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/gpio.h"
+
+/*
+ * ADS1115 behind the host I2C driver, for running the ads1115 component on the host. Keeps
+ * the config, threshold and conversion registers and the address pointer like the chip: a
+ * write sets the pointer and then the register, a read returns the register the pointer is on.
+ * Writing the config with OS set starts a single-shot conversion of the MUX input, it is done
+ * after one period of the data rate. With the thresholds in conversion ready mode ALERT/RDY
+ * pulses low at the end of each conversion, running the ISR added for MOCK_ADS1115_RDY_PIN.
+ *
+ * Conversions finish on the simulated time of esp_timer.c, the test moves it along with
+ * mock_ads1115_run_until. Every I2C command link is counted as a bus transaction.
+ */
+
+#define MOCK_ADS1115_ADDRESS        0x48
+#define MOCK_ADS1115_RDY_PIN        GPIO_NUM_16     // ROVER_CONTROLLER_ADS_RDY in config.h
+#define MOCK_ADS1115_MAX_LOG        64
+
+typedef struct mock_ads1115_stats_t {
+    uint32_t    transactions;
+    uint32_t    reads;              // Transactions reading from the chip
+    uint32_t    config_writes;
+    uint32_t    conversions;        // Finished
+    uint32_t    rdy_pulses;
+} mock_ads1115_stats_t;
+
+// What the input selected by the MUX reads, 16 bit two's complement
+typedef int16_t mock_ads1115_signal_t(uint8_t mux);
+
+void mock_ads1115_set_signal(mock_ads1115_signal_t* signal);
+// With ALERT/RDY not wired the pulses are lost, conversions still finish
+void mock_ads1115_set_rdy_connected(bool connected);
+// A chip that is not present NACKs every transaction, like on a loose connector, the registers are kept
+void mock_ads1115_set_present(bool present);
+// Runs the FreeRTOS tasks until the given time, finishing conversions on the way
+void mock_ads1115_run_until(int64_t until_us);
+void mock_ads1115_get_stats(mock_ads1115_stats_t* stats);
+void mock_ads1115_clear_stats(void);
+// MUX of the conversions started since the stats were cleared, the first MOCK_ADS1115_MAX_LOG of them
+uint8_t mock_ads1115_started_mux(uint32_t index);
@@ -0,0 +1,356 @@
+#include <string.h>
+#include <assert.h>
+#include "mock_httpd.h"
+#include "lwip/sockets.h"
+#include "esp_timer.h"
+
+#define MAX_SOCKETS         8
+#define MAX_URI_HANDLERS    8
+#define FIRST_FD            54      // LWIP_SOCKET_OFFSET, lwip sockets come after the FD_SETSIZE of newlib
+#define MAX_FRAME_LEN       4096
+#define STEP_US             1000    // Phones read what they can every step
+#define READ_UNLIMITED      UINT32_MAX
+
+typedef struct mock_socket_t {
+    bool            open;
+    uint32_t        read_rate;
+    double          read_credit;                            // Bytes the phone could have read by now
+    uint8_t         data[MOCK_HTTPD_SNDBUF_LEN + MAX_FRAME_LEN];
+    uint32_t        unread;
+    uint16_t        frame_len[MOCK_HTTPD_SNDBUF_LEN];       // Every frame is at least a byte
+    httpd_ws_type_t frame_type[MOCK_HTTPD_SNDBUF_LEN];
+    uint16_t        frame_head;
+    uint16_t        num_frames;
+} mock_socket_t;
+
+typedef struct request_t {
+    int             fd;
+    const char*     text;                                   // Websocket frame from the phone
+    char*           body;                                   // Response of a GET
+    size_t          body_size;
+    int             status;
+} request_t;
+
+typedef struct work_t {
+    httpd_work_fn_t fn;
+    void*           arg;
+} work_t;
+
+static bool started;
+static httpd_config_t config;
+static httpd_uri_t handlers[MAX_URI_HANDLERS];
+static uint8_t num_handlers;
+static mock_socket_t sockets[MAX_SOCKETS];
+static work_t work_queue[MOCK_HTTPD_WORK_QUEUE_LEN];
+static uint8_t work_head;
+static uint8_t work_count;
+static mock_httpd_stats_t stats;
+static mock_httpd_phone_callback* phone_callback;
+
+void mock_httpd_reset(void)
+{
+    started = false;
+    num_handlers = 0;
+    memset(sockets, 0, sizeof(sockets));
+    work_head = 0;
+    work_count = 0;
+    memset(&stats, 0, sizeof(stats));
+    phone_callback = NULL;
+}
+
+void mock_httpd_register_phone(mock_httpd_phone_callback* callback)
+{
+    phone_callback = callback;
+}
+
+void mock_httpd_get_stats(mock_httpd_stats_t* out)
+{
+    *out = stats;
+}
+
+static mock_socket_t* find_socket(int fd)
+{
+    if (fd < FIRST_FD || fd >= FIRST_FD + MAX_SOCKETS || !sockets[fd - FIRST_FD].open) {
+        return NULL;
+    }
+    return &sockets[fd - FIRST_FD];
+}
+
+static const httpd_uri_t* find_handler(const char* uri)
+{
+    for (uint8_t i = 0; i < num_handlers; i++) {
+        if (strcmp(handlers[i].uri, uri) == 0) {
+            return &handlers[i];
+        }
+    }
+    return NULL;
+}
+
+int mock_httpd_connect(void)
+{
+    uint8_t num_open = 0;
+    int fd = MOCK_HTTPD_NO_SOCKET;
+
+    assert(started);
+    for (uint8_t i = 0; i < MAX_SOCKETS; i++) {
+        if (sockets[i].open) {
+            num_open++;
+        } else if (fd == MOCK_HTTPD_NO_SOCKET) {
+            fd = FIRST_FD + i;
+        }
+    }
+    if (num_open >= config.max_open_sockets || fd == MOCK_HTTPD_NO_SOCKET) {
+        return MOCK_HTTPD_NO_SOCKET;
+    }
+    mock_socket_t* socket = &sockets[fd - FIRST_FD];
+    memset(socket, 0, sizeof(mock_socket_t));
+    socket->open = true;
+    socket->read_rate = READ_UNLIMITED;
+    return fd;
+}
+
+esp_err_t mock_httpd_ws_send_text(int fd, const char* text)
+{
+    const httpd_uri_t* handler = find_handler("/ws");
+    request_t request = { .fd = fd, .text = text };
+    httpd_req_t req = { .handle = &config, .uri = "/ws", .aux = &request };
+
+    assert(handler != NULL && handler->is_websocket);
+    assert(find_socket(fd) != NULL);
+    esp_err_t err = handler->handler(&req);
+    if (err != ESP_OK) {
+        mock_httpd_close(fd);
+    }
+    return err;
+}
+
+void mock_httpd_close(int fd)
+{
+    mock_socket_t* socket = find_socket(fd);
+
+    assert(socket != NULL);
+    socket->open = false;
+    if (config.close_fn != NULL) {
+        config.close_fn(&config, fd);
+    }
+}
+
+void mock_httpd_set_read_rate(int fd, uint32_t bytes_per_s)
+{
+    mock_socket_t* socket = find_socket(fd);
+
+    assert(socket != NULL);
+    socket->read_rate = bytes_per_s;
+}
+
+uint32_t mock_httpd_unread(int fd)
+{
+    mock_socket_t* socket = find_socket(fd);
+
+    assert(socket != NULL);
+    return socket->unread;
+}
+
+int mock_httpd_get(const char* uri, char* body, size_t size)
+{
+    const httpd_uri_t* handler = find_handler(uri);
+    int fd = mock_httpd_connect();
+
+    if (fd == MOCK_HTTPD_NO_SOCKET) {
+        return 503;
+    }
+    request_t request = { .fd = fd, .body = body, .body_size = size, .status = 404 };
+    httpd_req_t req = { .handle = &config, .uri = uri, .aux = &request };
+    if (handler != NULL && !handler->is_websocket) {
+        handler->handler(&req);
+    }
+    mock_httpd_close(fd);
+    return request.status;
+}
+
+// The phone reads whole frames as far as its rate allows
+static void read_socket(int fd, mock_socket_t* socket, int64_t step_us)
+{
+    if (socket->read_rate == READ_UNLIMITED) {
+        socket->read_credit = socket->unread;
+    } else {
+        socket->read_credit += (double)socket->read_rate * step_us / 1000000;
+    }
+
+    uint32_t offset = 0;
+    while (socket->num_frames > 0 && socket->read_credit >= socket->frame_len[socket->frame_head]) {
+        uint16_t len = socket->frame_len[socket->frame_head];
+        httpd_ws_type_t type = socket->frame_type[socket->frame_head];
+        socket->frame_head = (socket->frame_head + 1) % MOCK_HTTPD_SNDBUF_LEN;
+        socket->num_frames--;
+        socket->read_credit -= len;
+        if (phone_callback != NULL) {
+            phone_callback(fd, type, &socket->data[offset], len);
+        }
+        offset += len;
+    }
+    memmove(socket->data, &socket->data[offset], socket->unread - offset);
+    socket->unread -= offset;
+    if (socket->num_frames == 0) {
+        // Nothing to read, the rate doesn't add up for later
+        socket->read_credit = 0;
+    }
+}
+
+static void run_work(void)
+{
+    while (work_count > 0) {
+        work_t work = work_queue[work_head];
+        work_head = (work_head + 1) % MOCK_HTTPD_WORK_QUEUE_LEN;
+        work_count--;
+        work.fn(work.arg);
+        stats.work_done++;
+    }
+}
+
+void mock_httpd_run_until(int64_t until_us)
+{
+    while (true) {
+        host_timer_run_due();
+        run_work();
+        int64_t now = esp_timer_get_time();
+        if (now >= until_us) {
+            break;
+        }
+        int64_t next_us = now + STEP_US;
+        if (host_timer_next_expiry_us() < next_us) {
+            next_us = host_timer_next_expiry_us();
+        }
+        if (until_us < next_us) {
+            next_us = until_us;
+        }
+        host_timer_set_us(next_us);
+        for (uint8_t i = 0; i < MAX_SOCKETS; i++) {
+            if (sockets[i].open) {
+                read_socket(FIRST_FD + i, &sockets[i], next_us - now);
+            }
+        }
+    }
+}
+
+esp_err_t httpd_start(httpd_handle_t* handle, const httpd_config_t* new_config)
+{
+    assert(!started);
+    assert(new_config->max_open_sockets <= MAX_SOCKETS);
+    config = *new_config;
+    started = true;
+    *handle = &config;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle)
+{
+    assert(started && handle == &config);
+    started = false;
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t* uri_handler)
+{
+    assert(handle == &config);
+    if (num_handlers == MAX_URI_HANDLERS || num_handlers == config.max_uri_handlers) {
+        return ESP_ERR_NO_MEM;
+    }
+    handlers[num_handlers++] = *uri_handler;
+    return ESP_OK;
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void* arg)
+{
+    assert(handle == &config);
+    if (work_count == MOCK_HTTPD_WORK_QUEUE_LEN) {
+        stats.work_queue_full++;
+        return ESP_FAIL;
+    }
+    work_queue[(work_head + work_count) % MOCK_HTTPD_WORK_QUEUE_LEN] = (work_t){ .fn = work, .arg = arg };
+    work_count++;
+    return ESP_OK;
+}
+
+int httpd_req_to_sockfd(httpd_req_t* r)
+{
+    return ((request_t*)r->aux)->fd;
+}
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t* req, httpd_ws_frame_t* pkt, size_t max_len)
+{
+    const char* text = ((request_t*)req->aux)->text;
+
+    assert(text != NULL && strlen(text) <= max_len);
+    pkt->type = HTTPD_WS_TYPE_TEXT;
+    pkt->final = true;
+    pkt->len = strlen(text);
+    memcpy(pkt->payload, text, pkt->len);
+    return ESP_OK;
+}
+
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t* frame)
+{
+    mock_socket_t* socket = find_socket(fd);
+
+    assert(hd == &config);
+    assert(frame->final && frame->len > 0 && frame->len <= MAX_FRAME_LEN);
+    if (socket == NULL) {
+        return ESP_FAIL;
+    }
+    if (socket->unread >= MOCK_HTTPD_SNDBUF_LEN) {
+        stats.blocked_sends++;
+        return ESP_FAIL;
+    }
+    uint16_t tail = (socket->frame_head + socket->num_frames) % MOCK_HTTPD_SNDBUF_LEN;
+    socket->frame_len[tail] = frame->len;
+    socket->frame_type[tail] = frame->type;
+    socket->num_frames++;
+    memcpy(&socket->data[socket->unread], frame->payload, frame->len);
+    socket->unread += frame->len;
+    stats.frames_sent++;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t* r, const char* type)
+{
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t* r, const char* buf, ssize_t buf_len)
+{
+    request_t* request = r->aux;
+
+    assert(request->body != NULL && buf_len >= 0 && (size_t)buf_len < request->body_size);
+    memcpy(request->body, buf, buf_len);
+    request->body[buf_len] = '\0';
+    request->status = 200;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_500(httpd_req_t* r)
+{
+    ((request_t*)r->aux)->status = 500;
+    return ESP_OK;
+}
+
+// Only tells which sockets the server can write to without waiting
+int lwip_select(int maxfdp1, fd_set* readset, fd_set* writeset, fd_set* exceptset, struct timeval* timeout)
+{
+    int ready = 0;
+
+    assert(readset == NULL && exceptset == NULL && writeset != NULL);
+    assert(timeout != NULL && timeout->tv_sec == 0 && timeout->tv_usec == 0);
+    for (int fd = 0; fd < maxfdp1; fd++) {
+        if (!FD_ISSET(fd, writeset)) {
+            continue;
+        }
+        mock_socket_t* socket = find_socket(fd);
+        if (socket != NULL && socket->unread < MOCK_HTTPD_SNDBUF_LEN) {
+            ready++;
+        } else {
+            FD_CLR(fd, writeset);
+        }
+    }
+    return ready;
+}
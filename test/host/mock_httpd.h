@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_http_server.h"
+
+/*
+ * The esp-idf http server for running web_server.c on the host. Phones open a socket, send
+ * websocket text frames to /ws and GET pages like a browser would, each handler runs right
+ * away as it would on the httpd task.
+ *
+ * What the server sends a phone goes into the phone's socket send buffer, which the phone
+ * reads at its own rate, a phone that stops reading fills it up. The socket is writable as
+ * long as the buffer isn't full, a send to a full socket is where the real server would wait
+ * for send_wait_timeout and is counted as a blocked send instead.
+ *
+ * Work queued with httpd_queue_work runs in order like on the httpd task and the timers of
+ * esp_timer.c fire on the way, all on the simulated time moved along by mock_httpd_run_until.
+ */
+
+#define MOCK_HTTPD_SNDBUF_LEN       5744    // lwip TCP_SND_BUF, 4 * TCP_MSS
+#define MOCK_HTTPD_WORK_QUEUE_LEN   16
+#define MOCK_HTTPD_NO_SOCKET        -1
+
+typedef struct mock_httpd_stats_t {
+    uint32_t    work_done;
+    uint32_t    work_queue_full;        // httpd_queue_work failed
+    uint32_t    frames_sent;            // Websocket frames put in a send buffer
+    uint32_t    blocked_sends;          // Sends to a full socket
+} mock_httpd_stats_t;
+
+// Called when a phone has read a whole websocket frame from its socket
+typedef void mock_httpd_phone_callback(int fd, httpd_ws_type_t type, const uint8_t* data, size_t len);
+
+void mock_httpd_reset(void);
+void mock_httpd_register_phone(mock_httpd_phone_callback* callback);
+// Opens a socket to the server, MOCK_HTTPD_NO_SOCKET if it already has max_open_sockets open
+int mock_httpd_connect(void);
+// Returns what the handler returned, the socket is closed if that was an error like httpd does
+esp_err_t mock_httpd_ws_send_text(int fd, const char* text);
+// The phone closes the socket, the server's close_fn is called
+void mock_httpd_close(int fd);
+// Bytes per second the phone reads from its socket, 0 stops it reading, phones read as fast as they get it by default
+void mock_httpd_set_read_rate(int fd, uint32_t bytes_per_s);
+// Bytes sent to the phone it hasn't read yet
+uint32_t mock_httpd_unread(int fd);
+// GET on a socket of its own that is closed again, returns the status, 503 when no socket is left for it
+int mock_httpd_get(const char* uri, char* body, size_t size);
+// Runs the queued work and timers, and lets the phones read, until the given time
+void mock_httpd_run_until(int64_t until_us);
+void mock_httpd_get_stats(mock_httpd_stats_t* stats);
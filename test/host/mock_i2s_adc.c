@@ -0,0 +1,125 @@
+#include <string.h>
+#include <assert.h>
+#include "mock_i2s_adc.h"
+#include "driver/i2s.h"
+#include "soc/syscon_struct.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+
+#define MAX_BUF_LEN         1024
+#define PATTERN_WIDTH_12    3
+
+syscon_dev_t SYSCON;
+
+static mock_i2s_adc_signal_t* signal_fn;
+static mock_i2s_adc_stats_t stats;
+static QueueHandle_t full_buffers;
+static i2s_config_t config;
+static int64_t enabled_us;
+static bool enabled;
+
+void mock_i2s_adc_set_signal(mock_i2s_adc_signal_t* signal)
+{
+    signal_fn = signal;
+}
+
+void mock_i2s_adc_get_stats(mock_i2s_adc_stats_t* out)
+{
+    *out = stats;
+}
+
+int64_t mock_i2s_adc_conversion_us(uint32_t conversion)
+{
+    return enabled_us + (int64_t)conversion * 1000000 / config.sample_rate;
+}
+
+esp_err_t i2s_driver_install(i2s_port_t i2s_num, const i2s_config_t* i2s_config, int queue_size, void* i2s_queue)
+{
+    assert(i2s_num == I2S_NUM_0);
+    assert(i2s_config->mode & I2S_MODE_ADC_BUILT_IN);
+    assert(i2s_config->bits_per_sample == I2S_BITS_PER_SAMPLE_16BIT);
+    assert(i2s_config->dma_buf_len <= MAX_BUF_LEN);
+    config = *i2s_config;
+    full_buffers = xQueueCreate(config.dma_buf_count, config.dma_buf_len * sizeof(uint16_t));
+    memset(&stats, 0, sizeof(stats));
+    return ESP_OK;
+}
+
+// Sets up a pattern table of just this channel, adc_dma overwrites it
+esp_err_t i2s_set_adc_mode(adc_unit_t adc_unit, adc1_channel_t adc_channel)
+{
+    assert(adc_unit == ADC_UNIT_1);
+    SYSCON.saradc_ctrl.sar1_patt_len = 0;
+    SYSCON.saradc_sar1_patt_tab[0] = ((adc_channel << 4) | (PATTERN_WIDTH_12 << 2) | ADC_ATTEN_DB_11) << 24;
+    return ESP_OK;
+}
+
+esp_err_t i2s_adc_enable(i2s_port_t i2s_num)
+{
+    assert(full_buffers != NULL);
+    enabled_us = esp_timer_get_time();
+    enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t i2s_read(i2s_port_t i2s_num, void* dest, size_t size, size_t* bytes_read, TickType_t ticks_to_wait)
+{
+    uint16_t buf[MAX_BUF_LEN];
+    size_t buf_size = config.dma_buf_len * sizeof(uint16_t);
+
+    // adc_dma reads whole buffers, the driver would copy partial ones across reads
+    assert(size == buf_size);
+    if (xQueueReceive(full_buffers, buf, ticks_to_wait) != pdTRUE) {
+        *bytes_read = 0;
+        return ESP_ERR_TIMEOUT;
+    }
+    memcpy(dest, buf, buf_size);
+    *bytes_read = buf_size;
+    stats.reads++;
+    return ESP_OK;
+}
+
+// The pattern table entry the ADC uses for the conversion
+static uint8_t pattern_entry(uint32_t conversion)
+{
+    uint8_t index = conversion % (SYSCON.saradc_ctrl.sar1_patt_len + 1);
+    return SYSCON.saradc_sar1_patt_tab[index / 4] >> ((3 - index % 4) * 8);
+}
+
+static void fill_buffer(uint16_t* buf)
+{
+    for (int i = 0; i < config.dma_buf_len; i++) {
+        uint8_t entry = pattern_entry(stats.conversions);
+        adc1_channel_t channel = entry >> 4;
+        assert(((entry >> 2) & 0x03) == PATTERN_WIDTH_12);
+        uint16_t value = signal_fn != NULL ? signal_fn(channel, stats.conversions) & 0x0FFF : 0;
+        buf[i ^ 1] = (channel << 12) | value;
+        stats.conversions++;
+    }
+}
+
+void mock_i2s_adc_run_until(int64_t until_us)
+{
+    uint16_t buf[MAX_BUF_LEN];
+
+    while (enabled) {
+        uint32_t last_conversion = stats.conversions + config.dma_buf_len - 1;
+        int64_t done_us = mock_i2s_adc_conversion_us(last_conversion);
+        if (done_us >= until_us) {
+            break;
+        }
+        host_rtos_run_until(done_us);
+        fill_buffer(buf);
+        stats.buffers++;
+        // The DMA interrupt makes room by dropping the oldest buffer nobody read
+        if (xQueueSendFromISR(full_buffers, buf, NULL) != pdPASS) {
+            uint16_t oldest[MAX_BUF_LEN];
+            xQueueReceive(full_buffers, oldest, 0);
+            xQueueSendFromISR(full_buffers, buf, NULL);
+            stats.dropped_buffers++;
+        }
+    }
+    host_rtos_run_until(until_us);
+}
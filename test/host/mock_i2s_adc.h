@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include "driver/adc.h"
+
+/*
+ * The I2S peripheral in built-in ADC mode behind the host I2S driver, for running adc_dma.c
+ * on the host. ADC1 converts at the configured sample rate, scanning the SAR pattern table
+ * in SYSCON, and the samples are DMAed into buffers of dma_buf_len 16 bit words, the channel
+ * number in the upper 4 bits. Like on the ESP32 each pair of words comes swapped. When the
+ * driver's buffers are all full the oldest one is dropped.
+ *
+ * Conversions happen on the simulated time of esp_timer.c, the test moves it along with
+ * mock_i2s_adc_run_until which hands each buffer over when its last conversion is done.
+ */
+
+// What ADC1 reads on the channel at the given conversion, counted from i2s_adc_enable
+typedef uint16_t mock_i2s_adc_signal_t(adc1_channel_t channel, uint32_t conversion);
+
+typedef struct mock_i2s_adc_stats_t {
+    uint32_t    conversions;
+    uint32_t    buffers;
+    uint32_t    dropped_buffers;
+    uint32_t    reads;              // i2s_read calls that returned samples
+} mock_i2s_adc_stats_t;
+
+void mock_i2s_adc_set_signal(mock_i2s_adc_signal_t* signal);
+// Runs the FreeRTOS tasks until the given time, with the DMA buffers completed on the way
+void mock_i2s_adc_run_until(int64_t until_us);
+void mock_i2s_adc_get_stats(mock_i2s_adc_stats_t* stats);
+// Simulated time of a conversion
+int64_t mock_i2s_adc_conversion_us(uint32_t conversion);
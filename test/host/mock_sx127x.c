@@ -0,0 +1,295 @@
+#include <string.h>
+#include <assert.h>
+#include "mock_sx127x.h"
+#include "driver/spi_master.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+
+#define REG_FIFO_TX_BASE_ADDR       0x0e
+#define REG_FIFO_RX_BASE_ADDR       0x0f
+#define REG_FIFO_RX_CURRENT_ADDR    0x10
+#define REG_RX_NB_BYTES             0x13
+#define REG_PKT_SNR_VALUE           0x19
+#define REG_PKT_RSSI_VALUE          0x1a
+#define REG_MODEM_CONFIG_1          0x1d
+#define REG_MODEM_CONFIG_2          0x1e
+#define REG_DIO_MAPPING_1           0x40
+#define REG_VERSION                 0x42
+
+#define MODE_MASK                   0x07
+#define MODE_STDBY                  0x01
+#define MODE_TX                     0x03
+#define MODE_RX_CONTINUOUS          0x05
+
+#define IRQ_TX_DONE_MASK            0x08
+#define IRQ_RX_DONE_MASK            0x40
+
+#define DIO0_MAPPING_MASK           0xc0
+#define DIO0_RX_DONE                0x00
+#define DIO0_TX_DONE                0x40
+
+#define NUM_REGS                    0x80
+#define FIFO_SIZE                   256
+#define WRITE_BIT                   0x80
+#define MAX_QUEUE_SIZE              64
+#define RSSI_OFFSET_HF              157     // RSSI is the register value minus this on the high frequency port
+
+static uint8_t regs[NUM_REGS];
+static uint8_t fifo[FIFO_SIZE];
+static uint8_t tx_payload[FIFO_SIZE];
+static mock_sx127x_stats_t stats;
+static spi_transaction_t* queued[MAX_QUEUE_SIZE];
+static int queue_size;
+static int queue_head;
+static int num_queued;
+static int clock_speed_hz;
+static gpio_isr_t dio0_isr;
+static void* dio0_isr_arg;
+static bool dio0_connected;
+static int64_t tx_started_us;
+static int64_t rx_started_us;
+static int packet_rssi;
+static float packet_snr;
+
+static void dio0_edge(void);
+
+void mock_sx127x_reset(void)
+{
+    memset(regs, 0, sizeof(regs));
+    memset(fifo, 0, sizeof(fifo));
+    regs[MOCK_SX127X_REG_OP_MODE] = 0x09;
+    regs[REG_FIFO_TX_BASE_ADDR] = 0x80;
+    regs[REG_MODEM_CONFIG_1] = 0x72;
+    regs[REG_MODEM_CONFIG_2] = 0x70;
+    regs[MOCK_SX127X_REG_PAYLOAD_LENGTH] = 0x01;
+    regs[REG_VERSION] = 0x12;
+    num_queued = 0;
+    dio0_connected = true;
+    tx_started_us = 0;
+    rx_started_us = 0;
+    mock_sx127x_set_packet_quality(-60, 10.0f);
+    mock_sx127x_clear_stats();
+}
+
+void mock_sx127x_clear_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+void mock_sx127x_get_stats(mock_sx127x_stats_t* out)
+{
+    *out = stats;
+}
+
+uint8_t mock_sx127x_get_reg(uint8_t reg)
+{
+    assert(reg < NUM_REGS);
+    return regs[reg];
+}
+
+const uint8_t* mock_sx127x_tx_payload(void)
+{
+    for (int i = 0; i < regs[MOCK_SX127X_REG_PAYLOAD_LENGTH]; i++) {
+        tx_payload[i] = fifo[(regs[REG_FIFO_TX_BASE_ADDR] + i) % FIFO_SIZE];
+    }
+    return tx_payload;
+}
+
+void mock_sx127x_receive(const uint8_t* data, uint8_t length)
+{
+    uint8_t addr = regs[REG_FIFO_RX_BASE_ADDR];
+
+    for (int i = 0; i < length; i++) {
+        fifo[(addr + i) % FIFO_SIZE] = data[i];
+    }
+    regs[REG_FIFO_RX_CURRENT_ADDR] = addr;
+    regs[REG_RX_NB_BYTES] = length;
+    regs[REG_PKT_RSSI_VALUE] = packet_rssi + RSSI_OFFSET_HF;
+    regs[REG_PKT_SNR_VALUE] = (int8_t)(packet_snr * 4);
+    regs[MOCK_SX127X_REG_IRQ_FLAGS] |= IRQ_RX_DONE_MASK;
+    if ((regs[MOCK_SX127X_REG_OP_MODE] & MODE_MASK) == MODE_RX_CONTINUOUS &&
+        (regs[REG_DIO_MAPPING_1] & DIO0_MAPPING_MASK) == DIO0_RX_DONE) {
+        dio0_edge();
+    }
+}
+
+void mock_sx127x_set_packet_quality(int rssi, float snr)
+{
+    packet_rssi = rssi;
+    packet_snr = snr;
+}
+
+bool mock_sx127x_transmitting(void)
+{
+    return (regs[MOCK_SX127X_REG_OP_MODE] & MODE_MASK) == MODE_TX;
+}
+
+void mock_sx127x_finish_tx(void)
+{
+    assert(mock_sx127x_transmitting());
+    regs[MOCK_SX127X_REG_OP_MODE] = (regs[MOCK_SX127X_REG_OP_MODE] & ~MODE_MASK) | MODE_STDBY;
+    regs[MOCK_SX127X_REG_IRQ_FLAGS] |= IRQ_TX_DONE_MASK;
+    if ((regs[REG_DIO_MAPPING_1] & DIO0_MAPPING_MASK) == DIO0_TX_DONE) {
+        dio0_edge();
+    }
+}
+
+int64_t mock_sx127x_tx_started_us(void)
+{
+    return tx_started_us;
+}
+
+int64_t mock_sx127x_rx_started_us(void)
+{
+    return rx_started_us;
+}
+
+void mock_sx127x_set_dio0_connected(bool connected)
+{
+    dio0_connected = connected;
+}
+
+static void write_reg(uint8_t reg, uint8_t value)
+{
+    switch (reg) {
+        case MOCK_SX127X_REG_OP_MODE:
+            regs[reg] = value;
+            if ((value & MODE_MASK) == MODE_TX) {
+                tx_started_us = esp_timer_get_time();
+            } else if ((value & MODE_MASK) == MODE_RX_CONTINUOUS) {
+                rx_started_us = esp_timer_get_time();
+            }
+            break;
+        case MOCK_SX127X_REG_IRQ_FLAGS:
+            // Flags are cleared by writing a 1
+            regs[reg] &= ~value;
+            break;
+        default:
+            regs[reg] = value;
+            break;
+    }
+}
+
+static void dio0_edge(void)
+{
+    if (dio0_connected && dio0_isr != NULL) {
+        dio0_isr(dio0_isr_arg);
+    }
+}
+
+static void transfer(spi_transaction_t* t)
+{
+    const uint8_t* tx = (t->flags & SPI_TRANS_USE_TXDATA) ? t->tx_data : t->tx_buffer;
+    uint8_t* rx = (t->flags & SPI_TRANS_USE_RXDATA) ? t->rx_data : t->rx_buffer;
+    size_t len = t->length / 8;
+
+    assert(t->length % 8 == 0 && len >= 2 && tx != NULL);
+    uint8_t reg = tx[0] & ~WRITE_BIT;
+    bool write = tx[0] & WRITE_BIT;
+
+    stats.transactions++;
+    stats.bus_ns += t->length * 1000000000ULL / clock_speed_hz;
+    if (len > stats.max_transaction_len) {
+        stats.max_transaction_len = len;
+    }
+    if (reg == MOCK_SX127X_REG_FIFO) {
+        stats.fifo_transactions++;
+        for (size_t i = 1; i < len; i++) {
+            uint8_t* ptr = &regs[MOCK_SX127X_REG_FIFO_ADDR_PTR];
+            if (write) {
+                fifo[*ptr] = tx[i];
+            } else if (rx != NULL) {
+                rx[i] = fifo[*ptr];
+            }
+            (*ptr)++;
+        }
+        return;
+    }
+
+    // Burst access to other registers is never used by the driver
+    assert(len == 2 && reg < NUM_REGS);
+    if (write) {
+        write_reg(reg, tx[1]);
+    } else {
+        stats.reads++;
+        if (rx != NULL) {
+            rx[1] = regs[reg];
+        }
+    }
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t* bus_config, int dma_chan)
+{
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t* dev_config,
+                             spi_device_handle_t* handle)
+{
+    assert(dev_config->queue_size <= MAX_QUEUE_SIZE);
+    queue_size = dev_config->queue_size;
+    clock_speed_hz = dev_config->clock_speed_hz;
+    *handle = NULL;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t* trans)
+{
+    // Queued transactions go first on the bus, the driver doesn't allow mixing them
+    assert(num_queued == 0);
+    transfer(trans);
+    return ESP_OK;
+}
+
+// Queued transactions are clocked out right away, the results are collected later
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t* trans, TickType_t ticks_to_wait)
+{
+    // A full queue blocks on the target until a result is collected
+    assert(num_queued < queue_size);
+    transfer(trans);
+    stats.queued_transactions++;
+    queued[(queue_head + num_queued++) % MAX_QUEUE_SIZE] = trans;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t** trans, TickType_t ticks_to_wait)
+{
+    // Waiting with nothing queued blocks forever on the target
+    assert(num_queued > 0);
+    *trans = queued[queue_head];
+    queue_head = (queue_head + 1) % MAX_QUEUE_SIZE;
+    num_queued--;
+    return ESP_OK;
+}
+
+void gpio_pad_select_gpio(uint8_t gpio_num)
+{
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_config(const gpio_config_t* config)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t num, gpio_isr_t isr_handler, void* args)
+{
+    assert(num == MOCK_SX127X_DIO0_PIN);
+    dio0_isr = isr_handler;
+    dio0_isr_arg = args;
+    return ESP_OK;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/gpio.h"
+
+/*
+ * SX127x in LoRa mode behind the host SPI driver, for running components/lora/lora.c on
+ * the host. Keeps the register file and the FIFO like the radio does: a transaction is an
+ * address byte, bit 7 set for a write, followed by data, FIFO accesses auto-increment
+ * RegFifoAddrPtr. Every transaction is counted so tests can check what an access costs.
+ *
+ * Putting the radio in TX mode starts a packet, it is on air until the test ends it with
+ * mock_sx127x_finish_tx at the time it should take. TxDone and RxDone give an edge on DIO0
+ * when it is mapped to them, running the ISR added for MOCK_SX127X_DIO0_PIN.
+ */
+
+#define MOCK_SX127X_DIO0_PIN            GPIO_NUM_26     // DIO0_PIN in transport_lora.c
+
+#define MOCK_SX127X_REG_FIFO            0x00
+#define MOCK_SX127X_REG_OP_MODE         0x01
+#define MOCK_SX127X_REG_FIFO_ADDR_PTR   0x0d
+#define MOCK_SX127X_REG_IRQ_FLAGS       0x12
+#define MOCK_SX127X_REG_PAYLOAD_LENGTH  0x22
+
+typedef struct mock_sx127x_stats_t {
+    uint32_t    transactions;       // Polling and queued
+    uint32_t    queued_transactions;
+    uint32_t    reads;              // Register reads, the caller waits for each one
+    uint32_t    fifo_transactions;
+    uint32_t    max_transaction_len;    // Bytes, address included
+    uint64_t    bus_ns;             // Time the transactions take on the bus at the device clock
+} mock_sx127x_stats_t;
+
+// Registers back to their reset values and the stats cleared
+void mock_sx127x_reset(void);
+void mock_sx127x_clear_stats(void);
+void mock_sx127x_get_stats(mock_sx127x_stats_t* stats);
+uint8_t mock_sx127x_get_reg(uint8_t reg);
+// What the radio would transmit: the FIFO from RegFifoTxBaseAddr, RegPayloadLength bytes
+const uint8_t* mock_sx127x_tx_payload(void);
+// A packet received from the air, left in the FIFO with RxDone set like the radio does
+void mock_sx127x_receive(const uint8_t* data, uint8_t length);
+// Signal of the packets received from now on, -60 dBm and 10 dB SNR after a reset, assumes 868 MHz
+void mock_sx127x_set_packet_quality(int rssi, float snr);
+bool mock_sx127x_transmitting(void);
+// Ends the packet on air: TxDone is set and the radio goes back to standby
+void mock_sx127x_finish_tx(void);
+// When the radio was last put in TX mode and in RX continuous mode
+int64_t mock_sx127x_tx_started_us(void);
+int64_t mock_sx127x_rx_started_us(void);
+// With DIO0 disconnected the edges are lost, the flags are still set
+void mock_sx127x_set_dio0_connected(bool connected);
@@ -0,0 +1,190 @@
+#include <string.h>
+#include <assert.h>
+#include "mock_udp.h"
+#include "lwip/sockets.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+
+#define SOCKET_FD           3
+#define MAX_IN_FLIGHT       64
+#define RX_QUEUE_LEN        8       // Datagrams lwip keeps for the socket until it is read
+#define STEP_US             50      // Datagrams sent by a task during a step arrive at its end at the latest
+#define NEVER               INT64_MAX
+
+typedef struct datagram_t {
+    int64_t     arrive_us;          // NEVER if the slot is free
+    bool        to_rover;
+    uint16_t    length;
+    uint8_t     data[MOCK_UDP_MAX_LEN];
+} datagram_t;
+
+static mock_udp_link_t link;
+static mock_udp_stats_t stats;
+static mock_udp_rover_callback* rover_callback;
+static datagram_t in_flight[MAX_IN_FLIGHT];
+static QueueHandle_t rx_queue;
+static bool socket_open;
+static bool buffers_full;
+static uint16_t local_port;
+static uint32_t seed;
+
+void mock_udp_reset(void)
+{
+    memset(&link, 0, sizeof(link));
+    memset(&stats, 0, sizeof(stats));
+    for (uint8_t i = 0; i < MAX_IN_FLIGHT; i++) {
+        in_flight[i].arrive_us = NEVER;
+    }
+    if (rx_queue == NULL) {
+        rx_queue = xQueueCreate(RX_QUEUE_LEN, sizeof(datagram_t));
+    }
+    xQueueReset(rx_queue);
+    rover_callback = NULL;
+    socket_open = false;
+    buffers_full = false;
+    local_port = 0;
+    seed = 1;
+}
+
+void mock_udp_set_link(const mock_udp_link_t* new_link)
+{
+    assert(new_link->loss_percent <= 100);
+    link = *new_link;
+}
+
+void mock_udp_set_send_buffers_full(bool full)
+{
+    buffers_full = full;
+}
+
+void mock_udp_register_rover(mock_udp_rover_callback* callback)
+{
+    rover_callback = callback;
+}
+
+void mock_udp_get_stats(mock_udp_stats_t* out)
+{
+    *out = stats;
+}
+
+// Same sequence every run
+static uint32_t next_random(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static void transmit(bool to_rover, const void* data, uint16_t length)
+{
+    assert(length <= MOCK_UDP_MAX_LEN);
+    uint32_t jitter = link.jitter_us > 0 ? next_random() % (link.jitter_us + 1) : 0;
+    if (next_random() % 100 < link.loss_percent) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < MAX_IN_FLIGHT; i++) {
+        if (in_flight[i].arrive_us == NEVER) {
+            in_flight[i].arrive_us = esp_timer_get_time() + link.delay_us + jitter;
+            in_flight[i].to_rover = to_rover;
+            in_flight[i].length = length;
+            memcpy(in_flight[i].data, data, length);
+            return;
+        }
+    }
+    assert(false);  // More in flight than the test should ever have
+}
+
+void mock_udp_rover_send(const uint8_t* data, uint16_t length)
+{
+    stats.to_controller_sent++;
+    transmit(false, data, length);
+}
+
+static void deliver(datagram_t* datagram)
+{
+    if (datagram->to_rover) {
+        stats.to_rover_delivered++;
+        if (rover_callback != NULL) {
+            rover_callback(datagram->data, datagram->length);
+        }
+    } else if (socket_open && local_port != 0 && xQueueSend(rx_queue, datagram, 0) == pdTRUE) {
+        // Dropped by the stack if nobody reads the socket
+        stats.to_controller_delivered++;
+    }
+    datagram->arrive_us = NEVER;
+}
+
+void mock_udp_run_until(int64_t until_us)
+{
+    while (esp_timer_get_time() < until_us) {
+        int64_t now = esp_timer_get_time();
+
+        // In order of arrival, a datagram may overtake another one with jitter
+        while (true) {
+            datagram_t* next = NULL;
+            for (uint8_t i = 0; i < MAX_IN_FLIGHT; i++) {
+                if (in_flight[i].arrive_us <= now && (next == NULL || in_flight[i].arrive_us < next->arrive_us)) {
+                    next = &in_flight[i];
+                }
+            }
+            if (next == NULL) {
+                break;
+            }
+            deliver(next);
+        }
+
+        int64_t next_us = now + STEP_US;
+        for (uint8_t i = 0; i < MAX_IN_FLIGHT; i++) {
+            if (in_flight[i].arrive_us < next_us) {
+                next_us = in_flight[i].arrive_us;
+            }
+        }
+        host_rtos_run_until(next_us < until_us ? next_us : until_us);
+    }
+}
+
+int lwip_socket(int domain, int type, int protocol)
+{
+    assert(domain == AF_INET && type == SOCK_DGRAM);
+    assert(!socket_open);
+    socket_open = true;
+    return SOCKET_FD;
+}
+
+int lwip_bind(int s, const struct sockaddr* name, socklen_t namelen)
+{
+    assert(s == SOCKET_FD && namelen == sizeof(struct sockaddr_in));
+    local_port = ntohs(((const struct sockaddr_in*)name)->sin_port);
+    return 0;
+}
+
+ssize_t lwip_sendto(int s, const void* data, size_t size, int flags, const struct sockaddr* to, socklen_t tolen)
+{
+    assert(s == SOCKET_FD && tolen == sizeof(struct sockaddr_in));
+    // The send path must never wait for the stack
+    assert(flags & MSG_DONTWAIT);
+    if (buffers_full) {
+        errno = ENOMEM;
+        return -1;
+    }
+    stats.to_rover_sent++;
+    transmit(true, data, size);
+    return size;
+}
+
+ssize_t lwip_recvfrom(int s, void* mem, size_t len, int flags, struct sockaddr* from, socklen_t* fromlen)
+{
+    datagram_t datagram;
+
+    assert(s == SOCKET_FD);
+    xQueueReceive(rx_queue, &datagram, portMAX_DELAY);
+    // Like UDP, what doesn't fit the buffer is lost
+    size_t length = datagram.length < len ? datagram.length : len;
+    memcpy(mem, datagram.data, length);
+    if (from != NULL) {
+        memset(from, 0, *fromlen);
+    }
+    return length;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A WiFi link between the controller and the Rover behind the lwip socket calls, for running
+ * transport_udp.c on the host. The controller has one UDP socket, its datagrams go to the
+ * Rover simulated by the test and the Rover's go back to the port the socket was bound to.
+ * Each datagram takes the link delay plus up to the jitter and may be lost, the same in
+ * both directions, so datagrams can overtake each other.
+ *
+ * Datagrams travel on the simulated time of esp_timer.c, the test moves it along with
+ * mock_udp_run_until which delivers each one when it arrives.
+ */
+
+#define MOCK_UDP_MAX_LEN        64
+
+typedef struct mock_udp_link_t {
+    uint32_t    delay_us;
+    uint32_t    jitter_us;          // Added to the delay, evenly spread from 0 to this
+    uint8_t     loss_percent;
+} mock_udp_link_t;
+
+typedef struct mock_udp_stats_t {
+    uint32_t    to_rover_sent;
+    uint32_t    to_rover_delivered;
+    uint32_t    to_controller_sent;
+    uint32_t    to_controller_delivered;
+} mock_udp_stats_t;
+
+// Called outside of the tasks when a datagram arrives at the Rover
+typedef void mock_udp_rover_callback(const uint8_t* data, uint16_t length);
+
+void mock_udp_reset(void);
+void mock_udp_set_link(const mock_udp_link_t* link);
+// sendto fails right away like it does when lwip is out of buffers
+void mock_udp_set_send_buffers_full(bool full);
+void mock_udp_register_rover(mock_udp_rover_callback* callback);
+void mock_udp_rover_send(const uint8_t* data, uint16_t length);
+// Runs the FreeRTOS tasks until the given time, delivering the datagrams on the way
+void mock_udp_run_until(int64_t until_us);
+void mock_udp_get_stats(mock_udp_stats_t* stats);
@@ -0,0 +1,348 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "replay_hw.h"
+#include "controller_sample.h"
+#include "rover_controller.h"
+#include "link_manager.h"
+#include "latency_probe.h"
+
+/*
+ * Replays recorded controller inputs through controller_input, rover_controller and the
+ * payload builder on simulated time (see stubs/freertos.c) and prints every frame handed to
+ * a transport, with its time:
+ *
+ *   replay <trace.csv> [--loops n] [--frames out.frames] [--expect expected.frames]
+ *
+ * --loops plays the trace n times back to back, for steadier throughput numbers.
+ * --expect fails if the frames differ from a previous run, traces/ has the expected frames
+ * of the canned traces and ctest replays them. When a change to sampling, filtering or
+ * encoding is meant to change the frames, write new ones with --frames and check the diff.
+ *
+ * Trace format, CSV: the first line that isn't empty or a # comment names the columns,
+ * time_ms first and then any of the inputs in trace_inputs. Every row sets the inputs from
+ * time_ms on, the trace ends at the time of the last row. Sticks are 12 bit ADC readings,
+ * pots ADS1115 readings and switches pin levels. Inputs without a column stay at rest.
+ *
+ * Frame format, one line per frame: time_us since the start of the trace,transport,hex bytes
+ */
+
+#define REPLAY_START_US     1000000LL   // Some modules take 0 to mean never
+#define MAX_LINE_LEN        512
+
+typedef enum input_kind_t {
+    INPUT_KIND_ADC,
+    INPUT_KIND_ADS,
+    INPUT_KIND_GPIO
+} input_kind_t;
+
+typedef struct trace_input_t {
+    const char*     name;
+    input_kind_t    kind;
+    uint8_t         index;      // adc_dma channel, ADS1115 sampler channel or GPIO
+    int32_t         rest;
+} trace_input_t;
+
+// Switch pins must match rover_pin_map in controller_input.c, checked against the ISRs it adds
+static const trace_input_t trace_inputs[] = {
+    { "left_x",         INPUT_KIND_ADC,     INPUT_LEFT_JOYSTICK_X,                  2048 },
+    { "left_y",         INPUT_KIND_ADC,     INPUT_LEFT_JOYSTICK_Y,                  2048 },
+    { "left_rotate",    INPUT_KIND_ADC,     INPUT_LEFT_JOYSTICK_ROTATE,             2048 },
+    { "right_x",        INPUT_KIND_ADC,     INPUT_RIGHT_JOYSTICK_X,                 2048 },
+    { "right_y",        INPUT_KIND_ADC,     INPUT_RIGHT_JOYSTICK_Y,                 2048 },
+    { "right_rotate",   INPUT_KIND_ADC,     INPUT_RIGHT_JOYSTICK_ROTATE,            2048 },
+    { "pot_left",       INPUT_KIND_ADS,     INPUT_POT_LEFT - INPUT_ANALOG_END,      0 },
+    { "pot_right",      INPUT_KIND_ADS,     INPUT_POT_RIGHT - INPUT_ANALOG_END,     0 },
+    { "switch_1_up",    INPUT_KIND_GPIO,    GPIO_NUM_25,                            0 },
+    { "switch_1_down",  INPUT_KIND_GPIO,    GPIO_NUM_13,                            0 },
+    { "switch_2_up",    INPUT_KIND_GPIO,    GPIO_NUM_17,                            0 },
+    { "switch_2_down",  INPUT_KIND_GPIO,    GPIO_NUM_21,                            0 },
+};
+#define NUM_TRACE_INPUTS    (sizeof(trace_inputs) / sizeof(trace_inputs[0]))
+
+typedef struct trace_row_t {
+    int64_t     time_ms;
+    int32_t     values[NUM_TRACE_INPUTS];
+} trace_row_t;
+
+typedef struct trace_t {
+    trace_row_t*    rows;
+    size_t          num_rows;
+    int64_t         duration_ms;
+} trace_t;
+
+static const char* transport_names[REPLAY_TRANSPORT_END] = {
+    [REPLAY_TRANSPORT_LORA] = "lora",
+    [REPLAY_TRANSPORT_WS] = "ws",
+    [REPLAY_TRANSPORT_UDP] = "udp",
+};
+
+static FILE* frames_out;
+static int64_t trace_start_us;
+static uint32_t frames[REPLAY_TRANSPORT_END];
+
+static void fail(const char* path, unsigned line, const char* message)
+{
+    fprintf(stderr, "%s:%u: %s\n", path, line, message);
+    exit(1);
+}
+
+static int find_input(const char* name)
+{
+    for (size_t i = 0; i < NUM_TRACE_INPUTS; i++) {
+        if (strcmp(trace_inputs[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void load_trace(const char* path, trace_t* trace)
+{
+    char line[MAX_LINE_LEN];
+    int columns[NUM_TRACE_INPUTS];
+    size_t num_columns = 0;
+    size_t capacity = 0;
+    bool header = true;
+    unsigned line_num = 0;
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL) {
+        fail(path, 0, "can't open trace");
+    }
+    memset(trace, 0, sizeof(trace_t));
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_num++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+
+        char* save;
+        char* field = strtok_r(line, ",", &save);
+        if (header) {
+            if (field == NULL || strcmp(field, "time_ms") != 0) {
+                fail(path, line_num, "first column must be time_ms");
+            }
+            while ((field = strtok_r(NULL, ",", &save)) != NULL) {
+                int input = find_input(field);
+                if (input < 0 || num_columns == NUM_TRACE_INPUTS) {
+                    fail(path, line_num, "unknown column");
+                }
+                columns[num_columns++] = input;
+            }
+            header = false;
+            continue;
+        }
+
+        if (trace->num_rows == capacity) {
+            capacity = capacity == 0 ? 256 : capacity * 2;
+            trace->rows = realloc(trace->rows, capacity * sizeof(trace_row_t));
+            if (trace->rows == NULL) {
+                fail(path, line_num, "out of memory");
+            }
+        }
+        trace_row_t* row = &trace->rows[trace->num_rows];
+        // Inputs not in the trace stay at rest, the others hold their last value
+        for (size_t i = 0; i < NUM_TRACE_INPUTS; i++) {
+            row->values[i] = trace->num_rows == 0 ? trace_inputs[i].rest : row[-1].values[i];
+        }
+        char* end;
+        row->time_ms = strtoll(field, &end, 10);
+        if (*end != '\0' || (trace->num_rows > 0 && row->time_ms < row[-1].time_ms)) {
+            fail(path, line_num, "bad time_ms");
+        }
+        for (size_t i = 0; i < num_columns; i++) {
+            field = strtok_r(NULL, ",", &save);
+            if (field == NULL) {
+                fail(path, line_num, "missing value");
+            }
+            row->values[columns[i]] = strtol(field, &end, 10);
+            if (*end != '\0') {
+                fail(path, line_num, "bad value");
+            }
+        }
+        if (strtok_r(NULL, ",", &save) != NULL) {
+            fail(path, line_num, "too many values");
+        }
+        trace->num_rows++;
+    }
+    fclose(file);
+
+    if (trace->num_rows == 0) {
+        fail(path, line_num, "no rows");
+    }
+    trace->duration_ms = trace->rows[trace->num_rows - 1].time_ms;
+}
+
+static void apply_row(const trace_row_t* row)
+{
+    for (size_t i = 0; i < NUM_TRACE_INPUTS; i++) {
+        switch (trace_inputs[i].kind) {
+            case INPUT_KIND_ADC:
+                replay_hw_set_adc(trace_inputs[i].index, row->values[i]);
+                break;
+            case INPUT_KIND_ADS:
+                replay_hw_set_ads(trace_inputs[i].index, row->values[i]);
+                break;
+            case INPUT_KIND_GPIO:
+                replay_hw_set_gpio(trace_inputs[i].index, row->values[i]);
+                break;
+        }
+    }
+}
+
+static void on_frame(replay_transport_t transport, const uint8_t* data, uint16_t length)
+{
+    fprintf(frames_out, "%lld,%s,", (long long)(esp_timer_get_time() - trace_start_us), transport_names[transport]);
+    for (uint16_t i = 0; i < length; i++) {
+        fprintf(frames_out, "%02x", data[i]);
+    }
+    fprintf(frames_out, "\n");
+    frames[transport]++;
+}
+
+static char* read_file(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fail(path, 0, "can't open");
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* contents = malloc(size + 1);
+    if (contents == NULL || fread(contents, 1, size, file) != (size_t)size) {
+        fail(path, 0, "can't read");
+    }
+    contents[size] = '\0';
+    fclose(file);
+
+    return contents;
+}
+
+// Returns false and prints the first line that differs
+static bool compare_frames(const char* path, const char* actual)
+{
+    char* expected = read_file(path);
+    const char* e = expected;
+    const char* a = actual;
+    const char* e_line = e;
+    const char* a_line = a;
+    unsigned line = 1;
+
+    while (*e != '\0' && *e == *a) {
+        if (*e == '\n') {
+            line++;
+            e_line = e + 1;
+            a_line = a + 1;
+        }
+        e++;
+        a++;
+    }
+    bool same = *e == *a;
+    if (!same) {
+        fprintf(stderr, "%s:%u: frames differ\n  expected: %.*s\n  got:      %.*s\n", path, line,
+                (int)strcspn(e_line, "\n"), e_line, (int)strcspn(a_line, "\n"), a_line);
+    }
+    free(expected);
+
+    return same;
+}
+
+static double wall_time_s(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv)
+{
+    const char* trace_path = NULL;
+    const char* frames_path = NULL;
+    const char* expect_path = NULL;
+    long loops = 1;
+    trace_t trace;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc) {
+            loops = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames_path = argv[++i];
+        } else if (strcmp(argv[i], "--expect") == 0 && i + 1 < argc) {
+            expect_path = argv[++i];
+        } else if (trace_path == NULL && argv[i][0] != '-') {
+            trace_path = argv[i];
+        } else {
+            trace_path = NULL;
+            break;
+        }
+    }
+    if (trace_path == NULL || loops < 1) {
+        fprintf(stderr, "usage: %s <trace.csv> [--loops n] [--frames out.frames] [--expect expected.frames]\n", argv[0]);
+        return 1;
+    }
+    load_trace(trace_path, &trace);
+
+    char* stream;
+    size_t stream_len;
+    frames_out = open_memstream(&stream, &stream_len);
+    if (frames_out == NULL) {
+        fail(trace_path, 0, "out of memory");
+    }
+
+    // Same order as app_main, the switch levels have to be set before controller_input reads them
+    trace_start_us = REPLAY_START_US;
+    host_timer_set_us(trace_start_us);
+    apply_row(&trace.rows[0]);
+    link_manager_init();
+    latency_probe_init();
+    replay_hw_register_on_frame(&on_frame);
+    rover_controller_init();
+    for (size_t i = 0; i < NUM_TRACE_INPUTS; i++) {
+        if (trace_inputs[i].kind == INPUT_KIND_GPIO && !replay_hw_gpio_has_isr(trace_inputs[i].index)) {
+            fprintf(stderr, "%s is not a switch pin of controller_input\n", trace_inputs[i].name);
+            return 1;
+        }
+    }
+
+    double start_s = wall_time_s();
+    for (long loop = 0; loop < loops; loop++) {
+        int64_t loop_start_us = trace_start_us + loop * trace.duration_ms * 1000;
+        for (size_t i = 0; i < trace.num_rows; i++) {
+            host_rtos_run_until(loop_start_us + trace.rows[i].time_ms * 1000);
+            apply_row(&trace.rows[i]);
+        }
+    }
+    host_rtos_run_until(trace_start_us + loops * trace.duration_ms * 1000);
+    double wall_s = wall_time_s() - start_s;
+    fclose(frames_out);
+
+    rover_controller_stats_t stats;
+    rover_controller_get_stats(&stats);
+    double replayed_s = loops * trace.duration_ms / 1000.0;
+    printf("%s: %.1f s of input replayed in %.1f ms, %.0fx real time\n", trace_path, replayed_s, wall_s * 1000,
+           replayed_s / wall_s);
+    printf("frames: %u sent (lora %u, ws %u, udp %u), %u suppressed, %.0f frames/s\n", stats.frames_sent,
+           frames[REPLAY_TRANSPORT_LORA], frames[REPLAY_TRANSPORT_WS], frames[REPLAY_TRANSPORT_UDP],
+           stats.frames_suppressed, stats.frames_sent / wall_s);
+    printf("switch edge to frame: last %.1f ms, max %.1f ms\n", stats.last_switch_latency_us / 1000.0,
+           stats.max_switch_latency_us / 1000.0);
+
+    if (frames_path != NULL) {
+        FILE* file = fopen(frames_path, "w");
+        if (file == NULL || fwrite(stream, 1, stream_len, file) != stream_len) {
+            fail(frames_path, 0, "can't write");
+        }
+        fclose(file);
+    }
+    bool ok = expect_path == NULL || compare_frames(expect_path, stream);
+    free(stream);
+
+    return ok ? 0 : 1;
+}
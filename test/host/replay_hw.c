@@ -0,0 +1,243 @@
+#include <string.h>
+#include <assert.h>
+#include "replay_hw.h"
+#include "driver/adc.h"
+#include "driver/i2c.h"
+#include "esp_adc_cal.h"
+#include "adc_dma.h"
+#include "ads1115.h"
+#include "transport_lora.h"
+#include "transport_wifi.h"
+#include "transport_udp.h"
+#include "rover_utils.h"
+
+#define ADC_MAX_READING     4095
+#define ADC_MAX_MV          3300
+#define ADS_FSR_V           4.096
+
+// rover_utils.h only has an inline definition, this is the external one needed when it isn't inlined
+extern long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+typedef struct gpio_pin_t {
+    int         level;
+    gpio_isr_t  isr;
+    void*       isr_arg;
+} gpio_pin_t;
+
+static replay_frame_callback* on_frame;
+static uint32_t adc[ADC_DMA_MAX_CHANNELS];
+static int16_t ads[ADS1115_SAMPLER_MAX_CHANNELS];
+static gpio_pin_t gpio[GPIO_NUM_MAX];
+
+void replay_hw_register_on_frame(replay_frame_callback* callback)
+{
+    on_frame = callback;
+}
+
+void replay_hw_set_adc(uint8_t index, uint32_t raw)
+{
+    assert(index < ADC_DMA_MAX_CHANNELS);
+    adc[index] = raw;
+}
+
+void replay_hw_set_ads(uint8_t index, int16_t raw)
+{
+    assert(index < ADS1115_SAMPLER_MAX_CHANNELS);
+    ads[index] = raw;
+}
+
+void replay_hw_set_gpio(gpio_num_t num, int level)
+{
+    assert(num < GPIO_NUM_MAX);
+    if (gpio[num].level == level) {
+        return;
+    }
+    gpio[num].level = level;
+    if (gpio[num].isr != NULL) {
+        gpio[num].isr(gpio[num].isr_arg);
+    }
+}
+
+void replay_hw_set_gpio_missed(gpio_num_t num, int level)
+{
+    assert(num < GPIO_NUM_MAX);
+    gpio[num].level = level;
+}
+
+bool replay_hw_gpio_has_isr(gpio_num_t num)
+{
+    assert(num < GPIO_NUM_MAX);
+    return gpio[num].isr != NULL;
+}
+
+static void frame_sent(replay_transport_t transport, const uint8_t* data, uint16_t length)
+{
+    if (on_frame != NULL) {
+        on_frame(transport, data, length);
+    }
+}
+
+void transport_lora_send(uint8_t* data, uint16_t length)
+{
+    frame_sent(REPLAY_TRANSPORT_LORA, data, length);
+}
+
+void transport_lora_configure_slots(uint32_t period_ms, uint16_t controller_payload_len)
+{
+}
+
+void transport_lora_register_on_ack(on_frame_ack* callback)
+{
+}
+
+esp_err_t transport_ws_send(uint8_t* buf, uint16_t len)
+{
+    frame_sent(REPLAY_TRANSPORT_WS, buf, len);
+    return ESP_OK;
+}
+
+esp_err_t transport_ws_send_timeout(uint8_t* buf, uint16_t len, uint32_t timeout_ms)
+{
+    return transport_ws_send(buf, len);
+}
+
+esp_err_t transport_udp_send(uint16_t seq, uint8_t* payload, uint16_t length)
+{
+    frame_sent(REPLAY_TRANSPORT_UDP, payload, length);
+    return ESP_OK;
+}
+
+void adc_dma_init(const adc1_channel_t* channels, uint8_t num_channels, adc_atten_t atten)
+{
+    assert(num_channels <= ADC_DMA_MAX_CHANNELS);
+}
+
+uint32_t adc_dma_get_average(uint8_t index, uint8_t num_samples)
+{
+    assert(index < ADC_DMA_MAX_CHANNELS);
+    return adc[index];
+}
+
+esp_err_t adc1_config_width(adc_bits_width_t width_bit)
+{
+    return ESP_OK;
+}
+
+esp_err_t adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten)
+{
+    return ESP_OK;
+}
+
+// Linear over the whole range, the real calibration curve doesn't matter for the frames
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t adc_num, adc_atten_t atten, adc_bits_width_t bit_width,
+                                             uint32_t default_vref, esp_adc_cal_characteristics_t* chars)
+{
+    chars->adc_num = adc_num;
+    chars->atten = atten;
+    chars->bit_width = bit_width;
+    chars->vref = default_vref;
+    return ESP_ADC_CAL_VAL_DEFAULT_VREF;
+}
+
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t adc_reading, const esp_adc_cal_characteristics_t* chars)
+{
+    return adc_reading * ADC_MAX_MV / ADC_MAX_READING;
+}
+
+void gpio_pad_select_gpio(uint8_t gpio_num)
+{
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull)
+{
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t num)
+{
+    assert(num < GPIO_NUM_MAX);
+    return gpio[num].level;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t num, gpio_isr_t isr_handler, void* args)
+{
+    assert(num < GPIO_NUM_MAX);
+    gpio[num].isr = isr_handler;
+    gpio[num].isr_arg = args;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len,
+                             int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2c_set_pin(i2c_port_t i2c_num, int sda_io_num, int scl_io_num, bool sda_pullup_en, bool scl_pullup_en,
+                      i2c_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t* i2c_conf)
+{
+    return ESP_OK;
+}
+
+ads1115_t ads1115_config(i2c_port_t i2c_port, uint8_t address)
+{
+    ads1115_t ads;
+
+    memset(&ads, 0, sizeof(ads));
+    ads.i2c_port = i2c_port;
+    ads.address = address;
+    return ads;
+}
+
+void ads1115_set_sps(ads1115_t* ads, ads1115_sps_t sps)
+{
+    ads->config.bit.DR = sps;
+}
+
+void ads1115_set_rdy_pin(ads1115_t* ads, gpio_num_t gpio)
+{
+    ads->rdy_pin.in_use = true;
+    ads->rdy_pin.pin = gpio;
+}
+
+esp_err_t ads1115_sampler_start(ads1115_sampler_t* sampler, ads1115_t* ads, const ads1115_mux_t* mux,
+                                uint8_t num_channels)
+{
+    assert(num_channels <= ADS1115_SAMPLER_MAX_CHANNELS);
+    memset(sampler, 0, sizeof(ads1115_sampler_t));
+    sampler->ads = ads;
+    sampler->num_channels = num_channels;
+    memcpy(sampler->mux, mux, num_channels * sizeof(ads1115_mux_t));
+    return ESP_OK;
+}
+
+int16_t ads1115_sampler_get_raw(ads1115_sampler_t* sampler, uint8_t index)
+{
+    assert(index < sampler->num_channels);
+    return ads[index];
+}
+
+double ads1115_get_voltage_from_raw(ads1115_t* ads, int16_t raw)
+{
+    return raw * ADS_FSR_V / 32768;
+}
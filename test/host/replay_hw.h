@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/gpio.h"
+
+/*
+ * Host stand-ins for the ADC, ADS1115, GPIO and transports used by controller_input and
+ * rover_controller. The replay sets the inputs and gets every frame handed to a transport.
+ * ADC values are what adc_dma_get_average would return, the DMA averaging is not simulated.
+ */
+
+typedef enum replay_transport_t {
+    REPLAY_TRANSPORT_LORA,
+    REPLAY_TRANSPORT_WS,
+    REPLAY_TRANSPORT_UDP,
+    REPLAY_TRANSPORT_END
+} replay_transport_t;
+
+typedef void replay_frame_callback(replay_transport_t transport, const uint8_t* data, uint16_t length);
+
+void replay_hw_register_on_frame(replay_frame_callback* callback);
+// index is the channel index given to adc_dma_init
+void replay_hw_set_adc(uint8_t index, uint32_t raw);
+// index is the channel index given to ads1115_sampler_start
+void replay_hw_set_ads(uint8_t index, int16_t raw);
+// Runs the ISR added for the pin if the level changed, like an edge would
+void replay_hw_set_gpio(gpio_num_t gpio, int level);
+// Changes the level without running the ISR, an edge the interrupt missed
+void replay_hw_set_gpio_missed(gpio_num_t gpio, int level);
+bool replay_hw_gpio_has_isr(gpio_num_t gpio);
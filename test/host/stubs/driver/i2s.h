@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/adc.h"
+#include "freertos/FreeRTOS.h"
+
+typedef int i2s_port_t;
+
+#define I2S_NUM_0   0
+
+typedef enum {
+    I2S_MODE_MASTER = 1,
+    I2S_MODE_SLAVE = 2,
+    I2S_MODE_TX = 4,
+    I2S_MODE_RX = 8,
+    I2S_MODE_DAC_BUILT_IN = 16,
+    I2S_MODE_ADC_BUILT_IN = 32,
+} i2s_mode_t;
+
+typedef enum {
+    I2S_BITS_PER_SAMPLE_8BIT = 8,
+    I2S_BITS_PER_SAMPLE_16BIT = 16,
+    I2S_BITS_PER_SAMPLE_24BIT = 24,
+    I2S_BITS_PER_SAMPLE_32BIT = 32,
+} i2s_bits_per_sample_t;
+
+typedef enum {
+    I2S_CHANNEL_FMT_RIGHT_LEFT,
+    I2S_CHANNEL_FMT_ALL_RIGHT,
+    I2S_CHANNEL_FMT_ALL_LEFT,
+    I2S_CHANNEL_FMT_ONLY_RIGHT,
+    I2S_CHANNEL_FMT_ONLY_LEFT,
+} i2s_channel_fmt_t;
+
+typedef enum {
+    I2S_COMM_FORMAT_I2S = 0x01,
+    I2S_COMM_FORMAT_I2S_MSB = 0x02,
+    I2S_COMM_FORMAT_I2S_LSB = 0x04,
+} i2s_comm_format_t;
+
+typedef struct {
+    i2s_mode_t              mode;
+    int                     sample_rate;
+    i2s_bits_per_sample_t   bits_per_sample;
+    i2s_channel_fmt_t       channel_format;
+    i2s_comm_format_t       communication_format;
+    int                     intr_alloc_flags;
+    int                     dma_buf_count;
+    int                     dma_buf_len;
+    bool                    use_apll;
+} i2s_config_t;
+
+esp_err_t i2s_driver_install(i2s_port_t i2s_num, const i2s_config_t* i2s_config, int queue_size, void* i2s_queue);
+esp_err_t i2s_set_adc_mode(adc_unit_t adc_unit, adc1_channel_t adc_channel);
+esp_err_t i2s_adc_enable(i2s_port_t i2s_num);
+esp_err_t i2s_read(i2s_port_t i2s_num, void* dest, size_t size, size_t* bytes_read, TickType_t ticks_to_wait);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "esp_err.h"
+
+// The parts of the esp-idf http server web_server.c uses, served by mock_httpd.c
+typedef void* httpd_handle_t;
+
+typedef enum {
+    HTTP_GET = 1
+} httpd_method_t;
+
+typedef enum {
+    HTTPD_WS_TYPE_CONTINUE  = 0x0,
+    HTTPD_WS_TYPE_TEXT      = 0x1,
+    HTTPD_WS_TYPE_BINARY    = 0x2,
+    HTTPD_WS_TYPE_CLOSE     = 0x8,
+    HTTPD_WS_TYPE_PING      = 0x9,
+    HTTPD_WS_TYPE_PONG      = 0xA
+} httpd_ws_type_t;
+
+typedef struct httpd_req {
+    httpd_handle_t  handle;
+    const char*     uri;
+    void*           aux;
+} httpd_req_t;
+
+typedef struct httpd_ws_frame {
+    bool            final;
+    bool            fragmented;
+    httpd_ws_type_t type;
+    uint8_t*        payload;
+    size_t          len;
+} httpd_ws_frame_t;
+
+typedef void (*httpd_close_func_t)(httpd_handle_t hd, int sockfd);
+typedef void (*httpd_work_fn_t)(void* arg);
+
+typedef struct httpd_config {
+    uint16_t            server_port;
+    uint16_t            max_open_sockets;
+    uint16_t            max_uri_handlers;
+    uint16_t            send_wait_timeout;
+    bool                lru_purge_enable;
+    httpd_close_func_t  close_fn;
+} httpd_config_t;
+
+#define HTTPD_DEFAULT_CONFIG() {            \
+        .server_port        = 80,           \
+        .max_open_sockets   = 7,            \
+        .max_uri_handlers   = 8,            \
+        .send_wait_timeout  = 5,            \
+        .lru_purge_enable   = false,        \
+        .close_fn           = NULL,         \
+}
+
+typedef struct httpd_uri {
+    const char*     uri;
+    httpd_method_t  method;
+    esp_err_t       (*handler)(httpd_req_t* r);
+    void*           user_ctx;
+    bool            is_websocket;
+} httpd_uri_t;
+
+esp_err_t httpd_start(httpd_handle_t* handle, const httpd_config_t* config);
+esp_err_t httpd_stop(httpd_handle_t handle);
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t* uri_handler);
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void* arg);
+int httpd_req_to_sockfd(httpd_req_t* r);
+esp_err_t httpd_ws_recv_frame(httpd_req_t* req, httpd_ws_frame_t* pkt, size_t max_len);
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t* frame);
+esp_err_t httpd_resp_set_type(httpd_req_t* r, const char* type);
+esp_err_t httpd_resp_send(httpd_req_t* r, const char* buf, ssize_t buf_len);
+esp_err_t httpd_resp_send_500(httpd_req_t* r);
@@ -0,0 +1,102 @@
+#include "esp_timer.h"
+
+#define MAX_TIMERS      8
+#define NOT_RUNNING     INT64_MAX
+
+struct esp_timer {
+    esp_timer_create_args_t args;
+    int64_t                 expiry_us;
+    uint64_t                period_us;  // 0 for one shot
+};
+
+static int64_t now;
+static struct esp_timer timers[MAX_TIMERS];
+static uint8_t num_timers;
+
+int64_t esp_timer_get_time(void)
+{
+    return now;
+}
+
+void host_timer_set_us(int64_t now_us)
+{
+    now = now_us;
+}
+
+void host_timer_advance_us(int64_t us)
+{
+    now += us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle)
+{
+    assert(create_args->callback != NULL);
+    if (num_timers == MAX_TIMERS) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_timer_handle_t timer = &timers[num_timers++];
+    timer->args = *create_args;
+    timer->expiry_us = NOT_RUNNING;
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us)
+{
+    if (timer->expiry_us != NOT_RUNNING) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->expiry_us = now + timeout_us;
+    timer->period_us = period_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    assert(period_us > 0);
+    return timer_start(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (timer->expiry_us == NOT_RUNNING) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->expiry_us = NOT_RUNNING;
+    return ESP_OK;
+}
+
+static esp_timer_handle_t next_timer(void)
+{
+    esp_timer_handle_t next = NULL;
+
+    for (uint8_t i = 0; i < num_timers; i++) {
+        if (timers[i].expiry_us != NOT_RUNNING && (next == NULL || timers[i].expiry_us < next->expiry_us)) {
+            next = &timers[i];
+        }
+    }
+    return next;
+}
+
+void host_timer_run_due(void)
+{
+    esp_timer_handle_t timer;
+
+    while ((timer = next_timer()) != NULL && timer->expiry_us <= now) {
+        // Restarted or stopped before the callback runs, the callback may start it again
+        timer->expiry_us = timer->period_us > 0 ? timer->expiry_us + timer->period_us : NOT_RUNNING;
+        timer->args.callback(timer->args.arg);
+    }
+}
+
+int64_t host_timer_next_expiry_us(void)
+{
+    esp_timer_handle_t timer = next_timer();
+
+    return timer != NULL ? timer->expiry_us : INT64_MAX;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Host stand-in for the esp-idf timer, time only moves when the test moves it
+int64_t esp_timer_get_time(void);
+void host_timer_set_us(int64_t now_us);
+void host_timer_advance_us(int64_t us);
+
+typedef struct esp_timer* esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef struct esp_timer_create_args_t {
+    esp_timer_cb_t  callback;
+    void*           arg;
+    const char*     name;
+} esp_timer_create_args_t;
+
+// Timers only fire when the test calls host_timer_run_due, like the esp_timer task they run one at a time
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+// Fires every timer that is due by now in the order they expire
+void host_timer_run_due(void);
+// When the next timer expires, INT64_MAX if none is running
+int64_t host_timer_next_expiry_us(void);
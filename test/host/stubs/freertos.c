@@ -0,0 +1,421 @@
+#include <ucontext.h>
+#include <string.h>
+#include <assert.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+/*
+ * Tasks run as coroutines, one at a time, on the simulated time of esp_timer.c. A task runs
+ * until it blocks, or until it wakes one of higher priority like it would be preempted on the
+ * target, and takes no simulated time while running. Time only moves in host_rtos_run_until
+ * when every task is blocked, straight to the next wake up, so replays run as fast as the CPU
+ * allows and the same input always gives the same schedule.
+ * Semaphores and queues can also be used outside of tasks as long as they don't have to wait,
+ * a delay outside of the tasks just moves the time.
+ */
+
+#define MAX_TASKS           16
+#define TASK_STACK_SIZE     (256 * 1024)    // Host code needs more than the target, the requested size is ignored
+#define TICK_US             (portTICK_PERIOD_MS * 1000LL)
+#define NEVER               INT64_MAX
+
+typedef bool wait_done_t(TaskHandle_t task);
+
+struct host_task {
+    ucontext_t      ctx;
+    const char*     name;
+    UBaseType_t     priority;
+    TaskFunction_t  function;
+    void*           params;
+    bool            ready;
+    int64_t         wake_us;        // Timeout of a blocked task, NEVER to only wake on wait_done
+    wait_done_t*    wait_done;      // NULL for a plain delay
+    void*           wait_obj;
+    uint32_t        notify_value;
+    bool            notify_pending;
+};
+
+struct host_queue {
+    uint8_t*        items;
+    UBaseType_t     length;
+    UBaseType_t     item_size;
+    UBaseType_t     head;
+    UBaseType_t     count;
+};
+
+struct host_semaphore {
+    UBaseType_t     count;
+    UBaseType_t     max;
+};
+
+static struct host_task tasks[MAX_TASKS];
+static uint8_t num_tasks;
+static uint8_t last_run;
+static TaskHandle_t current;        // NULL outside of the tasks, also in ISRs called by the harness
+static ucontext_t scheduler_ctx;
+
+static void task_entry(void)
+{
+    current->function(current->params);
+    // FreeRTOS tasks must never return
+    assert(false);
+}
+
+static int64_t timeout_us(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY) {
+        return NEVER;
+    }
+    return (xTaskGetTickCount() + (int64_t)ticks) * TICK_US;
+}
+
+// Gives the CPU back to the scheduler until done returns true or wake_us is reached
+static void block_until(wait_done_t* done, void* obj, int64_t wake_us)
+{
+    TaskHandle_t task = current;
+
+    assert(task != NULL);   // Only tasks can wait
+    task->wait_done = done;
+    task->wait_obj = obj;
+    task->wake_us = wake_us;
+    task->ready = false;
+    swapcontext(&task->ctx, &scheduler_ctx);
+    task->wait_done = NULL;
+}
+
+// A task that woke a higher priority task lets it run first, like it would be preempted on the target
+static void preempt_for(TaskHandle_t woken)
+{
+    TaskHandle_t task = current;
+
+    if (task != NULL && woken->priority > task->priority) {
+        swapcontext(&task->ctx, &scheduler_ctx);
+    }
+}
+
+static bool timed_out(int64_t wake_us)
+{
+    return esp_timer_get_time() >= wake_us;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth, void* params,
+                       UBaseType_t priority, TaskHandle_t* handle)
+{
+    assert(num_tasks < MAX_TASKS);
+    TaskHandle_t task = &tasks[num_tasks++];
+
+    memset(task, 0, sizeof(struct host_task));
+    task->name = name;
+    task->priority = priority;
+    task->function = function;
+    task->params = params;
+    task->ready = true;
+    task->wake_us = NEVER;
+    getcontext(&task->ctx);
+    task->ctx.uc_stack.ss_sp = malloc(TASK_STACK_SIZE);
+    assert(task->ctx.uc_stack.ss_sp != NULL);
+    task->ctx.uc_stack.ss_size = TASK_STACK_SIZE;
+    task->ctx.uc_link = NULL;
+    makecontext(&task->ctx, task_entry, 0);
+    if (handle != NULL) {
+        *handle = task;
+    }
+
+    return pdPASS;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return esp_timer_get_time() / TICK_US;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (current == NULL) {
+        host_timer_advance_us(ticks * TICK_US);
+        return;
+    }
+    if (ticks == 0) {
+        // Still ready, others of the same priority get a turn
+        swapcontext(&current->ctx, &scheduler_ctx);
+        return;
+    }
+    block_until(NULL, NULL, timeout_us(ticks));
+}
+
+void vTaskDelayUntil(TickType_t* previous_wake, TickType_t increment)
+{
+    *previous_wake += increment;
+    int64_t wake_us = (int64_t)*previous_wake * TICK_US;
+    if (!timed_out(wake_us)) {
+        block_until(NULL, NULL, wake_us);
+    }
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    switch (action) {
+        case eNoAction:
+            break;
+        case eSetBits:
+            task->notify_value |= value;
+            break;
+        case eIncrement:
+            task->notify_value++;
+            break;
+        case eSetValueWithOverwrite:
+            task->notify_value = value;
+            break;
+        case eSetValueWithoutOverwrite:
+            if (task->notify_pending) {
+                return pdFAIL;
+            }
+            task->notify_value = value;
+            break;
+    }
+    task->notify_pending = true;
+    preempt_for(task);
+
+    return pdPASS;
+}
+
+// The harness calls ISRs from outside of the tasks, the woken task runs once the harness lets time move on
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t* higher_prio_task_woken)
+{
+    if (higher_prio_task_woken != NULL) {
+        *higher_prio_task_woken = pdFALSE;
+    }
+    return xTaskNotify(task, value, action);
+}
+
+static bool notify_pending(TaskHandle_t task)
+{
+    return task->notify_pending;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks)
+{
+    TaskHandle_t task = current;
+    int64_t wake_us = timeout_us(ticks);
+
+    if (!task->notify_pending) {
+        task->notify_value &= ~clear_on_entry;
+        while (!task->notify_pending && !timed_out(wake_us)) {
+            block_until(notify_pending, NULL, wake_us);
+        }
+    }
+    if (value != NULL) {
+        *value = task->notify_value;
+    }
+    if (!task->notify_pending) {
+        return pdFALSE;
+    }
+    task->notify_value &= ~clear_on_exit;
+    task->notify_pending = false;
+
+    return pdTRUE;
+}
+
+static bool notify_value_set(TaskHandle_t task)
+{
+    return task->notify_value != 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    TaskHandle_t task = current;
+    int64_t wake_us = timeout_us(ticks);
+
+    while (task->notify_value == 0 && !timed_out(wake_us)) {
+        block_until(notify_value_set, NULL, wake_us);
+    }
+    uint32_t value = task->notify_value;
+    if (value != 0) {
+        task->notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    task->notify_pending = false;
+
+    return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t queue = calloc(1, sizeof(struct host_queue));
+    assert(queue != NULL);
+    queue->items = calloc(length, item_size);
+    assert(queue->items != NULL);
+    queue->length = length;
+    queue->item_size = item_size;
+
+    return queue;
+}
+
+static bool queue_not_full(TaskHandle_t task)
+{
+    QueueHandle_t queue = task->wait_obj;
+    return queue->count < queue->length;
+}
+
+static bool queue_not_empty(TaskHandle_t task)
+{
+    QueueHandle_t queue = task->wait_obj;
+    return queue->count > 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks)
+{
+    int64_t wake_us = timeout_us(ticks);
+
+    while (queue->count == queue->length) {
+        if (timed_out(wake_us)) {
+            return errQUEUE_FULL;
+        }
+        block_until(queue_not_full, queue, wake_us);
+    }
+    memcpy(&queue->items[((queue->head + queue->count) % queue->length) * queue->item_size], item, queue->item_size);
+    queue->count++;
+
+    return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* higher_prio_task_woken)
+{
+    if (higher_prio_task_woken != NULL) {
+        *higher_prio_task_woken = pdFALSE;
+    }
+    return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks)
+{
+    int64_t wake_us = timeout_us(ticks);
+
+    while (queue->count == 0) {
+        if (timed_out(wake_us)) {
+            return pdFALSE;
+        }
+        block_until(queue_not_empty, queue, wake_us);
+    }
+    memcpy(item, &queue->items[queue->head * queue->item_size], queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    queue->head = 0;
+    queue->count = 0;
+
+    return pdPASS;
+}
+
+static xSemaphoreHandle semaphore_create(UBaseType_t count)
+{
+    xSemaphoreHandle sem = malloc(sizeof(struct host_semaphore));
+    if (sem != NULL) {
+        sem->count = count;
+        sem->max = 1;
+    }
+    return sem;
+}
+
+xSemaphoreHandle xSemaphoreCreateMutex(void)
+{
+    return semaphore_create(1);
+}
+
+xSemaphoreHandle xSemaphoreCreateBinary(void)
+{
+    return semaphore_create(0);
+}
+
+static bool semaphore_available(TaskHandle_t task)
+{
+    xSemaphoreHandle sem = task->wait_obj;
+    return sem->count > 0;
+}
+
+BaseType_t xSemaphoreTake(xSemaphoreHandle sem, TickType_t ticks)
+{
+    int64_t wake_us = timeout_us(ticks);
+
+    while (sem->count == 0) {
+        if (timed_out(wake_us)) {
+            return pdFALSE;
+        }
+        block_until(semaphore_available, sem, wake_us);
+    }
+    sem->count--;
+
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(xSemaphoreHandle sem)
+{
+    if (sem->count == sem->max) {
+        return pdFALSE;
+    }
+    sem->count++;
+
+    return pdTRUE;
+}
+
+static void wake_tasks(void)
+{
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        TaskHandle_t task = &tasks[i];
+        if (!task->ready && ((task->wait_done != NULL && task->wait_done(task)) || timed_out(task->wake_us))) {
+            task->ready = true;
+        }
+    }
+}
+
+// Highest priority first, tasks of the same priority take turns starting after the one that ran last
+static TaskHandle_t next_ready(void)
+{
+    TaskHandle_t next = NULL;
+
+    for (uint8_t n = 1; n <= num_tasks; n++) {
+        TaskHandle_t task = &tasks[(last_run + n) % num_tasks];
+        if (task->ready && (next == NULL || task->priority > next->priority)) {
+            next = task;
+        }
+    }
+    return next;
+}
+
+void host_rtos_run_until(int64_t until_us)
+{
+    assert(current == NULL);
+
+    while (true) {
+        wake_tasks();
+        TaskHandle_t task = next_ready();
+        if (task != NULL) {
+            last_run = task - tasks;
+            current = task;
+            swapcontext(&scheduler_ctx, &task->ctx);
+            current = NULL;
+            continue;
+        }
+
+        int64_t next_us = NEVER;
+        for (uint8_t i = 0; i < num_tasks; i++) {
+            if (tasks[i].wake_us < next_us) {
+                next_us = tasks[i].wake_us;
+            }
+        }
+        if (next_us >= until_us) {
+            if (until_us > esp_timer_get_time()) {
+                host_timer_set_us(until_us);
+            }
+            return;
+        }
+        host_timer_set_us(next_us);
+    }
+}
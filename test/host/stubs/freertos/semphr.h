@@ -0,0 +1,11 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_semaphore* xSemaphoreHandle;
+typedef xSemaphoreHandle SemaphoreHandle_t;
+
+xSemaphoreHandle xSemaphoreCreateMutex(void);
+xSemaphoreHandle xSemaphoreCreateBinary(void);
+BaseType_t xSemaphoreTake(xSemaphoreHandle sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(xSemaphoreHandle sem);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_task* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* params);
+
+typedef enum {
+    eNoAction,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite
+} eNotifyAction;
+
+typedef enum {
+    eRunning,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+    eInvalid
+} eTaskState;
+
+typedef struct xTASK_STATUS {
+    TaskHandle_t    xHandle;
+    const char*     pcTaskName;
+    UBaseType_t     xTaskNumber;
+    eTaskState      eCurrentState;
+    UBaseType_t     uxCurrentPriority;
+    UBaseType_t     uxBasePriority;
+    uint32_t        ulRunTimeCounter;
+    uint32_t        usStackHighWaterMark;
+} TaskStatus_t;
+
+#define xTaskNotifyGive(task)   xTaskNotify((task), 0, eIncrement)
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth, void* params,
+                       UBaseType_t priority, TaskHandle_t* handle);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t* previous_wake, TickType_t increment);
+TickType_t xTaskGetTickCount(void);
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t* higher_prio_task_woken);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* task_status, UBaseType_t array_size, uint32_t* total_run_time);
+
+// Runs the tasks until simulated time reaches until_us, what is due at until_us is left for the next call.
+// Must be called from outside of the tasks.
+void host_rtos_run_until(int64_t until_us);
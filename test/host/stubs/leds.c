@@ -0,0 +1,10 @@
+#include "leds.h"
+
+void leds_init(void)
+{
+}
+
+void leds_toggle(Led num)
+{
+    (void)num;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <errno.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/select.h>
+
+// The lwip socket calls the way LWIP_COMPAT_SOCKETS maps them, served by mock_udp.c and mock_httpd.c
+#define socket(domain, type, protocol)                  lwip_socket(domain, type, protocol)
+#define bind(s, name, namelen)                          lwip_bind(s, name, namelen)
+#define sendto(s, data, size, flags, to, tolen)         lwip_sendto(s, data, size, flags, to, tolen)
+#define recvfrom(s, mem, len, flags, from, fromlen)     lwip_recvfrom(s, mem, len, flags, from, fromlen)
+#define select(maxfdp1, readset, writeset, exceptset, timeout) \
+    lwip_select(maxfdp1, readset, writeset, exceptset, timeout)
+
+int lwip_socket(int domain, int type, int protocol);
+int lwip_bind(int s, const struct sockaddr* name, socklen_t namelen);
+ssize_t lwip_sendto(int s, const void* data, size_t size, int flags, const struct sockaddr* to, socklen_t tolen);
+ssize_t lwip_recvfrom(int s, void* mem, size_t len, int flags, struct sockaddr* from, socklen_t* fromlen);
+int lwip_select(int maxfdp1, fd_set* readset, fd_set* writeset, fd_set* exceptset, struct timeval* timeout);
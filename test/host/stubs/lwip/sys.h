@@ -0,0 +1,6 @@
+#pragma once
+
+// Like sys_arch.h of the esp-idf port, which web_server.c gets the FreeRTOS semaphores from
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
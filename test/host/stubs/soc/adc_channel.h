@@ -0,0 +1,10 @@
+#pragma once
+
+#define ADC1_GPIO36_CHANNEL     ADC1_CHANNEL_0
+#define ADC1_GPIO37_CHANNEL     ADC1_CHANNEL_1
+#define ADC1_GPIO38_CHANNEL     ADC1_CHANNEL_2
+#define ADC1_GPIO39_CHANNEL     ADC1_CHANNEL_3
+#define ADC1_GPIO32_CHANNEL     ADC1_CHANNEL_4
+#define ADC1_GPIO33_CHANNEL     ADC1_CHANNEL_5
+#define ADC1_GPIO34_CHANNEL     ADC1_CHANNEL_6
+#define ADC1_GPIO35_CHANNEL     ADC1_CHANNEL_7
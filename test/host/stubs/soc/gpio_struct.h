@@ -0,0 +1,3 @@
+#pragma once
+
+// lora.c includes it but only uses the gpio driver
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+// Only the SAR ADC1 pattern table of the SYSCON registers
+typedef volatile struct syscon_dev_s {
+    struct {
+        uint32_t sar1_patt_len;
+    } saradc_ctrl;
+    uint32_t saradc_sar1_patt_tab[4];
+} syscon_dev_t;
+
+extern syscon_dev_t SYSCON;
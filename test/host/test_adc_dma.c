@@ -0,0 +1,166 @@
+#include "host_test.h"
+#include "mock_i2s_adc.h"
+#include "adc_dma.h"
+#include "esp_timer.h"
+#include "soc/syscon_struct.h"
+#include "soc/adc_channel.h"
+
+/*
+ * adc_dma on a simulated I2S ADC: synthetic signals per channel are converted in the order of
+ * the pattern table and DMAed in buffers, the averages have to come out per channel and from
+ * the latest samples only.
+ */
+
+#define START_US            1000000LL
+#define NUM_CHANNELS        6
+#define SAMPLE_RATE         12000   // ADC_DMA_SAMPLE_RATE in adc_dma.c, all channels together
+#define BUF_LEN             256     // ADC_DMA_BUF_LEN in adc_dma.c
+#define RING_LEN            64      // ADC_DMA_RING_LEN in adc_dma.c
+#define NUM_SAMPLES         32      // NO_OF_SAMPLES in controller_input.c
+#define STEP_LOW            1000
+#define STEP_HIGH           3000
+
+// Sticks in the order controller_input gives them
+static const adc1_channel_t channels[NUM_CHANNELS] = {
+    ADC1_GPIO39_CHANNEL, ADC1_GPIO36_CHANNEL, ADC1_GPIO33_CHANNEL,
+    ADC1_GPIO34_CHANNEL, ADC1_GPIO35_CHANNEL, ADC1_GPIO32_CHANNEL,
+};
+
+static uint32_t step_conversion;
+
+// Each channel at its own level
+static uint16_t levels(adc1_channel_t channel, uint32_t conversion)
+{
+    return 100 + channel * 500;
+}
+
+// Every sample is its conversion number, the mean tells which samples were used
+static uint16_t ramp(adc1_channel_t channel, uint32_t conversion)
+{
+    return conversion & 0x0FFF;
+}
+
+static uint16_t step(adc1_channel_t channel, uint32_t conversion)
+{
+    return conversion < step_conversion ? STEP_LOW : STEP_HIGH;
+}
+
+static int64_t buffer_done_us(uint32_t buffers)
+{
+    return mock_i2s_adc_conversion_us(buffers * BUF_LEN - 1);
+}
+
+// Moves on until the given buffer was handed over and read
+static void run_buffers(uint32_t buffers)
+{
+    mock_i2s_adc_run_until(buffer_done_us(buffers) + 1);
+}
+
+static void test_pattern_table(void)
+{
+    CHECK_EQ(SYSCON.saradc_ctrl.sar1_patt_len, NUM_CHANNELS - 1);
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        uint8_t entry = SYSCON.saradc_sar1_patt_tab[i / 4] >> ((3 - i % 4) * 8);
+        CHECK_EQ(entry >> 4, channels[i]);
+        CHECK_EQ(entry & 0x03, ADC_ATTEN_DB_11);
+    }
+}
+
+static void test_nothing_before_first_buffer(void)
+{
+    mock_i2s_adc_run_until(buffer_done_us(1) - 1);
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        CHECK_EQ(adc_dma_get_average(i, NUM_SAMPLES), 0);
+    }
+}
+
+// Until the ring filled up the mean is over what there is
+static void test_first_buffer_partial(void)
+{
+    run_buffers(1);
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        uint32_t sum = 0, num = 0;
+        for (uint32_t conversion = i; conversion < BUF_LEN; conversion += NUM_CHANNELS) {
+            sum += conversion;
+            num++;
+        }
+        CHECK(num < RING_LEN);
+        CHECK_EQ(adc_dma_get_average(i, RING_LEN), sum / num);
+    }
+}
+
+static void test_mean_of_latest(uint32_t buffers)
+{
+    run_buffers(buffers);
+    uint32_t conversions = buffers * BUF_LEN;
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        for (uint8_t num_samples = 1; num_samples <= RING_LEN; num_samples *= 2) {
+            // Latest conversions of this channel, the ramp is the conversion number
+            uint32_t last = conversions - 1 - (conversions - 1 + NUM_CHANNELS - i) % NUM_CHANNELS;
+            uint32_t sum = 0;
+            for (uint8_t n = 0; n < num_samples; n++) {
+                sum += (last - n * NUM_CHANNELS) & 0x0FFF;
+            }
+            CHECK_EQ(adc_dma_get_average(i, num_samples), sum / num_samples);
+        }
+    }
+}
+
+static void test_channels_separated(uint32_t buffers)
+{
+    mock_i2s_adc_set_signal(levels);
+    // Flush the ring with samples of the new signal
+    run_buffers(buffers + 2);
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        CHECK_EQ(adc_dma_get_average(i, RING_LEN), levels(channels[i], 0));
+    }
+}
+
+// Time from a step on the input until the NUM_SAMPLES mean read by controller_input has all of it
+static void test_step_latency(uint32_t buffers)
+{
+    mock_i2s_adc_set_signal(step);
+    step_conversion = buffers * BUF_LEN + BUF_LEN / 3;
+    int64_t step_us = mock_i2s_adc_conversion_us(step_conversion);
+    int64_t settled_us = 0;
+
+    run_buffers(buffers);
+    for (uint32_t b = buffers + 1; b < buffers + 6 && settled_us == 0; b++) {
+        run_buffers(b);
+        if (adc_dma_get_average(0, NUM_SAMPLES) == STEP_HIGH) {
+            settled_us = esp_timer_get_time() - step_us;
+        }
+    }
+    CHECK(settled_us > 0);
+    int64_t buffer_us = BUF_LEN * 1000000LL / SAMPLE_RATE;
+    int64_t window_us = NUM_SAMPLES * NUM_CHANNELS * 1000000LL / SAMPLE_RATE;
+    printf("Step to a settled %d sample mean: %.1f ms, a DMA buffer takes %.1f ms, the window %.1f ms\n",
+           NUM_SAMPLES, settled_us / 1000.0, buffer_us / 1000.0, window_us / 1000.0);
+    CHECK(settled_us <= window_us + buffer_us);
+}
+
+int main(void)
+{
+    mock_i2s_adc_stats_t stats;
+    uint32_t buffers = 1;
+
+    host_timer_set_us(START_US);
+    mock_i2s_adc_set_signal(ramp);
+    adc_dma_init(channels, NUM_CHANNELS, ADC_ATTEN_DB_11);
+
+    test_pattern_table();
+    test_nothing_before_first_buffer();
+    test_first_buffer_partial();
+    for (buffers = 2; buffers < 40; buffers++) {
+        test_mean_of_latest(buffers);
+    }
+    test_channels_separated(buffers);
+    test_step_latency(buffers + 2);
+
+    // The task keeps up, every buffer read and none dropped
+    mock_i2s_adc_get_stats(&stats);
+    CHECK_EQ(stats.dropped_buffers, 0);
+    CHECK_EQ(stats.reads, stats.buffers);
+    printf("test_adc_dma passed\n");
+    return 0;
+}
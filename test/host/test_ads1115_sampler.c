@@ -0,0 +1,159 @@
+#include "host_test.h"
+#include "mock_ads1115.h"
+#include "ads1115.h"
+#include "esp_timer.h"
+
+/*
+ * The round-robin sampler of the ads1115 component on a simulated chip: every RDY edge has to
+ * read the finished conversion into its channel and start the next channel, two bus
+ * transactions per sample at close to the full 860 SPS. Without RDY edges it falls back to
+ * polling once per tick until they come back, and conversions lost while the chip was off
+ * the bus are restarted.
+ */
+
+#define START_US            1000000LL
+#define NUM_CHANNELS        2
+#define TICK_US             (portTICK_PERIOD_MS * 1000)
+#define CONVERSION_US       1163    // One conversion at 860 SPS
+#define RESTART_MS          20      // restart_ticks in ads1115_sampler_task
+
+// The pots, like controller_input samples them
+static const ads1115_mux_t channels[NUM_CHANNELS] = { ADS1115_MUX_0_GND, ADS1115_MUX_1_GND };
+
+static ads1115_t ads;
+static ads1115_sampler_t sampler;
+static int16_t offset;
+
+// Each input at its own level, offset moves them all
+static int16_t levels(uint8_t mux)
+{
+    return 1000 * mux + offset;
+}
+
+static void run_for(int64_t us)
+{
+    mock_ads1115_run_until(esp_timer_get_time() + us);
+}
+
+// The conversions started since the stats were cleared take the channels in turn
+static void check_round_robin(void)
+{
+    uint8_t first = 0;
+    while (first < NUM_CHANNELS && channels[first] != mock_ads1115_started_mux(0)) {
+        first++;
+    }
+    CHECK(first < NUM_CHANNELS);
+    for (uint32_t i = 1; i < MOCK_ADS1115_MAX_LOG; i++) {
+        CHECK_EQ(mock_ads1115_started_mux(i), channels[(first + i) % NUM_CHANNELS]);
+    }
+}
+
+static void check_latest(void)
+{
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++) {
+        CHECK_EQ(ads1115_sampler_get_raw(&sampler, i), levels(channels[i]));
+    }
+}
+
+static void test_rdy_sequencing(void)
+{
+    mock_ads1115_stats_t stats;
+
+    mock_ads1115_clear_stats();
+    run_for(1000000);
+    mock_ads1115_get_stats(&stats);
+
+    check_round_robin();
+    check_latest();
+    // Every conversion is a read and the config write starting the next one, nothing else
+    CHECK_EQ(stats.rdy_pulses, stats.conversions);
+    CHECK_EQ(stats.transactions, 2 * stats.conversions);
+    CHECK_EQ(stats.reads, stats.conversions);
+    CHECK(stats.conversions >= 1000000 / CONVERSION_US - 1);
+    CHECK(sampler.conversions[0] >= stats.conversions / 2 - 1 && sampler.conversions[1] >= stats.conversions / 2 - 1);
+    printf("RDY: %u conversions/s, %.1f transactions per sample\n", stats.conversions,
+           (double)stats.transactions / stats.conversions);
+
+    // New readings show up right away
+    offset = 7;
+    run_for(NUM_CHANNELS * CONVERSION_US + 1);
+    check_latest();
+}
+
+// ALERT/RDY not wired, the sampler has to find the conversions itself
+static void test_polling_fallback(void)
+{
+    mock_ads1115_stats_t stats;
+
+    mock_ads1115_set_rdy_connected(false);
+    offset = 13;
+    // Notices after the first wait times out, the conversion in flight is read by polling
+    run_for((RESTART_MS + 2) * 1000 + 2 * TICK_US);
+    mock_ads1115_clear_stats();
+    run_for(1000000);
+    mock_ads1115_get_stats(&stats);
+
+    check_round_robin();
+    check_latest();
+    // One conversion per tick, the config read in front of every sample
+    CHECK(stats.conversions >= 1000000 / TICK_US - 1 && stats.conversions <= 1000000 / TICK_US + 1);
+    CHECK(stats.transactions <= 3 * stats.conversions + 1);
+    CHECK(stats.transactions >= 3 * stats.conversions - 1);
+    printf("Polling: %u conversions/s, %.1f transactions per sample\n", stats.conversions,
+           (double)stats.transactions / stats.conversions);
+}
+
+// Once the edges are back the sampler goes back to full speed
+static void test_rdy_back(void)
+{
+    mock_ads1115_stats_t stats;
+
+    mock_ads1115_set_rdy_connected(true);
+    run_for(2 * TICK_US);
+    mock_ads1115_clear_stats();
+    run_for(100000);
+    mock_ads1115_get_stats(&stats);
+    CHECK(stats.conversions >= 100000 / CONVERSION_US - 1);
+    CHECK_EQ(stats.transactions, 2 * stats.conversions);
+}
+
+// The chip off the bus for a while, the lost conversion must not stop the sampler for good
+static void test_chip_gone_restarted(void)
+{
+    mock_ads1115_stats_t stats;
+    uint32_t conversions = sampler.conversions[0] + sampler.conversions[1];
+
+    mock_ads1115_set_present(false);
+    run_for(100000);
+    mock_ads1115_set_present(true);
+    CHECK(sampler.conversions[0] + sampler.conversions[1] <= conversions + 1);
+
+    offset = 21;
+    run_for((RESTART_MS + 2) * 1000 + 2 * TICK_US);
+    mock_ads1115_clear_stats();
+    run_for(100000);
+    mock_ads1115_get_stats(&stats);
+    check_round_robin();
+    check_latest();
+    CHECK(stats.conversions >= 100000 / CONVERSION_US - 1);
+}
+
+int main(void)
+{
+    host_timer_set_us(START_US);
+    mock_ads1115_set_signal(levels);
+    ads = ads1115_config(I2C_NUM_0, MOCK_ADS1115_ADDRESS);
+    ads1115_set_sps(&ads, ADS1115_SPS_860);
+
+    // Needs the RDY pin
+    CHECK_EQ(ads1115_sampler_start(&sampler, &ads, channels, NUM_CHANNELS), ESP_ERR_INVALID_ARG);
+    ads1115_set_rdy_pin(&ads, MOCK_ADS1115_RDY_PIN);
+    CHECK_EQ(ads1115_sampler_start(&sampler, &ads, channels, NUM_CHANNELS), ESP_OK);
+
+    test_rdy_sequencing();
+    test_polling_fallback();
+    test_rdy_back();
+    test_chip_gone_restarted();
+    printf("test_ads1115_sampler passed\n");
+    return 0;
+}
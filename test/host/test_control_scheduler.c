@@ -0,0 +1,218 @@
+#include <string.h>
+#include "host_test.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "control_scheduler.h"
+
+/*
+ * The control cycle on simulated time: a task runs the stages like controller_input and
+ * rover_controller do, each taking as long as the workload says, and a task of higher priority
+ * can take the CPU right when a cycle is due. Checks the jitter, deadline and budget stats
+ * against what the workload must give and that overruns skip cycles to get back on schedule.
+ */
+
+#define START_US                1000000LL
+#define PERIOD_MS               100
+#define PERIOD_US               (PERIOD_MS * 1000)
+#define CYCLES                  100
+#define HOG_PRIORITY            (CONTROL_TASK_PRIORITY + 1)
+
+typedef struct workload_t {
+    uint32_t    stage_us[CONTROL_STAGE_END];    // LINK_WAIT is spent inside SEND, on top of it
+    uint32_t    hog_us;                         // CPU taken by the higher priority task when a cycle is due
+    uint32_t    hog_step_us;                    // Added to hog_us every cycle, wraps at hog_max_us
+    uint32_t    hog_max_us;
+} workload_t;
+
+static workload_t workload;
+static uint32_t overrun_once_us;
+static int64_t cycle_starts[CYCLES];
+static uint32_t num_starts;
+
+static void stage(control_stage_t stage, uint32_t extra_us)
+{
+    control_scheduler_stage_begin(stage);
+    host_timer_advance_us(workload.stage_us[stage] + extra_us);
+    control_scheduler_stage_end(stage);
+}
+
+static void control_task(void* arg)
+{
+    while (true) {
+        control_scheduler_wait_next_cycle();
+        if (num_starts < CYCLES) {
+            cycle_starts[num_starts++] = control_scheduler_get_cycle_start_us();
+        }
+        stage(CONTROL_STAGE_SAMPLE, overrun_once_us);
+        overrun_once_us = 0;
+        stage(CONTROL_STAGE_FILTER, 0);
+        stage(CONTROL_STAGE_ENCODE, 0);
+        control_scheduler_stage_begin(CONTROL_STAGE_SEND);
+        stage(CONTROL_STAGE_LINK_WAIT, 0);
+        host_timer_advance_us(workload.stage_us[CONTROL_STAGE_SEND]);
+        control_scheduler_stage_end(CONTROL_STAGE_SEND);
+        control_scheduler_cycle_done();
+    }
+}
+
+// Wakes on the same ticks the cycles are due and keeps the CPU for a while
+static void hog_task(void* arg)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (true) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(PERIOD_MS));
+        host_timer_advance_us(workload.hog_us);
+        if (workload.hog_step_us > 0) {
+            workload.hog_us = (workload.hog_us + workload.hog_step_us) % workload.hog_max_us;
+        }
+    }
+}
+
+// Runs the given number of cycles with the stats starting from zero
+static void run(uint32_t cycles, control_scheduler_stats_t* stats)
+{
+    control_scheduler_reset_stats();
+    num_starts = 0;
+    host_rtos_run_until(esp_timer_get_time() + cycles * PERIOD_US);
+    control_scheduler_get_stats(stats);
+}
+
+static void set_nominal_workload(void)
+{
+    memset(&workload, 0, sizeof(workload));
+    workload.stage_us[CONTROL_STAGE_SAMPLE] = 1200;
+    workload.stage_us[CONTROL_STAGE_FILTER] = 150;
+    workload.stage_us[CONTROL_STAGE_ENCODE] = 80;
+    workload.stage_us[CONTROL_STAGE_SEND] = 900;
+    workload.stage_us[CONTROL_STAGE_LINK_WAIT] = 0;
+}
+
+// Cycles are due on whole periods from the start, none may start early
+static void check_on_schedule(uint32_t max_late_us)
+{
+    CHECK(num_starts > 0);
+    for (uint32_t i = 0; i < num_starts; i++) {
+        CHECK((cycle_starts[i] - START_US) % PERIOD_US <= max_late_us);
+    }
+}
+
+static void test_nominal(void)
+{
+    control_scheduler_stats_t stats;
+
+    set_nominal_workload();
+    run(CYCLES, &stats);
+    CHECK_EQ(stats.period_us, PERIOD_US);
+    CHECK_EQ(stats.cycles, CYCLES);
+    CHECK_EQ(stats.deadline_misses, 0);
+    CHECK_EQ(stats.skipped_cycles, 0);
+    CHECK_EQ(stats.max_jitter_us, 0);
+    for (uint8_t i = 0; i < CONTROL_STAGE_END; i++) {
+        CHECK_EQ(stats.stages[i].last_us, workload.stage_us[i]);
+        CHECK_EQ(stats.stages[i].max_us, workload.stage_us[i]);
+        CHECK_EQ(stats.stages[i].overruns, 0);
+    }
+    check_on_schedule(0);
+}
+
+// Only the stage over its budget is counted, the cycle still makes its deadline
+static void test_stage_overrun(void)
+{
+    control_scheduler_stats_t stats;
+
+    set_nominal_workload();
+    workload.stage_us[CONTROL_STAGE_ENCODE] = 800;
+    run(CYCLES, &stats);
+    CHECK_EQ(stats.stages[CONTROL_STAGE_ENCODE].overruns, CYCLES);
+    CHECK_EQ(stats.stages[CONTROL_STAGE_SAMPLE].overruns, 0);
+    CHECK_EQ(stats.stages[CONTROL_STAGE_SEND].overruns, 0);
+    CHECK_EQ(stats.deadline_misses, 0);
+}
+
+// Waiting for the link is its own stage, it doesn't count against SEND
+static void test_link_wait_nested(void)
+{
+    control_scheduler_stats_t stats;
+
+    set_nominal_workload();
+    workload.stage_us[CONTROL_STAGE_LINK_WAIT] = 40000;
+    run(CYCLES, &stats);
+    CHECK_EQ(stats.stages[CONTROL_STAGE_SEND].max_us, workload.stage_us[CONTROL_STAGE_SEND]);
+    CHECK_EQ(stats.stages[CONTROL_STAGE_SEND].overruns, 0);
+    CHECK_EQ(stats.stages[CONTROL_STAGE_LINK_WAIT].max_us, 40000);
+    CHECK_EQ(stats.stages[CONTROL_STAGE_LINK_WAIT].overruns, 0);
+    CHECK_EQ(stats.deadline_misses, 0);
+}
+
+// One cycle takes two and a half periods: one deadline miss, the cycles it ran into are skipped
+static void test_deadline_miss(void)
+{
+    control_scheduler_stats_t stats;
+
+    set_nominal_workload();
+    overrun_once_us = 5 * PERIOD_US / 2;
+    run(CYCLES, &stats);
+    CHECK_EQ(stats.deadline_misses, 1);
+    CHECK_EQ(stats.skipped_cycles, 2);
+    CHECK_EQ(stats.cycles, CYCLES - 2);
+    CHECK_EQ(stats.max_jitter_us, 0);
+    CHECK_EQ(stats.stages[CONTROL_STAGE_SAMPLE].overruns, 1);
+    check_on_schedule(0);
+}
+
+// The higher priority task delays the wake up by what it takes, from 0 to 4.5 ms
+static void test_jitter(void)
+{
+    control_scheduler_stats_t stats;
+
+    set_nominal_workload();
+    workload.hog_step_us = 500;
+    workload.hog_max_us = 5000;
+    run(CYCLES, &stats);
+    printf("Jitter with a task taking 0 to %.1f ms when a cycle is due: last %u us, max %u us, avg %u us\n",
+           (workload.hog_max_us - workload.hog_step_us) / 1000.0, stats.last_jitter_us, stats.max_jitter_us,
+           stats.avg_jitter_us);
+    CHECK_EQ(stats.cycles, CYCLES);
+    CHECK_EQ(stats.max_jitter_us, workload.hog_max_us - workload.hog_step_us);
+    CHECK_EQ(stats.avg_jitter_us, (workload.hog_max_us - workload.hog_step_us) / 2);
+    CHECK_EQ(stats.deadline_misses, 0);
+    check_on_schedule(stats.max_jitter_us);
+}
+
+// Late wake ups and a long cycle together, the deadline counts from the late start
+static void test_jitter_and_deadline(void)
+{
+    control_scheduler_stats_t stats;
+
+    set_nominal_workload();
+    workload.hog_us = 3000;
+    workload.stage_us[CONTROL_STAGE_LINK_WAIT] = PERIOD_US - 1000;
+    run(CYCLES, &stats);
+    CHECK_EQ(stats.max_jitter_us, 3000);
+    CHECK_EQ(stats.deadline_misses, stats.cycles);
+    CHECK(stats.skipped_cycles > 0);
+    check_on_schedule(3000);
+}
+
+int main(void)
+{
+    host_timer_set_us(START_US);
+    control_scheduler_init(PERIOD_MS);
+    BaseType_t status = xTaskCreate(control_task, "control_task", 4096, NULL, CONTROL_TASK_PRIORITY, NULL);
+    CHECK_EQ(status, pdPASS);
+    status = xTaskCreate(hog_task, "hog_task", 4096, NULL, HOG_PRIORITY, NULL);
+    CHECK_EQ(status, pdPASS);
+    // Up to the first cycle, every run starts when one is due
+    host_rtos_run_until(START_US + PERIOD_US);
+
+    test_nominal();
+    test_stage_overrun();
+    test_link_wait_nested();
+    test_deadline_miss();
+    test_jitter();
+    test_jitter_and_deadline();
+    printf("test_control_scheduler passed\n");
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <string.h>
+#include "host_test.h"
+#include "flight_record.h"
+
+// Decodes by hand from the layout in flight_recorder.h, the same way tools/read_flight_recorder.py does
+
+static uint16_t get_u16(const uint8_t* buf)
+{
+    return buf[0] | buf[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t* buf)
+{
+    return get_u16(buf) | (uint32_t)get_u16(&buf[2]) << 16;
+}
+
+static void test_sector_layout(void)
+{
+    static uint8_t sector[FLIGHT_RECORDER_SECTOR_SIZE];
+    const uint8_t control[] = { 0xAA, 0x01, 0x02, 0x03 };
+    const char* telematics = "{\"speed\":1}";
+    uint16_t used = FLIGHT_RECORDER_SECTOR_HEADER;
+
+    memset(sector, 0, sizeof(sector));
+    used += flight_record_put(&sector[used], 0x01020304, FLIGHT_RECORD_CONTROL, FLIGHT_TRANSPORT_LORA,
+                              control, sizeof(control));
+    used += flight_record_put(&sector[used], 70000, FLIGHT_RECORD_TELEMATICS, FLIGHT_TRANSPORT_UDP,
+                              (const uint8_t*)telematics, strlen(telematics));
+    CHECK_EQ(used, FLIGHT_RECORDER_SECTOR_HEADER + 2 * FLIGHT_RECORDER_RECORD_HEADER + sizeof(control) + strlen(telematics));
+    flight_record_finish_sector(sector, 0x80000001, used);
+
+    CHECK_EQ(get_u32(sector), FLIGHT_RECORDER_MAGIC);
+    CHECK(memcmp(sector, "FREC", 4) == 0);
+    CHECK_EQ(get_u32(&sector[4]), 0x80000001);
+    CHECK_EQ(get_u16(&sector[8]), used);
+    CHECK_EQ(sector[10], FLIGHT_RECORDER_VERSION);
+    CHECK_EQ(sector[11], 0);
+
+    const uint8_t* record = &sector[FLIGHT_RECORDER_SECTOR_HEADER];
+    CHECK_EQ(get_u32(record), 0x01020304);
+    CHECK_EQ(record[0], 0x04);
+    CHECK_EQ(record[4], FLIGHT_RECORD_CONTROL);
+    CHECK_EQ(record[5], FLIGHT_TRANSPORT_LORA);
+    CHECK_EQ(get_u16(&record[6]), sizeof(control));
+    CHECK(memcmp(&record[FLIGHT_RECORDER_RECORD_HEADER], control, sizeof(control)) == 0);
+
+    record += FLIGHT_RECORDER_RECORD_HEADER + sizeof(control);
+    CHECK_EQ(get_u32(record), 70000);
+    CHECK_EQ(record[4], FLIGHT_RECORD_TELEMATICS);
+    CHECK_EQ(record[5], FLIGHT_TRANSPORT_UDP);
+    CHECK_EQ(get_u16(&record[6]), strlen(telematics));
+    CHECK(memcmp(&record[FLIGHT_RECORDER_RECORD_HEADER], telematics, strlen(telematics)) == 0);
+
+    // The rest is left as erased flash
+    for (uint32_t i = used; i < FLIGHT_RECORDER_SECTOR_SIZE; i++) {
+        CHECK_EQ(sector[i], 0xFF);
+    }
+}
+
+static void test_full_sector(void)
+{
+    static uint8_t sector[FLIGHT_RECORDER_SECTOR_SIZE];
+    static uint8_t data[FLIGHT_RECORDER_SECTOR_SIZE];
+    uint16_t length = FLIGHT_RECORDER_SECTOR_SIZE - FLIGHT_RECORDER_SECTOR_HEADER - FLIGHT_RECORDER_RECORD_HEADER;
+
+    memset(data, 0x5A, sizeof(data));
+    uint16_t used = FLIGHT_RECORDER_SECTOR_HEADER +
+                    flight_record_put(&sector[FLIGHT_RECORDER_SECTOR_HEADER], 1, FLIGHT_RECORD_CONTROL,
+                                      FLIGHT_TRANSPORT_WS, data, length);
+    CHECK_EQ(used, FLIGHT_RECORDER_SECTOR_SIZE);
+    flight_record_finish_sector(sector, 7, used);
+    CHECK_EQ(get_u16(&sector[8]), FLIGHT_RECORDER_SECTOR_SIZE);
+    CHECK_EQ(sector[FLIGHT_RECORDER_SECTOR_SIZE - 1], 0x5A);
+}
+
+static void test_read_sector_header(void)
+{
+    uint8_t sector[FLIGHT_RECORDER_SECTOR_SIZE];
+    uint32_t sequence = 0;
+
+    memset(sector, 0xFF, sizeof(sector));
+    CHECK(!flight_record_read_sector_header(sector, &sequence));
+    memset(sector, 0, sizeof(sector));
+    CHECK(!flight_record_read_sector_header(sector, &sequence));
+
+    flight_record_finish_sector(sector, 0xFFFFFFFE, FLIGHT_RECORDER_SECTOR_HEADER);
+    CHECK(flight_record_read_sector_header(sector, &sequence));
+    CHECK_EQ(sequence, 0xFFFFFFFE);
+}
+
+int main(void)
+{
+    test_sector_layout();
+    test_full_sector();
+    test_read_sector_header();
+
+    return 0;
+}
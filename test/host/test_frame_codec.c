@@ -0,0 +1,218 @@
+#include <string.h>
+#include "host_test.h"
+#include "frame_codec.h"
+
+static void make_frame(frame_codec_frame_t* frame, uint16_t base)
+{
+    memset(frame, 0, sizeof(frame_codec_frame_t));
+    frame->num_channels = 4;
+    for (uint8_t i = 0; i < frame->num_channels; i++) {
+        frame->channels[i] = base + i * 100;
+    }
+    frame->num_switches = 1;
+    frame->switches[0] = FRAME_CODEC_SWITCH_UP;
+}
+
+static void check_same(const frame_codec_frame_t* a, const frame_codec_frame_t* b)
+{
+    CHECK_EQ(a->seq, b->seq);
+    CHECK_EQ(a->num_channels, b->num_channels);
+    CHECK_EQ(a->num_switches, b->num_switches);
+    for (uint8_t i = 0; i < a->num_channels; i++) {
+        CHECK_EQ(a->channels[i], b->channels[i]);
+    }
+    for (uint8_t i = 0; i < a->num_switches; i++) {
+        CHECK_EQ(a->switches[i], b->switches[i]);
+    }
+}
+
+static void test_full_round_trip(void)
+{
+    frame_codec_t tx, rx;
+    frame_codec_frame_t frame, decoded;
+    uint8_t buf[FRAME_CODEC_MAX_LEN];
+
+    frame_codec_init(&tx);
+    frame_codec_init(&rx);
+    make_frame(&frame, 1100);
+    uint16_t len = frame_codec_encode(&tx, &frame, buf, sizeof(buf));
+    // 3 header bytes, 4 * 10 + 2 bits packed in 6 bytes and the CRC
+    CHECK_EQ(len, 10);
+    CHECK_EQ(buf[0] & 0x0F, FRAME_CODEC_FULL);
+    CHECK(frame_codec_decode(&rx, buf, len, &decoded));
+    check_same(&frame, &decoded);
+}
+
+static void test_channels_clamped(void)
+{
+    frame_codec_t tx, rx;
+    frame_codec_frame_t frame, decoded;
+    uint8_t buf[FRAME_CODEC_MAX_LEN];
+
+    frame_codec_init(&tx);
+    frame_codec_init(&rx);
+    make_frame(&frame, 1500);
+    frame.channels[0] = 900;
+    frame.channels[1] = 2100;
+    uint16_t len = frame_codec_encode(&tx, &frame, buf, sizeof(buf));
+    CHECK(frame_codec_decode(&rx, buf, len, &decoded));
+    CHECK_EQ(decoded.channels[0], FRAME_CODEC_CHANNEL_MIN);
+    CHECK_EQ(decoded.channels[1], FRAME_CODEC_CHANNEL_MAX);
+}
+
+static void test_delta_after_ack(void)
+{
+    frame_codec_t tx, rx;
+    frame_codec_frame_t frame, decoded;
+    uint8_t buf[FRAME_CODEC_MAX_LEN];
+
+    frame_codec_init(&tx);
+    frame_codec_init(&rx);
+    make_frame(&frame, 1100);
+    uint16_t len = frame_codec_encode(&tx, &frame, buf, sizeof(buf));
+    CHECK(frame_codec_decode(&rx, buf, len, &decoded));
+    frame_codec_ack(&tx, frame.seq);
+
+    // Only channel 2 changed, 4 header bytes, 10 + 2 bits in 2 bytes and the CRC
+    make_frame(&frame, 1100);
+    frame.channels[2] = 1750;
+    len = frame_codec_encode(&tx, &frame, buf, sizeof(buf));
+    CHECK_EQ(buf[0] & 0x0F, FRAME_CODEC_DELTA);
+    CHECK_EQ(len, 7);
+    CHECK(frame_codec_decode(&rx, buf, len, &decoded));
+    check_same(&frame, &decoded);
+}
+
+static void test_full_frame_interval(void)
+{
+    frame_codec_t tx;
+    frame_codec_frame_t frame;
+    uint8_t buf[FRAME_CODEC_MAX_LEN];
+    int num_full = 0;
+
+    frame_codec_init(&tx);
+    for (int i = 0; i < 30; i++) {
+        make_frame(&frame, 1100);
+        frame_codec_encode(&tx, &frame, buf, sizeof(buf));
+        if ((buf[0] & 0x0F) == FRAME_CODEC_FULL) {
+            num_full++;
+        }
+        frame_codec_ack(&tx, frame.seq);
+    }
+    // The first frame and then one every FULL_INTERVAL + 1 frames
+    CHECK_EQ(num_full, 3);
+}
+
+static void test_corruption_rejected(void)
+{
+    frame_codec_t tx, rx;
+    frame_codec_frame_t frame, decoded;
+    uint8_t buf[FRAME_CODEC_MAX_LEN];
+
+    frame_codec_init(&tx);
+    frame_codec_init(&rx);
+    make_frame(&frame, 1100);
+    uint16_t len = frame_codec_encode(&tx, &frame, buf, sizeof(buf));
+    for (uint16_t i = 0; i < len; i++) {
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            buf[i] ^= 1 << bit;
+            CHECK(!frame_codec_decode(&rx, buf, len, &decoded));
+            buf[i] ^= 1 << bit;
+        }
+    }
+    CHECK(!frame_codec_decode(&rx, buf, len - 1, &decoded));
+    CHECK(!frame_codec_decode(&rx, buf, 3, &decoded));
+}
+
+static void test_delta_without_reference_rejected(void)
+{
+    frame_codec_t tx, rx;
+    frame_codec_frame_t frame, decoded;
+    uint8_t buf[FRAME_CODEC_MAX_LEN];
+
+    frame_codec_init(&tx);
+    frame_codec_init(&rx);
+    make_frame(&frame, 1100);
+    frame_codec_encode(&tx, &frame, buf, sizeof(buf));
+    frame_codec_ack(&tx, frame.seq);
+    // The receiver never saw the reference frame
+    make_frame(&frame, 1200);
+    uint16_t len = frame_codec_encode(&tx, &frame, buf, sizeof(buf));
+    CHECK_EQ(buf[0] & 0x0F, FRAME_CODEC_DELTA);
+    CHECK(!frame_codec_decode(&rx, buf, len, &decoded));
+}
+
+// Acks stop while frames keep going out, after the sequence number wrapped the old ack must not look recent again
+static void test_stale_ack_after_wrap(void)
+{
+    frame_codec_t tx, rx;
+    frame_codec_frame_t frame, decoded;
+    uint8_t buf[FRAME_CODEC_MAX_LEN];
+
+    frame_codec_init(&tx);
+    frame_codec_init(&rx);
+    make_frame(&frame, 1100);
+    uint16_t len = frame_codec_encode(&tx, &frame, buf, sizeof(buf));
+    CHECK(frame_codec_decode(&rx, buf, len, &decoded));
+    frame_codec_ack(&tx, frame.seq);
+
+    // The link goes down, nothing reaches the receiver and no acks come back
+    for (int i = 1; i < 300; i++) {
+        make_frame(&frame, 1100 + i % 200);
+        len = frame_codec_encode(&tx, &frame, buf, sizeof(buf));
+        CHECK(len > 0);
+        if (i >= FRAME_CODEC_HISTORY) {
+            CHECK_EQ(buf[0] & 0x0F, FRAME_CODEC_FULL);
+        }
+    }
+
+    // Back up, what the receiver gets decodes to what was sent
+    for (int i = 300; i < 320; i++) {
+        make_frame(&frame, 1100 + i % 200);
+        len = frame_codec_encode(&tx, &frame, buf, sizeof(buf));
+        CHECK(frame_codec_decode(&rx, buf, len, &decoded));
+        check_same(&frame, &decoded);
+        frame_codec_ack(&tx, frame.seq);
+    }
+    // And deltas are used again once acks come back
+    CHECK_EQ(buf[0] & 0x0F, FRAME_CODEC_DELTA);
+}
+
+static void test_buffer_too_small(void)
+{
+    frame_codec_t tx;
+    frame_codec_frame_t frame;
+    uint8_t buf[FRAME_CODEC_MAX_LEN];
+
+    frame_codec_init(&tx);
+    make_frame(&frame, 1100);
+    CHECK_EQ(frame_codec_encode(&tx, &frame, buf, 9), 0);
+}
+
+static void test_ack(void)
+{
+    uint8_t buf[FRAME_CODEC_ACK_LEN];
+    uint8_t seq;
+
+    CHECK_EQ(frame_codec_encode_ack(42, buf, sizeof(buf)), FRAME_CODEC_ACK_LEN);
+    CHECK(frame_codec_parse_ack(buf, sizeof(buf), &seq));
+    CHECK_EQ(seq, 42);
+    buf[1] ^= 1;
+    CHECK(!frame_codec_parse_ack(buf, sizeof(buf), &seq));
+    CHECK_EQ(frame_codec_encode_ack(42, buf, 2), 0);
+}
+
+int main(void)
+{
+    test_full_round_trip();
+    test_channels_clamped();
+    test_delta_after_ack();
+    test_full_frame_interval();
+    test_corruption_rejected();
+    test_delta_without_reference_rejected();
+    test_stale_ack_after_wrap();
+    test_buffer_too_small();
+    test_ack();
+    printf("test_frame_codec passed\n");
+    return 0;
+}
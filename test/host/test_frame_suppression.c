@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "replay_hw.h"
+#include "controller_sample.h"
+#include "rover_controller.h"
+#include "rover_payload.h"
+#include "link_manager.h"
+#include "latency_probe.h"
+
+/*
+ * Input traces through controller_input and rover_controller on simulated time, like the
+ * replay does, checking which control periods send a frame and which are suppressed: inputs
+ * inside the deadband only send the keepalive, moving sticks send every period.
+ */
+
+#define START_US                1000000LL
+#define PERIOD_MS               100     // ADC_SAMPLE_DELAY in rover_controller.c
+#define KEEPALIVE_MS            250     // KEEPALIVE_INTERVAL_MS in rover_controller.c
+#define STICK_DEADBAND          8       // STICK_DEADBAND in rover_controller.c
+#define ROW_MS                  10
+#define ADC_REST                2048
+#define MAX_FRAMES              256
+
+typedef struct frame_t {
+    int64_t     time_us;
+    uint16_t    channels[ROVER_PAYLOAD_CHANNELS];
+} frame_t;
+
+typedef int32_t stick_trace_t(int64_t time_ms, uint32_t* seed);
+
+static frame_t frames[MAX_FRAMES];
+static uint32_t num_frames;
+
+static void on_frame(replay_transport_t transport, const uint8_t* data, uint16_t length)
+{
+    CHECK_EQ(transport, REPLAY_TRANSPORT_LORA);
+    CHECK_EQ(length, ROVER_PAYLOAD_LEN);
+    CHECK(num_frames < MAX_FRAMES);
+    frames[num_frames].time_us = esp_timer_get_time();
+    memcpy(frames[num_frames].channels, data, ROVER_PAYLOAD_LEN);
+    num_frames++;
+}
+
+// ADC noise of a stick at rest, a few LSB either way, same sequence every run
+static int32_t noise(uint32_t* seed, int32_t amplitude)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (int32_t)((*seed >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+// About 5 payload units of noise, inside the deadband
+static int32_t rest(int64_t time_ms, uint32_t* seed)
+{
+    return ADC_REST + noise(seed, 20);
+}
+
+// Full range triangle in 2 s, about 100 payload units per period
+static int32_t sweep(int64_t time_ms, uint32_t* seed)
+{
+    int64_t phase = time_ms % 2000;
+    int32_t raw = phase < 1000 ? phase * 4 : (2000 - phase) * 4;
+    return raw > 4095 ? 4095 : raw;
+}
+
+// Creeps about 1 payload unit per period, the deadband is crossed every few periods
+static int32_t drift(int64_t time_ms, uint32_t* seed)
+{
+    return ADC_REST + time_ms / 25 + noise(seed, 2);
+}
+
+// Plays the stick trace on the right stick X for duration_ms, returns the stats of that part
+static void play(stick_trace_t* trace, int64_t duration_ms, rover_controller_stats_t* result)
+{
+    rover_controller_stats_t before, after;
+    int64_t start_us = esp_timer_get_time();
+    uint32_t seed = 1;
+
+    num_frames = 0;
+    rover_controller_get_stats(&before);
+    for (int64_t time_ms = 0; time_ms < duration_ms; time_ms += ROW_MS) {
+        replay_hw_set_adc(INPUT_RIGHT_JOYSTICK_X, trace(time_ms, &seed));
+        host_rtos_run_until(start_us + (time_ms + ROW_MS) * 1000);
+    }
+    rover_controller_get_stats(&after);
+    result->frames_sent = after.frames_sent - before.frames_sent;
+    result->frames_suppressed = after.frames_suppressed - before.frames_suppressed;
+    CHECK_EQ(result->frames_sent, num_frames);
+}
+
+static int max_change(const frame_t* a, const frame_t* b)
+{
+    int max = 0;
+    for (uint8_t i = 0; i < ROVER_PAYLOAD_CHANNELS; i++) {
+        int change = abs((int)a->channels[i] - (int)b->channels[i]);
+        max = change > max ? change : max;
+    }
+    return max;
+}
+
+static void print_result(const char* name, const rover_controller_stats_t* result)
+{
+    printf("%-10s %3u sent, %3u suppressed\n", name, result->frames_sent, result->frames_suppressed);
+}
+
+// Only the keepalive goes out, every third period as that is the first one past KEEPALIVE_MS
+static void test_rest_sends_keepalive(void)
+{
+    rover_controller_stats_t result;
+    const int64_t duration_ms = 9000;
+
+    play(rest, duration_ms, &result);
+    print_result("rest", &result);
+    CHECK_EQ(result.frames_sent + result.frames_suppressed, duration_ms / PERIOD_MS);
+    CHECK_EQ(result.frames_sent, duration_ms / (3 * PERIOD_MS));
+    for (uint32_t i = 1; i < num_frames; i++) {
+        CHECK_EQ(frames[i].time_us - frames[i - 1].time_us, 3 * PERIOD_MS * 1000);
+        CHECK(max_change(&frames[i], &frames[i - 1]) <= STICK_DEADBAND);
+    }
+}
+
+static void test_sweep_sends_every_period(void)
+{
+    rover_controller_stats_t result;
+    const int64_t duration_ms = 4000;
+
+    play(sweep, duration_ms, &result);
+    print_result("sweep", &result);
+    // The turns of the triangle may stay inside the deadband for a period
+    CHECK(result.frames_suppressed <= 4);
+    CHECK_EQ(result.frames_sent + result.frames_suppressed, duration_ms / PERIOD_MS);
+}
+
+// Each frame either moved past the deadband since the last one or is a keepalive
+static void test_drift_sends_past_deadband(void)
+{
+    rover_controller_stats_t result;
+    const int64_t duration_ms = 6000;
+
+    play(drift, duration_ms, &result);
+    print_result("drift", &result);
+    CHECK(result.frames_sent > duration_ms / (3 * PERIOD_MS));
+    CHECK(result.frames_suppressed > 0);
+    for (uint32_t i = 1; i < num_frames; i++) {
+        int64_t gap_us = frames[i].time_us - frames[i - 1].time_us;
+        CHECK(max_change(&frames[i], &frames[i - 1]) > STICK_DEADBAND || gap_us >= KEEPALIVE_MS * 1000);
+        CHECK(gap_us <= 3 * PERIOD_MS * 1000);
+    }
+}
+
+// Without a deadband the noise alone sends most periods
+static void test_no_deadband(void)
+{
+    rover_controller_stats_t with_deadband, without_deadband;
+    const int64_t duration_ms = 3000;
+
+    play(rest, duration_ms, &with_deadband);
+    rover_controller_set_deadband(0, 0);
+    play(rest, duration_ms, &without_deadband);
+    rover_controller_set_deadband(0, STICK_DEADBAND);
+    print_result("deadband 0", &without_deadband);
+    CHECK(without_deadband.frames_sent > 2 * with_deadband.frames_sent);
+}
+
+int main(void)
+{
+    rover_controller_stats_t settle;
+
+    // Same order as app_main, switches in the middle keep everything on LoRa without WiFi links
+    host_timer_set_us(START_US);
+    for (uint8_t i = 0; i < INPUT_ANALOG_END; i++) {
+        replay_hw_set_adc(i, ADC_REST);
+    }
+    link_manager_init();
+    latency_probe_init();
+    replay_hw_register_on_frame(&on_frame);
+    rover_controller_init();
+    // Let the filters settle on the rest position
+    play(rest, 2000, &settle);
+
+    test_rest_sends_keepalive();
+    test_sweep_sends_every_period();
+    test_drift_sends_past_deadband();
+    test_no_deadband();
+    printf("test_frame_suppression passed\n");
+    return 0;
+}
@@ -0,0 +1,302 @@
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "host_test.h"
+#include "input_filter.h"
+
+#define PERIOD_S            0.1f
+#define PERIOD_MS           100
+#define BENCH_SAMPLES       1000000
+#define MAX_TRACE_ROWS      1024
+#define MAX_LINE_LEN        512
+#define REST_END_MS         4000    // Sticks of switch_flips are at rest until then
+#define SETTLE_PERIODS      5
+#define MAX_LAG_MS          400
+
+typedef struct filter_case_t {
+    const char*             name;
+    input_filter_config_t   config;
+} filter_case_t;
+
+// A column of a replay trace, rows every few ms
+typedef struct trace_column_t {
+    int64_t     time_ms[MAX_TRACE_ROWS];
+    float       value[MAX_TRACE_ROWS];
+    size_t      num_rows;
+} trace_column_t;
+
+// JOYSTICK_FILTER in controller_input.c last, the others for comparison
+static const filter_case_t filter_cases[] = {
+    { "none",       { .type = INPUT_FILTER_NONE } },
+    { "ema 1/2",    { .type = INPUT_FILTER_EMA, .ema_shift = 1 } },
+    { "ema 1/4",    { .type = INPUT_FILTER_EMA, .ema_shift = 2 } },
+    { "median 3",   { .type = INPUT_FILTER_MEDIAN, .median_len = 3 } },
+    { "median 5",   { .type = INPUT_FILTER_MEDIAN, .median_len = 5 } },
+    { "one euro",   { .type = INPUT_FILTER_ONE_EURO, .min_cutoff_hz = 5.0f, .beta = 0.01f, .d_cutoff_hz = 1.0f } },
+};
+#define NUM_FILTER_CASES    (sizeof(filter_cases) / sizeof(filter_cases[0]))
+#define ONE_EURO_CASE       (NUM_FILTER_CASES - 1)
+
+static void test_none_passes_through(void)
+{
+    input_filter_config_t config = { .type = INPUT_FILTER_NONE };
+    input_filter_t filter;
+
+    input_filter_init(&filter, &config);
+    CHECK_EQ(input_filter_apply(&filter, 1234, PERIOD_S), 1234);
+    CHECK_EQ(input_filter_apply(&filter, 17, PERIOD_S), 17);
+    CHECK(input_filter_group_delay_ms(&filter, 100) == 0);
+}
+
+static void test_ema_step(void)
+{
+    input_filter_config_t config = { .type = INPUT_FILTER_EMA, .ema_shift = 1 };
+    input_filter_t filter;
+
+    input_filter_init(&filter, &config);
+    // Starts at the first value instead of ramping up from 0
+    CHECK_EQ(input_filter_apply(&filter, 1000, PERIOD_S), 1000);
+    CHECK_EQ(input_filter_apply(&filter, 2000, PERIOD_S), 1500);
+    CHECK_EQ(input_filter_apply(&filter, 2000, PERIOD_S), 1750);
+    for (int i = 0; i < 20; i++) {
+        input_filter_apply(&filter, 2000, PERIOD_S);
+    }
+    CHECK_EQ(input_filter_apply(&filter, 2000, PERIOD_S), 2000);
+    CHECK(fabsf(input_filter_group_delay_ms(&filter, 100) - 100.0f) < 0.01f);
+}
+
+static void test_median_removes_spike(void)
+{
+    input_filter_config_t config = { .type = INPUT_FILTER_MEDIAN, .median_len = 3 };
+    input_filter_t filter;
+
+    input_filter_init(&filter, &config);
+    input_filter_apply(&filter, 500, PERIOD_S);
+    input_filter_apply(&filter, 500, PERIOD_S);
+    CHECK_EQ(input_filter_apply(&filter, 4000, PERIOD_S), 500);
+    CHECK_EQ(input_filter_apply(&filter, 500, PERIOD_S), 500);
+    CHECK_EQ(input_filter_apply(&filter, 500, PERIOD_S), 500);
+    // A real step gets through after half the window
+    CHECK_EQ(input_filter_apply(&filter, 900, PERIOD_S), 500);
+    CHECK_EQ(input_filter_apply(&filter, 900, PERIOD_S), 900);
+    CHECK(fabsf(input_filter_group_delay_ms(&filter, 100) - 100.0f) < 0.01f);
+}
+
+static void test_one_euro_smooth_at_rest_fast_when_moving(void)
+{
+    input_filter_config_t config = { .type = INPUT_FILTER_ONE_EURO, .min_cutoff_hz = 5.0f, .beta = 0.01f, .d_cutoff_hz = 1.0f };
+    input_filter_t filter;
+
+    input_filter_init(&filter, &config);
+    input_filter_apply(&filter, 2048, PERIOD_S);
+    // Small jitter at rest is damped
+    uint16_t out = input_filter_apply(&filter, 2058, PERIOD_S);
+    CHECK(out > 2048 && out < 2058);
+
+    // A full stick throw is followed closely
+    input_filter_init(&filter, &config);
+    input_filter_apply(&filter, 0, PERIOD_S);
+    input_filter_apply(&filter, 4000, PERIOD_S);
+    out = input_filter_apply(&filter, 4000, PERIOD_S);
+    CHECK(out > 3900);
+}
+
+static void test_one_euro_delay_at_rest(void)
+{
+    input_filter_config_t config = { .type = INPUT_FILTER_ONE_EURO, .min_cutoff_hz = 5.0f, .beta = 0.01f, .d_cutoff_hz = 1.0f };
+    input_filter_t filter;
+
+    input_filter_init(&filter, &config);
+    float delay_ms = input_filter_group_delay_ms(&filter, 100);
+    CHECK(delay_ms > 31.0f && delay_ms < 33.0f);
+}
+
+static double cpu_time_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+static uint64_t cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Cost of one sample on the host, a moving stick with noise so the median has to sort
+static void bench_filters(void)
+{
+    volatile uint16_t sink = 0;
+
+    for (size_t c = 0; c < NUM_FILTER_CASES; c++) {
+        input_filter_t filter;
+        uint32_t seed = 1;
+
+        input_filter_init(&filter, &filter_cases[c].config);
+        double start_ns = cpu_time_ns();
+        uint64_t start_cycles = cycles();
+        for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+            seed = seed * 1103515245 + 12345;
+            uint16_t value = 2048 + (i % 2000) - 1000 + ((seed >> 16) & 0x0F);
+            sink = input_filter_apply(&filter, value, PERIOD_S);
+        }
+        double cycles_per_sample = (double)(cycles() - start_cycles) / BENCH_SAMPLES;
+        double ns_per_sample = (cpu_time_ns() - start_ns) / BENCH_SAMPLES;
+        printf("%-10s %6.1f cycles/sample %6.1f ns/sample\n", filter_cases[c].name, cycles_per_sample, ns_per_sample);
+    }
+    (void)sink;
+}
+
+static void load_trace_column(const char* path, const char* name, trace_column_t* column)
+{
+    char line[MAX_LINE_LEN];
+    int index = -1;
+    FILE* file = fopen(path, "r");
+
+    CHECK(file != NULL);
+    column->num_rows = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        char* save;
+        char* field = strtok_r(line, ",", &save);
+        if (index < 0) {
+            for (int i = 1; (field = strtok_r(NULL, ",", &save)) != NULL; i++) {
+                if (strcmp(field, name) == 0) {
+                    index = i;
+                }
+            }
+            CHECK(index > 0);
+            continue;
+        }
+        CHECK(column->num_rows < MAX_TRACE_ROWS);
+        column->time_ms[column->num_rows] = strtoll(field, NULL, 10);
+        for (int i = 1; i <= index; i++) {
+            field = strtok_r(NULL, ",", &save);
+            CHECK(field != NULL);
+        }
+        column->value[column->num_rows] = strtof(field, NULL);
+        column->num_rows++;
+    }
+    fclose(file);
+}
+
+// The input at any time, linear between the rows
+static float trace_at(const trace_column_t* column, float time_ms)
+{
+    if (time_ms <= column->time_ms[0]) {
+        return column->value[0];
+    }
+    for (size_t i = 1; i < column->num_rows; i++) {
+        if (time_ms <= column->time_ms[i]) {
+            float t = (time_ms - column->time_ms[i - 1]) / (column->time_ms[i] - column->time_ms[i - 1]);
+            return column->value[i - 1] + t * (column->value[i] - column->value[i - 1]);
+        }
+    }
+    return column->value[column->num_rows - 1];
+}
+
+// Runs the filter once per control period like controller_input, returns the number of outputs
+static size_t filter_trace(const filter_case_t* filter_case, const trace_column_t* column, int64_t end_ms, float* out)
+{
+    input_filter_t filter;
+    size_t n = 0;
+
+    input_filter_init(&filter, &filter_case->config);
+    for (int64_t t = 0; t <= end_ms; t += PERIOD_MS) {
+        out[n++] = input_filter_apply(&filter, (uint16_t)lroundf(trace_at(column, t)), PERIOD_S);
+    }
+    return n;
+}
+
+// Standard deviation of the output with the stick at rest
+static float rest_jitter(const filter_case_t* filter_case, const trace_column_t* rest)
+{
+    float out[MAX_TRACE_ROWS];
+    size_t n = filter_trace(filter_case, rest, REST_END_MS - PERIOD_MS, out);
+    float sum = 0, sum_sq = 0;
+
+    for (size_t i = SETTLE_PERIODS; i < n; i++) {
+        sum += out[i];
+        sum_sq += out[i] * out[i];
+    }
+    float mean = sum / (n - SETTLE_PERIODS);
+    return sqrtf(sum_sq / (n - SETTLE_PERIODS) - mean * mean);
+}
+
+// How far the output lags behind a moving stick: the shift of the input that fits the output best
+static float sweep_lag_ms(const filter_case_t* filter_case, const trace_column_t* sweep, float* rms_error)
+{
+    float out[MAX_TRACE_ROWS];
+    int64_t end_ms = sweep->time_ms[sweep->num_rows - 1];
+    size_t n = filter_trace(filter_case, sweep, end_ms, out);
+    float best_lag_ms = 0;
+
+    *rms_error = INFINITY;
+    for (int lag_ms = 0; lag_ms <= MAX_LAG_MS; lag_ms++) {
+        float sum_sq = 0;
+        for (size_t i = SETTLE_PERIODS; i < n; i++) {
+            float error = out[i] - trace_at(sweep, (float)i * PERIOD_MS - lag_ms);
+            sum_sq += error * error;
+        }
+        float rms = sqrtf(sum_sq / (n - SETTLE_PERIODS));
+        if (rms < *rms_error) {
+            *rms_error = rms;
+            best_lag_ms = lag_ms;
+        }
+    }
+    return best_lag_ms;
+}
+
+// Jitter at rest from switch_flips and lag behind the sweep of stick_sweep, the recorded traces of the replay
+static void test_traces(void)
+{
+    static trace_column_t rest, sweep;
+    float jitter[NUM_FILTER_CASES];
+    float lag_ms[NUM_FILTER_CASES];
+
+    load_trace_column(TRACES_DIR "/switch_flips.csv", "right_x", &rest);
+    load_trace_column(TRACES_DIR "/stick_sweep.csv", "right_x", &sweep);
+    for (size_t c = 0; c < NUM_FILTER_CASES; c++) {
+        input_filter_t filter;
+        float rms_error;
+
+        input_filter_init(&filter, &filter_cases[c].config);
+        jitter[c] = rest_jitter(&filter_cases[c], &rest);
+        lag_ms[c] = sweep_lag_ms(&filter_cases[c], &sweep, &rms_error);
+        printf("%-10s jitter at rest %4.2f LSB, lag on the sweep %3.0f ms (%5.1f LSB rms off), delay at rest %3.0f ms\n",
+               filter_cases[c].name, jitter[c], lag_ms[c], rms_error, input_filter_group_delay_ms(&filter, PERIOD_MS));
+    }
+
+    // The one euro filter damps the noise at rest and lags less on the move than at rest
+    input_filter_t one_euro;
+    input_filter_init(&one_euro, &filter_cases[ONE_EURO_CASE].config);
+    CHECK(jitter[ONE_EURO_CASE] < jitter[0]);
+    CHECK(lag_ms[ONE_EURO_CASE] < input_filter_group_delay_ms(&one_euro, PERIOD_MS));
+    // Where the EMAs and medians lag a period or more
+    for (size_t c = 1; c < ONE_EURO_CASE; c++) {
+        CHECK(lag_ms[ONE_EURO_CASE] < lag_ms[c]);
+    }
+}
+
+int main(void)
+{
+    test_none_passes_through();
+    test_ema_step();
+    test_median_removes_spike();
+    test_one_euro_smooth_at_rest_fast_when_moving();
+    test_one_euro_delay_at_rest();
+    test_traces();
+    bench_filters();
+    printf("test_input_filter passed\n");
+    return 0;
+}
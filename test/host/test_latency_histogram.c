@@ -0,0 +1,77 @@
+#include "host_test.h"
+#include "latency_histogram.h"
+
+#define LAST_OCTAVE_END_US  (LATENCY_HISTOGRAM_MIN_US << LATENCY_HISTOGRAM_OCTAVES)
+
+static void test_bucket_edges(void)
+{
+    CHECK_EQ(latency_histogram_bucket(0), 0);
+    CHECK_EQ(latency_histogram_bucket(LATENCY_HISTOGRAM_MIN_US - 1), 0);
+    CHECK_EQ(latency_histogram_bucket(LATENCY_HISTOGRAM_MIN_US), 1);
+    CHECK_EQ(latency_histogram_bucket_upper_us(0), LATENCY_HISTOGRAM_MIN_US);
+    CHECK_EQ(latency_histogram_bucket_upper_us(1), 80);
+
+    // Every bucket ends where the next one starts
+    for (uint8_t i = 1; i < LATENCY_HISTOGRAM_OVERFLOW; i++) {
+        uint32_t upper = latency_histogram_bucket_upper_us(i);
+        CHECK_EQ(latency_histogram_bucket(upper - 1), i);
+        CHECK_EQ(latency_histogram_bucket(upper), i + 1);
+    }
+}
+
+static void test_overflow_bucket(void)
+{
+    CHECK_EQ(LATENCY_HISTOGRAM_OVERFLOW, LATENCY_HISTOGRAM_BUCKETS - 1);
+    CHECK_EQ(latency_histogram_bucket(LAST_OCTAVE_END_US - 1), LATENCY_HISTOGRAM_OVERFLOW - 1);
+    CHECK_EQ(latency_histogram_bucket_upper_us(LATENCY_HISTOGRAM_OVERFLOW - 1), LAST_OCTAVE_END_US);
+    CHECK_EQ(latency_histogram_bucket(LAST_OCTAVE_END_US), LATENCY_HISTOGRAM_OVERFLOW);
+    CHECK_EQ(latency_histogram_bucket(UINT32_MAX), LATENCY_HISTOGRAM_OVERFLOW);
+    CHECK_EQ(latency_histogram_bucket_upper_us(LATENCY_HISTOGRAM_OVERFLOW), UINT32_MAX);
+}
+
+static void test_percentiles(void)
+{
+    latency_histogram_t histogram;
+
+    latency_histogram_init(&histogram);
+    CHECK_EQ(latency_histogram_percentile(&histogram, 50), 0);
+    CHECK_EQ(latency_histogram_mean(&histogram), 0);
+
+    for (int i = 0; i < 99; i++) {
+        latency_histogram_record(&histogram, 1000);
+    }
+    latency_histogram_record(&histogram, 10000);
+    CHECK_EQ(histogram.count, 100);
+    CHECK_EQ(histogram.min_us, 1000);
+    CHECK_EQ(histogram.max_us, 10000);
+    CHECK_EQ(latency_histogram_mean(&histogram), 1090);
+    // Upper bound of the bucket, 1000 is in [896, 1024)
+    CHECK_EQ(latency_histogram_percentile(&histogram, 0), 1024);
+    CHECK_EQ(latency_histogram_percentile(&histogram, 50), 1024);
+    CHECK_EQ(latency_histogram_percentile(&histogram, 99), 1024);
+    // Capped by the largest value
+    CHECK_EQ(latency_histogram_percentile(&histogram, 100), 10000);
+}
+
+static void test_overflow_not_mixed_with_last_octave(void)
+{
+    latency_histogram_t histogram;
+
+    latency_histogram_init(&histogram);
+    latency_histogram_record(&histogram, LAST_OCTAVE_END_US - 100000);
+    latency_histogram_record(&histogram, 2 * LAST_OCTAVE_END_US);
+    CHECK_EQ(histogram.buckets[LATENCY_HISTOGRAM_OVERFLOW - 1], 1);
+    CHECK_EQ(histogram.buckets[LATENCY_HISTOGRAM_OVERFLOW], 1);
+    CHECK_EQ(latency_histogram_percentile(&histogram, 50), LAST_OCTAVE_END_US);
+    CHECK_EQ(latency_histogram_percentile(&histogram, 100), 2 * LAST_OCTAVE_END_US);
+}
+
+int main(void)
+{
+    test_bucket_edges();
+    test_overflow_bucket();
+    test_percentiles();
+    test_overflow_not_mixed_with_last_octave();
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "host_test.h"
+#include "esp_timer.h"
+#include "latency_probe.h"
+
+/*
+ * The LoRa transport's calls for frames that are sent, replaced by a profile switch frame or
+ * dropped: a TxDone is only booked against the frame that was actually on air.
+ */
+
+static latency_trace_t trace_at(int64_t sampled_us)
+{
+    return (latency_trace_t){ .sampled_us = sampled_us, .filtered_us = sampled_us, .encoded_us = sampled_us };
+}
+
+static uint32_t on_air_count(void)
+{
+    latency_histogram_t histogram;
+
+    latency_probe_get(LATENCY_LINK_LORA, LATENCY_STAGE_ON_AIR, &histogram);
+    return histogram.count;
+}
+
+static void test_sent(void)
+{
+    latency_histogram_t histogram;
+    latency_trace_t trace = trace_at(1000);
+
+    host_timer_set_us(2000);
+    latency_probe_enqueue(LATENCY_LINK_LORA, &trace, 1);
+    latency_probe_tx_started(LATENCY_LINK_LORA);
+    host_timer_set_us(30000);
+    latency_probe_on_air(LATENCY_LINK_LORA);
+    latency_probe_get(LATENCY_LINK_LORA, LATENCY_STAGE_ON_AIR, &histogram);
+    CHECK_EQ(histogram.count, 1);
+    CHECK_EQ(histogram.max_us, 29000);
+    // TxDone once per transmission
+    latency_probe_on_air(LATENCY_LINK_LORA);
+    CHECK_EQ(on_air_count(), 1);
+}
+
+// A profile switch frame takes the slot, its TxDone is not the frame's and the next untraced frame isn't either
+static void test_replaced_by_switch(void)
+{
+    latency_trace_t trace = trace_at(100000);
+    uint32_t count = on_air_count();
+
+    host_timer_set_us(101000);
+    latency_probe_enqueue(LATENCY_LINK_LORA, &trace, 2);
+    latency_probe_tx_dropped(LATENCY_LINK_LORA);
+    latency_probe_tx_started(LATENCY_LINK_LORA);
+    host_timer_set_us(130000);
+    latency_probe_on_air(LATENCY_LINK_LORA);
+    CHECK_EQ(on_air_count(), count);
+
+    // A keepalive after it
+    latency_probe_tx_started(LATENCY_LINK_LORA);
+    latency_probe_on_air(LATENCY_LINK_LORA);
+    CHECK_EQ(on_air_count(), count);
+}
+
+// Dropped while the previous frame was still on air, that one's TxDone still counts
+static void test_dropped_while_on_air(void)
+{
+    latency_histogram_t histogram;
+    latency_trace_t first = trace_at(200000), second = trace_at(300000);
+    uint32_t count = on_air_count();
+
+    host_timer_set_us(201000);
+    latency_probe_enqueue(LATENCY_LINK_LORA, &first, 3);
+    latency_probe_tx_started(LATENCY_LINK_LORA);
+    host_timer_set_us(301000);
+    latency_probe_enqueue(LATENCY_LINK_LORA, &second, 4);
+    latency_probe_tx_dropped(LATENCY_LINK_LORA);
+    host_timer_set_us(350000);
+    latency_probe_on_air(LATENCY_LINK_LORA);
+    latency_probe_get(LATENCY_LINK_LORA, LATENCY_STAGE_ON_AIR, &histogram);
+    CHECK_EQ(histogram.count, count + 1);
+    CHECK_EQ(histogram.max_us, 150000);
+
+    // The next untraced transmission isn't booked against the dropped frame
+    latency_probe_tx_started(LATENCY_LINK_LORA);
+    latency_probe_on_air(LATENCY_LINK_LORA);
+    CHECK_EQ(on_air_count(), count + 1);
+}
+
+int main(void)
+{
+    latency_probe_init();
+
+    test_sent();
+    test_replaced_by_switch();
+    test_dropped_while_on_air();
+    printf("test_latency_probe passed\n");
+    return 0;
+}
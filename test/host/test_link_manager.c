@@ -0,0 +1,126 @@
+#include "host_test.h"
+#include "esp_timer.h"
+#include "link_manager.h"
+#include "metrics.h"
+
+#define MS  1000LL
+
+// Rover telematics on both links and a control frame every 100 ms for the given time, returns the last link used
+static link_t ws_traffic(int64_t duration_ms)
+{
+    link_t link = LINK_LORA;
+
+    for (int64_t t = 0; t < duration_ms; t += 100) {
+        link_manager_on_ws_data();
+        link_manager_on_lora_packet(-80, 5.0f);
+        link = link_manager_select();
+        if (link == LINK_WIFI) {
+            link_manager_on_ws_send(true, 2000);
+        }
+        host_timer_advance_us(100 * MS);
+    }
+    return link;
+}
+
+static link_t udp_traffic(int64_t duration_ms)
+{
+    link_t link = LINK_LORA;
+
+    for (int64_t t = 0; t < duration_ms; t += 100) {
+        link_manager_on_udp_data();
+        link_manager_on_lora_packet(-80, 5.0f);
+        link = link_manager_select();
+        host_timer_advance_us(100 * MS);
+    }
+    return link;
+}
+
+static void setup(void)
+{
+    host_timer_set_us(1000 * MS);
+    link_manager_init();
+}
+
+static void test_starts_on_lora(void)
+{
+    setup();
+    CHECK_EQ(link_manager_select(), LINK_LORA);
+    CHECK_EQ(metrics_get(METRIC_ACTIVE_LINK), LINK_LORA);
+}
+
+static void test_wifi_after_hold_time(void)
+{
+    setup();
+    // LoRa is fine, so WiFi has to prove itself for 2 s first
+    CHECK_EQ(ws_traffic(1900), LINK_LORA);
+    CHECK_EQ(ws_traffic(300), LINK_WIFI);
+}
+
+static void test_wifi_right_away_without_lora(void)
+{
+    setup();
+    link_manager_on_ws_data();
+    CHECK_EQ(link_manager_select(), LINK_WIFI);
+}
+
+static void test_stale_websocket_fails_over(void)
+{
+    link_stats_t stats;
+
+    setup();
+    link_manager_on_ws_data();
+    CHECK_EQ(link_manager_select(), LINK_WIFI);
+    host_timer_advance_us(450 * MS);
+    CHECK_EQ(link_manager_select(), LINK_LORA);
+    link_manager_get_stats(&stats);
+    CHECK_EQ(stats.handovers, 2);
+    CHECK(!stats.ws_healthy);
+}
+
+static void test_send_loss_fails_over(void)
+{
+    setup();
+    link_manager_on_ws_data();
+    CHECK_EQ(link_manager_select(), LINK_WIFI);
+    for (int i = 0; i < 5; i++) {
+        link_manager_on_ws_send(false, 20000);
+    }
+    CHECK_EQ(link_manager_select(), LINK_LORA);
+}
+
+static void test_udp_only_rover_uses_wifi(void)
+{
+    link_stats_t stats;
+
+    setup();
+    CHECK_EQ(udp_traffic(2200), LINK_WIFI);
+    link_manager_get_stats(&stats);
+    CHECK_EQ(stats.udp_staleness_ms, 100);
+    CHECK_EQ(stats.ws_staleness_ms, UINT32_MAX);
+
+    host_timer_advance_us(450 * MS);
+    CHECK_EQ(link_manager_select(), LINK_LORA);
+}
+
+static void test_forced_modes(void)
+{
+    setup();
+    link_manager_set_mode(LINK_MODE_FORCE_WIFI);
+    CHECK_EQ(link_manager_select(), LINK_WIFI);
+    link_manager_set_mode(LINK_MODE_FORCE_LORA);
+    link_manager_on_ws_data();
+    CHECK_EQ(link_manager_select(), LINK_LORA);
+}
+
+int main(void)
+{
+    test_starts_on_lora();
+    test_wifi_after_hold_time();
+    test_wifi_right_away_without_lora();
+    test_stale_websocket_fails_over();
+    test_send_loss_fails_over();
+    test_udp_only_rover_uses_wifi();
+    test_forced_modes();
+    printf("test_link_manager passed\n");
+    return 0;
+}
@@ -0,0 +1,223 @@
+#include <math.h>
+#include "host_test.h"
+#include "lora_adr.h"
+
+#define PREAMBLE_LENGTH     8
+#define TX_POWER_DBM        17
+#define NOISE_FIGURE_DB     6.0f
+#define LOSS_STEP_DB        0.1f    // Path loss change per packet in the link simulation
+
+typedef struct airtime_case_t {
+    uint8_t     spreading_factor;
+    uint32_t    bandwidth;
+    uint8_t     coding_rate;
+    uint16_t    payload_len;
+    bool        explicit_header;
+    bool        crc;
+    uint32_t    expected_us;
+} airtime_case_t;
+
+// Worked out from the SX1276 datasheet formula, the explicit header ones match the Semtech LoRa calculator
+static const airtime_case_t airtime_cases[] = {
+    { 7,  125000, 5, 12,  true,  true,  41216 },
+    { 7,  125000, 5, 100, true,  true,  174336 },
+    { 7,  500000, 8, 12,  false, false, 11328 },
+    { 9,  125000, 6, 51,  false, true,  353280 },
+    { 10, 250000, 7, 3,   true,  false, 111616 },
+    // Low data rate optimization kicks in from SF11/125k on
+    { 11, 125000, 5, 12,  true,  true,  577536 },
+    { 12, 125000, 5, 12,  true,  true,  1155072 },
+    { 12, 500000, 8, 255, true,  true,  2983936 },
+};
+
+// Time on air straight from the datasheet, in floating point
+static double semtech_time_on_air_us(const lora_profile_t* profile, uint16_t payload_len, bool explicit_header, bool crc)
+{
+    double symbol_s = pow(2, profile->spreading_factor) / profile->bandwidth;
+    int de = symbol_s > 0.016 ? 1 : 0;
+    int ih = explicit_header ? 0 : 1;
+    double blocks = ceil((8.0 * payload_len - 4 * profile->spreading_factor + 28 + 16 * crc - 20 * ih) /
+                         (4 * (profile->spreading_factor - 2 * de)));
+    double payload_symbols = 8 + fmax(blocks * profile->coding_rate, 0);
+
+    return (PREAMBLE_LENGTH + 4.25 + payload_symbols) * symbol_s * 1e6;
+}
+
+static void test_time_on_air_cases(void)
+{
+    for (size_t i = 0; i < sizeof(airtime_cases) / sizeof(airtime_cases[0]); i++) {
+        const airtime_case_t* c = &airtime_cases[i];
+        lora_profile_t profile = { .spreading_factor = c->spreading_factor, .bandwidth = c->bandwidth,
+                                   .coding_rate = c->coding_rate };
+        CHECK_EQ(lora_packet_time_on_air_us(&profile, PREAMBLE_LENGTH, c->payload_len, c->explicit_header, c->crc),
+                 c->expected_us);
+    }
+}
+
+static void test_time_on_air_formula(void)
+{
+    static const uint32_t bandwidths[] = { 125000, 250000, 500000 };
+    static const uint16_t payload_lens[] = { 0, 1, 3, 12, 51, 100, 222, 255 };
+    uint32_t checked = 0;
+
+    for (uint8_t sf = 7; sf <= 12; sf++) {
+        for (size_t bw = 0; bw < sizeof(bandwidths) / sizeof(bandwidths[0]); bw++) {
+            for (uint8_t cr = 5; cr <= 8; cr++) {
+                lora_profile_t profile = { .spreading_factor = sf, .bandwidth = bandwidths[bw], .coding_rate = cr };
+                for (size_t len = 0; len < sizeof(payload_lens) / sizeof(payload_lens[0]); len++) {
+                    for (int header = 0; header < 2; header++) {
+                        for (int crc = 0; crc < 2; crc++) {
+                            double expected = semtech_time_on_air_us(&profile, payload_lens[len], header, crc);
+                            uint32_t us = lora_packet_time_on_air_us(&profile, PREAMBLE_LENGTH, payload_lens[len],
+                                                                     header, crc);
+                            CHECK(fabs(us - expected) < 1.0);
+                            checked++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    printf("Time on air matches the datasheet formula in %u cases\n", checked);
+}
+
+static void test_profiles_ordered(void)
+{
+    lora_profile_t sf7_125k = { .spreading_factor = 7, .bandwidth = 125000, .coding_rate = 5 };
+
+    CHECK_EQ(lora_time_on_air_us(&sf7_125k, PREAMBLE_LENGTH, 12),
+             lora_packet_time_on_air_us(&sf7_125k, PREAMBLE_LENGTH, 12, true, true));
+
+    // Profiles go from fastest to most robust
+    for (uint8_t i = 1; i < lora_adr_num_profiles(); i++) {
+        CHECK(lora_time_on_air_us(lora_adr_get_profile(i), PREAMBLE_LENGTH, 12) >
+              lora_time_on_air_us(lora_adr_get_profile(i - 1), PREAMBLE_LENGTH, 12));
+    }
+}
+
+static void test_good_link_stays(void)
+{
+    lora_adr_set_max_profile(lora_adr_num_profiles() - 1);
+    lora_adr_reset(LORA_ADR_DEFAULT_PROFILE);
+    for (int i = 0; i < 20; i++) {
+        CHECK_EQ(lora_adr_on_packet(-60, 10.0f), LORA_ADR_DEFAULT_PROFILE);
+    }
+}
+
+static void test_weak_link_steps_down(void)
+{
+    lora_adr_set_max_profile(lora_adr_num_profiles() - 1);
+    lora_adr_reset(0);
+    // 2.5 dB margin on SF7/500k, halving the bandwidth gains 3 dB
+    CHECK_EQ(lora_adr_on_packet(-60, -5.0f), 1);
+
+    lora_adr_reset(0);
+    CHECK_EQ(lora_adr_on_packet(-60, -30.0f), lora_adr_num_profiles() - 1);
+}
+
+static void test_max_profile_caps_step_down(void)
+{
+    lora_adr_set_max_profile(0);
+    lora_adr_reset(0);
+    CHECK_EQ(lora_adr_on_packet(-60, -5.0f), 0);
+    CHECK_EQ(lora_adr_on_packet(-60, -30.0f), 0);
+
+    lora_adr_set_max_profile(2);
+    lora_adr_reset(0);
+    CHECK_EQ(lora_adr_on_packet(-60, -30.0f), 2);
+}
+
+static void test_strong_link_steps_up_after_averaging(void)
+{
+    lora_adr_set_max_profile(lora_adr_num_profiles() - 1);
+    lora_adr_reset(2);
+    for (int i = 0; i < 7; i++) {
+        CHECK_EQ(lora_adr_on_packet(-60, 10.0f), 2);
+    }
+    CHECK_EQ(lora_adr_on_packet(-60, 10.0f), 0);
+}
+
+typedef struct link_sim_t {
+    uint8_t     profile;
+    uint8_t     slowest_profile;
+    uint32_t    packets;
+    uint32_t    lost;
+    uint32_t    switches;
+    uint32_t    seed;
+} link_sim_t;
+
+// A few dB of fading on each packet, same sequence every run
+static float link_sim_fading(link_sim_t* sim)
+{
+    sim->seed = sim->seed * 1103515245 + 12345;
+    return ((sim->seed >> 16) % 401) / 100.0f - 2.0f;
+}
+
+// A telematics packet over a path with the given loss, only heard if its SNR is above the demodulation floor
+static void link_sim_packet(link_sim_t* sim, float loss_db)
+{
+    const lora_profile_t* p = lora_adr_get_profile(sim->profile);
+    float rssi = TX_POWER_DBM - loss_db + link_sim_fading(sim);
+    float snr = rssi - (-174.0f + 10.0f * log10f(p->bandwidth) + NOISE_FIGURE_DB);
+
+    sim->packets++;
+    if (snr < -5.0f - 2.5f * (p->spreading_factor - 6)) {
+        sim->lost++;
+        return;
+    }
+    uint8_t next = lora_adr_on_packet((int)lroundf(rssi), snr);
+    if (next != sim->profile) {
+        // Both ends switch like transport_lora does, the averages start over
+        sim->profile = next;
+        sim->switches++;
+        lora_adr_reset(next);
+        if (next > sim->slowest_profile) {
+            sim->slowest_profile = next;
+        }
+    }
+}
+
+// Path loss grows until only the most robust profile holds and then goes back, ADR has to follow without losing packets
+static void test_link_degradation(void)
+{
+    link_sim_t sim = { .profile = LORA_ADR_DEFAULT_PROFILE, .seed = 1 };
+    const uint8_t last = lora_adr_num_profiles() - 1;
+    const float best_loss_db = 100.0f;
+    const float worst_loss_db = 142.0f;
+
+    lora_adr_set_max_profile(last);
+    lora_adr_reset(sim.profile);
+    for (float loss = best_loss_db; loss < worst_loss_db; loss += LOSS_STEP_DB) {
+        link_sim_packet(&sim, loss);
+    }
+    CHECK_EQ(sim.profile, last);
+    uint32_t switches_down = sim.switches;
+    for (float loss = worst_loss_db; loss > best_loss_db; loss -= LOSS_STEP_DB) {
+        link_sim_packet(&sim, loss);
+    }
+    for (int i = 0; i < 20; i++) {
+        link_sim_packet(&sim, best_loss_db);
+    }
+
+    printf("Link degradation: %u packets, %u lost, %u switches down and %u up\n", sim.packets, sim.lost,
+           switches_down, sim.switches - switches_down);
+    CHECK_EQ(sim.lost, 0);
+    CHECK_EQ(sim.slowest_profile, last);
+    CHECK_EQ(sim.profile, LORA_ADR_DEFAULT_PROFILE);
+    // Fading doesn't make it flap between neighbouring profiles
+    CHECK(sim.switches <= 2 * last + 2);
+}
+
+int main(void)
+{
+    test_time_on_air_cases();
+    test_time_on_air_formula();
+    test_profiles_ordered();
+    test_good_link_stays();
+    test_weak_link_steps_down();
+    test_max_profile_caps_step_down();
+    test_strong_link_steps_up_after_averaging();
+    test_link_degradation();
+    printf("test_lora_adr passed\n");
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <string.h>
+#include "host_test.h"
+#include "mock_sx127x.h"
+#include "lora.h"
+
+static const uint8_t lengths[] = { 1, 12, 100, 255 };
+
+static void make_payload(uint8_t* payload, uint8_t length, uint8_t seed)
+{
+    for (int i = 0; i < length; i++) {
+        payload[i] = seed + i * 7;
+    }
+}
+
+// Whatever the payload length, the FIFO is written in one transaction, the rest is register setup
+static void test_send_takes_one_fifo_transaction(void)
+{
+    uint8_t payload[255];
+    mock_sx127x_stats_t stats;
+    uint32_t transactions = 0;
+
+    for (size_t i = 0; i < sizeof(lengths); i++) {
+        make_payload(payload, lengths[i], i);
+        mock_sx127x_clear_stats();
+        lora_send_packet_async(payload, lengths[i]);
+        mock_sx127x_get_stats(&stats);
+
+        CHECK_EQ(stats.fifo_transactions, 1);
+        CHECK_EQ(stats.max_transaction_len, lengths[i] + 1);
+        if (i > 0) {
+            CHECK_EQ(stats.transactions, transactions);
+        }
+        transactions = stats.transactions;
+        CHECK_EQ(mock_sx127x_get_reg(MOCK_SX127X_REG_PAYLOAD_LENGTH), lengths[i]);
+        CHECK(memcmp(mock_sx127x_tx_payload(), payload, lengths[i]) == 0);
+        printf("send %3d bytes: %u SPI transactions\n", lengths[i], stats.transactions);
+
+        lora_send_packet_complete();
+    }
+}
+
+static void test_receive_takes_one_fifo_transaction(void)
+{
+    uint8_t payload[255];
+    uint8_t buf[255];
+    mock_sx127x_stats_t stats;
+    uint32_t transactions = 0;
+
+    lora_receive();
+    for (size_t i = 0; i < sizeof(lengths); i++) {
+        make_payload(payload, lengths[i], 100 + i);
+        mock_sx127x_receive(payload, lengths[i]);
+        mock_sx127x_clear_stats();
+        CHECK_EQ(lora_receive_packet(buf, sizeof(buf)), lengths[i]);
+        mock_sx127x_get_stats(&stats);
+
+        CHECK_EQ(stats.fifo_transactions, 1);
+        CHECK_EQ(stats.max_transaction_len, lengths[i] + 1);
+        if (i > 0) {
+            CHECK_EQ(stats.transactions, transactions);
+        }
+        transactions = stats.transactions;
+        CHECK(memcmp(buf, payload, lengths[i]) == 0);
+        printf("receive %3d bytes: %u SPI transactions\n", lengths[i], stats.transactions);
+    }
+}
+
+// A packet longer than the buffer is cut to it, still in one transaction
+static void test_receive_truncated_to_buffer(void)
+{
+    uint8_t payload[100];
+    uint8_t buf[12];
+    mock_sx127x_stats_t stats;
+
+    make_payload(payload, sizeof(payload), 3);
+    mock_sx127x_receive(payload, sizeof(payload));
+    mock_sx127x_clear_stats();
+    CHECK_EQ(lora_receive_packet(buf, sizeof(buf)), sizeof(buf));
+    mock_sx127x_get_stats(&stats);
+    CHECK_EQ(stats.fifo_transactions, 1);
+    CHECK(memcmp(buf, payload, sizeof(buf)) == 0);
+}
+
+int main(void)
+{
+    mock_sx127x_reset();
+    CHECK_EQ(lora_init(), 0);
+
+    test_send_takes_one_fifo_transaction();
+    test_receive_takes_one_fifo_transaction();
+    test_receive_truncated_to_buffer();
+    printf("test_lora_fifo passed\n");
+    return 0;
+}
@@ -0,0 +1,184 @@
+#include <string.h>
+#include "host_test.h"
+#include "mock_sx127x.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "transport_lora.h"
+#include "lora_adr.h"
+#include "link_manager.h"
+#include "latency_probe.h"
+#include "control_scheduler.h"
+#include "flight_recorder.h"
+#include "rover_telematics.h"
+
+/*
+ * Two endpoints on one LoRa channel: the controller is transport_lora on the simulated
+ * radio, sending a control frame every period from a task like rover_controller does, and
+ * the Rover is simulated here. A packet only gets through if the receiving end is listening
+ * for all of it and nobody else transmits meanwhile, LoRa radios are half duplex.
+ *
+ * Without slots the Rover sends telematics on its own schedule, with slots it follows
+ * transport_lora.h and answers each control frame in its slot. Reports the frames per
+ * second delivered each way.
+ */
+
+#define START_US                1000000LL
+#define SIM_US                  10000000LL
+#define PERIOD_MS               100
+#define CONTROL_LEN             12
+#define TELEMATICS_LEN          100     // MAX_LORA_PAYLOAD in transport_lora.c, what the Rover slot is sized for
+#define PREAMBLE_LENGTH         8
+#define ROVER_TURNAROUND_US     1000    // Rover back from RX to TX after a control frame
+#define ROVER_OWN_PERIOD_US     97000   // Rover sending telematics on its own, not in step with the controller
+#define TICK_US                 (portTICK_PERIOD_MS * 1000)
+#define NEVER                   INT64_MAX
+
+typedef struct packet_t {
+    int64_t     start_us;
+    int64_t     end_us;         // NEVER while nothing is on air
+    bool        lost;
+} packet_t;
+
+typedef struct sim_result_t {
+    uint32_t    control_sent;
+    uint32_t    control_delivered;
+    uint32_t    telematics_sent;
+    uint32_t    telematics_delivered;
+} sim_result_t;
+
+static uint8_t control_frame[CONTROL_LEN];
+static uint32_t telematics_received;
+
+void flight_recorder_record(flight_record_type_t type, flight_transport_t transport, const uint8_t* data, uint16_t length)
+{
+}
+
+void rover_telematics_put(uint8_t* telematics, uint16_t length)
+{
+    telematics_received++;
+}
+
+static void send_task(void* arg)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (true) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(PERIOD_MS));
+        control_frame[0]++;
+        transport_lora_send(control_frame, sizeof(control_frame));
+    }
+}
+
+static uint32_t airtime_us(uint16_t length)
+{
+    return lora_time_on_air_us(lora_adr_get_profile(LORA_ADR_DEFAULT_PROFILE), PREAMBLE_LENGTH, length);
+}
+
+static int64_t min_us(int64_t a, int64_t b)
+{
+    return a < b ? a : b;
+}
+
+static bool controller_listening(void)
+{
+    return (mock_sx127x_get_reg(MOCK_SX127X_REG_OP_MODE) & 0x07) == 0x05;
+}
+
+static void run(bool slotted, sim_result_t* result)
+{
+    packet_t control = { .end_us = NEVER };
+    packet_t telematics = { .end_us = NEVER };
+    int64_t end_us = esp_timer_get_time() + SIM_US;
+    int64_t rover_next_us = slotted ? NEVER : esp_timer_get_time() + ROVER_OWN_PERIOD_US;
+    uint8_t telematics_frame[TELEMATICS_LEN];
+    uint32_t received = telematics_received;
+
+    memset(result, 0, sizeof(sim_result_t));
+    memset(telematics_frame, 'x', sizeof(telematics_frame));
+    while (esp_timer_get_time() < end_us) {
+        int64_t now = esp_timer_get_time();
+
+        // The controller started a frame, the Rover can't hear it while it is sending itself
+        if (control.end_us == NEVER && mock_sx127x_transmitting()) {
+            control.start_us = mock_sx127x_tx_started_us();
+            control.end_us = control.start_us + airtime_us(mock_sx127x_get_reg(MOCK_SX127X_REG_PAYLOAD_LENGTH));
+            control.lost = telematics.end_us != NEVER;
+            telematics.lost = true;
+            result->control_sent++;
+        }
+        if (now >= control.end_us) {
+            control.end_us = NEVER;
+            mock_sx127x_finish_tx();
+            if (!control.lost) {
+                result->control_delivered++;
+                if (slotted && telematics.end_us == NEVER) {
+                    rover_next_us = now + ROVER_TURNAROUND_US;
+                }
+            }
+        }
+        if (now >= telematics.end_us) {
+            telematics.end_us = NEVER;
+            if (!telematics.lost && controller_listening()) {
+                mock_sx127x_receive(telematics_frame, sizeof(telematics_frame));
+            }
+        }
+        if (now >= rover_next_us) {
+            telematics.start_us = now;
+            telematics.end_us = now + airtime_us(sizeof(telematics_frame));
+            telematics.lost = control.end_us != NEVER || !controller_listening();
+            control.lost = control.lost || control.end_us != NEVER;
+            result->telematics_sent++;
+            rover_next_us = slotted ? NEVER : rover_next_us + ROVER_OWN_PERIOD_US;
+        }
+
+        // Tasks only start sending on a tick or right after one of the events above
+        int64_t next_us = min_us(min_us(control.end_us, telematics.end_us), rover_next_us);
+        host_rtos_run_until(min_us(next_us, (now / TICK_US + 1) * TICK_US));
+    }
+    result->telematics_delivered = telematics_received - received;
+}
+
+static void print_result(const char* name, const sim_result_t* result)
+{
+    double seconds = SIM_US / 1e6;
+
+    printf("%-8s control %4.1f/s sent %4.1f/s delivered, telematics %4.1f/s sent %4.1f/s delivered\n", name,
+           result->control_sent / seconds, result->control_delivered / seconds,
+           result->telematics_sent / seconds, result->telematics_delivered / seconds);
+}
+
+int main(void)
+{
+    sim_result_t unslotted, slotted;
+    lora_slot_plan_t plan;
+
+    mock_sx127x_reset();
+    host_timer_set_us(START_US);
+    link_manager_init();
+    latency_probe_init();
+    transport_lora_init();
+    BaseType_t status = xTaskCreate(send_task, "send_task", 4096, NULL, CONTROL_TASK_PRIORITY, NULL);
+    CHECK_EQ(status, pdPASS);
+
+    // No slot plan yet, the controller sends whenever the period is up
+    run(false, &unslotted);
+    print_result("no slots", &unslotted);
+
+    transport_lora_configure_slots(PERIOD_MS, CONTROL_LEN);
+    transport_lora_get_slot_plan(&plan);
+    CHECK(plan.idle_us > 0);
+    run(true, &slotted);
+    print_result("slots", &slotted);
+
+    // Every period has room for a control frame and an answer, nothing collides
+    int32_t periods = SIM_US / (PERIOD_MS * 1000);
+    CHECK(slotted.control_sent >= periods - 1);
+    CHECK_EQ(slotted.control_delivered, slotted.control_sent);
+    CHECK_EQ(slotted.telematics_delivered, slotted.telematics_sent);
+    CHECK(slotted.telematics_delivered >= slotted.control_delivered - 1);
+    CHECK(slotted.telematics_delivered > unslotted.telematics_delivered);
+    CHECK(slotted.control_delivered >= unslotted.control_delivered);
+    printf("test_lora_slots passed\n");
+    return 0;
+}
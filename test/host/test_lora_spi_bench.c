@@ -0,0 +1,142 @@
+#include <time.h>
+#include "host_test.h"
+#include "mock_sx127x.h"
+#include "lora.h"
+
+/*
+ * Register configuration sequences of the LoRa driver on the simulated radio, one by one
+ * and batched. Reports the SPI transactions of each sequence, the time they take on the
+ * bus and the host CPU time of the driver calls, and checks that batched writes are all
+ * queued and no sequence needs a register read.
+ */
+
+#define ITERATIONS          100000
+#define REG_MODEM_CONFIG_1  0x1d
+#define REG_MODEM_CONFIG_2  0x1e
+
+typedef void sequence_t(void);
+
+// The modem profile, what transport_lora applies on an ADR switch
+static void set_profile(void)
+{
+    lora_set_spreading_factor(9);
+    lora_set_bandwidth(125000);
+    lora_set_coding_rate(5);
+}
+
+static void set_profile_batched(void)
+{
+    lora_begin_batch();
+    set_profile();
+    lora_end_batch();
+}
+
+// What transport_lora_init sets up
+static void init_config_batched(void)
+{
+    lora_begin_batch();
+    lora_set_frequency(868e6);
+    lora_enable_crc();
+    lora_set_tx_power(17);
+    lora_set_preamble_length(8);
+    lora_end_batch();
+}
+
+// More writes than the SPI queue holds, the batch has to wait for room
+static void long_batch(void)
+{
+    lora_begin_batch();
+    for (int i = 0; i < 6; i++) {
+        set_profile();
+    }
+    lora_end_batch();
+}
+
+static double cpu_time_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+static void bench(const char* name, sequence_t* sequence, mock_sx127x_stats_t* stats)
+{
+    mock_sx127x_clear_stats();
+    sequence();
+    mock_sx127x_get_stats(stats);
+
+    double start_ns = cpu_time_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        sequence();
+    }
+    double cpu_ns = (cpu_time_ns() - start_ns) / ITERATIONS;
+
+    printf("%-20s %3u transactions, %3u queued, %u reads, %5.1f us on the bus, %5.0f ns CPU\n", name,
+           stats->transactions, stats->queued_transactions, stats->reads, stats->bus_ns / 1000.0, cpu_ns);
+}
+
+static void test_profile_sequence(void)
+{
+    mock_sx127x_stats_t single, batched;
+
+    bench("profile", set_profile, &single);
+    uint8_t config_1 = mock_sx127x_get_reg(REG_MODEM_CONFIG_1);
+    uint8_t config_2 = mock_sx127x_get_reg(REG_MODEM_CONFIG_2);
+    bench("profile batched", set_profile_batched, &batched);
+
+    // Same registers written either way, from the shadow copies without reading them first
+    CHECK_EQ(mock_sx127x_get_reg(REG_MODEM_CONFIG_1), config_1);
+    CHECK_EQ(mock_sx127x_get_reg(REG_MODEM_CONFIG_2), config_2);
+    CHECK_EQ(single.transactions, batched.transactions);
+    CHECK_EQ(single.reads, 0);
+    CHECK_EQ(single.queued_transactions, 0);
+    CHECK_EQ(batched.reads, 0);
+    CHECK_EQ(batched.queued_transactions, batched.transactions);
+}
+
+static void test_init_sequence(void)
+{
+    mock_sx127x_stats_t stats;
+
+    bench("init config batched", init_config_batched, &stats);
+    CHECK_EQ(stats.transactions, 7);
+    CHECK_EQ(stats.queued_transactions, stats.transactions);
+}
+
+static void test_long_batch(void)
+{
+    mock_sx127x_stats_t stats;
+
+    bench("long batch", long_batch, &stats);
+    CHECK_EQ(stats.queued_transactions, stats.transactions);
+    CHECK(stats.transactions > 16);
+}
+
+// A read in a batch has to wait for the queued writes, the simulated bus checks the order
+static void test_read_flushes_batch(void)
+{
+    mock_sx127x_stats_t stats;
+
+    mock_sx127x_clear_stats();
+    lora_begin_batch();
+    lora_set_spreading_factor(7);
+    CHECK(!lora_received());
+    lora_set_bandwidth(500000);
+    lora_end_batch();
+    mock_sx127x_get_stats(&stats);
+    CHECK_EQ(stats.reads, 1);
+    CHECK_EQ(stats.transactions - stats.queued_transactions, 1);
+}
+
+int main(void)
+{
+    mock_sx127x_reset();
+    CHECK_EQ(lora_init(), 0);
+
+    test_profile_sequence();
+    test_init_sequence();
+    test_long_batch();
+    test_read_flushes_batch();
+    printf("test_lora_spi_bench passed\n");
+    return 0;
+}
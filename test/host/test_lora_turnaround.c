@@ -0,0 +1,145 @@
+#include <string.h>
+#include "host_test.h"
+#include "mock_sx127x.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "transport_lora.h"
+#include "lora_adr.h"
+#include "link_manager.h"
+#include "latency_probe.h"
+#include "metrics.h"
+#include "flight_recorder.h"
+#include "rover_telematics.h"
+
+/*
+ * transport_lora on the simulated radio: a control frame goes on air, TxDone comes after
+ * its time on air and the radio has to be back in RX continuous mode for the Rover's slot.
+ * The turnaround is the simulated time from TxDone until RX is entered, plus the time the
+ * SPI transactions in between take on the bus.
+ */
+
+#define START_US            1000000LL
+#define PREAMBLE_LENGTH     8       // LORA_PREAMBLE_LENGTH in transport_lora.c
+#define TX_TIMEOUT_MARGIN_MS 20     // LORA_TX_TIMEOUT_MARGIN_MS in transport_lora.c
+#define TICK_US             (portTICK_PERIOD_MS * 1000)
+#define MAX_TURNAROUND_US   100
+#define POLL_TICKS          2       // What lora_send_packet still sleeps between polls
+
+static uint32_t telematics_received;
+
+// Only the parts of the firmware transport_lora hands frames to
+void flight_recorder_record(flight_record_type_t type, flight_transport_t transport, const uint8_t* data, uint16_t length)
+{
+}
+
+void rover_telematics_put(uint8_t* telematics, uint16_t length)
+{
+    telematics_received++;
+}
+
+static uint32_t frame_airtime_us(uint16_t length)
+{
+    return lora_time_on_air_us(lora_adr_get_profile(LORA_ADR_DEFAULT_PROFILE), PREAMBLE_LENGTH, length);
+}
+
+// Sends a frame and lets it go on air for as long as it takes, returns when TxDone was raised
+static int64_t send_frame(uint8_t* frame, uint16_t length)
+{
+    int64_t start_us = esp_timer_get_time();
+
+    transport_lora_send(frame, length);
+    CHECK(mock_sx127x_transmitting());
+    CHECK_EQ(mock_sx127x_tx_started_us(), start_us);
+    CHECK(memcmp(mock_sx127x_tx_payload(), frame, length) == 0);
+
+    int64_t done_us = start_us + frame_airtime_us(length);
+    host_rtos_run_until(done_us);
+    // Not back in RX while still on air
+    CHECK(mock_sx127x_rx_started_us() < start_us);
+    mock_sx127x_finish_tx();
+    return done_us;
+}
+
+static void test_rx_right_after_tx_done(void)
+{
+    uint8_t frame[12] = { 0xDC, 0x05, 0xE8, 0x03 };
+    mock_sx127x_stats_t before, after;
+
+    for (int i = 0; i < 5; i++) {
+        int64_t done_us = send_frame(frame, sizeof(frame));
+        mock_sx127x_get_stats(&before);
+        host_rtos_run_until(done_us + TICK_US);
+        mock_sx127x_get_stats(&after);
+
+        CHECK(!mock_sx127x_transmitting());
+        CHECK(mock_sx127x_rx_started_us() >= done_us);
+        int64_t turnaround_us = mock_sx127x_rx_started_us() - done_us + (after.bus_ns - before.bus_ns) / 1000;
+        CHECK(turnaround_us <= MAX_TURNAROUND_US);
+        if (i == 0) {
+            printf("TX->RX turnaround: %lld us, %u SPI transactions, polling every %d ticks took up to %d us\n",
+                   (long long)turnaround_us, after.transactions - before.transactions, POLL_TICKS,
+                   POLL_TICKS * TICK_US);
+        }
+        host_rtos_run_until(esp_timer_get_time() + 20 * TICK_US);
+    }
+    CHECK_EQ(metrics_get(METRIC_LORA_FRAMES_SENT), 5);
+    CHECK_EQ(metrics_get(METRIC_LORA_TX_TIMEOUTS), 0);
+    CHECK_EQ(metrics_get(METRIC_LORA_FRAMES_DROPPED), 0);
+}
+
+// Telematics in the Rover slot right after the turnaround are picked up from the RxDone edge
+static void test_rover_frame_received_after_turnaround(void)
+{
+    uint8_t frame[12] = { 0 };
+    uint8_t telematics[] = "{\"bat\":12.1}";
+    uint32_t received = telematics_received;
+
+    int64_t done_us = send_frame(frame, sizeof(frame));
+    host_rtos_run_until(done_us + TICK_US);
+    host_rtos_run_until(esp_timer_get_time() + frame_airtime_us(sizeof(telematics)));
+    mock_sx127x_receive(telematics, sizeof(telematics));
+    host_rtos_run_until(esp_timer_get_time() + TICK_US);
+    CHECK_EQ(telematics_received, received + 1);
+    host_rtos_run_until(esp_timer_get_time() + 20 * TICK_US);
+}
+
+// Without the DIO0 edge the receive task still finds TxDone set when its wait times out
+static void test_lost_tx_done_edge_recovers(void)
+{
+    uint8_t frame[12] = { 0 };
+
+    mock_sx127x_set_dio0_connected(false);
+    int64_t start_us = esp_timer_get_time();
+    int64_t done_us = send_frame(frame, sizeof(frame));
+    host_rtos_run_until(start_us + (frame_airtime_us(sizeof(frame)) / 1000 + TX_TIMEOUT_MARGIN_MS) * 1000 + 2 * TICK_US);
+    mock_sx127x_set_dio0_connected(true);
+
+    CHECK(!mock_sx127x_transmitting());
+    CHECK(mock_sx127x_rx_started_us() > done_us + MAX_TURNAROUND_US);
+    printf("TX->RX turnaround without the DIO0 edge: %lld us\n", (long long)(mock_sx127x_rx_started_us() - done_us));
+
+    // The next frame goes out as usual
+    host_rtos_run_until(esp_timer_get_time() + 20 * TICK_US);
+    done_us = send_frame(frame, sizeof(frame));
+    host_rtos_run_until(done_us + TICK_US);
+    CHECK(mock_sx127x_rx_started_us() - done_us <= MAX_TURNAROUND_US);
+    CHECK_EQ(metrics_get(METRIC_LORA_FRAMES_DROPPED), 0);
+}
+
+int main(void)
+{
+    mock_sx127x_reset();
+    host_timer_set_us(START_US);
+    link_manager_init();
+    latency_probe_init();
+    transport_lora_init();
+    host_rtos_run_until(esp_timer_get_time() + TICK_US);
+    CHECK_EQ(mock_sx127x_get_reg(MOCK_SX127X_REG_OP_MODE) & 0x07, 0x05);
+
+    test_rx_right_after_tx_done();
+    test_rover_frame_received_after_turnaround();
+    test_lost_tx_done_edge_recovers();
+    printf("test_lora_turnaround passed\n");
+    return 0;
+}
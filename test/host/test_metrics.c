@@ -0,0 +1,146 @@
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include "host_test.h"
+#include "metrics.h"
+
+/*
+ * Counters and gauges as they are read back and exported to /metrics, and a contention
+ * benchmark: threads incrementing one counter at once, as the transport tasks and timer
+ * callbacks do on both cores, against each thread on a counter of its own and against the
+ * same increments under a mutex. No increment may be lost.
+ */
+
+#define THREADS             4
+#define INCREMENTS          1000000
+
+typedef struct bench_arg_t {
+    metric_t    metric;
+    bool        locked;
+} bench_arg_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void test_counters(void)
+{
+    metrics_inc(METRIC_LORA_FRAMES_SENT);
+    metrics_inc(METRIC_LORA_FRAMES_SENT);
+    metrics_add(METRIC_LORA_FRAMES_SENT, 40);
+    CHECK_EQ(metrics_get(METRIC_LORA_FRAMES_SENT), 42);
+    CHECK_EQ(metrics_get(METRIC_WS_FRAMES_SENT), 0);
+
+    // Wraps at 32 bits, never read as negative
+    metrics_add(METRIC_UDP_FRAMES_SENT, UINT32_MAX);
+    CHECK_EQ(metrics_get(METRIC_UDP_FRAMES_SENT), UINT32_MAX);
+    metrics_add(METRIC_UDP_FRAMES_SENT, 3);
+    CHECK_EQ(metrics_get(METRIC_UDP_FRAMES_SENT), 2);
+}
+
+static void test_gauges(void)
+{
+    metrics_set(METRIC_LORA_RSSI, -120);
+    CHECK_EQ(metrics_get(METRIC_LORA_RSSI), -120);
+    metrics_set(METRIC_LORA_RSSI, INT32_MIN);
+    CHECK_EQ(metrics_get(METRIC_LORA_RSSI), INT32_MIN);
+    metrics_set(METRIC_PHONES_CONNECTED, 2);
+    metrics_inc(METRIC_PHONES_CONNECTED);
+    CHECK_EQ(metrics_get(METRIC_PHONES_CONNECTED), 3);
+    metrics_set(METRIC_LORA_RSSI, -87);
+}
+
+static void test_format(void)
+{
+    char buf[METRICS_MAX_TEXT_LEN];
+    uint16_t len = metrics_format(buf, sizeof(buf));
+    int lines = 0;
+
+    CHECK(len > 0 && len < sizeof(buf));
+    CHECK_EQ(strlen(buf), len);
+    CHECK(strstr(buf, "# TYPE rover_lora_frames_sent counter\nrover_lora_frames_sent 42\n") != NULL);
+    CHECK(strstr(buf, "# TYPE rover_lora_rssi gauge\nrover_lora_rssi -87\n") != NULL);
+    CHECK(strstr(buf, "rover_udp_frames_sent 2\n") != NULL);
+    for (uint16_t i = 0; i < len; i++) {
+        lines += buf[i] == '\n';
+    }
+    CHECK_EQ(lines, 2 * METRIC_END);
+    CHECK_EQ(buf[len - 1], '\n');
+
+    // Exactly fits with the terminating null, one less is nothing rather than a cut off line
+    CHECK_EQ(metrics_format(buf, len + 1), len);
+    CHECK_EQ(metrics_format(buf, len), 0);
+    CHECK_EQ(metrics_format(buf, 10), 0);
+}
+
+static double wall_time_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+static void* bench_thread(void* arg)
+{
+    const bench_arg_t* bench = arg;
+
+    for (int i = 0; i < INCREMENTS; i++) {
+        if (bench->locked) {
+            pthread_mutex_lock(&lock);
+            metrics_inc(bench->metric);
+            pthread_mutex_unlock(&lock);
+        } else {
+            metrics_inc(bench->metric);
+        }
+    }
+    return NULL;
+}
+
+// Reports the ns per increment of each thread, with every thread running at once
+static void bench(const char* name, bool shared, bool locked)
+{
+    static const metric_t own[THREADS] = {
+        METRIC_WS_SEND_ERRORS, METRIC_UDP_SEND_ERRORS, METRIC_LORA_CRC_ERRORS, METRIC_LORA_TX_TIMEOUTS
+    };
+    pthread_t threads[THREADS];
+    bench_arg_t args[THREADS];
+    int64_t before[THREADS];
+
+    for (int i = 0; i < THREADS; i++) {
+        args[i] = (bench_arg_t){ .metric = shared ? METRIC_SEMAPHORE_TIMEOUTS : own[i], .locked = locked };
+        before[i] = metrics_get(args[i].metric);
+    }
+    double start_ns = wall_time_ns();
+    for (int i = 0; i < THREADS; i++) {
+        CHECK_EQ(pthread_create(&threads[i], NULL, bench_thread, &args[i]), 0);
+    }
+    for (int i = 0; i < THREADS; i++) {
+        CHECK_EQ(pthread_join(threads[i], NULL), 0);
+    }
+    double ns = (wall_time_ns() - start_ns) / THREADS / INCREMENTS;
+
+    if (shared) {
+        CHECK_EQ(metrics_get(METRIC_SEMAPHORE_TIMEOUTS), before[0] + THREADS * INCREMENTS);
+    } else {
+        for (int i = 0; i < THREADS; i++) {
+            CHECK_EQ(metrics_get(own[i]), before[i] + INCREMENTS);
+        }
+    }
+    printf("%-24s %u threads x %u increments, %6.1f ns per increment\n", name, THREADS, INCREMENTS, ns);
+}
+
+static void test_contention(void)
+{
+    bench("one counter", true, false);
+    bench("a counter each", false, false);
+    bench("one counter, mutex", true, true);
+}
+
+int main(void)
+{
+    test_counters();
+    test_gauges();
+    test_format();
+    test_contention();
+    printf("test_metrics passed\n");
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include <string.h>
+#include "host_test.h"
+#include "redundant_link.h"
+
+static uint16_t encode(uint16_t seq, uint8_t* frame)
+{
+    const uint8_t payload[] = { 0xDC, 0x05, 0xE8, 0x03 };
+    return redundant_link_encode(seq, payload, sizeof(payload), frame);
+}
+
+static void test_encode(void)
+{
+    uint8_t frame[REDUNDANT_LINK_HEADER_LEN + 4];
+
+    CHECK_EQ(encode(0x1234, frame), sizeof(frame));
+    CHECK_EQ(frame[0], 0x34);
+    CHECK_EQ(frame[1], 0x12);
+    CHECK_EQ(frame[2], 0xDC);
+    CHECK_EQ(frame[5], 0x03);
+}
+
+static void test_duplicate_from_other_link_dropped(void)
+{
+    redundant_link_rx_t rx;
+    uint8_t frame[REDUNDANT_LINK_HEADER_LEN + 4];
+    const uint8_t* payload;
+    uint16_t payload_len;
+
+    redundant_link_rx_init(&rx);
+    uint16_t len = encode(1, frame);
+    // Websocket copy first, the LoRa copy of the same frame right after
+    CHECK(redundant_link_rx_accept(&rx, frame, len, 0, &payload, &payload_len));
+    CHECK_EQ(payload_len, 4);
+    CHECK(payload == &frame[REDUNDANT_LINK_HEADER_LEN]);
+    CHECK(!redundant_link_rx_accept(&rx, frame, len, 40, &payload, &payload_len));
+    CHECK_EQ(rx.accepted, 1);
+    CHECK_EQ(rx.duplicates, 1);
+}
+
+static void test_older_never_overwrites_newer(void)
+{
+    redundant_link_rx_t rx;
+    uint8_t frame[REDUNDANT_LINK_HEADER_LEN + 4];
+    const uint8_t* payload;
+    uint16_t payload_len;
+
+    redundant_link_rx_init(&rx);
+    CHECK(redundant_link_rx_accept(&rx, frame, encode(10, frame), 0, &payload, &payload_len));
+    CHECK(redundant_link_rx_accept(&rx, frame, encode(13, frame), 100, &payload, &payload_len));
+    CHECK_EQ(rx.lost, 2);
+    // A late copy of 12 over the slow link
+    CHECK(!redundant_link_rx_accept(&rx, frame, encode(12, frame), 150, &payload, &payload_len));
+    CHECK_EQ(rx.last_seq, 13);
+}
+
+static void test_sequence_wraps(void)
+{
+    redundant_link_rx_t rx;
+    uint8_t frame[REDUNDANT_LINK_HEADER_LEN + 4];
+    const uint8_t* payload;
+    uint16_t payload_len;
+
+    redundant_link_rx_init(&rx);
+    CHECK(redundant_link_rx_accept(&rx, frame, encode(0xFFFF, frame), 0, &payload, &payload_len));
+    CHECK(redundant_link_rx_accept(&rx, frame, encode(0, frame), 100, &payload, &payload_len));
+    CHECK(!redundant_link_rx_accept(&rx, frame, encode(0xFFFE, frame), 150, &payload, &payload_len));
+    CHECK_EQ(rx.lost, 0);
+}
+
+static void test_resync_after_silence(void)
+{
+    redundant_link_rx_t rx;
+    uint8_t frame[REDUNDANT_LINK_HEADER_LEN + 4];
+    const uint8_t* payload;
+    uint16_t payload_len;
+
+    redundant_link_rx_init(&rx);
+    CHECK(redundant_link_rx_accept(&rx, frame, encode(500, frame), 0, &payload, &payload_len));
+    // Restarted controller starts over from 0
+    CHECK(!redundant_link_rx_accept(&rx, frame, encode(0, frame), REDUNDANT_LINK_RESYNC_MS - 1, &payload, &payload_len));
+    CHECK(redundant_link_rx_accept(&rx, frame, encode(0, frame), REDUNDANT_LINK_RESYNC_MS + 1, &payload, &payload_len));
+    CHECK_EQ(rx.last_seq, 0);
+}
+
+static void test_short_frame_rejected(void)
+{
+    redundant_link_rx_t rx;
+    uint8_t frame[1] = { 0 };
+    const uint8_t* payload;
+    uint16_t payload_len;
+
+    redundant_link_rx_init(&rx);
+    CHECK(!redundant_link_rx_accept(&rx, frame, sizeof(frame), 0, &payload, &payload_len));
+    CHECK_EQ(rx.accepted, 0);
+}
+
+int main(void)
+{
+    test_encode();
+    test_duplicate_from_other_link_dropped();
+    test_older_never_overwrites_newer();
+    test_sequence_wraps();
+    test_resync_after_silence();
+    test_short_frame_rejected();
+    printf("test_redundant_link passed\n");
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <string.h>
+#include "host_test.h"
+#include "esp_timer.h"
+#include "rover_telematics.h"
+#include "metrics.h"
+
+// Built twice, with and without ROVER_PHONE_TELEMATICS_DELTAS, see CMakeLists.txt
+
+static char received[ROVER_TELEMATICS_MAX_LEN + 1];
+static int received_count;
+
+static void on_data(uint8_t* telematics, uint16_t length)
+{
+    CHECK(length <= ROVER_TELEMATICS_MAX_LEN);
+    memcpy(received, telematics, length);
+    received[length] = '\0';
+    received_count++;
+}
+
+static void put(const char* frame)
+{
+    rover_telematics_put((uint8_t*)frame, strlen(frame));
+}
+
+// Frames that aren't a flat object must reach the phones exactly as received and not be cached
+static void check_passed_through(const char* frame, const char* key)
+{
+    telematics_value_t value;
+    int count = received_count;
+
+    put(frame);
+    CHECK_EQ(received_count, count + 1);
+    CHECK(strcmp(received, frame) == 0);
+    CHECK(!rover_telematics_get(key, &value));
+}
+
+static void test_empty_snapshot(void)
+{
+    uint8_t buf[64];
+
+    CHECK_EQ(rover_telematics_snapshot(buf, sizeof(buf)), 0);
+}
+
+static void test_parse_values(void)
+{
+    telematics_value_t value;
+    const char* frame = "{ \"speed\": -1.5e1, \"armed\":true,\n\"gps\" : null }";
+
+    host_timer_set_us(1000);
+    put(frame);
+    CHECK_EQ(received_count, 1);
+#ifdef ROVER_PHONE_TELEMATICS_DELTAS
+    CHECK(strcmp(received, "{\"speed\":-1.5e1,\"armed\":true,\"gps\":null}") == 0);
+#else
+    CHECK(strcmp(received, frame) == 0);
+#endif
+
+    CHECK(rover_telematics_get("speed", &value));
+    CHECK_EQ(value.type, TELEMATICS_NUMBER);
+    CHECK(value.number == -15.0);
+    CHECK_EQ(value.updated_us, 1000);
+    CHECK(rover_telematics_get("armed", &value));
+    CHECK_EQ(value.type, TELEMATICS_BOOL);
+    CHECK(value.number == 1.0);
+    CHECK(rover_telematics_get("gps", &value));
+    CHECK_EQ(value.type, TELEMATICS_NULL);
+    CHECK(!rover_telematics_get("spee", &value));
+}
+
+static void test_update(void)
+{
+    telematics_value_t value;
+
+    host_timer_set_us(2000);
+    put("{\"speed\":-1.5e1,\"armed\":false}");
+    CHECK_EQ(received_count, 2);
+#ifdef ROVER_PHONE_TELEMATICS_DELTAS
+    CHECK(strcmp(received, "{\"armed\":false}") == 0);
+
+    // Nothing changed, nothing to send
+    put("{\"speed\":-1.5e1,\"armed\":false}");
+    CHECK_EQ(received_count, 2);
+    put("{}");
+    CHECK_EQ(received_count, 2);
+#else
+    put("{}");
+    CHECK_EQ(received_count, 3);
+    CHECK(strcmp(received, "{}") == 0);
+#endif
+
+    CHECK(rover_telematics_get("armed", &value));
+    CHECK(value.number == 0.0);
+    // Unchanged fields are still marked as received
+    CHECK(rover_telematics_get("speed", &value));
+    CHECK_EQ(value.updated_us, 2000);
+    CHECK(rover_telematics_get("gps", &value));
+    CHECK_EQ(value.updated_us, 1000);
+}
+
+static void test_not_flat_object(void)
+{
+    char frame[512];
+    int len;
+
+    check_passed_through("hello", "hello");
+    check_passed_through("[1,2]", "a");
+    check_passed_through("{\"a\":\"text\"}", "a");
+    check_passed_through("{\"a\":{\"b\":1}}", "a");
+    check_passed_through("{\"a\":1x}", "a");
+    check_passed_through("{\"a\":abc}", "a");
+    check_passed_through("{\"a\":1,}", "a");
+    check_passed_through("{\"a\":1} x", "a");
+    check_passed_through("{\"a\\\"b\":1}", "a");
+    check_passed_through("{\"\":1}", "");
+    // A frame cut short, like the first fragment of a fragmented websocket message
+    check_passed_through("{\"a\":1,\"b\":", "a");
+    check_passed_through("{\"keykeykeykeykeykeykeykey\":1}", "keykeykeykeykeykeykeykey");
+    check_passed_through("{\"a\":1234567890123456789012345}", "a");
+
+    len = snprintf(frame, sizeof(frame), "{");
+    for (int i = 0; i <= ROVER_TELEMATICS_MAX_FIELDS; i++) {
+        len += snprintf(&frame[len], sizeof(frame) - len, "%s\"f%d\":%d", i == 0 ? "" : ",", i, i);
+    }
+    snprintf(&frame[len], sizeof(frame) - len, "}");
+    check_passed_through(frame, "f0");
+}
+
+static void test_snapshot(void)
+{
+    uint8_t buf[64];
+    const char* expected = "{\"speed\":-1.5e1,\"armed\":false,\"gps\":null}";
+    uint16_t len = rover_telematics_snapshot(buf, sizeof(buf));
+
+    CHECK_EQ(len, strlen(expected));
+    CHECK(memcmp(buf, expected, len) == 0);
+    // Exactly fits, the object isn't NUL terminated
+    CHECK_EQ(rover_telematics_snapshot(buf, len), len);
+    // Doesn't fit, nothing rather than a cut off object
+    CHECK_EQ(rover_telematics_snapshot(buf, len - 1), 0);
+    CHECK_EQ(rover_telematics_snapshot(buf, 10), 0);
+}
+
+static void test_field_limit(void)
+{
+    char frame[64];
+    telematics_value_t value;
+
+    // The cache is full after this, new fields are still passed on but not stored
+    for (int i = 3; i <= ROVER_TELEMATICS_MAX_FIELDS; i++) {
+        snprintf(frame, sizeof(frame), "{\"f%d\":%d}", i, i);
+        put(frame);
+    }
+    CHECK(rover_telematics_get("f31", &value));
+    CHECK(value.number == 31.0);
+    CHECK(!rover_telematics_get("f32", &value));
+    CHECK(strcmp(received, "{\"f32\":32}") == 0);
+}
+
+// Longer than a phone is ever sent, dropped before it is cached
+static void test_too_long(void)
+{
+    char frame[ROVER_TELEMATICS_MAX_LEN + 64];
+    telematics_value_t value;
+    int len = 0, count = received_count;
+    uint32_t dropped = metrics_get(METRIC_TELEMATICS_DROPPED);
+
+    for (int i = 0; len < ROVER_TELEMATICS_MAX_LEN; i++) {
+        len += snprintf(&frame[len], sizeof(frame) - len, "%s\"long%d\":%020d", i == 0 ? "{" : ",", i, i);
+    }
+    len += snprintf(&frame[len], sizeof(frame) - len, "}");
+    CHECK(len > ROVER_TELEMATICS_MAX_LEN && len < (int)sizeof(frame));
+    put(frame);
+    CHECK_EQ(received_count, count);
+    CHECK(!rover_telematics_get("long0", &value));
+    CHECK_EQ(metrics_get(METRIC_TELEMATICS_DROPPED), dropped + 1);
+}
+
+int main(void)
+{
+    rover_telematics_register_on_data(&on_data);
+
+    test_empty_snapshot();
+    test_parse_values();
+    test_update();
+    test_not_flat_object();
+    test_snapshot();
+    test_too_long();
+    test_field_limit();
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+#include <string.h>
+#include "host_test.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "replay_hw.h"
+#include "controller_sample.h"
+#include "rover_controller.h"
+#include "rover_payload.h"
+#include "link_manager.h"
+#include "latency_probe.h"
+
+/*
+ * Switch edges through the debounce in controller_input and on to rover_controller on
+ * simulated time: bouncing contacts give one frame with the settled level, glitches shorter
+ * than the debounce give none, and a level reaches the Rover even if its edges were lost.
+ * Reports the time from the first edge to the frame.
+ */
+
+#define START_US                1000000LL
+#define PERIOD_MS               100     // ADC_SAMPLE_DELAY in rover_controller.c
+#define DEBOUNCE_MS             10      // SWITCH_DEBOUNCE_MS in controller_input.c
+#define RESYNC_MS               100     // SWITCH_RESYNC_MS in controller_input.c
+#define TICK_MS                 portTICK_PERIOD_MS
+#define SWITCH_1_CHANNEL        4
+#define SWITCH_1_UP_GPIO        GPIO_NUM_25
+#define SWITCH_1_DOWN_GPIO      GPIO_NUM_13
+#define SWITCH_2_UP_GPIO        GPIO_NUM_17
+#define ADC_REST                2048
+#define MAX_FRAMES              64
+#define LATENCY_RUNS            20
+
+typedef struct frame_t {
+    int64_t     time_us;
+    uint16_t    channels[ROVER_PAYLOAD_CHANNELS];
+} frame_t;
+
+// Time of each level change from the first edge, the last one is the settled level
+static const uint32_t bounce_us[] = { 0, 300, 800, 1500, 2600, 4000, 4300 };
+#define NUM_BOUNCES             (sizeof(bounce_us) / sizeof(bounce_us[0]))
+#define SETTLED_US              bounce_us[NUM_BOUNCES - 1]
+
+static frame_t frames[MAX_FRAMES];
+static uint32_t num_frames;
+static int64_t period_start_us;
+
+static void on_frame(replay_transport_t transport, const uint8_t* data, uint16_t length)
+{
+    CHECK_EQ(transport, REPLAY_TRANSPORT_LORA);
+    CHECK_EQ(length, ROVER_PAYLOAD_LEN);
+    CHECK(num_frames < MAX_FRAMES);
+    frames[num_frames].time_us = esp_timer_get_time();
+    memcpy(frames[num_frames].channels, data, ROVER_PAYLOAD_LEN);
+    num_frames++;
+}
+
+// Moves to offset_ms into the next control period, the periodic frames are sent at its start
+static void next_period(uint32_t offset_ms)
+{
+    period_start_us += PERIOD_MS * 1000;
+    host_rtos_run_until(period_start_us + offset_ms * 1000);
+    num_frames = 0;
+}
+
+// Runs to the end of the period, the frames sent are only the ones caused by switches
+static void finish_period(void)
+{
+    host_rtos_run_until(period_start_us + PERIOD_MS * 1000 - 1);
+}
+
+// Flips the pin with contact bounce, ends at level
+static void bounce(gpio_num_t gpio, int level)
+{
+    int64_t start_us = esp_timer_get_time();
+
+    for (uint8_t i = 0; i < NUM_BOUNCES; i++) {
+        host_rtos_run_until(start_us + bounce_us[i]);
+        // Alternates so that the last change is to level
+        replay_hw_set_gpio(gpio, (NUM_BOUNCES - 1 - i) % 2 == 0 ? level : !level);
+    }
+}
+
+// Up to the last edge, the debounce window and the wait for the next tick
+static uint32_t max_latency_us(uint32_t last_edge_us)
+{
+    return last_edge_us + DEBOUNCE_MS * 1000 + 2 * TICK_MS * 1000;
+}
+
+static void test_bounce_sends_once(void)
+{
+    rover_controller_stats_t stats;
+
+    next_period(20);
+    int64_t edge_us = esp_timer_get_time();
+    bounce(SWITCH_1_UP_GPIO, 1);
+    finish_period();
+    CHECK_EQ(num_frames, 1);
+    CHECK_EQ(frames[0].channels[SWITCH_1_CHANNEL], 1000);
+    rover_controller_get_stats(&stats);
+    CHECK_EQ(stats.last_switch_latency_us, frames[0].time_us - edge_us);
+    CHECK(frames[0].time_us - edge_us >= SETTLED_US + DEBOUNCE_MS * 1000);
+    CHECK(stats.last_switch_latency_us <= max_latency_us(SETTLED_US));
+
+    // And back to the middle
+    next_period(20);
+    bounce(SWITCH_1_UP_GPIO, 0);
+    finish_period();
+    CHECK_EQ(num_frames, 1);
+    CHECK_EQ(frames[0].channels[SWITCH_1_CHANNEL], 1500);
+}
+
+// Shorter than the debounce window, the level is the same when it is read
+static void test_glitch_ignored(void)
+{
+    next_period(20);
+    int64_t start_us = esp_timer_get_time();
+    replay_hw_set_gpio(SWITCH_1_DOWN_GPIO, 1);
+    host_rtos_run_until(start_us + (DEBOUNCE_MS - 3) * 1000);
+    replay_hw_set_gpio(SWITCH_1_DOWN_GPIO, 0);
+    finish_period();
+    CHECK_EQ(num_frames, 0);
+}
+
+// Far more edges than the old 32 entry event queue held before the task gets to run
+static void test_edge_storm(void)
+{
+    next_period(20);
+    int64_t edge_us = esp_timer_get_time();
+    for (int i = 0; i < 200; i++) {
+        replay_hw_set_gpio(SWITCH_2_UP_GPIO, i % 2 == 0);
+    }
+    replay_hw_set_gpio(SWITCH_1_DOWN_GPIO, 1);
+    finish_period();
+    CHECK_EQ(num_frames, 1);
+    CHECK_EQ(frames[0].channels[SWITCH_1_CHANNEL], 2000);
+    CHECK(frames[0].time_us - edge_us <= max_latency_us(0));
+
+    next_period(20);
+    replay_hw_set_gpio(SWITCH_1_DOWN_GPIO, 0);
+    finish_period();
+    CHECK_EQ(num_frames, 1);
+    CHECK_EQ(frames[0].channels[SWITCH_1_CHANNEL], 1500);
+}
+
+// No interrupt at all, the periodic resync finds the new level
+static void test_missed_edge_resynced(void)
+{
+    int64_t bound_us = (RESYNC_MS + DEBOUNCE_MS + 2 * TICK_MS) * 1000;
+
+    next_period(20);
+    int64_t change_us = esp_timer_get_time();
+    replay_hw_set_gpio_missed(SWITCH_1_UP_GPIO, 1);
+    host_rtos_run_until(change_us + bound_us);
+    uint32_t i = 0;
+    while (i < num_frames && frames[i].channels[SWITCH_1_CHANNEL] != 1000) {
+        i++;
+    }
+    CHECK(i < num_frames);
+    printf("Missed switch edge to frame: %.1f ms\n", (frames[i].time_us - change_us) / 1000.0);
+
+    period_start_us += (esp_timer_get_time() - period_start_us) / (PERIOD_MS * 1000) * PERIOD_MS * 1000;
+    next_period(20);
+    bounce(SWITCH_1_UP_GPIO, 0);
+    finish_period();
+    CHECK_EQ(num_frames, 1);
+    CHECK_EQ(frames[0].channels[SWITCH_1_CHANNEL], 1500);
+}
+
+// Edges at different points of the tick, from the first edge to the frame
+static void test_latency(void)
+{
+    uint64_t sum_us = 0;
+    uint32_t min_us = UINT32_MAX, max_us = 0;
+
+    for (int run = 0; run < LATENCY_RUNS; run++) {
+        next_period(10 + run * 37 % 40);
+        host_rtos_run_until(esp_timer_get_time() + run * 450 % TICK_MS * 1000);
+        int64_t edge_us = esp_timer_get_time();
+        bounce(SWITCH_1_UP_GPIO, run % 2 == 0);
+        finish_period();
+        CHECK_EQ(num_frames, 1);
+        uint32_t latency_us = frames[0].time_us - edge_us;
+        CHECK(latency_us <= max_latency_us(SETTLED_US));
+        sum_us += latency_us;
+        min_us = latency_us < min_us ? latency_us : min_us;
+        max_us = latency_us > max_us ? latency_us : max_us;
+    }
+    printf("Switch edge to frame, %.1f ms of bounce: min %.1f ms, mean %.1f ms, max %.1f ms\n",
+           SETTLED_US / 1000.0, min_us / 1000.0, sum_us / 1000.0 / LATENCY_RUNS, max_us / 1000.0);
+}
+
+int main(void)
+{
+    // Same order as app_main, switches in the middle keep everything on LoRa without WiFi links
+    host_timer_set_us(START_US);
+    for (uint8_t i = 0; i < INPUT_ANALOG_END; i++) {
+        replay_hw_set_adc(i, ADC_REST);
+    }
+    link_manager_init();
+    latency_probe_init();
+    replay_hw_register_on_frame(&on_frame);
+    rover_controller_init();
+    // Control periods start on START_US, let the filters settle
+    period_start_us = START_US + 20 * PERIOD_MS * 1000;
+    host_rtos_run_until(period_start_us);
+
+    // The switch levels at start are no change, the first frame waits for the sticks to be sampled
+    CHECK(num_frames > 0);
+    CHECK(frames[0].time_us >= START_US + PERIOD_MS * 1000);
+    CHECK(frames[0].channels[0] > 1400 && frames[0].channels[0] < 1600);
+
+    test_bounce_sends_once();
+    test_glitch_ignored();
+    test_edge_storm();
+    test_missed_edge_resynced();
+    test_latency();
+    printf("test_switch_debounce passed\n");
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include <string.h>
+#include "host_test.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "task_profiler.h"
+
+/*
+ * task_profiler sampling a made up set of tasks whose run time counters the test moves along,
+ * checks the JSON served by GET /tasks byte for byte: the cpu history oldest first, tasks that
+ * come and go, the most tasks there can be and every buffer size it can be cut off at.
+ */
+
+#define INTERVAL_MS         1000
+#define MAX_TASKS           (TASK_PROFILER_MAX_TASKS + 1)
+#define CANARY              0x5A
+
+typedef struct fake_task_t {
+    char            name[configMAX_TASK_NAME_LEN];
+    UBaseType_t     number;
+    UBaseType_t     priority;
+    uint32_t        stack_free;
+    uint32_t        run_time;
+} fake_task_t;
+
+static fake_task_t tasks[MAX_TASKS];
+static uint8_t num_tasks;
+static uint32_t total_run_time;
+static char json[TASK_PROFILER_JSON_MAX_LEN];
+
+// The run time counters come from esp_timer in us like CONFIG_FREERTOS_RUN_TIME_STATS_USING_ESP_TIMER
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* task_status, UBaseType_t array_size, uint32_t* total)
+{
+    if (num_tasks > array_size) {
+        return 0;
+    }
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        task_status[i] = (TaskStatus_t){
+            .pcTaskName = tasks[i].name,
+            .xTaskNumber = tasks[i].number,
+            .eCurrentState = eReady,
+            .uxCurrentPriority = tasks[i].priority,
+            .uxBasePriority = tasks[i].priority,
+            .ulRunTimeCounter = tasks[i].run_time,
+            .usStackHighWaterMark = tasks[i].stack_free,
+        };
+    }
+    *total = total_run_time;
+    return num_tasks;
+}
+
+static fake_task_t* add_task(const char* name, UBaseType_t number, UBaseType_t priority, uint32_t stack_free)
+{
+    CHECK(num_tasks < MAX_TASKS);
+    fake_task_t* task = &tasks[num_tasks++];
+    memset(task, 0, sizeof(fake_task_t));
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    task->number = number;
+    task->priority = priority;
+    task->stack_free = stack_free;
+    return task;
+}
+
+static void delete_task(UBaseType_t number)
+{
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        if (tasks[i].number == number) {
+            tasks[i] = tasks[--num_tasks];
+            return;
+        }
+    }
+    CHECK(false);
+}
+
+static fake_task_t* find_task(UBaseType_t number)
+{
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        if (tasks[i].number == number) {
+            return &tasks[i];
+        }
+    }
+    CHECK(false);
+    return NULL;
+}
+
+// One interval in which each task used the given percent of it, shares are in the order of tasks
+static void run_interval(const uint8_t* percent)
+{
+    uint32_t interval_us = INTERVAL_MS * 1000;
+
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        tasks[i].run_time += interval_us / 100 * percent[i];
+    }
+    total_run_time += interval_us;
+    host_timer_advance_us(interval_us);
+    host_timer_run_due();
+}
+
+static void check_json(const char* expected)
+{
+    uint16_t len = task_profiler_to_json(json, sizeof(json));
+
+    if (len != strlen(expected) || strcmp(json, expected) != 0) {
+        fprintf(stderr, "expected %s\n     got %s\n", expected, json);
+    }
+    CHECK_EQ(len, strlen(expected));
+    CHECK(strcmp(json, expected) == 0);
+}
+
+static void test_no_samples(void)
+{
+    check_json("{\"interval_ms\":1000,\"tasks\":[]}");
+}
+
+// The first sample only sets the run times the next one counts from
+static void test_baseline(void)
+{
+    add_task("send_values", 1, 5, 1204);
+    add_task("IDLE0", 2, 0, 612);
+    add_task("lora_receive_ta", 3, 2, 388);
+    run_interval((const uint8_t[]){ 10, 80, 10 });
+    check_json("{\"interval_ms\":1000,\"tasks\":["
+               "{\"name\":\"send_values\",\"prio\":5,\"stack_free\":1204,\"cpu\":[]},"
+               "{\"name\":\"IDLE0\",\"prio\":0,\"stack_free\":612,\"cpu\":[]},"
+               "{\"name\":\"lora_receive_ta\",\"prio\":2,\"stack_free\":388,\"cpu\":[]}]}");
+}
+
+// The oldest samples make room for new ones, the stack shown is the latest high water mark
+static void test_history(void)
+{
+    for (uint8_t i = 1; i <= TASK_PROFILER_HISTORY + 2; i++) {
+        run_interval((const uint8_t[]){ i, 100 - 2 * i, i });
+    }
+    find_task(3)->stack_free = 120;
+    find_task(3)->priority = 7;
+    run_interval((const uint8_t[]){ 50, 25, 25 });
+    check_json("{\"interval_ms\":1000,\"tasks\":["
+               "{\"name\":\"send_values\",\"prio\":5,\"stack_free\":1204,\"cpu\":[4,5,6,7,8,9,10,11,12,50]},"
+               "{\"name\":\"IDLE0\",\"prio\":0,\"stack_free\":612,\"cpu\":[92,90,88,86,84,82,80,78,76,25]},"
+               "{\"name\":\"lora_receive_ta\",\"prio\":7,\"stack_free\":120,\"cpu\":[4,5,6,7,8,9,10,11,12,25]}]}");
+}
+
+// A deleted task is 0 from then on, a new one counts from when it was created
+static void test_tasks_come_and_go(void)
+{
+    delete_task(3);
+    fake_task_t* blink = add_task("blink_task", 4, 1, 1500);
+    blink->run_time = INTERVAL_MS * 1000 / 100 * 3;
+    run_interval((const uint8_t[]){ 20, 77, 0 });
+    check_json("{\"interval_ms\":1000,\"tasks\":["
+               "{\"name\":\"send_values\",\"prio\":5,\"stack_free\":1204,\"cpu\":[5,6,7,8,9,10,11,12,50,20]},"
+               "{\"name\":\"IDLE0\",\"prio\":0,\"stack_free\":612,\"cpu\":[90,88,86,84,82,80,78,76,25,77]},"
+               "{\"name\":\"lora_receive_ta\",\"prio\":7,\"stack_free\":120,\"cpu\":[5,6,7,8,9,10,11,12,25,0]},"
+               "{\"name\":\"blink_task\",\"prio\":1,\"stack_free\":1500,\"cpu\":[0,0,0,0,0,0,0,0,0,3]}]}");
+}
+
+// Every profile taken, long names and 3 digit numbers everywhere: still fits TASK_PROFILER_JSON_MAX_LEN.
+// More tasks than that and the sample is skipped.
+static void test_most_tasks(void)
+{
+    uint8_t percent[MAX_TASKS];
+    char name[configMAX_TASK_NAME_LEN];
+
+    for (UBaseType_t number = 10; num_tasks < TASK_PROFILER_MAX_TASKS; number++) {
+        snprintf(name, sizeof(name), "task_%010u", number);
+        add_task(name, number, 24, 65535);
+    }
+    memset(percent, 100, sizeof(percent));
+    for (uint8_t i = 0; i < TASK_PROFILER_HISTORY; i++) {
+        run_interval(percent);
+    }
+    uint16_t len = task_profiler_to_json(json, sizeof(json));
+    printf("%u tasks: %u bytes of JSON, %u at most\n", TASK_PROFILER_MAX_TASKS, len, TASK_PROFILER_JSON_MAX_LEN);
+    CHECK(len > 0);
+    CHECK(strstr(json, "{\"name\":\"task_0000000010\",\"prio\":24,\"stack_free\":65535,"
+                       "\"cpu\":[100,100,100,100,100,100,100,100,100,100]}") != NULL);
+
+    char before[TASK_PROFILER_JSON_MAX_LEN];
+    strcpy(before, json);
+    add_task("one_too_many", 99, 1, 100);
+    run_interval(percent);
+    check_json(before);
+    delete_task(99);
+}
+
+// Cut off at every size the JSON is either whole or nothing, and nothing is written past size
+static void test_truncation(void)
+{
+    char expected[TASK_PROFILER_JSON_MAX_LEN];
+    char buf[TASK_PROFILER_JSON_MAX_LEN + 16];
+    uint16_t len = task_profiler_to_json(expected, sizeof(expected));
+
+    CHECK(len > 0);
+    for (uint16_t size = 0; size <= len + 1; size++) {
+        memset(buf, CANARY, sizeof(buf));
+        uint16_t result = task_profiler_to_json(buf, size);
+        if (size > len) {
+            CHECK_EQ(result, len);
+            CHECK(strcmp(buf, expected) == 0);
+        } else {
+            CHECK_EQ(result, 0);
+        }
+        for (size_t i = size; i < sizeof(buf); i++) {
+            CHECK_EQ(buf[i], CANARY);
+        }
+    }
+}
+
+int main(void)
+{
+    host_timer_set_us(1000000);
+    task_profiler_init(INTERVAL_MS);
+
+    test_no_samples();
+    test_baseline();
+    test_history();
+    test_tasks_come_and_go();
+    test_most_tasks();
+    test_truncation();
+    printf("test_task_profiler passed\n");
+    return 0;
+}
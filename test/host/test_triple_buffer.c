@@ -0,0 +1,87 @@
+#include <pthread.h>
+#include "host_test.h"
+#include "triple_buffer.h"
+
+#define STRESS_VALUES   2000000
+#define VALUE_WORDS     16
+
+typedef struct value_t {
+    uint32_t    words[VALUE_WORDS];     // All the same, a mix means the value was torn
+} value_t;
+
+static triple_buffer_t buffer;
+static value_t storage[3];
+
+static void write_value(uint32_t n)
+{
+    value_t* value = triple_buffer_write_buf(&buffer);
+    for (int i = 0; i < VALUE_WORDS; i++) {
+        value->words[i] = n;
+    }
+    triple_buffer_publish(&buffer);
+}
+
+static void test_latest_value_wins(void)
+{
+    const void* data;
+
+    triple_buffer_init(&buffer, storage, sizeof(value_t));
+    CHECK(!triple_buffer_read(&buffer, &data));
+
+    write_value(1);
+    CHECK(triple_buffer_read(&buffer, &data));
+    CHECK_EQ(((const value_t*)data)->words[0], 1);
+    // Nothing new, the same value is returned again
+    CHECK(!triple_buffer_read(&buffer, &data));
+    CHECK_EQ(((const value_t*)data)->words[0], 1);
+
+    write_value(2);
+    write_value(3);
+    write_value(4);
+    CHECK(triple_buffer_read(&buffer, &data));
+    CHECK_EQ(((const value_t*)data)->words[0], 4);
+    CHECK_EQ(triple_buffer_publish_count(&buffer), 4);
+}
+
+static void* producer(void* arg)
+{
+    for (uint32_t n = 1; n <= STRESS_VALUES; n++) {
+        write_value(n);
+    }
+    return NULL;
+}
+
+// One producer and one consumer thread, the consumer must never see a torn or older value
+static void test_concurrent_never_torn(void)
+{
+    pthread_t thread;
+    uint32_t last = 0;
+    uint32_t reads = 0;
+
+    triple_buffer_init(&buffer, storage, sizeof(value_t));
+    CHECK_EQ(pthread_create(&thread, NULL, producer, NULL), 0);
+    while (last < STRESS_VALUES) {
+        const void* data;
+        if (!triple_buffer_read(&buffer, &data)) {
+            continue;
+        }
+        const value_t* value = data;
+        for (int i = 1; i < VALUE_WORDS; i++) {
+            CHECK_EQ(value->words[i], value->words[0]);
+        }
+        CHECK(value->words[0] > last);
+        last = value->words[0];
+        reads++;
+    }
+    pthread_join(thread, NULL);
+    CHECK(reads > 0);
+    CHECK_EQ(triple_buffer_publish_count(&buffer), STRESS_VALUES);
+}
+
+int main(void)
+{
+    test_latest_value_wins();
+    test_concurrent_never_torn();
+    printf("test_triple_buffer passed\n");
+    return 0;
+}
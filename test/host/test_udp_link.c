@@ -0,0 +1,222 @@
+#include <string.h>
+#include "host_test.h"
+#include "mock_udp.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "transport_udp.h"
+#include "redundant_link.h"
+#include "link_manager.h"
+#include "latency_probe.h"
+#include "control_scheduler.h"
+#include "flight_recorder.h"
+
+/*
+ * transport_udp over a simulated WiFi link to a Rover that follows transport_udp.h: it takes
+ * the newest frame by the redundant_link rules and acks it. Frames go out every control
+ * period like rover_controller sends them. Reports the one way latency, the frames lost and
+ * the round trip time transport_udp gets from the acks for links of different quality.
+ */
+
+#define START_US                1000000LL
+#define PERIOD_MS               100
+#define RUN_US                  20000000LL
+#define PAYLOAD_LEN             12
+#define ALIVE_TIMEOUT_MS        500     // ACK_ALIVE_TIMEOUT_MS in transport_udp.c
+#define SENT_HISTORY            16      // SENT_HISTORY in transport_udp.c
+#define STEP_US                 50      // STEP_US in mock_udp.c
+#define MAX_SEQ                 1024
+
+typedef struct link_result_t {
+    uint32_t    sent;
+    uint32_t    accepted;
+    uint32_t    lost;
+    uint32_t    duplicates;
+    uint32_t    acks;
+    uint32_t    rtt_us;
+    uint32_t    max_latency_us;
+    uint64_t    latency_sum_us;
+} link_result_t;
+
+static uint16_t next_seq;
+static int64_t sent_at_us[MAX_SEQ];
+static redundant_link_rx_t rover;
+static bool rover_acks = true;
+static link_result_t result;
+
+void flight_recorder_record(flight_record_type_t type, flight_transport_t transport, const uint8_t* data, uint16_t length)
+{
+}
+
+static void send_task(void* arg)
+{
+    uint8_t payload[PAYLOAD_LEN] = { 0 };
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (true) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(PERIOD_MS));
+        sent_at_us[next_seq % MAX_SEQ] = esp_timer_get_time();
+        if (transport_udp_send(next_seq, payload, sizeof(payload)) == ESP_OK) {
+            result.sent++;
+        }
+        next_seq++;
+    }
+}
+
+// The Rover acks every frame it accepts
+static void on_rover_receive(const uint8_t* data, uint16_t length)
+{
+    const uint8_t* payload;
+    uint16_t payload_len;
+    int64_t now = esp_timer_get_time();
+
+    if (!redundant_link_rx_accept(&rover, data, length, now / 1000, &payload, &payload_len)) {
+        return;
+    }
+    CHECK_EQ(payload_len, PAYLOAD_LEN);
+    uint16_t seq = rover.last_seq;
+    uint32_t latency_us = now - sent_at_us[seq % MAX_SEQ];
+    result.latency_sum_us += latency_us;
+    result.max_latency_us = latency_us > result.max_latency_us ? latency_us : result.max_latency_us;
+    if (rover_acks) {
+        uint8_t ack[] = { 'A', seq & 0xFF, seq >> 8 };
+        mock_udp_rover_send(ack, sizeof(ack));
+    }
+}
+
+static void run(const char* name, const mock_udp_link_t* link)
+{
+    transport_udp_stats_t before, after;
+    redundant_link_rx_t start;
+
+    // From the start of a period, the last frame of the run has arrived by its end
+    int64_t period_us = PERIOD_MS * 1000;
+    mock_udp_run_until(START_US + (esp_timer_get_time() - START_US + period_us - 1) / period_us * period_us);
+    mock_udp_set_link(link);
+    memset(&result, 0, sizeof(result));
+    transport_udp_get_stats(&before);
+    start = rover;
+    mock_udp_run_until(esp_timer_get_time() + RUN_US);
+    transport_udp_get_stats(&after);
+
+    result.accepted = rover.accepted - start.accepted;
+    result.lost = rover.lost - start.lost;
+    result.duplicates = rover.duplicates - start.duplicates;
+    result.acks = after.acks - before.acks;
+    result.rtt_us = after.rtt_us;
+    printf("%-16s %3u sent, %3u accepted, %5.1f%% lost, %3u out of order, latency avg %5.1f ms max %5.1f ms, "
+           "%3u acks, rtt %5.1f ms\n", name, result.sent, result.accepted, 100.0 * result.lost / result.sent,
+           result.duplicates, result.accepted > 0 ? result.latency_sum_us / 1000.0 / result.accepted : 0.0,
+           result.max_latency_us / 1000.0, result.acks, result.rtt_us / 1000.0);
+}
+
+// Acks that come back after their send time left the history can't give a round trip time
+static void test_acks_older_than_history(void)
+{
+    mock_udp_link_t link = { .delay_us = SENT_HISTORY * PERIOD_MS * 1000 / 2 + 100000 };
+
+    run("late acks", &link);
+    CHECK(result.acks > 0);
+    CHECK_EQ(result.rtt_us, 0);
+    // Let the late ones arrive before the next link
+    mock_udp_set_link(&(mock_udp_link_t){ .loss_percent = 100 });
+    mock_udp_run_until(esp_timer_get_time() + 2 * link.delay_us + 1);
+}
+
+static void test_clean_link(void)
+{
+    mock_udp_link_t link = { .delay_us = 2000 };
+
+    run("clean", &link);
+    CHECK_EQ(result.accepted, result.sent);
+    CHECK_EQ(result.lost, 0);
+    CHECK_EQ(result.acks, result.sent);
+    CHECK(result.max_latency_us <= link.delay_us + STEP_US);
+    CHECK(result.rtt_us >= 2 * link.delay_us && result.rtt_us <= 2 * (link.delay_us + STEP_US));
+    CHECK(transport_udp_alive());
+}
+
+// Jitter larger than the delay, frames still never arrive a period late so none are reordered
+static void test_jitter(void)
+{
+    mock_udp_link_t link = { .delay_us = 3000, .jitter_us = 8000 };
+
+    run("jitter", &link);
+    CHECK_EQ(result.accepted, result.sent);
+    CHECK(result.max_latency_us <= link.delay_us + link.jitter_us + STEP_US);
+    CHECK(result.rtt_us >= 2 * link.delay_us && result.rtt_us <= 2 * (link.delay_us + link.jitter_us + STEP_US));
+}
+
+static void test_loss(uint8_t loss_percent)
+{
+    mock_udp_link_t link = { .delay_us = 2000, .jitter_us = 2000, .loss_percent = loss_percent };
+    char name[16];
+
+    snprintf(name, sizeof(name), "%u%% loss", loss_percent);
+    run(name, &link);
+    // Nothing is resent, the Rover counts what it missed when the next frame comes, one may be lost at either end
+    CHECK(result.accepted + result.lost + 1 >= result.sent && result.accepted + result.lost <= result.sent + 1);
+    float lost = 100.0f * (result.sent - result.accepted) / result.sent;
+    CHECK(lost > loss_percent / 2.0f && lost < loss_percent * 1.5f);
+    // Acks are lost on the way back as well
+    CHECK(result.acks < result.accepted);
+    CHECK(result.rtt_us >= 2 * link.delay_us && result.rtt_us <= 2 * (link.delay_us + link.jitter_us + STEP_US));
+}
+
+// A Rover that doesn't ack is not alive after the timeout, the frames still get through
+static void test_no_acks(void)
+{
+    mock_udp_link_t link = { .delay_us = 2000 };
+    transport_udp_stats_t stats;
+
+    mock_udp_set_link(&link);
+    mock_udp_run_until(esp_timer_get_time() + 3 * PERIOD_MS * 1000);
+    CHECK(transport_udp_alive());
+    rover_acks = false;
+    int64_t start_us = esp_timer_get_time();
+    mock_udp_run_until(start_us + (ALIVE_TIMEOUT_MS - 2 * PERIOD_MS) * 1000);
+    CHECK(transport_udp_alive());
+    mock_udp_run_until(start_us + (ALIVE_TIMEOUT_MS + PERIOD_MS) * 1000);
+    CHECK(!transport_udp_alive());
+    transport_udp_get_stats(&stats);
+    CHECK(stats.ack_staleness_ms >= ALIVE_TIMEOUT_MS);
+    rover_acks = true;
+}
+
+// Out of buffers in lwip the frame is dropped right away, the send task never waits
+static void test_send_buffers_full(void)
+{
+    transport_udp_stats_t before, after;
+    uint8_t payload[PAYLOAD_LEN] = { 0 };
+
+    transport_udp_get_stats(&before);
+    mock_udp_set_send_buffers_full(true);
+    CHECK_EQ(transport_udp_send(next_seq++, payload, sizeof(payload)), ESP_FAIL);
+    mock_udp_set_send_buffers_full(false);
+    transport_udp_get_stats(&after);
+    CHECK_EQ(after.send_errors, before.send_errors + 1);
+    CHECK_EQ(after.frames_sent, before.frames_sent);
+}
+
+int main(void)
+{
+    host_timer_set_us(START_US);
+    mock_udp_reset();
+    mock_udp_register_rover(&on_rover_receive);
+    redundant_link_rx_init(&rover);
+    link_manager_init();
+    latency_probe_init();
+    transport_udp_init();
+    BaseType_t status = xTaskCreate(send_task, "send_task", 4096, NULL, CONTROL_TASK_PRIORITY, NULL);
+    CHECK_EQ(status, pdPASS);
+
+    test_acks_older_than_history();
+    test_clean_link();
+    test_jitter();
+    test_loss(10);
+    test_loss(30);
+    test_no_acks();
+    test_send_buffers_full();
+    printf("test_udp_link passed\n");
+    return 0;
+}
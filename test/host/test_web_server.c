@@ -0,0 +1,460 @@
+#include <string.h>
+#include "host_test.h"
+#include "mock_httpd.h"
+#include "esp_timer.h"
+#include "web_server.h"
+#include "rover_telematics.h"
+#include "link_manager.h"
+#include "latency_probe.h"
+#include "task_profiler.h"
+#include "metrics.h"
+#include "config.h"
+
+/*
+ * web_server.c on the mock http server: telematics from the Rover come in bursts the way the
+ * LoRa and WiFi receive tasks hand them over and phones read them from their sockets.
+ * Checks what every phone gets against what was sent, in order and as a whole, and what was
+ * dropped on the way.
+ *
+ * Built three times, one websocket frame per telematics frame, with ROVER_PHONE_TELEMATICS_BATCH_MS
+ * and batching deltas with ROVER_PHONE_TELEMATICS_DELTAS too, see CMakeLists.txt
+ */
+
+#define START_US                1000000LL
+#define BATCH_RECORD_HEADER_LEN 2       // BATCH_RECORD_HEADER_LEN in web_server.c
+#define CLIENT_QUEUE_LEN        4       // CLIENT_QUEUE_LEN in web_server.c
+#define STEP_US                 1000    // STEP_US in mock_httpd.c
+#define TELEMATICS_TAG          0xA5    // Not JSON, passed on untouched
+#define FRAME_LEN               20
+#define MAX_SEQ                 4096
+#define MAX_PHONES              (ROVER_MAX_PHONES + 1)
+#define BURSTS                  20
+#define BURST_LEN               6
+#define BURST_INTERVAL_MS       100
+
+typedef struct phone_t {
+    int         fd;
+    uint32_t    messages;       // Binary websocket frames
+    uint32_t    records;        // Telematics frames in them
+    uint32_t    texts;
+    uint32_t    missed;
+    uint16_t    next_seq;
+    size_t      max_message_len;
+    int64_t     max_delay_us;
+    int32_t     last_json_seq;  // Of the JSON telematics, -1 before the first
+} phone_t;
+
+static phone_t phones[MAX_PHONES];
+static uint16_t next_seq;
+static int64_t sent_at_us[MAX_SEQ];
+static int32_t allocated;
+
+// Linked with --wrap=malloc,--wrap=free, see CMakeLists.txt, every buffer shared by the phones must be freed again
+void* __real_malloc(size_t size);
+void __real_free(void* ptr);
+
+void* __wrap_malloc(size_t size)
+{
+    void* ptr = __real_malloc(size);
+    allocated += ptr != NULL;
+    return ptr;
+}
+
+void __wrap_free(void* ptr)
+{
+    allocated -= ptr != NULL;
+    __real_free(ptr);
+}
+
+// Served by task_profiler.c on the target, it isn't what is tested here
+uint16_t task_profiler_to_json(char* buf, uint16_t size)
+{
+    return snprintf(buf, size, "{}");
+}
+
+static phone_t* find_phone(int fd)
+{
+    for (uint8_t i = 0; i < MAX_PHONES; i++) {
+        if (phones[i].fd == fd) {
+            return &phones[i];
+        }
+    }
+    return NULL;
+}
+
+// JSON telematics, frames, deltas and snapshots alike, must never go back to an older seq
+static void check_json_record(phone_t* phone, const uint8_t* data, size_t len)
+{
+    char json[ROVER_TELEMATICS_MAX_LEN + 1];
+    const char* field;
+    int32_t seq;
+
+    CHECK(len < sizeof(json));
+    memcpy(json, data, len);
+    json[len] = '\0';
+    field = strstr(json, "\"seq\":");
+    CHECK(field != NULL);
+    CHECK_EQ(sscanf(field, "\"seq\":%d", &seq), 1);
+    CHECK(seq > phone->last_json_seq);
+    phone->last_json_seq = seq;
+    phone->records++;
+}
+
+// Every frame carries its sequence number and a pattern from it, anything cut or mixed up shows
+static void check_record(phone_t* phone, const uint8_t* data, size_t len)
+{
+    CHECK(len >= 3);
+    if (data[0] == '{') {
+        check_json_record(phone, data, len);
+        return;
+    }
+    CHECK_EQ(data[0], TELEMATICS_TAG);
+    uint16_t seq = data[1] | data[2] << 8;
+    for (size_t i = 3; i < len; i++) {
+        CHECK_EQ(data[i], (uint8_t)(seq + i));
+    }
+    CHECK((int16_t)(seq - phone->next_seq) >= 0);
+    phone->missed += (uint16_t)(seq - phone->next_seq);
+    phone->next_seq = seq + 1;
+    phone->records++;
+
+    int64_t delay_us = esp_timer_get_time() - sent_at_us[seq % MAX_SEQ];
+    phone->max_delay_us = delay_us > phone->max_delay_us ? delay_us : phone->max_delay_us;
+}
+
+static void on_phone_read(int fd, httpd_ws_type_t type, const uint8_t* data, size_t len)
+{
+    phone_t* phone = find_phone(fd);
+
+    CHECK(phone != NULL);
+    if (type == HTTPD_WS_TYPE_TEXT) {
+        // Link stats
+        CHECK(len > 0 && data[0] == '{');
+        phone->texts++;
+        return;
+    }
+    CHECK_EQ(type, HTTPD_WS_TYPE_BINARY);
+    phone->messages++;
+    phone->max_message_len = len > phone->max_message_len ? len : phone->max_message_len;
+#ifdef ROVER_PHONE_TELEMATICS_BATCH_MS
+    size_t offset = 0;
+    while (offset < len) {
+        CHECK(offset + BATCH_RECORD_HEADER_LEN <= len);
+        uint16_t record_len = data[offset] | data[offset + 1] << 8;
+        offset += BATCH_RECORD_HEADER_LEN;
+        CHECK(record_len > 0 && offset + record_len <= len);
+        check_record(phone, &data[offset], record_len);
+        offset += record_len;
+    }
+#else
+    check_record(phone, data, len);
+#endif
+}
+
+static phone_t* connect_phone(void)
+{
+    phone_t* phone = find_phone(MOCK_HTTPD_NO_SOCKET);
+
+    CHECK(phone != NULL);
+    memset(phone, 0, sizeof(phone_t));
+    phone->fd = mock_httpd_connect();
+    CHECK(phone->fd != MOCK_HTTPD_NO_SOCKET);
+    phone->next_seq = next_seq;
+    phone->last_json_seq = -1;
+    CHECK_EQ(mock_httpd_ws_send_text(phone->fd, "CONNECT"), ESP_OK);
+    return phone;
+}
+
+static void disconnect_phone(phone_t* phone)
+{
+    mock_httpd_close(phone->fd);
+    phone->fd = MOCK_HTTPD_NO_SOCKET;
+}
+
+static void put_telematics(uint16_t len)
+{
+    uint8_t frame[ROVER_TELEMATICS_MAX_LEN];
+    uint16_t seq = next_seq++;
+
+    CHECK(len >= 3 && len <= sizeof(frame));
+    frame[0] = TELEMATICS_TAG;
+    frame[1] = seq & 0xFF;
+    frame[2] = seq >> 8;
+    for (uint16_t i = 3; i < len; i++) {
+        frame[i] = seq + i;
+    }
+    sent_at_us[seq % MAX_SEQ] = esp_timer_get_time();
+    rover_telematics_put(frame, len);
+}
+
+// Lets everything queued reach the phones
+static void settle(void)
+{
+    mock_httpd_run_until(esp_timer_get_time() + 200000);
+}
+
+// Nothing is kept or queued while no phone is connected
+static void test_no_phone(void)
+{
+    webserver_stats_t before, after;
+    mock_httpd_stats_t httpd_before, httpd_after;
+
+    webserver_get_stats(&before);
+    mock_httpd_get_stats(&httpd_before);
+    for (uint8_t i = 0; i < BURST_LEN; i++) {
+        put_telematics(FRAME_LEN);
+    }
+    settle();
+    webserver_get_stats(&after);
+    mock_httpd_get_stats(&httpd_after);
+    CHECK_EQ(after.frames_in, before.frames_in + BURST_LEN);
+    CHECK_EQ(after.frames_out, before.frames_out);
+    CHECK_EQ(httpd_after.frames_sent, httpd_before.frames_sent);
+}
+
+// Bursts come faster than the httpd task sends. One frame at a time the burst overflows the
+// client queue and its oldest frames are lost, batched the whole burst goes out as one frame.
+static void test_bursts(void)
+{
+    webserver_stats_t before, after;
+    phone_t* phone = connect_phone();
+
+    settle();
+    webserver_get_stats(&before);
+    for (uint8_t burst = 0; burst < BURSTS; burst++) {
+        for (uint8_t i = 0; i < BURST_LEN; i++) {
+            put_telematics(FRAME_LEN);
+        }
+        mock_httpd_run_until(esp_timer_get_time() + BURST_INTERVAL_MS * 1000);
+    }
+    settle();
+    webserver_get_stats(&after);
+
+    printf("%u bursts of %u: %u websocket frames, %u telematics frames, %u missed, max delay %.1f ms\n", BURSTS,
+           BURST_LEN, phone->messages, phone->records, phone->missed, phone->max_delay_us / 1000.0);
+    CHECK_EQ(after.frames_in - before.frames_in, BURSTS * BURST_LEN);
+    // Queued to the phone, then sent or dropped
+    CHECK_EQ(after.frames_out - before.frames_out, phone->messages + after.drops - before.drops);
+    CHECK_EQ(phone->records + phone->missed, BURSTS * BURST_LEN);
+#ifdef ROVER_PHONE_TELEMATICS_BATCH_MS
+    CHECK_EQ(phone->messages, BURSTS);
+    CHECK_EQ(phone->missed, 0);
+    CHECK_EQ(after.drops, before.drops);
+    CHECK(phone->max_delay_us >= ROVER_PHONE_TELEMATICS_BATCH_MS * 1000);
+    CHECK(phone->max_delay_us <= ROVER_PHONE_TELEMATICS_BATCH_MS * 1000 + STEP_US);
+#else
+    CHECK_EQ(phone->messages, BURSTS * CLIENT_QUEUE_LEN);
+    CHECK_EQ(phone->missed, BURSTS * (BURST_LEN - CLIENT_QUEUE_LEN));
+    CHECK_EQ(after.drops - before.drops, phone->missed);
+    CHECK(phone->max_delay_us <= STEP_US);
+#endif
+    disconnect_phone(phone);
+}
+
+// A frame every few ms: batched, one websocket frame per window, a window starts with the first
+// frame after the last one was sent
+static void test_steady_stream(void)
+{
+    const uint32_t interval_ms = 7, run_ms = 2000;
+    phone_t* phone = connect_phone();
+
+    settle();
+    for (uint32_t t = 0; t < run_ms; t += interval_ms) {
+        put_telematics(FRAME_LEN);
+        mock_httpd_run_until(esp_timer_get_time() + interval_ms * 1000);
+    }
+    settle();
+
+    uint32_t frames = (run_ms + interval_ms - 1) / interval_ms;
+    printf("A frame every %u ms for %u ms: %u websocket frames, max delay %.1f ms\n", interval_ms, run_ms,
+           phone->messages, phone->max_delay_us / 1000.0);
+    CHECK_EQ(phone->records, frames);
+    CHECK_EQ(phone->missed, 0);
+#ifdef ROVER_PHONE_TELEMATICS_BATCH_MS
+    CHECK(phone->messages >= run_ms / (ROVER_PHONE_TELEMATICS_BATCH_MS + interval_ms));
+    CHECK(phone->messages <= run_ms / ROVER_PHONE_TELEMATICS_BATCH_MS + 1);
+    CHECK(phone->max_delay_us <= ROVER_PHONE_TELEMATICS_BATCH_MS * 1000 + STEP_US);
+#else
+    CHECK_EQ(phone->messages, frames);
+#endif
+    disconnect_phone(phone);
+}
+
+#ifdef ROVER_PHONE_TELEMATICS_BATCH_MS
+// A batch is sent as soon as the next frame doesn't fit, a frame of the largest size fits on its own
+static void test_burst_larger_than_batch(void)
+{
+    const uint16_t len = 400;
+    phone_t* phone = connect_phone();
+
+    settle();
+    for (uint8_t i = 0; i < 5; i++) {
+        put_telematics(len);
+    }
+    put_telematics(ROVER_TELEMATICS_MAX_LEN);
+    settle();
+
+    // Two of 400 fit, the fifth goes alone as the largest doesn't fit with it, the largest when the window ends
+    CHECK_EQ(phone->messages, 4);
+    CHECK_EQ(phone->records, 6);
+    CHECK_EQ(phone->missed, 0);
+    CHECK_EQ(phone->max_message_len, ROVER_TELEMATICS_MAX_LEN + BATCH_RECORD_HEADER_LEN);
+    disconnect_phone(phone);
+}
+#endif
+
+// A phone connecting while telematics are on their way to the others gets the snapshot first and
+// only what is newer after it, never an older frame that was batched or queued before it connected
+static void test_snapshot_ordering(void)
+{
+    const uint32_t interval_ms = 7;
+    const int32_t frames = 100;
+    char frame[64];
+    phone_t* first = connect_phone();
+    phone_t* second = NULL;
+
+    settle();
+    for (int32_t seq = 0; seq < frames; seq++) {
+        snprintf(frame, sizeof(frame), "{\"seq\":%d,\"v\":%d}", seq, 2 * seq);
+        rover_telematics_put((uint8_t*)frame, strlen(frame));
+        if (seq == frames / 2) {
+            // Batched, frames before this one are still waiting for the window to end
+            second = connect_phone();
+            CHECK_EQ(second->last_json_seq, -1);
+        }
+        mock_httpd_run_until(esp_timer_get_time() + interval_ms * 1000);
+    }
+    settle();
+
+    CHECK_EQ(first->last_json_seq, frames - 1);
+    CHECK_EQ(second->last_json_seq, frames - 1);
+    // Every frame, a frame never has two unchanged fields
+    CHECK_EQ(first->records, frames);
+    CHECK(second->records > 0 && second->records <= frames - frames / 2);
+    disconnect_phone(first);
+    disconnect_phone(second);
+}
+
+// CONNECT again on the same socket keeps the phone's slot, a phone more than ROVER_MAX_PHONES is closed,
+// the pages can still be fetched while every phone is connected
+static void test_connect_limits(void)
+{
+    phone_t* connected[ROVER_MAX_PHONES];
+    char body[METRICS_MAX_TEXT_LEN];
+
+    connected[0] = connect_phone();
+    for (uint8_t i = 0; i < 3; i++) {
+        CHECK_EQ(mock_httpd_ws_send_text(connected[0]->fd, "CONNECT"), ESP_OK);
+    }
+    CHECK_EQ(metrics_get(METRIC_PHONES_CONNECTED), 1);
+    for (uint8_t i = 1; i < ROVER_MAX_PHONES; i++) {
+        connected[i] = connect_phone();
+    }
+    CHECK_EQ(metrics_get(METRIC_PHONES_CONNECTED), ROVER_MAX_PHONES);
+
+    int fd = mock_httpd_connect();
+    CHECK(fd != MOCK_HTTPD_NO_SOCKET);
+    CHECK_EQ(mock_httpd_ws_send_text(fd, "CONNECT"), ESP_FAIL);
+    CHECK_EQ(metrics_get(METRIC_PHONES_CONNECTED), ROVER_MAX_PHONES);
+
+    // Two pages fetched at once
+    int first = mock_httpd_connect(), second = mock_httpd_connect();
+    CHECK(first != MOCK_HTTPD_NO_SOCKET && second != MOCK_HTTPD_NO_SOCKET);
+    mock_httpd_close(first);
+    mock_httpd_close(second);
+    CHECK_EQ(mock_httpd_get("/metrics", body, sizeof(body)), 200);
+    CHECK(strstr(body, "phones_connected") != NULL);
+    CHECK_EQ(mock_httpd_get("/tasks", body, sizeof(body)), 200);
+
+    put_telematics(FRAME_LEN);
+    settle();
+    for (uint8_t i = 0; i < ROVER_MAX_PHONES; i++) {
+        CHECK_EQ(connected[i]->records, 1);
+        disconnect_phone(connected[i]);
+    }
+    CHECK_EQ(metrics_get(METRIC_PHONES_CONNECTED), 0);
+}
+
+// One phone reads at half the rate telematics come in and one stopped reading. The other phone still gets every frame right
+// away, the slow ones get what their socket has room for and the httpd task never waits on them.
+// Every buffer the phones shared is freed once they are gone, also with their queues full.
+static void test_slow_phones(void)
+{
+    const uint32_t interval_ms = 10, run_ms = 5000;
+    const uint16_t len = 100;
+    mock_httpd_stats_t before, after;
+    webserver_stats_t stats_before, stats_after;
+    int32_t allocated_before = allocated;
+
+    phone_t* fast = connect_phone();
+    phone_t* slow = connect_phone();
+    phone_t* stalled = connect_phone();
+    mock_httpd_set_read_rate(slow->fd, len * 1000 / interval_ms / 2);
+    mock_httpd_set_read_rate(stalled->fd, 0);
+    settle();
+    mock_httpd_get_stats(&before);
+    webserver_get_stats(&stats_before);
+    for (uint32_t t = 0; t < run_ms; t += interval_ms) {
+        put_telematics(len);
+        mock_httpd_run_until(esp_timer_get_time() + interval_ms * 1000);
+    }
+    settle();
+    mock_httpd_get_stats(&after);
+    webserver_get_stats(&stats_after);
+
+    uint32_t frames = run_ms / interval_ms;
+    printf("%u frames of %u bytes: fast phone %u, max delay %.1f ms, phone reading half of it %u, "
+           "stalled phone %u with %u bytes unread, %u drops\n", frames, len, fast->records,
+           fast->max_delay_us / 1000.0, slow->records, stalled->records, mock_httpd_unread(stalled->fd),
+           stats_after.drops - stats_before.drops);
+    CHECK_EQ(fast->records, frames);
+    CHECK_EQ(fast->missed, 0);
+#ifdef ROVER_PHONE_TELEMATICS_BATCH_MS
+    CHECK(fast->max_delay_us <= ROVER_PHONE_TELEMATICS_BATCH_MS * 1000 + STEP_US);
+#else
+    CHECK(fast->max_delay_us <= STEP_US);
+#endif
+    CHECK(slow->records > 0 && slow->records < frames);
+    CHECK(slow->missed > 0);
+    CHECK_EQ(stalled->records, 0);
+    CHECK(mock_httpd_unread(stalled->fd) >= MOCK_HTTPD_SNDBUF_LEN);
+    CHECK(stats_after.drops > stats_before.drops);
+    CHECK_EQ(after.blocked_sends, before.blocked_sends);
+    CHECK_EQ(after.work_queue_full, before.work_queue_full);
+
+    // Gone with a burst still queued to all of them
+    for (uint8_t i = 0; i < BURST_LEN; i++) {
+        put_telematics(len);
+    }
+    disconnect_phone(fast);
+    disconnect_phone(slow);
+    disconnect_phone(stalled);
+    settle();
+    CHECK_EQ(allocated, allocated_before);
+}
+
+int main(void)
+{
+    host_timer_set_us(START_US);
+    mock_httpd_reset();
+    mock_httpd_register_phone(&on_phone_read);
+    for (uint8_t i = 0; i < MAX_PHONES; i++) {
+        phones[i].fd = MOCK_HTTPD_NO_SOCKET;
+    }
+    link_manager_init();
+    latency_probe_init();
+    webserver_init();
+    webserver_start();
+
+    test_no_phone();
+    test_connect_limits();
+    test_bursts();
+    test_steady_stream();
+#ifdef ROVER_PHONE_TELEMATICS_BATCH_MS
+    test_burst_larger_than_batch();
+#endif
+    test_slow_phones();
+    test_snapshot_ordering();
+    printf("test_web_server passed\n");
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include <string.h>
+#include "host_test.h"
+#include "ws_reassembler.h"
+
+/*
+ * Feeds websocket frames to the reassembler in chunks the way the websocket client hands them
+ * over, whole and cut up at every size, with chunks lost, frames too big for the buffer and
+ * fragmented messages. Every message that comes out must be one that went in, byte for byte.
+ */
+
+#define BUF_LEN             256
+#define OPCODE_PING         0x9
+#define RANDOM_FRAMES       2000
+
+static uint8_t buf[BUF_LEN];
+static ws_reassembler_t reassembler;
+static uint32_t seed = 1;
+
+static uint32_t next_random(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static void fill(uint8_t* frame, int len, uint8_t tag)
+{
+    for (int i = 0; i < len; i++) {
+        frame[i] = tag + i * 7;
+    }
+}
+
+static ws_reassembler_result_t feed(uint8_t op_code, const uint8_t* frame, int offset, int chunk_len, int frame_len,
+                                    uint16_t* length)
+{
+    return ws_reassembler_feed(&reassembler, op_code, frame + offset, chunk_len, offset, frame_len, length);
+}
+
+// Feeds the whole frame in chunks of chunk_len, returns the result of the last chunk
+static ws_reassembler_result_t feed_frame(uint8_t op_code, const uint8_t* frame, int frame_len, int chunk_len,
+                                          uint16_t* length)
+{
+    ws_reassembler_result_t result = WS_REASSEMBLER_NONE;
+
+    for (int offset = 0; offset < frame_len || offset == 0; offset += chunk_len) {
+        int len = frame_len - offset < chunk_len ? frame_len - offset : chunk_len;
+        result = feed(op_code, frame, offset, len, frame_len, length);
+        if (offset + len < frame_len) {
+            CHECK(result != WS_REASSEMBLER_MESSAGE);
+        }
+    }
+    return result;
+}
+
+// length is only read here, after the result was fed
+static void check_message(const uint8_t* frame, int frame_len, ws_reassembler_result_t result, const uint16_t* length)
+{
+    CHECK_EQ(result, WS_REASSEMBLER_MESSAGE);
+    CHECK_EQ(*length, frame_len);
+    CHECK(memcmp(buf, frame, frame_len) == 0);
+}
+
+static void test_every_chunk_size(void)
+{
+    uint8_t frame[BUF_LEN];
+    uint16_t length;
+
+    for (int frame_len = 1; frame_len <= BUF_LEN; frame_len += 17) {
+        for (int chunk_len = 1; chunk_len <= frame_len; chunk_len++) {
+            fill(frame, frame_len, frame_len + chunk_len);
+            check_message(frame, frame_len, feed_frame(WS_REASSEMBLER_OPCODE_BINARY, frame, frame_len, chunk_len, &length),
+                          &length);
+        }
+    }
+    // A frame that fills the buffer exactly, also as text
+    fill(frame, BUF_LEN, 3);
+    check_message(frame, BUF_LEN, feed_frame(WS_REASSEMBLER_OPCODE_TEXT, frame, BUF_LEN, 100, &length), &length);
+}
+
+// Too big for the buffer: dropped once on the first chunk, the rest is skipped, the next frame is taken
+static void test_too_big(void)
+{
+    uint8_t frame[2 * BUF_LEN];
+    uint16_t length;
+
+    fill(frame, sizeof(frame), 1);
+    CHECK_EQ(feed(WS_REASSEMBLER_OPCODE_BINARY, frame, 0, 100, sizeof(frame), &length), WS_REASSEMBLER_DROPPED);
+    for (int offset = 100; offset < (int)sizeof(frame); offset += 100) {
+        int len = sizeof(frame) - offset < 100 ? sizeof(frame) - offset : 100;
+        CHECK_EQ(feed(WS_REASSEMBLER_OPCODE_BINARY, frame, offset, len, sizeof(frame), &length), WS_REASSEMBLER_NONE);
+    }
+    fill(frame, 50, 2);
+    check_message(frame, 50, feed_frame(WS_REASSEMBLER_OPCODE_BINARY, frame, 50, 20, &length), &length);
+}
+
+// A chunk missing in the middle drops the frame, its later chunks are skipped
+static void test_lost_chunk(void)
+{
+    uint8_t frame[200];
+    uint16_t length;
+
+    fill(frame, sizeof(frame), 4);
+    CHECK_EQ(feed(WS_REASSEMBLER_OPCODE_BINARY, frame, 0, 50, sizeof(frame), &length), WS_REASSEMBLER_NONE);
+    CHECK_EQ(feed(WS_REASSEMBLER_OPCODE_BINARY, frame, 100, 50, sizeof(frame), &length), WS_REASSEMBLER_DROPPED);
+    CHECK_EQ(feed(WS_REASSEMBLER_OPCODE_BINARY, frame, 150, 50, sizeof(frame), &length), WS_REASSEMBLER_NONE);
+
+    check_message(frame, sizeof(frame), feed_frame(WS_REASSEMBLER_OPCODE_BINARY, frame, sizeof(frame), 64, &length),
+                  &length);
+
+    // Starting in the middle of a frame, e.g. after a reconnect
+    CHECK_EQ(feed(WS_REASSEMBLER_OPCODE_BINARY, frame, 150, 50, sizeof(frame), &length), WS_REASSEMBLER_DROPPED);
+    check_message(frame, sizeof(frame), feed_frame(WS_REASSEMBLER_OPCODE_BINARY, frame, sizeof(frame), 64, &length),
+                  &length);
+}
+
+// A new frame while one is still being put together: the unfinished one is lost, the new one is taken
+static void test_frame_cut_off(void)
+{
+    uint8_t first[200], second[120];
+    uint16_t length;
+
+    fill(first, sizeof(first), 5);
+    fill(second, sizeof(second), 6);
+    CHECK_EQ(feed(WS_REASSEMBLER_OPCODE_BINARY, first, 0, 100, sizeof(first), &length), WS_REASSEMBLER_NONE);
+    check_message(second, sizeof(second), feed_frame(WS_REASSEMBLER_OPCODE_BINARY, second, sizeof(second), 50, &length),
+                  &length);
+}
+
+// A chunk running past the frame length can't be trusted
+static void test_chunk_past_end(void)
+{
+    uint8_t frame[100];
+    uint16_t length;
+
+    fill(frame, sizeof(frame), 7);
+    CHECK_EQ(feed(WS_REASSEMBLER_OPCODE_BINARY, frame, 0, 60, 80, &length), WS_REASSEMBLER_NONE);
+    CHECK_EQ(feed(WS_REASSEMBLER_OPCODE_BINARY, frame, 60, 40, 80, &length), WS_REASSEMBLER_DROPPED);
+}
+
+// Continuation frames of a fragmented message are dropped once, control frames in between don't matter
+static void test_fragmented_and_control(void)
+{
+    uint8_t frame[150];
+    uint16_t length;
+
+    fill(frame, sizeof(frame), 8);
+    CHECK_EQ(feed(WS_REASSEMBLER_OPCODE_CONT, frame, 0, 50, sizeof(frame), &length), WS_REASSEMBLER_DROPPED);
+    CHECK_EQ(feed(WS_REASSEMBLER_OPCODE_CONT, frame, 50, 50, sizeof(frame), &length), WS_REASSEMBLER_NONE);
+    CHECK_EQ(feed(OPCODE_PING, frame, 0, 4, 4, &length), WS_REASSEMBLER_NONE);
+
+    CHECK_EQ(feed(WS_REASSEMBLER_OPCODE_BINARY, frame, 0, 100, sizeof(frame), &length), WS_REASSEMBLER_NONE);
+    CHECK_EQ(feed(OPCODE_PING, frame, 0, 4, 4, &length), WS_REASSEMBLER_NONE);
+    check_message(frame, sizeof(frame), feed(WS_REASSEMBLER_OPCODE_BINARY, frame, 100, 50, sizeof(frame), &length),
+                  &length);
+}
+
+// Random frames in random chunks with some chunks lost: what comes out is exactly the frames that were complete,
+// a frame is reported dropped if it is too big or a chunk came after a lost one
+static void test_random_stream(void)
+{
+    uint8_t frame[BUF_LEN + 64];
+    uint32_t complete = 0, delivered = 0, dropped = 0, expect_dropped = 0;
+    uint16_t length;
+
+    for (int n = 0; n < RANDOM_FRAMES; n++) {
+        int frame_len = 1 + next_random() % sizeof(frame);
+        bool lose_chunk = next_random() % 8 == 0;
+        bool lost = false, fed_after_loss = false;
+        ws_reassembler_result_t result = WS_REASSEMBLER_NONE;
+
+        fill(frame, frame_len, n);
+        for (int offset = 0; offset < frame_len; ) {
+            int len = 1 + next_random() % 200;
+            len = frame_len - offset < len ? frame_len - offset : len;
+            // Never the first chunk, without it the frame is never started
+            if (lose_chunk && offset > 0 && !lost) {
+                lost = true;
+            } else {
+                fed_after_loss = fed_after_loss || lost;
+                result = feed(WS_REASSEMBLER_OPCODE_BINARY, frame, offset, len, frame_len, &length);
+                dropped += result == WS_REASSEMBLER_DROPPED;
+            }
+            offset += len;
+        }
+        if (frame_len > BUF_LEN) {
+            expect_dropped++;
+        } else if (lost) {
+            expect_dropped += fed_after_loss;
+        } else {
+            complete++;
+            check_message(frame, frame_len, result, &length);
+            delivered++;
+        }
+        if (frame_len > BUF_LEN || lost) {
+            CHECK(result != WS_REASSEMBLER_MESSAGE);
+        }
+    }
+    printf("%u random frames: %u delivered, %u dropped\n", RANDOM_FRAMES, delivered, dropped);
+    CHECK_EQ(delivered, complete);
+    CHECK_EQ(dropped, expect_dropped);
+}
+
+int main(void)
+{
+    ws_reassembler_init(&reassembler, buf, sizeof(buf));
+
+    test_every_chunk_size();
+    test_too_big();
+    test_lost_chunk();
+    test_frame_cut_off();
+    test_chunk_past_end();
+    test_fragmented_and_control();
+    test_random_stream();
+    printf("test_ws_reassembler passed\n");
+    return 0;
+}
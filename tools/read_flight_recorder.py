@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# Prints the records of a flight recorder partition dump in time order, see main/flight_recorder.h
+#
+#   esptool.py read_flash 0x110000 0x200000 flight.bin
+#   python tools/read_flight_recorder.py flight.bin [--csv]
+
+import struct
+import sys
+
+MAGIC = 0x43455246
+VERSION = 1
+SECTOR_SIZE = 4096
+SECTOR_HEADER = struct.Struct('<IIHBB')
+RECORD_HEADER = struct.Struct('<IBBH')
+
+TYPES = {0: 'control', 1: 'telematics'}
+TRANSPORTS = {0: 'lora', 1: 'ws', 2: 'udp'}
+
+
+def read_sectors(data):
+    sectors = []
+    for offset in range(0, len(data) - SECTOR_SIZE + 1, SECTOR_SIZE):
+        magic, sequence, used, version, _ = SECTOR_HEADER.unpack_from(data, offset)
+        if magic != MAGIC:
+            continue
+        if version != VERSION or used < SECTOR_HEADER.size or used > SECTOR_SIZE:
+            print('Skipping sector at 0x%x, version %d used %d' % (offset, version, used), file=sys.stderr)
+            continue
+        sectors.append((sequence, data[offset + SECTOR_HEADER.size:offset + used]))
+    # Sequence numbers only wrap after 2^32 sectors, a plain sort is enough
+    sectors.sort(key=lambda sector: sector[0])
+    return sectors
+
+
+def read_records(body):
+    offset = 0
+    while offset + RECORD_HEADER.size <= len(body):
+        time_ms, record_type, transport, length = RECORD_HEADER.unpack_from(body, offset)
+        offset += RECORD_HEADER.size
+        yield time_ms, record_type, transport, body[offset:offset + length]
+        offset += length
+
+
+def main():
+    if len(sys.argv) < 2:
+        print('usage: read_flight_recorder.py <dump> [--csv]', file=sys.stderr)
+        sys.exit(1)
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+    csv = '--csv' in sys.argv[2:]
+
+    if csv:
+        print('time_ms,type,transport,data')
+    for sequence, body in read_sectors(data):
+        for time_ms, record_type, transport, payload in read_records(body):
+            type_name = TYPES.get(record_type, str(record_type))
+            transport_name = TRANSPORTS.get(transport, str(transport))
+            if csv:
+                print('%d,%s,%s,%s' % (time_ms, type_name, transport_name, payload.hex()))
+            elif record_type == 1 and payload.isascii():
+                print('%10d %-10s %-4s %s' % (time_ms, type_name, transport_name, payload.decode()))
+            else:
+                print('%10d %-10s %-4s %s' % (time_ms, type_name, transport_name, payload.hex(' ')))
+
+
+if __name__ == '__main__':
+    main()